@@ -1,34 +1,96 @@
 import argparse
-import struct
 
 import numpy as np
 import matplotlib.pyplot as plt
 
+def decode_feature(filename, header):
+  """Decode feature written by `fextor --codec` or `fextor --dtype`."""
+  num_frame, feat_dim, codec, dtype = header[8:24].view(np.uint32)
+  data_offset = int(header[24:32].view(np.uint64)[0])
+  scale = float(header[40:48].view(np.float64)[0])
+  print("num_frame : {}, feat_dim : {}, codec : {}, dtype : {}".format(
+      num_frame, feat_dim, codec, dtype))
+  shape = (int(num_frame), int(feat_dim))
+
+  if int(codec) == 0:
+    values = {1: np.float32, 2: np.float64, 3: np.float16, 4: np.uint16, 5: np.int8}
+    if int(dtype) not in values:
+      raise ValueError("decode_feature() - unknown dtype : {}".format(dtype))
+    x = np.memmap(filename, dtype=values[int(dtype)], mode='r', offset=data_offset,
+                  shape=shape)
+    if int(dtype) == 4:
+      # bfloat16 is upper half of float32
+      return (x.astype(np.uint32) << 16).view(np.float32)
+    if int(dtype) == 5:
+      return scale * x.astype(np.float32)
+    return x
+
+  codes = {1: np.uint16, 2: np.uint8}
+  if int(codec) not in codes:
+    raise ValueError("decode_feature() - unknown codec : {}".format(codec))
+  tables = np.fromfile(filename, dtype=np.float64, count=2 * int(feat_dim), offset=64)
+  scale, offset = tables[:feat_dim], tables[feat_dim:]
+  q = np.memmap(filename, dtype=codes[int(codec)], mode='r', offset=data_offset,
+                shape=shape)
+  return offset + scale * q
+
 def load_feature(filename):
-  feats = []
-  with open(filename, "rb") as f:
-    num_frame = struct.unpack('I', f.read(4))[0]
-    feat_dim = struct.unpack('I', f.read(4))[0]
-    size = struct.unpack('L', f.read(8))[0]
-    
-    print("num_frame : {}, feat_dim : {}, size : {}".format(num_frame, feat_dim, size))
+  """Map feature written by fextor (.feat or .npy), without copying."""
+  if filename.endswith('.npy'):
+    feats = np.load(filename, mmap_mode='r')
+    print("num_frame : {}, feat_dim : {}".format(*feats.shape))
+    return feats
+
+  header = np.fromfile(filename, dtype=np.uint8, count=64)
+  if bytes(header[:4]) == b'FXFT':
+    return decode_feature(filename, header)
+
+  header = header[:16]
+  num_frame, feat_dim = header[:8].view(np.uint32)
+  size = int(header[8:].view(np.uint64)[0])
+  print("num_frame : {}, feat_dim : {}, size : {}".format(num_frame, feat_dim, size))
+  if size == 4:
+    dtype = np.float32
+  elif size == 8:
+    dtype = np.float64
+  else:
+    raise ValueError("load_feature() - size must be 4 or 8.")
+  return np.memmap(filename, dtype=dtype, mode='r', offset=16,
+                   shape=(int(num_frame), int(feat_dim)))
+
+def load_archive(filename, utterance_id):
+  """Find feature of `utterance_id` in archive written by `fextor --archive`.
+  Returned array is mapped from file, without copying."""
+  dtypes = {1: np.float32, 2: np.float64}
+  data = np.memmap(filename, dtype=np.uint8, mode='r')
+  if bytes(data[:8]) != b'FXARCHIV':
+    raise ValueError("load_archive() - invalid archive : {}".format(filename))
+  index_offset = int(data[24:32].view('<u8')[0])
 
-    feats = []
-    for n in range(num_frame):
-      if size == 4:
-        x = [struct.unpack('f', f.read(4))[0] for i in range(feat_dim)]
-      elif size == 8:
-        x = [struct.unpack('d', f.read(8))[0] for i in range(feat_dim)]
-      else:
-        raise ValueError("load_feature() - size must be 4 or 8.")
-      feats.append(x)
-  return np.array(feats)
+  # Records are scanned if index is not written
+  offset = 64
+  end = index_offset if index_offset > 0 else len(data)
+  while offset + 64 <= end:
+    if bytes(data[offset:offset + 4]) != b'FREC':
+      break
+    dtype, num_frame, feat_dim, id_length = data[offset + 4:offset + 20].view('<u4')
+    data_offset, data_size, record_size = data[offset + 24:offset + 48].view('<u8')
+    record_id = bytes(data[offset + 64:offset + 64 + id_length]).decode()
+    if record_id == utterance_id:
+      begin = offset + int(data_offset)
+      feats = data[begin:begin + int(data_size)].view(dtypes[int(dtype)])
+      print("num_frame : {}, feat_dim : {}".format(num_frame, feat_dim))
+      return feats.reshape(int(num_frame), int(feat_dim))
+    offset += int(record_size)
+  raise KeyError("load_archive() - id is not found : {}".format(utterance_id))
 
 
 if __name__ == '__main__':
   parser = argparse.ArgumentParser()
   parser.add_argument('-i', '--input_file_name', type=str, required=True)
   parser.add_argument('-o', '--output_file_name', type=str, required=True)
+  parser.add_argument('--id', type=str, default=None,
+                      help='utterance id, if input is archive')
   args = parser.parse_args()
 
   # parsing arguments
@@ -36,7 +98,10 @@ if __name__ == '__main__':
   output_file_name = args.output_file_name
 
   # load features
-  feats = load_feature(input_file_name)
+  if args.id is not None:
+    feats = np.array(load_archive(input_file_name, args.id))
+  else:
+    feats = np.array(load_feature(input_file_name))
   feats[:,0] = 0
   fig, ax = plt.subplots()
   cax = ax.imshow(feats.T, origin='lower')
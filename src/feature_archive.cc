@@ -0,0 +1,387 @@
+#include "feature_archive.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(FeatureArchiveHeader) == FEATURE_ARCHIVE_ALIGN,
+              "header of archive must fill one aligned block");
+static_assert(sizeof(FeatureRecordHeader) == FEATURE_ARCHIVE_ALIGN,
+              "header of record must fill one aligned block");
+
+static const char kArchiveMagic[8] = {'F', 'X', 'A', 'R', 'C', 'H', 'I', 'V'};
+static const char kRecordMagic[4] = {'F', 'R', 'E', 'C'};
+
+// Entry of index, followed by id padded to multiple of 8 bytes
+typedef struct index_entry_t {
+  uint64_t offset;
+  uint32_t id_length;
+  uint32_t reserved;
+} IndexEntry;
+
+static inline uint64_t align_size(const uint64_t size, const uint64_t align) {
+  return (size + align - 1) / align * align;
+}
+
+static inline bool is_little_endian() {
+  const uint16_t value = 1;
+  return *(const uint8_t *)&value == 1;
+}
+
+// Record at `offset` lies within `map_size` bytes, and its data hold exactly
+// `num_frame` x `feat_dim` values of its dtype. Sums are checked without
+// overflow, since headers are read from file.
+static bool is_valid_record(const FeatureRecordHeader *record,
+                            const uint64_t offset, const uint64_t map_size) {
+  const uint64_t dtype_size = getDtypeSize((int)record->dtype);
+  const uint64_t num_values = (uint64_t)record->num_frame * record->feat_dim;
+  return memcmp(record->magic, kRecordMagic, sizeof(kRecordMagic)) == 0 &&
+         dtype_size != 0 && num_values <= UINT64_MAX / dtype_size &&
+         record->data_size == num_values * dtype_size &&
+         record->record_size != 0 &&
+         record->record_size % FEATURE_ARCHIVE_ALIGN == 0 &&
+         offset <= map_size && record->record_size <= map_size - offset &&
+         record->data_offset <= record->record_size &&
+         record->data_size <= record->record_size - record->data_offset &&
+         sizeof(FeatureRecordHeader) + (uint64_t)record->id_length <= record->data_offset;
+}
+
+static bool write_padding(FILE *fp, const uint64_t size) {
+  static const char zeros[FEATURE_ARCHIVE_ALIGN] = {0};
+  return size == 0 || fwrite(zeros, 1, size, fp) == size;
+}
+
+FeatureArchiveWriter::FeatureArchiveWriter()
+  : fp_(NULL)
+  , position_(0) {
+
+}
+
+FeatureArchiveWriter::~FeatureArchiveWriter() {
+  if (fp_ != NULL) {
+    close();
+  }
+}
+
+int FeatureArchiveWriter::open(const char *file_name, const bool append) {
+  if (file_name == NULL || fp_ != NULL) {
+    fprintf(stderr, "FeatureArchiveWriter::open() - invalid argument or already opened.\n");
+    return 1;
+  }
+
+  offsets_.clear();
+  ids_.clear();
+  id_set_.clear();
+  position_ = FEATURE_ARCHIVE_ALIGN;
+
+  // Take over records of existing archive, index is overwritten by new records
+  if (append && access(file_name, F_OK) == 0) {
+    FeatureArchiveReader reader;
+    if (reader.open(file_name) != 0) {
+      return 1;
+    }
+    for (auto &id : reader.getIds()) {
+      id_set_[id] = ids_.size();
+      ids_.push_back(id);
+      offsets_.push_back(reader.offsets_[id]);
+    }
+    position_ = reader.records_end_;
+    reader.close();
+
+    fp_ = fopen(file_name, "r+b");
+    if (fp_ == NULL || ftruncate(fileno(fp_), (off_t)position_) != 0 ||
+        fseeko(fp_, (off_t)position_, SEEK_SET) != 0) {
+      fprintf(stderr, "FeatureArchiveWriter::open() - failed to open file : %s\n", file_name);
+      if (fp_ != NULL) {
+        fclose(fp_);
+        fp_ = NULL;
+      }
+      return 1;
+    }
+  } else {
+    fp_ = fopen(file_name, "wb");
+    if (fp_ == NULL) {
+      fprintf(stderr, "FeatureArchiveWriter::open() - failed to open file : %s\n", file_name);
+      return 1;
+    }
+  }
+
+  // Header without index, so that archive is readable even if writer stops
+  // before `close()`
+  FeatureArchiveHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kArchiveMagic, sizeof(kArchiveMagic));
+  header.version = FEATURE_ARCHIVE_VERSION;
+  header.is_little_endian = is_little_endian() ? 1 : 0;
+  if (fseeko(fp_, 0, SEEK_SET) != 0 ||
+      fwrite(&header, sizeof(header), 1, fp_) != 1 ||
+      fseeko(fp_, (off_t)position_, SEEK_SET) != 0) {
+    fprintf(stderr, "FeatureArchiveWriter::open() - failed to write header.\n");
+    fclose(fp_);
+    fp_ = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+int FeatureArchiveWriter::append(const std::string &id, const Feature &feat) {
+  return append(id, (const void *)feat.getData(), FEXTOR_DTYPE_NATIVE,
+                feat.getNumFrame(), feat.getFeatDim());
+}
+
+int FeatureArchiveWriter::append(const std::string &id, const void *data,
+                                 const unsigned int dtype,
+                                 const unsigned int num_frame,
+                                 const unsigned int feat_dim) {
+  // Scale of int8 has no place in record, so that int8 is not accepted
+  const unsigned int dtype_size = getDtypeSize(dtype);
+  if (id.empty() || dtype_size == 0 || dtype == FEXTOR_DTYPE_INT8) {
+    fprintf(stderr, "FeatureArchiveWriter::append() - invalid argument.\n");
+    return 1;
+  }
+
+  FeatureRecordHeader record;
+  memset(&record, 0, sizeof(record));
+  memcpy(record.magic, kRecordMagic, sizeof(kRecordMagic));
+  record.dtype = dtype;
+  record.num_frame = num_frame;
+  record.feat_dim = feat_dim;
+  record.id_length = (uint32_t)id.size();
+  record.data_offset = align_size(sizeof(record) + id.size(), FEATURE_ARCHIVE_ALIGN);
+  record.data_size = (uint64_t)num_frame * feat_dim * dtype_size;
+  record.record_size = align_size(record.data_offset + record.data_size,
+                                  FEATURE_ARCHIVE_ALIGN);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (fp_ == NULL) {
+    fprintf(stderr, "FeatureArchiveWriter::append() - archive is not opened.\n");
+    return 1;
+  }
+  if (id_set_.find(id) != id_set_.end()) {
+    fprintf(stderr, "FeatureArchiveWriter::append() - duplicated id : %s\n", id.c_str());
+    return 1;
+  }
+
+  const uint64_t id_end = sizeof(record) + id.size();
+  const uint64_t data_end = record.data_offset + record.data_size;
+  bool is_written =
+      fwrite(&record, sizeof(record), 1, fp_) == 1 &&
+      fwrite(id.data(), 1, id.size(), fp_) == id.size() &&
+      write_padding(fp_, record.data_offset - id_end) &&
+      (record.data_size == 0 ||
+       fwrite(data, 1, record.data_size, fp_) == record.data_size) &&
+      write_padding(fp_, record.record_size - data_end);
+  if (!is_written) {
+    // Drop partial record, so that next record starts at its boundary
+    fprintf(stderr, "FeatureArchiveWriter::append() - failed to write record : %s\n", id.c_str());
+    fseeko(fp_, (off_t)position_, SEEK_SET);
+    return 1;
+  }
+
+  id_set_[id] = ids_.size();
+  ids_.push_back(id);
+  offsets_.push_back(position_);
+  position_ += record.record_size;
+  return 0;
+}
+
+int FeatureArchiveWriter::close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (fp_ == NULL) {
+    return 0;
+  }
+
+  int error_code = 0;
+  uint64_t index_size = 0;
+  for (size_t i = 0; i < ids_.size(); i++) {
+    IndexEntry entry;
+    entry.offset = offsets_[i];
+    entry.id_length = (uint32_t)ids_[i].size();
+    entry.reserved = 0;
+    const uint64_t id_size = align_size(ids_[i].size(), 8);
+    if (fwrite(&entry, sizeof(entry), 1, fp_) != 1 ||
+        fwrite(ids_[i].data(), 1, ids_[i].size(), fp_) != ids_[i].size() ||
+        !write_padding(fp_, id_size - ids_[i].size())) {
+      error_code = 1;
+      break;
+    }
+    index_size += sizeof(entry) + id_size;
+  }
+
+  if (error_code == 0) {
+    FeatureArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kArchiveMagic, sizeof(kArchiveMagic));
+    header.version = FEATURE_ARCHIVE_VERSION;
+    header.is_little_endian = is_little_endian() ? 1 : 0;
+    header.num_records = ids_.size();
+    header.index_offset = position_;
+    header.index_size = index_size;
+    if (fseeko(fp_, 0, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, fp_) != 1) {
+      error_code = 1;
+    }
+  }
+  if (fclose(fp_) != 0) {
+    error_code = 1;
+  }
+  fp_ = NULL;
+
+  if (error_code != 0) {
+    fprintf(stderr, "FeatureArchiveWriter::close() - failed to write index.\n");
+  }
+  return error_code;
+}
+
+FeatureArchiveReader::FeatureArchiveReader()
+  : map_(NULL)
+  , map_size_(0)
+  , records_end_(0) {
+
+}
+
+FeatureArchiveReader::~FeatureArchiveReader() {
+  close();
+}
+
+int FeatureArchiveReader::open(const char *file_name) {
+  close();
+  if (file_name == NULL) {
+    fprintf(stderr, "FeatureArchiveReader::open() - invalid argument.\n");
+    return 1;
+  }
+
+  int fd = ::open(file_name, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "FeatureArchiveReader::open() - failed to open file : %s\n", file_name);
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FeatureArchiveHeader)) {
+    fprintf(stderr, "FeatureArchiveReader::open() - invalid archive : %s\n", file_name);
+    ::close(fd);
+    return 1;
+  }
+  void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "FeatureArchiveReader::open() - failed to map file : %s\n", file_name);
+    return 1;
+  }
+  map_ = (const unsigned char *)map;
+  map_size_ = (size_t)st.st_size;
+
+  const FeatureArchiveHeader *header = (const FeatureArchiveHeader *)map_;
+  if (memcmp(header->magic, kArchiveMagic, sizeof(kArchiveMagic)) != 0 ||
+      header->version != FEATURE_ARCHIVE_VERSION) {
+    fprintf(stderr, "FeatureArchiveReader::open() - invalid archive : %s\n", file_name);
+    close();
+    return 1;
+  }
+  if ((header->is_little_endian != 0) != is_little_endian()) {
+    fprintf(stderr, "FeatureArchiveReader::open() - byte order of archive is "
+            "different from this machine : %s\n", file_name);
+    close();
+    return 1;
+  }
+
+  int error_code = (header->index_offset != 0) ? readIndex(header) : scanRecords();
+  if (error_code != 0) {
+    fprintf(stderr, "FeatureArchiveReader::open() - broken archive : %s\n", file_name);
+    close();
+  }
+  return error_code;
+}
+
+void FeatureArchiveReader::close() {
+  if (map_ != NULL) {
+    munmap((void *)map_, map_size_);
+    map_ = NULL;
+  }
+  map_size_ = 0;
+  records_end_ = 0;
+  offsets_.clear();
+  ids_.clear();
+}
+
+int FeatureArchiveReader::readIndex(const FeatureArchiveHeader *header) {
+  if (header->index_offset < FEATURE_ARCHIVE_ALIGN ||
+      header->index_offset > map_size_ ||
+      header->index_size > map_size_ - header->index_offset) {
+    return 1;
+  }
+
+  uint64_t position = header->index_offset;
+  const uint64_t index_end = header->index_offset + header->index_size;
+  for (uint64_t i = 0; i < header->num_records; i++) {
+    if (position + sizeof(IndexEntry) > index_end) {
+      return 1;
+    }
+    IndexEntry entry;
+    memcpy(&entry, map_ + position, sizeof(entry));
+    position += sizeof(entry);
+    if (position + entry.id_length > index_end ||
+        entry.offset > header->index_offset - sizeof(FeatureRecordHeader)) {
+      return 1;
+    }
+    std::string id((const char *)(map_ + position), entry.id_length);
+    position += align_size(entry.id_length, 8);
+
+    offsets_[id] = entry.offset;
+    ids_.push_back(id);
+  }
+  records_end_ = header->index_offset;
+  return 0;
+}
+
+int FeatureArchiveReader::addRecord(const uint64_t offset,
+                                    uint64_t *record_size) {
+  if (offset + sizeof(FeatureRecordHeader) > map_size_) {
+    return 1;
+  }
+  const FeatureRecordHeader *record = (const FeatureRecordHeader *)(map_ + offset);
+  if (!is_valid_record(record, offset, map_size_)) {
+    return 1;
+  }
+
+  std::string id((const char *)(map_ + offset + sizeof(FeatureRecordHeader)),
+                 record->id_length);
+  offsets_[id] = offset;
+  ids_.push_back(id);
+  (*record_size) = record->record_size;
+  return 0;
+}
+
+// Archive is not closed by writer, so that records are scanned from the
+// first one. Partially written record at the end is ignored.
+int FeatureArchiveReader::scanRecords() {
+  uint64_t offset = FEATURE_ARCHIVE_ALIGN;
+  uint64_t record_size;
+  while (offset < map_size_ && addRecord(offset, &record_size) == 0) {
+    offset += record_size;
+  }
+  records_end_ = offset;
+  return 0;
+}
+
+int FeatureArchiveReader::find(const std::string &id, FeatureView *view) const {
+  auto it = offsets_.find(id);
+  if (it == offsets_.end()) {
+    return 1;
+  }
+
+  const FeatureRecordHeader *record = (const FeatureRecordHeader *)(map_ + it->second);
+  if (it->second + sizeof(FeatureRecordHeader) > map_size_ ||
+      !is_valid_record(record, it->second, map_size_)) {
+    fprintf(stderr, "FeatureArchiveReader::find() - broken record : %s\n", id.c_str());
+    return 1;
+  }
+  view->data = (const void *)(map_ + it->second + record->data_offset);
+  view->num_frame = record->num_frame;
+  view->feat_dim = record->feat_dim;
+  view->dtype = record->dtype;
+  return 0;
+}
@@ -0,0 +1,130 @@
+#ifndef FEATURE_ARCHIVE_H
+#define FEATURE_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fextor_app.h"
+
+// Records and index of archive are aligned by this number of bytes
+#define FEATURE_ARCHIVE_ALIGN 64
+#define FEATURE_ARCHIVE_VERSION 1
+
+// Archive of features of many utterances in a single file.
+//
+// layout :
+//   header (64 bytes)
+//   record 0, record 1, ...   (appended, each aligned by 64 bytes)
+//   index                     (written by `close()`)
+//
+// Each record has header of 64 bytes, followed by utterance id and by data
+// of `num_frame` x `feat_dim` values, which starts at 64-byte boundary.
+// Index has offset and id of every record, so that reader finds any record
+// without touching the others. If archive is not closed, reader rebuilds
+// index by scanning records. Values are stored in byte order of writer,
+// which is recorded in header.
+
+typedef struct feature_archive_header_t {
+  char magic[8];               // "FXARCHIV"
+  uint32_t version;
+  uint8_t is_little_endian;
+  uint8_t reserved0[3];
+  uint64_t num_records;
+  uint64_t index_offset;       // 0 if index is not written
+  uint64_t index_size;
+  uint8_t reserved1[24];
+} FeatureArchiveHeader;
+
+typedef struct feature_record_header_t {
+  char magic[4];               // "FREC"
+  uint32_t dtype;              // FEXTOR_DTYPE_*
+  uint32_t num_frame;
+  uint32_t feat_dim;
+  uint32_t id_length;
+  uint32_t reserved0;
+  uint64_t data_offset;        // from start of record
+  uint64_t data_size;          // in bytes
+  uint64_t record_size;        // in bytes, including padding
+  uint8_t reserved1[16];
+} FeatureRecordHeader;
+
+// Read-only view of feature in archive. `data` points into mapped archive,
+// and is valid while the reader is open.
+typedef struct feature_view_t {
+  const void *data;
+  unsigned int num_frame;
+  unsigned int feat_dim;
+  unsigned int dtype;
+
+  feature_view_t() : data(NULL), num_frame(0), feat_dim(0), dtype(0) {}
+} FeatureView;
+
+// Append features into archive. `append()` can be called by multiple
+// threads at once.
+class FeatureArchiveWriter {
+public:
+  FeatureArchiveWriter();
+  virtual ~FeatureArchiveWriter();
+
+private:
+  FILE *fp_;
+  uint64_t position_;                      // end of last record
+  std::vector<uint64_t> offsets_;          // offset of each record
+  std::vector<std::string> ids_;
+  std::unordered_map<std::string, size_t> id_set_;
+  std::mutex mutex_;
+
+public:
+  // Create archive. If `append` is set and archive exists, records are
+  // appended after existing ones instead.
+  int open(const char *file_name, const bool append = false);
+
+  // Append feature of utterance. Returns non-zero if id is already in
+  // archive, or on failure of writing.
+  int append(const std::string &id, const Feature &feat);
+
+  // Same as above, but data is given as raw values of `dtype`
+  int append(const std::string &id, const void *data, const unsigned int dtype,
+             const unsigned int num_frame, const unsigned int feat_dim);
+
+  // Write index and header. Archive without index is still readable.
+  int close();
+}; // class FeatureArchiveWriter
+
+// Map archive into memory and look up features by utterance id in O(1)
+class FeatureArchiveReader {
+public:
+  FeatureArchiveReader();
+  virtual ~FeatureArchiveReader();
+
+private:
+  const unsigned char *map_;
+  size_t map_size_;
+  std::unordered_map<std::string, uint64_t> offsets_;
+  std::vector<std::string> ids_;  // in order of records
+  uint64_t records_end_;          // end of last record
+
+  friend class FeatureArchiveWriter;
+
+  int readIndex(const FeatureArchiveHeader *header);
+  int scanRecords();
+  int addRecord(const uint64_t offset, uint64_t *record_size);
+
+public:
+  int open(const char *file_name);
+  void close();
+
+  // Returns non-zero if `id` is not in archive
+  int find(const std::string &id, FeatureView *view) const;
+
+  size_t size() const { return ids_.size(); }
+  const std::vector<std::string> &getIds() const { return ids_; }
+}; // class FeatureArchiveReader
+
+#endif // FEATURE_ARCHIVE_H
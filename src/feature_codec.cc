@@ -0,0 +1,538 @@
+#include "feature_codec.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// F16C is used when built with -mf16c, otherwise when detected at run time
+#if !USE_DOUBLE_PRECISION && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define FEXTOR_USE_F16C 1
+#if defined(__F16C__)
+#define FEXTOR_F16C_TARGET
+#else
+#define FEXTOR_F16C_TARGET __attribute__((target("avx,f16c")))
+#endif
+#endif
+
+#include "fextor_app.h"
+
+static_assert(sizeof(FeatFileHeader) == 64, "header of .feat must be 64 bytes");
+
+static const char kFeatMagic[4] = {'F', 'X', 'F', 'T'};
+
+static unsigned int get_code_size(const int codec) {
+  switch (codec)
+  {
+  case FEXTOR_CODEC_Q16:
+    return 2;
+  case FEXTOR_CODEC_Q8:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Round to nearest even, as conversion by F16C
+static inline uint16_t float_to_half(const float value) {
+  uint32_t x;
+  memcpy(&x, &value, sizeof(x));
+  const uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+  const uint32_t abs = x & 0x7fffffff;
+  if (abs > 0x7f800000) {
+    return sign | 0x7e00 | (uint16_t)((abs >> 13) & 0x3ff);  // quiet NaN
+  }
+  if (abs >= 0x477ff000) {
+    return sign | 0x7c00;  // overflow, rounded to infinity
+  }
+  if (abs < 0x33000000) {
+    return sign;           // underflow, rounded to zero
+  }
+
+  uint32_t bits, remainder, halfway;
+  if (abs < 0x38800000) {
+    // subnormal of half precision
+    const uint32_t shift = 126 - (abs >> 23);
+    const uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+    bits = mantissa >> shift;
+    remainder = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    bits = (abs - 0x38000000) >> 13;
+    remainder = abs & 0x1fff;
+    halfway = 0x1000;
+  }
+  if (remainder > halfway || (remainder == halfway && (bits & 1))) {
+    bits++;
+  }
+  return sign | (uint16_t)bits;
+}
+
+static inline float half_to_float(const uint16_t value) {
+  const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1f;
+  const uint32_t mantissa = value & 0x3ff;
+  uint32_t x;
+  if (exponent == 0x1f) {
+    // infinity, or NaN which is made quiet
+    x = sign | 0x7f800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);
+  } else if (exponent != 0) {
+    x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else {
+    // zero or subnormal, which is mantissa x 2^-24
+    const float abs = (float)mantissa * 5.9604644775390625e-8f;
+    return sign ? -abs : abs;
+  }
+  float result;
+  memcpy(&result, &x, sizeof(result));
+  return result;
+}
+
+static inline uint16_t float_to_bfloat(const float value) {
+  uint32_t x;
+  memcpy(&x, &value, sizeof(x));
+  if ((x & 0x7fffffff) > 0x7f800000) {
+    return (uint16_t)((x >> 16) | 0x40);  // NaN stays quiet NaN
+  }
+  return (uint16_t)((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+static inline float bfloat_to_float(const uint16_t value) {
+  const uint32_t x = (uint32_t)value << 16;
+  float result;
+  memcpy(&result, &x, sizeof(result));
+  return result;
+}
+
+#ifdef FEXTOR_USE_F16C
+static bool has_f16c() {
+#if defined(__F16C__)
+  return true;
+#else
+  static const bool is_supported = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  }();
+  return is_supported;
+#endif
+}
+
+// Converts multiples of 8 values, and returns number of converted values
+FEXTOR_F16C_TARGET
+static size_t encode_half_f16c(const float* data, const size_t num_values,
+                               uint16_t* out) {
+  size_t i = 0;
+  for (; i + 8 <= num_values; i += 8) {
+    _mm_storeu_si128((__m128i*)(out + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(data + i),
+                                     _MM_FROUND_TO_NEAREST_INT));
+  }
+  return i;
+}
+
+FEXTOR_F16C_TARGET
+static size_t decode_half_f16c(const uint16_t* in, const size_t num_values,
+                               float* data) {
+  size_t i = 0;
+  for (; i + 8 <= num_values; i += 8) {
+    _mm256_storeu_ps(data + i,
+                     _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(in + i))));
+  }
+  return i;
+}
+#endif
+
+static void encode_half(const dsp::float_t* data, const size_t num_values,
+                        uint16_t* out) {
+  size_t i = 0;
+#ifdef FEXTOR_USE_F16C
+  if (has_f16c()) {
+    i = encode_half_f16c(data, num_values, out);
+  }
+#endif
+  for (; i < num_values; i++) {
+    out[i] = float_to_half((float)data[i]);
+  }
+}
+
+static void decode_half(const uint16_t* in, const size_t num_values,
+                        dsp::float_t* data) {
+  size_t i = 0;
+#ifdef FEXTOR_USE_F16C
+  if (has_f16c()) {
+    i = decode_half_f16c(in, num_values, data);
+  }
+#endif
+  for (; i < num_values; i++) {
+    data[i] = (dsp::float_t)half_to_float(in[i]);
+  }
+}
+
+#if defined(__SSE2__) && !USE_DOUBLE_PRECISION
+// Upper halves of 4 floats rounded as float_to_bfloat(), sign extended for
+// _mm_packs_epi32()
+static inline __m128i bfloat_bits(const __m128 value) {
+  const __m128i x = _mm_castps_si128(value);
+  const __m128i upper = _mm_srli_epi32(x, 16);
+  const __m128i is_nan = _mm_cmpgt_epi32(
+      _mm_and_si128(x, _mm_set1_epi32(0x7fffffff)), _mm_set1_epi32(0x7f800000));
+  const __m128i rounded = _mm_srli_epi32(
+      _mm_add_epi32(_mm_add_epi32(x, _mm_set1_epi32(0x7fff)),
+                    _mm_and_si128(upper, _mm_set1_epi32(1))), 16);
+  const __m128i nan = _mm_or_si128(upper, _mm_set1_epi32(0x40));
+  const __m128i bits = _mm_or_si128(_mm_and_si128(is_nan, nan),
+                                    _mm_andnot_si128(is_nan, rounded));
+  return _mm_srai_epi32(_mm_slli_epi32(bits, 16), 16);
+}
+#endif
+
+static void encode_bfloat(const dsp::float_t* data, const size_t num_values,
+                          uint16_t* out) {
+  size_t i = 0;
+#if defined(__SSE2__) && !USE_DOUBLE_PRECISION
+  for (; i + 8 <= num_values; i += 8) {
+    _mm_storeu_si128((__m128i*)(out + i),
+                     _mm_packs_epi32(bfloat_bits(_mm_loadu_ps(data + i)),
+                                     bfloat_bits(_mm_loadu_ps(data + i + 4))));
+  }
+#endif
+  for (; i < num_values; i++) {
+    out[i] = float_to_bfloat((float)data[i]);
+  }
+}
+
+static void decode_bfloat(const uint16_t* in, const size_t num_values,
+                          dsp::float_t* data) {
+  size_t i = 0;
+#if defined(__SSE2__) && !USE_DOUBLE_PRECISION
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= num_values; i += 8) {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+    _mm_storeu_ps(data + i, _mm_castsi128_ps(_mm_unpacklo_epi16(zero, v)));
+    _mm_storeu_ps(data + i + 4, _mm_castsi128_ps(_mm_unpackhi_epi16(zero, v)));
+  }
+#endif
+  for (; i < num_values; i++) {
+    data[i] = (dsp::float_t)bfloat_to_float(in[i]);
+  }
+}
+
+// Values are rounded to nearest even and saturated into [-127, 127], and NaN
+// is quantized to zero
+static void encode_int8(const dsp::float_t* data, const size_t num_values,
+                        const double scale, int8_t* out) {
+  const dsp::float_t inv_scale = (scale > 0) ? (dsp::float_t)(1.0 / scale) : 0;
+  size_t i = 0;
+#if defined(__SSE2__) && !USE_DOUBLE_PRECISION
+  const __m128 inv = _mm_set1_ps(inv_scale);
+  const __m128 low = _mm_set1_ps(-127.0f);
+  const __m128 high = _mm_set1_ps(127.0f);
+  for (; i + 16 <= num_values; i += 16) {
+    __m128i q[4];
+    for (int k = 0; k < 4; k++) {
+      __m128 v = _mm_mul_ps(_mm_loadu_ps(data + i + 4 * k), inv);
+      v = _mm_and_ps(v, _mm_cmpord_ps(v, v));
+      q[k] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, low), high));
+    }
+    _mm_storeu_si128((__m128i*)(out + i),
+                     _mm_packs_epi16(_mm_packs_epi32(q[0], q[1]),
+                                     _mm_packs_epi32(q[2], q[3])));
+  }
+#endif
+  for (; i < num_values; i++) {
+    dsp::float_t v = data[i] * inv_scale;
+    if (v != v) {
+      v = 0;
+    }
+    v = std::min(std::max(v, (dsp::float_t)-127), (dsp::float_t)127);
+    out[i] = (int8_t)lrint((double)v);
+  }
+}
+
+// Quantize each dimension linearly into levels of `T`. Frames are visited
+// in order of memory, and inner loops over dimensions are vectorized.
+template <typename T>
+static void quantize(const dsp::float_t* data, const unsigned int num_frame,
+                     const unsigned int feat_dim, double* scale, double* offset,
+                     T* codes) {
+  const dsp::float_t max_level = (dsp::float_t)std::numeric_limits<T>::max();
+  std::vector<dsp::float_t> low(data, data + feat_dim);
+  std::vector<dsp::float_t> high(data, data + feat_dim);
+  for (unsigned int f = 1; f < num_frame; f++) {
+    const dsp::float_t* frame = data + (size_t)f * feat_dim;
+    for (unsigned int d = 0; d < feat_dim; d++) {
+      low[d] = std::min(low[d], frame[d]);
+      high[d] = std::max(high[d], frame[d]);
+    }
+  }
+
+  std::vector<dsp::float_t> inv_scale(feat_dim);
+  for (unsigned int d = 0; d < feat_dim; d++) {
+    offset[d] = (double)low[d];
+    scale[d] = ((double)high[d] - (double)low[d]) / max_level;
+    inv_scale[d] = (scale[d] > 0) ? (dsp::float_t)(1.0 / scale[d]) : 0;
+  }
+
+  for (unsigned int f = 0; f < num_frame; f++) {
+    const dsp::float_t* frame = data + (size_t)f * feat_dim;
+    T* code = codes + (size_t)f * feat_dim;
+    for (unsigned int d = 0; d < feat_dim; d++) {
+      const dsp::float_t level = (frame[d] - low[d]) * inv_scale[d] + (dsp::float_t)0.5;
+      code[d] = (T)std::min(level, max_level);
+    }
+  }
+}
+
+template <typename T>
+static void dequantize(const T* codes, const unsigned int num_frame,
+                       const unsigned int feat_dim, const double* scale,
+                       const double* offset, dsp::float_t* data) {
+  std::vector<dsp::float_t> s(scale, scale + feat_dim);
+  std::vector<dsp::float_t> o(offset, offset + feat_dim);
+  for (unsigned int f = 0; f < num_frame; f++) {
+    const T* code = codes + (size_t)f * feat_dim;
+    dsp::float_t* frame = data + (size_t)f * feat_dim;
+    for (unsigned int d = 0; d < feat_dim; d++) {
+      frame[d] = o[d] + s[d] * (dsp::float_t)code[d];
+    }
+  }
+}
+
+unsigned int getDtypeSize(const int dtype) {
+  switch (dtype)
+  {
+  case FEXTOR_DTYPE_FLOAT32:
+    return 4;
+  case FEXTOR_DTYPE_FLOAT64:
+    return 8;
+  case FEXTOR_DTYPE_FLOAT16:
+  case FEXTOR_DTYPE_BFLOAT16:
+    return 2;
+  case FEXTOR_DTYPE_INT8:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+void encodeValues(const dsp::float_t* data, const size_t num_values,
+                  const int dtype, const double scale, void* out) {
+  switch (dtype)
+  {
+  case FEXTOR_DTYPE_FLOAT32:
+    std::copy(data, data + num_values, (float*)out);
+    break;
+  case FEXTOR_DTYPE_FLOAT64:
+    std::copy(data, data + num_values, (double*)out);
+    break;
+  case FEXTOR_DTYPE_FLOAT16:
+    encode_half(data, num_values, (uint16_t*)out);
+    break;
+  case FEXTOR_DTYPE_BFLOAT16:
+    encode_bfloat(data, num_values, (uint16_t*)out);
+    break;
+  case FEXTOR_DTYPE_INT8:
+    encode_int8(data, num_values, scale, (int8_t*)out);
+    break;
+  default:
+    break;
+  }
+}
+
+void decodeValues(const void* in, const size_t num_values, const int dtype,
+                  const double scale, dsp::float_t* data) {
+  switch (dtype)
+  {
+  case FEXTOR_DTYPE_FLOAT32:
+    std::copy((const float*)in, (const float*)in + num_values, data);
+    break;
+  case FEXTOR_DTYPE_FLOAT64:
+    std::copy((const double*)in, (const double*)in + num_values, data);
+    break;
+  case FEXTOR_DTYPE_FLOAT16:
+    decode_half((const uint16_t*)in, num_values, data);
+    break;
+  case FEXTOR_DTYPE_BFLOAT16:
+    decode_bfloat((const uint16_t*)in, num_values, data);
+    break;
+  case FEXTOR_DTYPE_INT8: {
+    const dsp::float_t s = (dsp::float_t)scale;
+    for (size_t i = 0; i < num_values; i++) {
+      data[i] = s * (dsp::float_t)((const int8_t*)in)[i];
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+double getInt8Scale(const dsp::float_t* data, const size_t num_values) {
+  dsp::float_t max_abs = 0;
+  for (size_t i = 0; i < num_values; i++) {
+    max_abs = std::max(max_abs, (dsp::float_t)fabs(data[i]));
+  }
+  return (double)max_abs / 127.0;
+}
+
+bool isEncodedFeature(const unsigned char* bytes, const size_t size) {
+  return size >= sizeof(FeatFileHeader) &&
+         memcmp(bytes, kFeatMagic, sizeof(kFeatMagic)) == 0;
+}
+
+int encodeFeature(const dsp::float_t* data, const unsigned int num_frame,
+                  const unsigned int feat_dim, const FeatureFormat& format,
+                  std::vector<unsigned char>* bytes) {
+  const bool is_quantized = (format.codec != FEXTOR_CODEC_NONE);
+  const unsigned int value_size = is_quantized ? get_code_size(format.codec)
+                                               : getDtypeSize(format.dtype);
+  if (value_size == 0) {
+    fprintf(stderr, "encodeFeature() - invalid codec or dtype (given : %d, %d)\n",
+            format.codec, format.dtype);
+    return 1;
+  }
+  if (is_quantized && format.dtype != FEXTOR_DTYPE_NATIVE) {
+    fprintf(stderr, "encodeFeature() - codec is applied only to native dtype.\n");
+    return 1;
+  }
+
+  const size_t num_values = (size_t)num_frame * feat_dim;
+  FeatFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kFeatMagic, sizeof(kFeatMagic));
+  header.version = FEXTOR_FEAT_VERSION;
+  header.num_frame = num_frame;
+  header.feat_dim = feat_dim;
+  header.codec = (uint32_t)format.codec;
+  header.dtype = (uint32_t)format.dtype;
+  header.data_offset = sizeof(header);
+  if (is_quantized) {
+    header.data_offset =
+        (sizeof(header) + 2 * sizeof(double) * feat_dim + 63) / 64 * 64;
+  }
+  header.data_size = (uint64_t)num_values * value_size;
+  if (format.dtype == FEXTOR_DTYPE_INT8) {
+    header.scale = (format.scale > 0) ? format.scale
+                                      : getInt8Scale(data, num_values);
+  }
+
+  bytes->assign(header.data_offset + header.data_size, 0);
+  unsigned char* out = bytes->data();
+  memcpy(out, &header, sizeof(header));
+  if (num_frame == 0) {
+    return 0;
+  }
+  if (!is_quantized) {
+    encodeValues(data, num_values, format.dtype, header.scale,
+                 out + header.data_offset);
+    return 0;
+  }
+
+  // Tables are copied out, since they may be unaligned in general
+  std::vector<double> scale(feat_dim), offset(feat_dim);
+  if (format.codec == FEXTOR_CODEC_Q16) {
+    quantize(data, num_frame, feat_dim, scale.data(), offset.data(),
+             (uint16_t*)(out + header.data_offset));
+  } else {
+    quantize(data, num_frame, feat_dim, scale.data(), offset.data(),
+             (uint8_t*)(out + header.data_offset));
+  }
+  memcpy(out + sizeof(header), scale.data(), sizeof(double) * feat_dim);
+  memcpy(out + sizeof(header) + sizeof(double) * feat_dim, offset.data(),
+         sizeof(double) * feat_dim);
+  return 0;
+}
+
+int readFeatureHeader(const unsigned char* bytes, const size_t size,
+                      FeatFileHeader* header) {
+  if (!isEncodedFeature(bytes, size)) {
+    fprintf(stderr, "readFeatureHeader() - invalid magic.\n");
+    return 1;
+  }
+  memcpy(header, bytes, sizeof(FeatFileHeader));
+  if (header->version != FEXTOR_FEAT_VERSION) {
+    fprintf(stderr, "readFeatureHeader() - unsupported version (given : %u)\n",
+            header->version);
+    return 1;
+  }
+
+  const bool is_quantized = (header->codec != FEXTOR_CODEC_NONE);
+  const unsigned int value_size = is_quantized
+      ? get_code_size((int)header->codec) : getDtypeSize((int)header->dtype);
+  uint64_t table_end = sizeof(FeatFileHeader);
+  if (is_quantized) {
+    table_end += 2 * sizeof(double) * (uint64_t)header->feat_dim;
+  }
+  if (value_size == 0 ||
+      (is_quantized && header->dtype != FEXTOR_DTYPE_NATIVE) ||
+      header->data_offset < table_end ||
+      header->data_size !=
+          (uint64_t)header->num_frame * header->feat_dim * value_size ||
+      header->data_offset + header->data_size != size) {
+    fprintf(stderr, "readFeatureHeader() - invalid codec, dtype or size.\n");
+    return 1;
+  }
+  return 0;
+}
+
+int decodeFeature(const unsigned char* bytes, const FeatFileHeader& header,
+                  dsp::float_t* data) {
+  if (header.codec == FEXTOR_CODEC_NONE) {
+    decodeValues(bytes + header.data_offset,
+                 (size_t)header.num_frame * header.feat_dim, (int)header.dtype,
+                 header.scale, data);
+    return 0;
+  }
+
+  const unsigned int feat_dim = header.feat_dim;
+  std::vector<double> scale(feat_dim), offset(feat_dim);
+  memcpy(scale.data(), bytes + sizeof(header), sizeof(double) * feat_dim);
+  memcpy(offset.data(), bytes + sizeof(header) + sizeof(double) * feat_dim,
+         sizeof(double) * feat_dim);
+
+  const unsigned char* codes = bytes + header.data_offset;
+  if (header.codec == FEXTOR_CODEC_Q16) {
+    dequantize((const uint16_t*)codes, header.num_frame, feat_dim,
+               scale.data(), offset.data(), data);
+  } else if (header.codec == FEXTOR_CODEC_Q8) {
+    dequantize((const uint8_t*)codes, header.num_frame, feat_dim,
+               scale.data(), offset.data(), data);
+  } else {
+    fprintf(stderr, "decodeFeature() - invalid codec (given : %u)\n", header.codec);
+    return 1;
+  }
+  return 0;
+}
+
+int getCodec(const std::string& name) {
+  if (name == "none") {
+    return FEXTOR_CODEC_NONE;
+  } else if (name == "q16") {
+    return FEXTOR_CODEC_Q16;
+  } else if (name == "q8") {
+    return FEXTOR_CODEC_Q8;
+  }
+  return -1;
+}
+
+int getDtype(const std::string& name) {
+  if (name == "float32") {
+    return FEXTOR_DTYPE_FLOAT32;
+  } else if (name == "float64") {
+    return FEXTOR_DTYPE_FLOAT64;
+  } else if (name == "float16") {
+    return FEXTOR_DTYPE_FLOAT16;
+  } else if (name == "bfloat16") {
+    return FEXTOR_DTYPE_BFLOAT16;
+  } else if (name == "int8") {
+    return FEXTOR_DTYPE_INT8;
+  }
+  return -1;
+}
@@ -0,0 +1,108 @@
+#ifndef FEATURE_CODEC_H
+#define FEATURE_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "dsp/feature_extractor.h"
+
+// Data types of stored features. Values of FEXTOR_DTYPE_INT8 are decoded as
+// `scale * q`, with scale kept per file.
+#define FEXTOR_DTYPE_FLOAT32 1
+#define FEXTOR_DTYPE_FLOAT64 2
+#define FEXTOR_DTYPE_FLOAT16 3
+#define FEXTOR_DTYPE_BFLOAT16 4
+#define FEXTOR_DTYPE_INT8 5
+
+// Data type of `dsp::float_t`
+#define FEXTOR_DTYPE_NATIVE \
+  ((sizeof(dsp::float_t) == 4) ? FEXTOR_DTYPE_FLOAT32 : FEXTOR_DTYPE_FLOAT64)
+
+// Codecs of .feat file. Quantized values are decoded as
+// `offset[d] + scale[d] * q`, with scale and offset kept per dimension `d`,
+// so that error of each value is at most half of `scale[d]`.
+#define FEXTOR_CODEC_NONE 0
+#define FEXTOR_CODEC_Q16 1   // uint16 per value
+#define FEXTOR_CODEC_Q8 2    // uint8 per value
+
+// Version of .feat file with header `FeatFileHeader`. Files without codec
+// and with native dtype are written with header of FEXTOR_FEAT_HEADER_SIZE
+// bytes as before.
+#define FEXTOR_FEAT_VERSION 2
+
+// Header of encoded .feat file. Values are stored in byte order of writer.
+//
+// layout :
+//   header (64 bytes)
+//   scale (float64 x feat_dim), offset (float64 x feat_dim), only if codec
+//   is not FEXTOR_CODEC_NONE
+//   data (num_frame x feat_dim), starts at 64-byte boundary
+typedef struct feat_file_header_t {
+  char magic[4];          // "FXFT"
+  uint32_t version;       // FEXTOR_FEAT_VERSION
+  uint32_t num_frame;
+  uint32_t feat_dim;
+  uint32_t codec;         // FEXTOR_CODEC_*
+  uint32_t dtype;         // FEXTOR_DTYPE_* of stored values, or of decoded
+                          // values if codec is not FEXTOR_CODEC_NONE
+  uint64_t data_offset;
+  uint64_t data_size;
+  double scale;           // of FEXTOR_DTYPE_INT8
+  uint8_t reserved[16];
+} FeatFileHeader;
+
+// How features are written by `Feature::save()`
+typedef struct feature_format_t {
+  int codec;     // FEXTOR_CODEC_*, ignored for .npy
+  int dtype;     // FEXTOR_DTYPE_*, codec is applied only to native dtype
+  double scale;  // of FEXTOR_DTYPE_INT8, 0 to use max of absolute values of
+                 // each utterance divided by 127
+
+  feature_format_t()
+    : codec(FEXTOR_CODEC_NONE)
+    , dtype(FEXTOR_DTYPE_NATIVE)
+    , scale(0) {}
+} FeatureFormat;
+
+// Bytes per value of dtype, 0 if unknown
+unsigned int getDtypeSize(const int dtype);
+
+// Convert `num_values` values into `dtype`, and back. Conversion to half
+// precision uses F16C if it is enabled at compile time (e.g. -mf16c), and
+// int8 uses SSE2.
+void encodeValues(const dsp::float_t* data, const size_t num_values,
+                  const int dtype, const double scale, void* out);
+void decodeValues(const void* in, const size_t num_values, const int dtype,
+                  const double scale, dsp::float_t* data);
+
+// Scale of FEXTOR_DTYPE_INT8 for values of one utterance
+double getInt8Scale(const dsp::float_t* data, const size_t num_values);
+
+// True if `bytes` start with header of encoded .feat file
+bool isEncodedFeature(const unsigned char* bytes, const size_t size);
+
+// Encode `num_frame` x `feat_dim` values into whole contents of .feat file
+int encodeFeature(const dsp::float_t* data, const unsigned int num_frame,
+                  const unsigned int feat_dim, const FeatureFormat& format,
+                  std::vector<unsigned char>* bytes);
+
+// Validate header and size of encoded .feat file
+int readFeatureHeader(const unsigned char* bytes, const size_t size,
+                      FeatFileHeader* header);
+
+// Decode values of encoded .feat file into `data` of
+// `num_frame` x `feat_dim` values
+int decodeFeature(const unsigned char* bytes, const FeatFileHeader& header,
+                  dsp::float_t* data);
+
+// Codec of given name ("none", "q16" or "q8"), -1 if unknown
+int getCodec(const std::string& name);
+
+// Dtype of given name ("float32", "float64", "float16", "bfloat16" or
+// "int8"), -1 if unknown
+int getDtype(const std::string& name);
+
+#endif // FEATURE_CODEC_H
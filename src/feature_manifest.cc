@@ -0,0 +1,246 @@
+#include "feature_manifest.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <vector>
+
+static const uint64_t kPrime1 = 11400714785074694791ULL;
+static const uint64_t kPrime2 = 14029467366897019727ULL;
+static const uint64_t kPrime3 = 1609587929392839161ULL;
+static const uint64_t kPrime4 = 9650029242287828579ULL;
+static const uint64_t kPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl64(const uint64_t x, const int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, const uint64_t input) {
+  acc += input * kPrime2;
+  acc = rotl64(acc, 31);
+  return acc * kPrime1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, const uint64_t value) {
+  acc ^= xxh_round(0, value);
+  return acc * kPrime1 + kPrime4;
+}
+
+// Words are read in little endian order, as reference implementation on x86
+uint64_t hashBytes(const void* data, const size_t size, const uint64_t seed) {
+  const unsigned char* p = (const unsigned char*)data;
+  const unsigned char* end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = xxh_round(v1, read64(p));
+      v2 = xxh_round(v2, read64(p + 8));
+      v3 = xxh_round(v3, read64(p + 16));
+      v4 = xxh_round(v4, read64(p + 24));
+    }
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = xxh_merge(h, v1);
+    h = xxh_merge(h, v2);
+    h = xxh_merge(h, v3);
+    h = xxh_merge(h, v4);
+  } else {
+    h = seed + kPrime5;
+  }
+  h += (uint64_t)size;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh_round(0, read64(p));
+    h = rotl64(h, 27) * kPrime1 + kPrime4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)read32(p) * kPrime1;
+    h = rotl64(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (uint64_t)(*p) * kPrime5;
+    h = rotl64(h, 11) * kPrime1;
+  }
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+template <typename T>
+static void append_value(std::vector<unsigned char>* bytes, const T value) {
+  const unsigned char* p = (const unsigned char*)&value;
+  bytes->insert(bytes->end(), p, p + sizeof(value));
+}
+
+uint64_t hashConfig(const dsp::FEInitParam& param, const int target,
+                    const FeatureFormat& format) {
+  // Fields are hashed one by one, since padding of struct is undefined.
+  // Real numbers are widened, so that precision of build is not hashed.
+  std::vector<unsigned char> bytes;
+  append_value(&bytes, (uint32_t)FEATURE_MANIFEST_VERSION);
+  append_value(&bytes, (uint32_t)FEXTOR_FEAT_VERSION);
+  append_value(&bytes, (uint32_t)FEXTOR_SAMPLING_RATE);
+  append_value(&bytes, (uint32_t)FEXTOR_BIT_RATE);
+  append_value(&bytes, (uint32_t)FEXTOR_NUM_CHANNELS);
+  append_value(&bytes, (uint32_t)param.sampling_rate);
+  append_value(&bytes, (uint32_t)param.window_type);
+  append_value(&bytes, (uint32_t)param.window_size);
+  append_value(&bytes, (uint32_t)param.step_size);
+  append_value(&bytes, (uint32_t)param.num_fft_point);
+  append_value(&bytes, (uint32_t)param.num_mels);
+  append_value(&bytes, (uint32_t)param.num_mfcc);
+  append_value(&bytes, (uint32_t)param.is_center);
+  append_value(&bytes, (double)param.min_hertz);
+  append_value(&bytes, (double)param.max_hertz);
+  append_value(&bytes, (double)param.epsilon);
+  append_value(&bytes, (double)param.ref_level_db);
+  append_value(&bytes, (int32_t)target);
+  append_value(&bytes, (int32_t)format.codec);
+  append_value(&bytes, (int32_t)format.dtype);
+  append_value(&bytes, (double)format.scale);
+  append_value(&bytes, (uint32_t)sizeof(dsp::float_t));
+  return hashBytes(bytes.data(), bytes.size());
+}
+
+FeatureManifest::FeatureManifest()
+  : fp_(NULL)
+  , config_hash_(0) {
+
+}
+
+FeatureManifest::~FeatureManifest() {
+  close();
+}
+
+int FeatureManifest::open(const char* file_name, const uint64_t config_hash) {
+  if (file_name == NULL || fp_ != NULL) {
+    fprintf(stderr, "FeatureManifest::open() - invalid argument or already opened.\n");
+    return 1;
+  }
+  config_hash_ = config_hash;
+  entries_.clear();
+  sources_.clear();
+
+  // Last line of each output wins. Lines of outputs which no longer exist
+  // are dropped, so that they are extracted again.
+  std::vector<std::string> outputs;
+  std::ifstream input(file_name);
+  for (std::string line; getline(input, line);) {
+    Entry entry;
+    int length = 0;
+    if (line.empty() || line[0] == '#' ||
+        sscanf(line.c_str(), "%16" SCNx64 " %16" SCNx64 " %n",
+               &entry.config_hash, &entry.input_hash, &length) != 2 ||
+        length <= 0 || (size_t)length >= line.size()) {
+      continue;
+    }
+    const std::string output = line.substr(length);
+    if (entries_.find(output) == entries_.end()) {
+      outputs.push_back(output);
+    }
+    entries_[output] = entry;
+  }
+  input.close();
+
+  // Compact into temporary file, which replaces manifest at once
+  const std::string temp_name = std::string(file_name) + ".tmp";
+  FILE* fp = fopen(temp_name.c_str(), "w");
+  if (fp == NULL) {
+    fprintf(stderr, "FeatureManifest::open() - failed to open file : %s\n", temp_name.c_str());
+    return 1;
+  }
+  fprintf(fp, "# fextor manifest %d\n", FEATURE_MANIFEST_VERSION);
+  for (auto& output : outputs) {
+    const Entry& entry = entries_[output];
+    if (access(output.c_str(), F_OK) != 0) {
+      entries_.erase(output);
+      continue;
+    }
+    fprintf(fp, "%016" PRIx64 " %016" PRIx64 " %s\n", entry.config_hash,
+            entry.input_hash, output.c_str());
+    if (entry.config_hash == config_hash_) {
+      sources_.insert(std::make_pair(entry.input_hash, output));
+    }
+  }
+  if (fclose(fp) != 0 || rename(temp_name.c_str(), file_name) != 0) {
+    fprintf(stderr, "FeatureManifest::open() - failed to write file : %s\n", file_name);
+    unlink(temp_name.c_str());
+    return 1;
+  }
+
+  fp_ = fopen(file_name, "a");
+  if (fp_ == NULL) {
+    fprintf(stderr, "FeatureManifest::open() - failed to open file : %s\n", file_name);
+    return 1;
+  }
+  return 0;
+}
+
+void FeatureManifest::close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (fp_ != NULL) {
+    fclose(fp_);
+    fp_ = NULL;
+  }
+}
+
+FeatureManifest::claim_t FeatureManifest::claim(const std::string& output,
+                                                const uint64_t input_hash,
+                                                std::string* source) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = entries_.find(output);
+  if (it != entries_.end() && it->second.config_hash == config_hash_ &&
+      it->second.input_hash == input_hash) {
+    return kClaimUpToDate;
+  }
+
+  // First output of each input is extracted, and the others are its copies
+  auto source_it = sources_.find(input_hash);
+  if (source_it != sources_.end() && source_it->second != output) {
+    (*source) = source_it->second;
+    return kClaimDuplicate;
+  }
+  sources_[input_hash] = output;
+  return kClaimNew;
+}
+
+int FeatureManifest::add(const std::string& output, const uint64_t input_hash) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  Entry entry;
+  entry.config_hash = config_hash_;
+  entry.input_hash = input_hash;
+  entries_[output] = entry;
+
+  // Flushed at once, so that outputs written before crash are not lost
+  if (fp_ == NULL ||
+      fprintf(fp_, "%016" PRIx64 " %016" PRIx64 " %s\n", config_hash_,
+              input_hash, output.c_str()) < 0 ||
+      fflush(fp_) != 0) {
+    fprintf(stderr, "FeatureManifest::add() - failed to write manifest.\n");
+    return 1;
+  }
+  return 0;
+}
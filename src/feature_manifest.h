@@ -0,0 +1,71 @@
+#ifndef FEATURE_MANIFEST_H
+#define FEATURE_MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "dsp/feature_extractor.h"
+#include "fextor_app.h"
+
+#define FEATURE_MANIFEST_VERSION 1
+
+// 64-bit hash of bytes (XXH64), fast enough to hash audio while reading it
+uint64_t hashBytes(const void* data, const size_t size, const uint64_t seed = 0);
+
+// Hash of everything but input which determines contents of feature :
+// parameters of extractor, target, format and version of .feat file
+uint64_t hashConfig(const dsp::FEInitParam& param, const int target,
+                    const FeatureFormat& format);
+
+// Record of outputs written by previous and current runs, so that rerun
+// skips outputs which are up to date, and input identical to another one is
+// copied instead of extracted again.
+//
+// Manifest is a text file of lines "<config hash> <input hash> <output>",
+// appended as soon as each output is written. Last line of an output wins,
+// and the file is compacted when opened.
+class FeatureManifest {
+public:
+  FeatureManifest();
+  virtual ~FeatureManifest();
+
+  // Result of `claim()`
+  enum claim_t {
+    kClaimNew,        // output must be extracted
+    kClaimUpToDate,   // output is already written from same input
+    kClaimDuplicate,  // same input is (being) written to another output
+  };
+
+private:
+  typedef struct entry_t {
+    uint64_t config_hash;
+    uint64_t input_hash;
+  } Entry;
+
+  FILE* fp_;
+  uint64_t config_hash_;
+  std::unordered_map<std::string, Entry> entries_;            // by output
+  std::unordered_map<uint64_t, std::string> sources_;         // by input hash
+  std::mutex mutex_;
+
+public:
+  // Load manifest if it exists, and open it for appending. Only entries of
+  // `config_hash` are taken as up to date.
+  int open(const char* file_name, const uint64_t config_hash);
+  void close();
+
+  // Decide what to do with `output` of input of `input_hash`. If duplicate,
+  // `source` is set to output of same input.
+  claim_t claim(const std::string& output, const uint64_t input_hash,
+                std::string* source);
+
+  // Record that `output` is written from input of `input_hash`
+  int add(const std::string& output, const uint64_t input_hash);
+}; // class FeatureManifest
+
+#endif // FEATURE_MANIFEST_H
@@ -0,0 +1,482 @@
+#include "feature_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <new>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex word must be plain 32 bit integer");
+static_assert(sizeof(FeatureRingRecord) == FEATURE_RING_ALIGN,
+              "record header must be 64 bytes");
+
+static inline uint64_t align_size(const uint64_t size) {
+  return (size + FEATURE_RING_ALIGN - 1) / FEATURE_RING_ALIGN * FEATURE_RING_ALIGN;
+}
+
+static inline size_t get_header_size() {
+  return (size_t)align_size(sizeof(FeatureRingHeader));
+}
+
+// Sleep while `*word` is `value`, up to `timeout_ms`. Returns false on
+// timeout. Word is shared between processes, so futex is not private.
+static bool futex_wait(std::atomic<uint32_t>* word, const uint32_t value,
+                       const unsigned int timeout_ms) {
+  struct timespec timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+  const long ret = syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, value,
+                           &timeout, NULL, 0);
+  return !(ret != 0 && errno == ETIMEDOUT);
+}
+
+static void futex_wake(std::atomic<uint32_t>* word) {
+  syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Process which has exited but is not reaped by its parent yet is taken as
+// dead
+static bool is_process_alive(const int32_t pid) {
+  if (kill((pid_t)pid, 0) != 0 && errno == ESRCH) {
+    return false;
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return true;
+  }
+  char buffer[512];
+  const size_t num_read = fread(buffer, 1, sizeof(buffer) - 1, fp);
+  fclose(fp);
+  buffer[num_read] = '\0';
+  // State follows name of command in parentheses
+  const char* p = strrchr(buffer, ')');
+  return !(p != NULL && p[1] == ' ' && p[2] == 'Z');
+}
+
+// Elapsed time since `start` is over `timeout_ms`, never if 0
+static bool is_timed_out(const std::chrono::steady_clock::time_point& start,
+                         const unsigned int timeout_ms) {
+  return timeout_ms > 0 &&
+         std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeout_ms);
+}
+
+FeatureRingWriter::FeatureRingWriter()
+  : header_(NULL)
+  , data_(NULL)
+  , map_size_(0) {
+
+}
+
+FeatureRingWriter::~FeatureRingWriter() {
+  close();
+}
+
+int FeatureRingWriter::open(const char* name, const size_t capacity) {
+  if (name == NULL || name[0] != '/' || capacity < FEATURE_RING_ALIGN * 2) {
+    fprintf(stderr, "FeatureRingWriter::open() - invalid name or capacity of ring.\n");
+    return 1;
+  }
+  if (header_ != NULL) {
+    fprintf(stderr, "FeatureRingWriter::open() - ring is already opened.\n");
+    return 1;
+  }
+
+  // Readers of replaced ring keep their mapping, and see it is closed as
+  // writer of it has exited
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    fprintf(stderr, "FeatureRingWriter::open() - failed to create %s : %s\n",
+            name, strerror(errno));
+    return 1;
+  }
+  const uint64_t data_size = align_size(capacity);
+  const size_t map_size = get_header_size() + (size_t)data_size;
+  void* map = MAP_FAILED;
+  if (ftruncate(fd, (off_t)map_size) == 0) {
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "FeatureRingWriter::open() - failed to map %s : %s\n",
+            name, strerror(errno));
+    shm_unlink(name);
+    return 1;
+  }
+
+  // Memory of new shared memory is zero, which is initial state of ring
+  header_ = new (map) FeatureRingHeader();
+  header_->version = FEATURE_RING_VERSION;
+  header_->max_readers = FEATURE_RING_MAX_READERS;
+  header_->capacity = data_size;
+  header_->data_offset = get_header_size();
+  header_->writer_pid = (int32_t)getpid();
+  header_->is_closed = 0;
+  header_->position = 0;
+  header_->num_records = 0;
+  header_->write_seq = 0;
+  header_->num_waiting_readers = 0;
+  header_->read_seq = 0;
+  header_->is_writer_waiting = 0;
+  for (unsigned int i = 0; i < FEATURE_RING_MAX_READERS; i++) {
+    header_->readers[i].is_active = 0;
+    header_->readers[i].pid = 0;
+    header_->readers[i].position = 0;
+  }
+  // Readers check magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header_->magic, "FXRING\0\0", 8);
+
+  name_ = name;
+  data_ = (unsigned char*)map + get_header_size();
+  map_size_ = map_size;
+  return 0;
+}
+
+uint64_t FeatureRingWriter::getMinReadPosition() {
+  uint64_t min_position = header_->position.load(std::memory_order_relaxed);
+  for (unsigned int i = 0; i < FEATURE_RING_MAX_READERS; i++) {
+    FeatureRingReaderSlot& slot = header_->readers[i];
+    if (slot.is_active.load() == 1) {
+      const uint64_t position = slot.position.load(std::memory_order_acquire);
+      if (position < min_position) {
+        min_position = position;
+      }
+    }
+  }
+  return min_position;
+}
+
+void FeatureRingWriter::detachDeadReaders() {
+  for (unsigned int i = 0; i < FEATURE_RING_MAX_READERS; i++) {
+    FeatureRingReaderSlot& slot = header_->readers[i];
+    if (slot.is_active.load() == 1 && !is_process_alive(slot.pid.load())) {
+      fprintf(stderr, "FeatureRingWriter::detachDeadReaders() - reader of "
+              "process %d has exited.\n", (int)slot.pid.load());
+      slot.is_active = 0;
+    }
+  }
+}
+
+int FeatureRingWriter::waitReaders(const unsigned int num_readers,
+                                   const unsigned int timeout_ms) {
+  if (header_ == NULL) {
+    return 1;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  while (true) {
+    const uint32_t seq = header_->read_seq.load();
+    unsigned int num_active = 0;
+    for (unsigned int i = 0; i < FEATURE_RING_MAX_READERS; i++) {
+      num_active += (header_->readers[i].is_active.load() == 1) ? 1 : 0;
+    }
+    if (num_active >= num_readers) {
+      return 0;
+    }
+    if (is_timed_out(start, timeout_ms)) {
+      fprintf(stderr, "FeatureRingWriter::waitReaders() - %u of %u readers "
+              "are attached.\n", num_active, num_readers);
+      return 1;
+    }
+    header_->is_writer_waiting = 1;
+    futex_wait(&header_->read_seq, seq, FEATURE_RING_CHECK_MSEC);
+    header_->is_writer_waiting = 0;
+  }
+}
+
+int FeatureRingWriter::append(const std::string& id, const Feature& feat) {
+  return append(id, feat.getData(), FEXTOR_DTYPE_NATIVE, feat.getNumFrame(),
+                feat.getFeatDim());
+}
+
+int FeatureRingWriter::append(const std::string& id, const void* data,
+                              const unsigned int dtype,
+                              const unsigned int num_frame,
+                              const unsigned int feat_dim) {
+  const unsigned int value_size = getDtypeSize(dtype);
+  if (header_ == NULL || value_size == 0 ||
+      (data == NULL && (uint64_t)num_frame * feat_dim > 0)) {
+    fprintf(stderr, "FeatureRingWriter::append() - invalid argument or ring is not opened.\n");
+    return 1;
+  }
+  const uint64_t data_offset = align_size(sizeof(FeatureRingRecord) + id.size());
+  const uint64_t data_size = (uint64_t)num_frame * feat_dim * value_size;
+  const uint64_t record_size = data_offset + align_size(data_size);
+  const uint64_t capacity = header_->capacity;
+  if (record_size > capacity) {
+    fprintf(stderr, "FeatureRingWriter::append() - feature of %s is larger "
+            "than ring.\n", id.c_str());
+    return 1;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t position = header_->position.load(std::memory_order_relaxed);
+  const uint64_t offset = position % capacity;
+  const uint64_t skip_size = (capacity - offset < record_size) ? capacity - offset : 0;
+
+  // Wait until slowest reader releases space of record
+  while (position + skip_size + record_size - getMinReadPosition() > capacity) {
+    const uint32_t seq = header_->read_seq.load();
+    header_->is_writer_waiting = 1;
+    if (position + skip_size + record_size - getMinReadPosition() <= capacity) {
+      header_->is_writer_waiting = 0;
+      break;
+    }
+    const bool is_woken = futex_wait(&header_->read_seq, seq, FEATURE_RING_CHECK_MSEC);
+    header_->is_writer_waiting = 0;
+    if (!is_woken) {
+      detachDeadReaders();
+    }
+  }
+
+  if (skip_size > 0) {
+    FeatureRingRecord* skip = (FeatureRingRecord*)(data_ + offset);
+    memset(skip, 0, sizeof(FeatureRingRecord));
+    skip->kind = FEATURE_RING_RECORD_SKIP;
+    skip->record_size = skip_size;
+    position += skip_size;
+  }
+
+  unsigned char* p = data_ + position % capacity;
+  FeatureRingRecord* record = (FeatureRingRecord*)p;
+  memset(record, 0, sizeof(FeatureRingRecord));
+  record->kind = FEATURE_RING_RECORD_DATA;
+  record->dtype = dtype;
+  record->num_frame = num_frame;
+  record->feat_dim = feat_dim;
+  record->id_length = (uint32_t)id.size();
+  record->sequence = header_->num_records.load(std::memory_order_relaxed);
+  record->data_offset = data_offset;
+  record->data_size = data_size;
+  record->record_size = record_size;
+  memcpy(p + sizeof(FeatureRingRecord), id.data(), id.size());
+  if (data_size > 0) {
+    memcpy(p + data_offset, data, (size_t)data_size);
+  }
+
+  // Record is visible to readers once position is published
+  header_->num_records.fetch_add(1, std::memory_order_relaxed);
+  header_->position.store(position + record_size, std::memory_order_release);
+  header_->write_seq.fetch_add(1);
+  if (header_->num_waiting_readers.load() > 0) {
+    futex_wake(&header_->write_seq);
+  }
+  return 0;
+}
+
+int FeatureRingWriter::close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (header_ == NULL) {
+    return 0;
+  }
+  header_->is_closed = 1;
+  header_->write_seq.fetch_add(1);
+  futex_wake(&header_->write_seq);
+
+  munmap((void*)header_, map_size_);
+  header_ = NULL;
+  data_ = NULL;
+  map_size_ = 0;
+  // Readers keep their mapping after name is removed
+  int error_code = 0;
+  if (shm_unlink(name_.c_str()) != 0) {
+    fprintf(stderr, "FeatureRingWriter::close() - failed to remove %s : %s\n",
+            name_.c_str(), strerror(errno));
+    error_code = 1;
+  }
+  return error_code;
+}
+
+FeatureRingReader::FeatureRingReader()
+  : header_(NULL)
+  , data_(NULL)
+  , map_size_(0)
+  , slot_(-1)
+  , position_(0)
+  , record_size_(0) {
+
+}
+
+FeatureRingReader::~FeatureRingReader() {
+  close();
+}
+
+int FeatureRingReader::open(const char* name) {
+  if (name == NULL || header_ != NULL) {
+    fprintf(stderr, "FeatureRingReader::open() - invalid name or ring is already opened.\n");
+    return 1;
+  }
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0) {
+    fprintf(stderr, "FeatureRingReader::open() - failed to open %s : %s\n",
+            name, strerror(errno));
+    return 1;
+  }
+  struct stat status;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &status) == 0 && (size_t)status.st_size > get_header_size()) {
+    map = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+               fd, 0);
+  }
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "FeatureRingReader::open() - failed to map %s\n", name);
+    return 1;
+  }
+
+  FeatureRingHeader* header = (FeatureRingHeader*)map;
+  if (memcmp(header->magic, "FXRING", 6) != 0 ||
+      header->version != FEATURE_RING_VERSION ||
+      header->data_offset != get_header_size() ||
+      header->data_offset + header->capacity > (uint64_t)status.st_size) {
+    fprintf(stderr, "FeatureRingReader::open() - %s is not ring of features.\n", name);
+    munmap(map, (size_t)status.st_size);
+    return 1;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  // Slot is claimed (2) before activated (1), so that writer does not see
+  // its position before it is set
+  int slot = -1;
+  for (unsigned int i = 0; i < FEATURE_RING_MAX_READERS && slot < 0; i++) {
+    uint32_t expected = 0;
+    if (header->readers[i].is_active.compare_exchange_strong(expected, 2)) {
+      slot = (int)i;
+    }
+  }
+  if (slot < 0) {
+    fprintf(stderr, "FeatureRingReader::open() - %s has %d readers already.\n",
+            name, FEATURE_RING_MAX_READERS);
+    munmap(map, (size_t)status.st_size);
+    return 1;
+  }
+  FeatureRingReaderSlot& reader = header->readers[slot];
+  reader.pid = (int32_t)getpid();
+  reader.position = header->position.load(std::memory_order_acquire);
+  reader.is_active = 1;
+  // Writer may have moved before it saw this reader. Records from position
+  // read after activation are kept until they are released.
+  position_ = header->position.load(std::memory_order_acquire);
+  reader.position.store(position_, std::memory_order_release);
+
+  header_ = header;
+  data_ = (const unsigned char*)map + header->data_offset;
+  map_size_ = (size_t)status.st_size;
+  slot_ = slot;
+  record_size_ = 0;
+
+  // Writer may be waiting for readers to attach
+  header_->read_seq.fetch_add(1);
+  futex_wake(&header_->read_seq);
+  return 0;
+}
+
+void FeatureRingReader::close() {
+  if (header_ == NULL) {
+    return;
+  }
+  header_->readers[slot_].is_active = 0;
+  header_->read_seq.fetch_add(1);
+  if (header_->is_writer_waiting.load() != 0) {
+    futex_wake(&header_->read_seq);
+  }
+  munmap((void*)header_, map_size_);
+  header_ = NULL;
+  data_ = NULL;
+  map_size_ = 0;
+  slot_ = -1;
+  record_size_ = 0;
+}
+
+int FeatureRingReader::next(std::string* id, FeatureView* view,
+                            const unsigned int timeout_ms) {
+  if (header_ == NULL || view == NULL) {
+    return FEATURE_RING_ERROR;
+  }
+  if (record_size_ > 0) {
+    release();
+  }
+  if (header_->readers[slot_].is_active.load() != 1) {
+    fprintf(stderr, "FeatureRingReader::next() - reader is detached by writer.\n");
+    return FEATURE_RING_ERROR;
+  }
+
+  const uint64_t capacity = header_->capacity;
+  const auto start = std::chrono::steady_clock::now();
+  // Writer is checked by /proc only after waiting for a record timed out
+  bool is_woken = true;
+  while (true) {
+    const uint32_t seq = header_->write_seq.load();
+    if (header_->position.load(std::memory_order_acquire) == position_) {
+      // Closed ring is drained, since position is checked after closing
+      if (header_->is_closed.load() != 0 ||
+          (!is_woken && !is_process_alive(header_->writer_pid))) {
+        if (header_->position.load(std::memory_order_acquire) == position_) {
+          return FEATURE_RING_CLOSED;
+        }
+        continue;
+      }
+      if (is_timed_out(start, timeout_ms)) {
+        return FEATURE_RING_TIMEOUT;
+      }
+      header_->num_waiting_readers.fetch_add(1);
+      is_woken = true;
+      if (header_->position.load(std::memory_order_acquire) == position_) {
+        is_woken = futex_wait(&header_->write_seq, seq, FEATURE_RING_CHECK_MSEC);
+      }
+      header_->num_waiting_readers.fetch_sub(1);
+      continue;
+    }
+
+    const FeatureRingRecord* record =
+        (const FeatureRingRecord*)(data_ + position_ % capacity);
+    if (record->record_size == 0 || record->record_size % FEATURE_RING_ALIGN != 0 ||
+        position_ % capacity + record->record_size > capacity) {
+      fprintf(stderr, "FeatureRingReader::next() - broken record at %lu.\n",
+              (unsigned long)position_);
+      return FEATURE_RING_ERROR;
+    }
+    if (record->kind == FEATURE_RING_RECORD_SKIP) {
+      record_size_ = record->record_size;
+      release();
+      continue;
+    }
+
+    const unsigned char* p = (const unsigned char*)record;
+    if (id != NULL) {
+      id->assign((const char*)p + sizeof(FeatureRingRecord), record->id_length);
+    }
+    view->data = p + record->data_offset;
+    view->num_frame = record->num_frame;
+    view->feat_dim = record->feat_dim;
+    view->dtype = record->dtype;
+    record_size_ = record->record_size;
+    return FEATURE_RING_SUCCESS;
+  }
+}
+
+void FeatureRingReader::release() {
+  if (header_ == NULL || record_size_ == 0) {
+    return;
+  }
+  position_ += record_size_;
+  record_size_ = 0;
+  header_->readers[slot_].position.store(position_, std::memory_order_release);
+  header_->read_seq.fetch_add(1);
+  if (header_->is_writer_waiting.load() != 0) {
+    futex_wake(&header_->read_seq);
+  }
+}
@@ -0,0 +1,160 @@
+#ifndef FEATURE_RING_H
+#define FEATURE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "feature_archive.h"
+#include "fextor_app.h"
+
+// Records of ring are aligned by this number of bytes
+#define FEATURE_RING_ALIGN 64
+#define FEATURE_RING_VERSION 1
+#define FEATURE_RING_MAX_READERS 8
+
+// Interval to check whether readers are alive while writer waits for them
+#define FEATURE_RING_CHECK_MSEC 100
+
+// Return values of `FeatureRingReader::next()`
+#define FEATURE_RING_SUCCESS 0
+#define FEATURE_RING_ERROR 1
+#define FEATURE_RING_CLOSED 2    // writer closed ring, and all records are read
+#define FEATURE_RING_TIMEOUT 3
+
+#define FEATURE_RING_RECORD_DATA 1
+#define FEATURE_RING_RECORD_SKIP 2  // padding until end of ring
+
+// Ring of features in POSIX shared memory, written by one process and read
+// by other processes without copying or touching file system.
+//
+// layout :
+//   header (aligned by 64 bytes)
+//   records (each aligned by 64 bytes, `capacity` bytes)
+//
+// Record has header of 64 bytes, followed by utterance id and by data which
+// starts at 64-byte boundary. Positions of writer and readers are counters
+// of bytes, and record at position `p` is placed at `p % capacity`. A record
+// never wraps around; if it does not fit before end of ring, skip record is
+// written instead and the record starts at beginning.
+//
+// Every reader reads every record. Writer waits until slowest reader has
+// released the space. Readers which have exited are detached by writer, so
+// that it does not wait for them forever, and ring of writer which has
+// exited is taken as closed by readers. Waiting is done by futex on words
+// of header, so that nobody spins while ring is full or empty.
+
+typedef struct feature_ring_record_t {
+  uint32_t kind;               // FEATURE_RING_RECORD_*
+  uint32_t dtype;              // FEXTOR_DTYPE_*
+  uint32_t num_frame;
+  uint32_t feat_dim;
+  uint32_t id_length;
+  uint32_t reserved0;
+  uint64_t sequence;           // number of record, from 0
+  uint64_t data_offset;        // from start of record
+  uint64_t data_size;          // in bytes
+  uint64_t record_size;        // in bytes, including padding
+  uint8_t reserved1[8];
+} FeatureRingRecord;
+
+typedef struct feature_ring_reader_slot_t {
+  alignas(FEATURE_RING_ALIGN) std::atomic<uint32_t> is_active;
+  std::atomic<int32_t> pid;
+  std::atomic<uint64_t> position;    // start of next record to read
+} FeatureRingReaderSlot;
+
+typedef struct feature_ring_header_t {
+  char magic[8];               // "FXRING"
+  uint32_t version;
+  uint32_t max_readers;
+  uint64_t capacity;           // in bytes
+  uint64_t data_offset;        // start of records
+  int32_t writer_pid;
+  std::atomic<uint32_t> is_closed;
+
+  // Written by writer. `write_seq` is futex word bumped on every record.
+  alignas(FEATURE_RING_ALIGN) std::atomic<uint64_t> position;
+  std::atomic<uint64_t> num_records;
+  std::atomic<uint32_t> write_seq;
+  std::atomic<uint32_t> num_waiting_readers;
+
+  // Bumped by readers as they release records or attach
+  alignas(FEATURE_RING_ALIGN) std::atomic<uint32_t> read_seq;
+  std::atomic<uint32_t> is_writer_waiting;
+
+  FeatureRingReaderSlot readers[FEATURE_RING_MAX_READERS];
+} FeatureRingHeader;
+
+// Publish features into ring. `append()` can be called by multiple threads
+// at once, which are serialized.
+class FeatureRingWriter {
+public:
+  FeatureRingWriter();
+  virtual ~FeatureRingWriter();
+
+private:
+  std::string name_;
+  FeatureRingHeader* header_;
+  unsigned char* data_;
+  size_t map_size_;
+  std::mutex mutex_;
+
+  uint64_t getMinReadPosition();
+  void detachDeadReaders();
+
+public:
+  // Create ring of `capacity` bytes (rounded up by 64 bytes) in shared
+  // memory of `name`, such as "/fextor". Existing ring of same name is
+  // replaced.
+  int open(const char* name, const size_t capacity);
+
+  // Wait until at least `num_readers` readers are attached, so that they
+  // see records from the first one. Returns non-zero on timeout.
+  int waitReaders(const unsigned int num_readers, const unsigned int timeout_ms);
+
+  // Append feature of utterance, waiting while ring is full. Returns
+  // non-zero if record is larger than ring.
+  int append(const std::string& id, const Feature& feat);
+
+  // Same as above, but data is given as raw values of `dtype`
+  int append(const std::string& id, const void* data, const unsigned int dtype,
+             const unsigned int num_frame, const unsigned int feat_dim);
+
+  // Mark ring as closed, so that readers finish after reading remaining
+  // records, and remove its name
+  int close();
+}; // class FeatureRingWriter
+
+// Read features from ring without copying. Record returned by `next()` is
+// valid until `release()`.
+class FeatureRingReader {
+public:
+  FeatureRingReader();
+  virtual ~FeatureRingReader();
+
+private:
+  FeatureRingHeader* header_;
+  const unsigned char* data_;
+  size_t map_size_;
+  int slot_;
+  uint64_t position_;
+  uint64_t record_size_;       // of record returned by `next()`, 0 if none
+
+public:
+  // Attach to ring as a reader. Records appended from now on are read.
+  int open(const char* name);
+  void close();
+
+  // Wait for next record up to `timeout_ms` (forever if 0). `view` points
+  // into shared memory. Returns FEATURE_RING_* code.
+  int next(std::string* id, FeatureView* view, const unsigned int timeout_ms = 0);
+
+  // Give space of record returned by `next()` back to writer
+  void release();
+}; // class FeatureRingReader
+
+#endif // FEATURE_RING_H
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "feature_ring.h"
+
+DEFINE_string(ring, "/fextor_ring_test", "name of shared memory of test ring");
+DEFINE_uint32(num_readers, 2, "number of reader processes");
+DEFINE_uint32(num_records, 20000, "number of records in throughput test");
+DEFINE_uint32(num_frame, 1000, "number of frames of record in throughput test");
+DEFINE_uint32(feat_dim, 40, "dimension of records");
+DEFINE_uint32(ring_size_mb, 64, "size of ring in throughput test");
+
+double elapsedSec(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Number of frames of record `seq`, varying to wrap ring at any offset
+unsigned int getNumFrame(const unsigned int seq, const unsigned int max_frame) {
+  return (max_frame == 0) ? 0 : (seq * 7919u) % (max_frame + 1);
+}
+
+// Fixed pattern of values. First value is set to number of each record.
+void fillRecord(std::vector<float>* data) {
+  for (size_t i = 0; i < data->size(); i++) {
+    (*data)[i] = (float)(i % 1009);
+  }
+}
+
+// Read `num_records` records and check them. `exit_after` records are read
+// by reader which exits without detaching, if positive.
+int readRecords(const unsigned int num_records, const unsigned int max_frame,
+                const unsigned int exit_after) {
+  FeatureRingReader reader;
+  if (reader.open(FLAGS_ring.c_str()) != 0) {
+    return 1;
+  }
+  std::string id;
+  FeatureView view;
+  unsigned int seq = 0;
+  while (true) {
+    const int ret = reader.next(&id, &view, 10000);
+    if (ret == FEATURE_RING_CLOSED) {
+      break;
+    }
+    if (ret != FEATURE_RING_SUCCESS) {
+      fprintf(stderr, "reader %d : next() returned %d at %u\n", (int)getpid(), ret, seq);
+      return 1;
+    }
+    const unsigned int num_frame = getNumFrame(seq, max_frame);
+    const float* values = (const float*)view.data;
+    bool is_valid = (id == "utt" + std::to_string(seq) &&
+                     view.dtype == FEXTOR_DTYPE_FLOAT32 &&
+                     view.num_frame == num_frame && view.feat_dim == FLAGS_feat_dim &&
+                     ((uintptr_t)view.data % FEATURE_RING_ALIGN) == 0);
+    const size_t num_values = (size_t)num_frame * FLAGS_feat_dim;
+    for (size_t i = 1; i < num_values && is_valid; i++) {
+      is_valid = (values[i] == (float)(i % 1009));
+    }
+    if (!is_valid || (num_values > 0 && values[0] != (float)seq)) {
+      fprintf(stderr, "reader %d : record %u is broken\n", (int)getpid(), seq);
+      return 1;
+    }
+    seq++;
+    if (seq == exit_after) {
+      // Slot is left active, as if reader has crashed
+      _exit(0);
+    }
+  }
+  if (seq != num_records) {
+    fprintf(stderr, "reader %d : %u of %u records are read\n", (int)getpid(),
+            seq, num_records);
+    return 1;
+  }
+  return 0;
+}
+
+// Append records while `num_readers` processes read them, one of which exits
+// after `exit_after` records if positive
+int testRing(const char* name, const unsigned int num_readers,
+             const unsigned int num_records, const unsigned int max_frame,
+             const size_t ring_size, const unsigned int exit_after) {
+  FeatureRingWriter writer;
+  if (writer.open(FLAGS_ring.c_str(), ring_size) != 0) {
+    return 1;
+  }
+  std::vector<pid_t> children;
+  for (unsigned int i = 0; i < num_readers; i++) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      _exit(readRecords(num_records, max_frame, (i == 0) ? exit_after : 0));
+    } else if (pid < 0) {
+      fprintf(stderr, "failed to fork reader.\n");
+      break;
+    }
+    children.push_back(pid);
+  }
+  int error_code = (children.size() == num_readers) ? 0 : 1;
+  if (writer.waitReaders((unsigned int)children.size(), 10000) != 0) {
+    error_code = 1;
+  }
+
+  std::vector<float> data((size_t)max_frame * FLAGS_feat_dim);
+  fillRecord(&data);
+  uint64_t num_bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int seq = 0; seq < num_records && error_code == 0; seq++) {
+    const unsigned int num_frame = getNumFrame(seq, max_frame);
+    if (!data.empty()) {
+      data[0] = (float)seq;
+    }
+    error_code = writer.append("utt" + std::to_string(seq), data.data(),
+                               FEXTOR_DTYPE_FLOAT32, num_frame, FLAGS_feat_dim);
+    num_bytes += (uint64_t)num_frame * FLAGS_feat_dim * sizeof(float);
+  }
+  if (writer.close() != 0) {
+    error_code = 1;
+  }
+  for (pid_t pid : children) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      error_code = 1;
+    }
+  }
+  const double elapsed = elapsedSec(start);
+  fprintf(stdout, "%-8s: %u records x %u readers, %.1f MB in %.3f sec "
+          "(%.0f records/s, %.2f GB/s per reader)%s\n", name, num_records,
+          num_readers, num_bytes / 1e6, elapsed, num_records / elapsed,
+          num_bytes / 1e9 / elapsed, (error_code == 0) ? "" : " FAILED");
+  return error_code;
+}
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage("feature_ring_test");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  int error_code = 0;
+  const size_t ring_size = (size_t)FLAGS_ring_size_mb << 20;
+  error_code |= testRing("single", 1, FLAGS_num_records, FLAGS_num_frame,
+                         ring_size, 0);
+  error_code |= testRing("multi", FLAGS_num_readers, FLAGS_num_records,
+                         FLAGS_num_frame, ring_size, 0);
+  // Ring of a few records, which wraps on almost every record
+  error_code |= testRing("wrap", FLAGS_num_readers, FLAGS_num_records / 10,
+                         FLAGS_num_frame, (size_t)FLAGS_num_frame * FLAGS_feat_dim * 12, 0);
+  // Writer goes on after a reader exits in the middle
+  error_code |= testRing("crash", FLAGS_num_readers + 1, FLAGS_num_records / 10,
+                         FLAGS_num_frame, (size_t)FLAGS_num_frame * FLAGS_feat_dim * 12, 100);
+
+  fprintf(stdout, "%s\n", (error_code == 0) ? "PASSED" : "FAILED");
+
+  gflags::ShutDownCommandLineFlags();
+  return error_code;
+}
@@ -0,0 +1,1051 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "feature_archive.h"
+#include "feature_codec.h"
+#include "feature_manifest.h"
+#include "feature_writer.h"
+#include "fextor_app.h"
+#include "fextor_c_api.h"
+#include "fextor_protocol.h"
+#include "fextor_server.h"
+#include "wave/wave.h"
+
+DEFINE_string(test_dir, "", "directory of files written by test, temporary "
+              "directory which is removed at exit if empty");
+
+std::string g_test_dir;
+std::vector<std::string> g_test_files;
+
+// Path of file in test directory, removed at exit
+std::string getTestPath(const std::string& name) {
+  const std::string path = g_test_dir + "/" + name;
+  g_test_files.push_back(path);
+  return path;
+}
+
+int readFileBytes(const std::string& file_name, std::vector<unsigned char>* bytes) {
+  FILE* fp = fopen(file_name.c_str(), "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "failed to open file : %s\n", file_name.c_str());
+    return 1;
+  }
+  unsigned char buffer[65536];
+  size_t num_read;
+  bytes->clear();
+  while ((num_read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    bytes->insert(bytes->end(), buffer, buffer + num_read);
+  }
+  fclose(fp);
+  return 0;
+}
+
+int writeFileBytes(const std::string& file_name, const std::vector<unsigned char>& bytes) {
+  FILE* fp = fopen(file_name.c_str(), "wb");
+  if (fp == NULL) {
+    return 1;
+  }
+  const size_t num_written = fwrite(bytes.data(), 1, bytes.size(), fp);
+  return (fclose(fp) == 0 && num_written == bytes.size()) ? 0 : 1;
+}
+
+// Feature of smooth values in range of about [-40, 40], varied by `seed`
+void fillFeature(const unsigned int num_frame, const unsigned int feat_dim,
+                 const unsigned int seed, Feature* feat) {
+  feat->resize(num_frame, feat_dim);
+  for (unsigned int i = 0; i < num_frame * feat_dim; i++) {
+    (*feat->getPtr(i)) = (dsp::float_t)(40 * sin(0.01 * i + seed) - (i % feat_dim));
+  }
+}
+
+bool isSameFeature(const FeatureView& view, const Feature& feat) {
+  return view.dtype == FEXTOR_DTYPE_NATIVE &&
+         view.num_frame == feat.getNumFrame() && view.feat_dim == feat.getFeatDim() &&
+         memcmp(view.data, feat.getData(), sizeof(dsp::float_t) *
+                feat.getNumFrame() * feat.getFeatDim()) == 0;
+}
+
+bool isSameFeature(const Feature& a, const Feature& b) {
+  return a.getNumFrame() == b.getNumFrame() && a.getFeatDim() == b.getFeatDim() &&
+         memcmp(a.getData(), b.getData(), sizeof(dsp::float_t) *
+                a.getNumFrame() * a.getFeatDim()) == 0;
+}
+
+void report(const char* name, const int error_code) {
+  fprintf(stdout, "%-14s: %s\n", name, (error_code == 0) ? "ok" : "FAILED");
+}
+
+// Features written into archive are found by id, with and without index,
+// and after appending to existing archive
+int testArchive() {
+  const std::string file_name = getTestPath("archive.fxa");
+  std::vector<Feature> feats(5);
+  for (unsigned int i = 0; i < feats.size(); i++) {
+    fillFeature(100 + 37 * i, 40, i, &feats[i]);
+  }
+  fillFeature(0, 40, 0, &feats[4]);  // empty feature has record too
+
+  int error_code = 0;
+  FeatureArchiveWriter writer;
+  if (writer.open(file_name.c_str()) != 0) {
+    return 1;
+  }
+  for (unsigned int i = 0; i < 3; i++) {
+    error_code |= writer.append("utt" + std::to_string(i), feats[i]);
+  }
+  // Id is unique in archive
+  if (writer.append("utt0", feats[0]) == 0) {
+    error_code = 1;
+  }
+  error_code |= writer.close();
+  if (writer.open(file_name.c_str(), true) != 0) {
+    return 1;
+  }
+  for (unsigned int i = 3; i < feats.size(); i++) {
+    error_code |= writer.append("utt" + std::to_string(i), feats[i]);
+  }
+  error_code |= writer.close();
+
+  // Archive whose index is not written is scanned
+  const std::string scan_file_name = getTestPath("archive_scan.fxa");
+  std::vector<unsigned char> bytes;
+  error_code |= readFileBytes(file_name, &bytes);
+  FeatureArchiveHeader* header = (FeatureArchiveHeader*)bytes.data();
+  bytes.resize(header->index_offset);
+  header->index_offset = 0;
+  header->index_size = 0;
+  error_code |= writeFileBytes(scan_file_name, bytes);
+
+  const std::string names[] = {file_name, scan_file_name};
+  for (const auto& name : names) {
+    FeatureArchiveReader reader;
+    if (reader.open(name.c_str()) != 0 || reader.size() != feats.size()) {
+      error_code = 1;
+      continue;
+    }
+    for (unsigned int i = 0; i < feats.size(); i++) {
+      FeatureView view;
+      const std::string id = "utt" + std::to_string(i);
+      if (reader.find(id, &view) != 0 || !isSameFeature(view, feats[i]) ||
+          reader.getIds()[i] != id ||
+          ((uintptr_t)view.data % FEATURE_ARCHIVE_ALIGN) != 0) {
+        error_code = 1;
+      }
+    }
+    FeatureView view;
+    if (reader.find("missing", &view) == 0) {
+      error_code = 1;
+    }
+  }
+
+  // Record whose data size does not match its shape is not found, and index
+  // beyond end of file is rejected
+  const std::string broken_name = getTestPath("archive_broken.fxa");
+  error_code |= readFileBytes(file_name, &bytes);
+  header = (FeatureArchiveHeader*)bytes.data();
+  FeatureRecordHeader* record = (FeatureRecordHeader*)(bytes.data() + FEATURE_ARCHIVE_ALIGN);
+  record->num_frame *= 2;
+  error_code |= writeFileBytes(broken_name, bytes);
+  FeatureArchiveReader reader;
+  FeatureView view;
+  if (reader.open(broken_name.c_str()) != 0 || reader.find("utt0", &view) == 0 ||
+      reader.find("utt1", &view) != 0) {
+    error_code = 1;
+  }
+  reader.close();
+  record->num_frame /= 2;
+  header->index_offset = UINT64_MAX - 8;
+  error_code |= writeFileBytes(broken_name, bytes);
+  if (reader.open(broken_name.c_str()) == 0) {
+    error_code = 1;
+  }
+  report("archive", error_code);
+  return error_code;
+}
+
+// Saved .feat and .npy files are loaded by mapping them, and .npy header is
+// what numpy expects
+int testLoad() {
+  Feature feat;
+  fillFeature(123, 40, 7, &feat);
+  const std::string names[] = {getTestPath("load.feat"), getTestPath("load.npy")};
+
+  int error_code = 0;
+  for (const auto& name : names) {
+    Feature loaded;
+    if (feat.save(name.c_str()) != 0 || loaded.load(name.c_str()) != 0 ||
+        !loaded.isMapped() || loaded.getPtr(0) != NULL ||
+        !isSameFeature(loaded, feat)) {
+      error_code = 1;
+      continue;
+    }
+    // Resized feature is not mapped anymore
+    loaded.resize(2, 3);
+    if (loaded.isMapped() || loaded.getPtr(0) == NULL) {
+      error_code = 1;
+    }
+  }
+
+  std::vector<unsigned char> bytes;
+  error_code |= readFileBytes(names[1], &bytes);
+  const size_t data_size = sizeof(dsp::float_t) * feat.getNumFrame() * feat.getFeatDim();
+  const std::string header(bytes.begin(), bytes.end() - data_size);
+  const char* descr = (sizeof(dsp::float_t) == 4) ? "'descr': '<f4'" : "'descr': '<f8'";
+  if (header.compare(0, 6, "\x93NUMPY") != 0 || header.find(descr) == std::string::npos ||
+      header.find("'fortran_order': False") == std::string::npos ||
+      header.find("'shape': (123, 40)") == std::string::npos ||
+      header.size() % 64 != 0 || header.back() != '\n') {
+    error_code = 1;
+  }
+
+  // Truncated file is rejected instead of mapped
+  const std::string broken_name = getTestPath("broken.npy");
+  bytes.resize(bytes.size() - 1);
+  error_code |= writeFileBytes(broken_name, bytes);
+  Feature broken;
+  if (broken.load(broken_name.c_str()) == 0) {
+    error_code = 1;
+  }
+  report("load", error_code);
+  return error_code;
+}
+
+// Quantized .feat files are decoded within half a step of each dimension,
+// and constant dimension is kept exactly
+int testCodec() {
+  Feature feat;
+  fillFeature(321, 40, 3, &feat);
+  for (unsigned int i = 0; i < feat.getNumFrame(); i++) {
+    (*feat.getPtr(i * feat.getFeatDim() + 5)) = (dsp::float_t)3.25;
+  }
+  const struct {
+    const char* name;
+    unsigned int num_levels;
+    unsigned int code_size;
+  } codecs[] = {{"q16", 65535, 2}, {"q8", 255, 1}};
+
+  int error_code = 0;
+  for (const auto& codec : codecs) {
+    FeatureFormat format;
+    format.codec = getCodec(codec.name);
+    const std::string name = getTestPath(std::string("codec_") + codec.name + ".feat");
+    Feature loaded;
+    std::vector<unsigned char> bytes;
+    FeatFileHeader header;
+    if (format.codec < 0 || feat.save(name.c_str(), &format) != 0 ||
+        readFileBytes(name, &bytes) != 0 ||
+        readFeatureHeader(bytes.data(), bytes.size(), &header) != 0 ||
+        header.codec != (uint32_t)format.codec ||
+        header.data_size != (uint64_t)feat.getNumFrame() * feat.getFeatDim() * codec.code_size ||
+        loaded.load(name.c_str()) != 0 || loaded.isMapped() ||
+        loaded.getNumFrame() != feat.getNumFrame() ||
+        loaded.getFeatDim() != feat.getFeatDim()) {
+      fprintf(stderr, "failed to encode or decode by %s\n", codec.name);
+      error_code = 1;
+      continue;
+    }
+    const unsigned int num_frame = feat.getNumFrame();
+    const unsigned int feat_dim = feat.getFeatDim();
+    for (unsigned int d = 0; d < feat_dim; d++) {
+      double min_value = feat.getData()[d], max_value = feat.getData()[d];
+      for (unsigned int i = 0; i < num_frame; i++) {
+        min_value = std::min(min_value, (double)feat.getData()[i * feat_dim + d]);
+        max_value = std::max(max_value, (double)feat.getData()[i * feat_dim + d]);
+      }
+      const double max_error = 0.5 * (max_value - min_value) / codec.num_levels + 1e-5;
+      for (unsigned int i = 0; i < num_frame; i++) {
+        const unsigned int index = i * feat_dim + d;
+        if (fabs(loaded.getData()[index] - feat.getData()[index]) > max_error) {
+          error_code = 1;
+        }
+      }
+    }
+    for (unsigned int i = 0; i < num_frame; i++) {
+      if (loaded.getData()[i * feat_dim + 5] != (dsp::float_t)3.25) {
+        error_code = 1;
+      }
+    }
+  }
+  if (getCodec("none") != FEXTOR_CODEC_NONE || getCodec("q4") != -1) {
+    error_code = 1;
+  }
+  report("codec", error_code);
+  return error_code;
+}
+
+bool isNan(const uint16_t half) {
+  return (half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0;
+}
+
+// Half precision nearest to `value`, ties to even, searched among all finite
+// half values decoded by `table`
+uint16_t getNearestHalf(const double value, const std::vector<dsp::float_t>& table) {
+  const uint16_t sign = (value < 0 || (value == 0 && signbit(value))) ? 0x8000 : 0;
+  const double abs = fabs(value);
+  if (abs >= 65520.0) {
+    return sign | 0x7c00;
+  }
+  // Positive finite halves 0x0000 ~ 0x7bff are in order of their values
+  uint16_t low = 0, high = 0x7bff;
+  while (high - low > 1) {
+    const uint16_t middle = (uint16_t)((low + high) / 2);
+    if ((double)table[middle] <= abs) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  const double low_error = abs - (double)table[low];
+  const double high_error = (double)table[high] - abs;
+  if (low_error < high_error || (low_error == high_error && (low & 1) == 0)) {
+    return sign | low;
+  }
+  return sign | high;
+}
+
+// Float16 conversion is compared with exhaustive reference, on vectors (F16C
+// if enabled) and on single values which always take scalar path
+int testFloat16() {
+  int error_code = 0;
+  std::vector<uint16_t> halves(65536);
+  for (unsigned int i = 0; i < halves.size(); i++) {
+    halves[i] = (uint16_t)i;
+  }
+  std::vector<dsp::float_t> table(halves.size());
+  decodeValues(halves.data(), halves.size(), FEXTOR_DTYPE_FLOAT16, 0, table.data());
+  std::vector<uint16_t> encoded(halves.size());
+  encodeValues(table.data(), table.size(), FEXTOR_DTYPE_FLOAT16, 0, encoded.data());
+  for (unsigned int i = 0; i < halves.size(); i++) {
+    dsp::float_t value;
+    uint16_t half;
+    decodeValues(&halves[i], 1, FEXTOR_DTYPE_FLOAT16, 0, &value);
+    encodeValues(&table[i], 1, FEXTOR_DTYPE_FLOAT16, 0, &half);
+    if (isNan(halves[i])) {
+      if (!std::isnan(table[i]) || !std::isnan(value) || !isNan(encoded[i]) ||
+          !isNan(half)) {
+        error_code = 1;
+      }
+    } else if (memcmp(&value, &table[i], sizeof(value)) != 0 ||
+               encoded[i] != halves[i] || half != halves[i]) {
+      error_code = 1;
+    }
+  }
+  // Subnormal, normal and extreme values of half
+  if (table[0x0001] != (dsp::float_t)5.9604644775390625e-8 ||
+      table[0x03ff] != (dsp::float_t)6.0975551605224609e-5 ||
+      table[0x3c00] != 1 || table[0x7bff] != 65504 || table[0xc000] != -2 ||
+      !std::isinf(table[0x7c00])) {
+    error_code = 1;
+  }
+
+  // Rounding of floats between halves, including ties and values out of range
+  std::vector<dsp::float_t> values;
+  for (uint32_t x = 0; x < 0x7f800000; x += 4099) {
+    float value;
+    memcpy(&value, &x, sizeof(value));
+    values.push_back(value);
+    values.push_back(-value);
+  }
+  for (uint32_t i = 0; i + 1 < 0x7c00; i += 7) {
+    values.push_back((dsp::float_t)(((double)table[i] + (double)table[i + 1]) / 2));
+  }
+  encoded.resize(values.size());
+  encodeValues(values.data(), values.size(), FEXTOR_DTYPE_FLOAT16, 0, encoded.data());
+  for (size_t i = 0; i < values.size(); i++) {
+    uint16_t half;
+    encodeValues(&values[i], 1, FEXTOR_DTYPE_FLOAT16, 0, &half);
+    const uint16_t expected = getNearestHalf((double)values[i], table);
+    if (encoded[i] != expected || half != expected) {
+      if (error_code == 0) {
+        fprintf(stderr, "float16 of %.9g : %04x (single %04x), expected %04x\n",
+                (double)values[i], encoded[i], half, expected);
+      }
+      error_code = 1;
+    }
+  }
+  report("float16", error_code);
+  return error_code;
+}
+
+// bfloat16 and int8 of vectors, converted by SIMD, are same as ones of single
+// values, including NaN, infinity and ties of rounding
+int testVectorConversion() {
+  std::vector<dsp::float_t> values;
+  for (uint32_t x = 0; x < 0x7fc00000; x += 0x8001) {
+    float value;
+    memcpy(&value, &x, sizeof(value));
+    values.push_back(value);
+    values.push_back(-value);
+  }
+  const uint32_t specials[] = {
+    0x3f808000, 0x3f818000, 0x7f7fffff, 0x7f800000, 0x7f800001, 0x7fc00000,
+    0xff800000, 0xffffffff,
+  };
+  for (const uint32_t x : specials) {
+    float value;
+    memcpy(&value, &x, sizeof(value));
+    values.push_back(value);
+  }
+  values.resize(values.size() / 16 * 16 + 3, 0);
+
+  int error_code = 0;
+  std::vector<uint16_t> bfloats(values.size());
+  std::vector<dsp::float_t> decoded(values.size());
+  encodeValues(values.data(), values.size(), FEXTOR_DTYPE_BFLOAT16, 0, bfloats.data());
+  decodeValues(bfloats.data(), bfloats.size(), FEXTOR_DTYPE_BFLOAT16, 0, decoded.data());
+  for (size_t i = 0; i < values.size(); i++) {
+    uint16_t bfloat;
+    dsp::float_t value;
+    encodeValues(&values[i], 1, FEXTOR_DTYPE_BFLOAT16, 0, &bfloat);
+    decodeValues(&bfloat, 1, FEXTOR_DTYPE_BFLOAT16, 0, &value);
+    if (bfloats[i] != bfloat || memcmp(&decoded[i], &value, sizeof(value)) != 0) {
+      error_code = 1;
+    }
+  }
+
+  const double scale = 1.0 / 64;
+  std::vector<int8_t> codes(values.size());
+  encodeValues(values.data(), values.size(), FEXTOR_DTYPE_INT8, scale, codes.data());
+  for (size_t i = 0; i < values.size(); i++) {
+    int8_t code;
+    encodeValues(&values[i], 1, FEXTOR_DTYPE_INT8, scale, &code);
+    if (codes[i] != code || (std::isnan(values[i]) && code != 0)) {
+      error_code = 1;
+    }
+  }
+  report("simd", error_code);
+  return error_code;
+}
+
+// Every dtype is written into .feat (and .npy for float types) and loaded
+// within error of the dtype
+int testDtype() {
+  Feature feat;
+  fillFeature(257, 40, 5, &feat);
+  (*feat.getPtr(7)) = (dsp::float_t)1e-6;  // subnormal of float16
+  const size_t num_values = (size_t)feat.getNumFrame() * feat.getFeatDim();
+  double max_abs = 0;
+  for (size_t i = 0; i < num_values; i++) {
+    max_abs = std::max(max_abs, fabs((double)feat.getData()[i]));
+  }
+  const struct {
+    const char* name;
+    double relative_error;  // relative to value
+    double absolute_error;  // relative to max of absolute values
+    bool is_npy;
+  } dtypes[] = {
+    {"float32", 1.0 / (1 << 23), 0, true},
+    {"float64", 1.0 / (1 << 23), 0, true},
+    {"float16", 1.0 / (1 << 11), 1.0 / (1 << 24), true},
+    {"bfloat16", 1.0 / (1 << 8), 0, false},
+    {"int8", 0, 0.5 / 127 + 1e-6, false},
+  };
+
+  int error_code = 0;
+  for (const auto& dtype : dtypes) {
+    FeatureFormat format;
+    format.dtype = getDtype(dtype.name);
+    std::vector<std::string> names;
+    names.push_back(getTestPath(std::string("dtype_") + dtype.name + ".feat"));
+    if (dtype.is_npy) {
+      names.push_back(getTestPath(std::string("dtype_") + dtype.name + ".npy"));
+    }
+    for (const auto& name : names) {
+      Feature loaded;
+      if (format.dtype < 0 || feat.save(name.c_str(), &format) != 0 ||
+          loaded.load(name.c_str()) != 0 ||
+          loaded.getNumFrame() != feat.getNumFrame() ||
+          loaded.getFeatDim() != feat.getFeatDim()) {
+        fprintf(stderr, "failed to save or load %s\n", name.c_str());
+        error_code = 1;
+        continue;
+      }
+      for (size_t i = 0; i < num_values; i++) {
+        const double value = (double)feat.getData()[i];
+        const double max_error = fabs(value) * dtype.relative_error +
+                                 max_abs * dtype.absolute_error;
+        if (fabs((double)loaded.getData()[i] - value) > max_error) {
+          error_code = 1;
+        }
+      }
+    }
+  }
+  // .npy has no place for scale of int8
+  FeatureFormat format;
+  format.dtype = FEXTOR_DTYPE_INT8;
+  if (feat.save(getTestPath("dtype_int8.npy").c_str(), &format) == 0) {
+    error_code = 1;
+  }
+  report("dtype", error_code);
+  return error_code;
+}
+
+// Files written by writer, on calling thread and by its threads, with and
+// without O_DIRECT, are same as files written by `Feature::save()`
+int testWriter() {
+  // Sizes around multiples of alignment and of buffer of writer
+  const unsigned int num_frames[] = {
+    0, 1, 100, FEATURE_WRITER_ALIGN / 4 / 40 + 1,
+    FEATURE_WRITER_BUFFER_SIZE / 4 / 40 + 3, 2 * FEATURE_WRITER_BUFFER_SIZE / 4 / 40,
+  };
+  const size_t num_feats = sizeof(num_frames) / sizeof(num_frames[0]);
+  std::vector<Feature> feats(num_feats);
+  for (size_t i = 0; i < num_feats; i++) {
+    fillFeature(num_frames[i], 40, (unsigned int)i, &feats[i]);
+  }
+  std::vector<FeatureFormat> formats(3);
+  formats[1].codec = FEXTOR_CODEC_Q16;
+  formats[2].dtype = FEXTOR_DTYPE_FLOAT16;
+
+  int error_code = 0;
+  for (int use_direct_io = 0; use_direct_io < 2; use_direct_io++) {
+    for (size_t f = 0; f < formats.size(); f++) {
+      FeatureWriter writer(formats[f], 2, 4, use_direct_io != 0);
+      std::vector<std::string> names, expected_names;
+      for (size_t i = 0; i < num_feats; i++) {
+        const std::string prefix = "writer_" + std::to_string(use_direct_io) +
+            "_" + std::to_string(f) + "_" + std::to_string(i);
+        const char* extension = (i % 2 == 0) ? ".feat" : ".npy";
+        names.push_back(getTestPath(prefix + "_sync" + extension));
+        names.push_back(getTestPath(prefix + "_async" + extension));
+        expected_names.push_back(getTestPath(prefix + "_save" + extension));
+        error_code |= feats[i].save(expected_names.back().c_str(), &formats[f]);
+        error_code |= writer.write(names[2 * i], feats[i]);
+        Feature* copied = new Feature(feats[i].getNumFrame(), feats[i].getFeatDim());
+        if (feats[i].getNumFrame() > 0) {
+          memcpy(copied->getPtr(0), feats[i].getData(), sizeof(dsp::float_t) *
+                 feats[i].getNumFrame() * feats[i].getFeatDim());
+        }
+        error_code |= writer.submit(names[2 * i + 1], copied);
+      }
+      if (writer.finish() != 0 || writer.getNumWritten() != 2 * num_feats) {
+        error_code = 1;
+      }
+      for (size_t i = 0; i < names.size(); i++) {
+        std::vector<unsigned char> bytes, expected_bytes;
+        if (readFileBytes(names[i], &bytes) != 0 ||
+            readFileBytes(expected_names[i / 2], &expected_bytes) != 0 ||
+            bytes != expected_bytes) {
+          fprintf(stderr, "%s is different from %s\n", names[i].c_str(),
+                  expected_names[i / 2].c_str());
+          error_code = 1;
+        }
+      }
+    }
+  }
+
+  // Failure is counted, and no file is left
+  FeatureWriter writer(formats[0], 1);
+  const std::string missing_name = g_test_dir + "/missing/writer.feat";
+  if (writer.write(missing_name, feats[1]) == 0 || writer.finish() != 1 ||
+      access(missing_name.c_str(), F_OK) == 0) {
+    error_code = 1;
+  }
+  report("writer", error_code);
+  return error_code;
+}
+
+int touchFile(const std::string& file_name) {
+  return writeFileBytes(file_name, std::vector<unsigned char>(1, 0));
+}
+
+// Rerun skips outputs written from same input and config, copies outputs of
+// duplicated input, and extracts again after input, config or output changes
+int testManifest() {
+  int error_code = 0;
+
+  // Hash is XXH64
+  std::vector<unsigned char> bytes(1280);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = (unsigned char)i;
+  }
+  if (hashBytes("", 0) != 0xef46db3751d8e999ull ||
+      hashBytes("abc", 3) != 0x44bc2cf5ad770999ull ||
+      hashBytes("abc", 3, 1) != 0xbea9ca8199328908ull ||
+      hashBytes(bytes.data(), bytes.size()) != 0xafc184ad7938a354ull) {
+    error_code = 1;
+  }
+
+  dsp::FEInitParam param;
+  dsp::setDefaultParam(FEXTOR_SAMPLING_RATE, &param);
+  FeatureFormat format, q16_format;
+  q16_format.codec = FEXTOR_CODEC_Q16;
+  const uint64_t config = hashConfig(param, FEXTOR_TARGET_MFCC, format);
+  if (config != hashConfig(param, FEXTOR_TARGET_MFCC, format) ||
+      config == hashConfig(param, FEXTOR_TARGET_MEL, format) ||
+      config == hashConfig(param, FEXTOR_TARGET_MFCC, q16_format)) {
+    error_code = 1;
+  }
+
+  const std::string manifest_name = getTestPath("manifest.txt");
+  getTestPath("manifest.txt.tmp");
+  const std::string a = getTestPath("manifest_a.feat");
+  const std::string b = getTestPath("manifest_b.feat");
+  const std::string c = getTestPath("manifest_c.feat");
+  const uint64_t input_x = 1, input_y = 2, input_z = 3;
+  std::string source;
+
+  // First run : b has same input as a
+  FeatureManifest manifest;
+  error_code |= manifest.open(manifest_name.c_str(), config);
+  if (manifest.claim(a, input_x, &source) != FeatureManifest::kClaimNew ||
+      manifest.claim(b, input_x, &source) != FeatureManifest::kClaimDuplicate ||
+      source != a || manifest.claim(c, input_y, &source) != FeatureManifest::kClaimNew) {
+    error_code = 1;
+  }
+  error_code |= touchFile(a) | touchFile(b) | touchFile(c);
+  error_code |= manifest.add(a, input_x) | manifest.add(b, input_x) | manifest.add(c, input_y);
+  manifest.close();
+
+  // Rerun : input of c is changed
+  error_code |= manifest.open(manifest_name.c_str(), config);
+  if (manifest.claim(a, input_x, &source) != FeatureManifest::kClaimUpToDate ||
+      manifest.claim(b, input_x, &source) != FeatureManifest::kClaimUpToDate ||
+      manifest.claim(c, input_z, &source) != FeatureManifest::kClaimNew) {
+    error_code = 1;
+  }
+  error_code |= manifest.add(c, input_z);
+  manifest.close();
+
+  // Removed output is extracted again, and others copy it
+  unlink(a.c_str());
+  unlink(b.c_str());
+  error_code |= manifest.open(manifest_name.c_str(), config);
+  if (manifest.claim(c, input_z, &source) != FeatureManifest::kClaimUpToDate ||
+      manifest.claim(a, input_x, &source) != FeatureManifest::kClaimNew ||
+      manifest.claim(b, input_x, &source) != FeatureManifest::kClaimDuplicate ||
+      source != a) {
+    error_code = 1;
+  }
+  manifest.close();
+
+  // Every output is extracted again by other config
+  error_code |= manifest.open(manifest_name.c_str(),
+                              hashConfig(param, FEXTOR_TARGET_MFCC, q16_format));
+  if (manifest.claim(c, input_z, &source) != FeatureManifest::kClaimNew) {
+    error_code = 1;
+  }
+  manifest.close();
+
+  // Manifest is compacted into one line per existing output
+  std::ifstream input(manifest_name);
+  unsigned int num_lines = 0;
+  for (std::string line; getline(input, line);) {
+    if (!line.empty() && line[0] != '#') {
+      num_lines++;
+      if (line.find(c) == std::string::npos) {
+        error_code = 1;
+      }
+    }
+  }
+  if (num_lines != 1) {
+    error_code = 1;
+  }
+  report("manifest", error_code);
+  return error_code;
+}
+
+// Mono wave of tone and deterministic noise, written as WAV file and
+// decoded back, so that decoded samples are those which server reads
+int makeTestWave(const std::string& file_name, std::vector<dsp::float_t>* wav) {
+  const unsigned int num_samples = FEXTOR_SAMPLING_RATE + 123;
+  std::vector<float> samples(num_samples);
+  uint32_t seed = 1;
+  for (unsigned int i = 0; i < num_samples; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    samples[i] = (float)(0.3 * sin(2 * M_PI * 440 * i / FEXTOR_SAMPLING_RATE) +
+                         0.01 * ((double)(seed >> 8) / (1 << 24) - 0.5));
+  }
+  {
+    // File is flushed when writer is destroyed
+    wave::WaveWriter writer;
+    writer.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, FEXTOR_NUM_CHANNELS);
+    if (writer.write(file_name.c_str(), samples.data(), num_samples) != WAVE_SUCCESS) {
+      return 1;
+    }
+  }
+  wave::WaveReader reader;
+  reader.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, FEXTOR_NUM_CHANNELS);
+  dsp::float_t* data = NULL;
+  unsigned int length = 0;
+  if (reader.read(file_name.c_str(), &data, &length) != WAVE_SUCCESS) {
+    return 1;
+  }
+  wav->assign(data, data + length);
+  delete[] data;
+  return 0;
+}
+
+// Features extracted while streaming PCM, mono and stereo of same channels,
+// are same as those of whole file
+int testStream() {
+  const std::string wav_name = getTestPath("stream.wav");
+  const std::string expected_name = getTestPath("stream_expected.feat");
+  std::vector<dsp::float_t> wav;
+  if (makeTestWave(wav_name, &wav) != 0) {
+    return 1;
+  }
+  std::vector<unsigned char> mono, stereo;
+  for (const auto sample : wav) {
+    const int16_t value = (int16_t)lrint(sample * 32768);
+    const unsigned char bytes[] = {(unsigned char)(value & 0xff),
+                                   (unsigned char)((value >> 8) & 0xff)};
+    mono.insert(mono.end(), bytes, bytes + 2);
+    stereo.insert(stereo.end(), bytes, bytes + 2);
+    stereo.insert(stereo.end(), bytes, bytes + 2);
+  }
+
+  dsp::FEInitParam param;
+  dsp::setDefaultParam(FEXTOR_SAMPLING_RATE, &param);
+  dsp::FeatureExtractor extractor;
+  Feature expected;
+  if (extractor.init(&param) != DSP_SUCCESS ||
+      extractOne(wav_name.c_str(), expected_name.c_str(), &param, &extractor,
+                 FEXTOR_TARGET_MFCC) != 0 ||
+      expected.load(expected_name.c_str()) != 0) {
+    return 1;
+  }
+
+  int error_code = 0;
+  const struct {
+    const char* name;
+    const std::vector<unsigned char>* bytes;
+    unsigned int num_channels;
+  } inputs[] = {
+    {"mono", &mono, 1},
+    {"stereo", &stereo, 2},
+  };
+  for (const auto& input : inputs) {
+    const std::string pcm_name = getTestPath(std::string("stream_") + input.name + ".pcm");
+    const std::string output_name = getTestPath(std::string("stream_") + input.name + ".feat");
+    wave::PcmStreamReader reader;
+    Feature feat;
+    if (writeFileBytes(pcm_name, *input.bytes) != 0 ||
+        reader.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, input.num_channels) != WAVE_SUCCESS ||
+        reader.open(pcm_name.c_str()) != WAVE_SUCCESS ||
+        extractStream(&reader, output_name.c_str(), &param, &extractor,
+                      FEXTOR_TARGET_MFCC) != 0 ||
+        feat.load(output_name.c_str()) != 0 || !isSameFeature(feat, expected)) {
+      fprintf(stderr, "stream : feature of %s input is different\n", input.name);
+      error_code = 1;
+    }
+  }
+  report("stream", error_code);
+  return error_code;
+}
+
+bool isSameResponse(const FextorResponse& response, const Feature& feat) {
+  return response.status == 0 && response.dtype == FEXTOR_DTYPE_NATIVE &&
+         response.num_frame == feat.getNumFrame() &&
+         response.feat_dim == feat.getFeatDim() &&
+         response.data.size() == sizeof(dsp::float_t) * feat.getNumFrame() * feat.getFeatDim() &&
+         memcmp(response.data.data(), feat.getData(), response.data.size()) == 0;
+}
+
+// Features served for path, WAV, and PCM inputs are same as computed in
+// process, also from concurrent clients, and invalid requests get error
+// status without closing connection
+int testServer() {
+  const std::string wav_name = getTestPath("server.wav");
+  const std::string pcm_name = getTestPath("server.pcm");
+  const std::string output_name = getTestPath("server_output.feat");
+  const std::string expected_name = getTestPath("server_expected.feat");
+  const std::string socket_name = getTestPath("server.sock");
+  std::vector<dsp::float_t> wav;
+  std::vector<unsigned char> pcm;
+  if (makeTestWave(wav_name, &wav) != 0) {
+    return 1;
+  }
+  for (const auto sample : wav) {
+    const int16_t value = (int16_t)lrint(sample * 32768);
+    pcm.push_back((unsigned char)(value & 0xff));
+    pcm.push_back((unsigned char)((value >> 8) & 0xff));
+  }
+  int error_code = writeFileBytes(pcm_name, pcm);
+
+  dsp::FEInitParam param;
+  dsp::setDefaultParam(FEXTOR_SAMPLING_RATE, &param);
+  dsp::FeatureExtractor extractor;
+  Feature expected;
+  if (extractor.init(&param) != DSP_SUCCESS ||
+      computeFeature(wav.data(), (unsigned int)wav.size(), &param, &extractor,
+                     FEXTOR_TARGET_MFCC, &expected) != 0 ||
+      expected.save(expected_name.c_str()) != 0) {
+    return 1;
+  }
+
+  parallel::ThreadPool pool(4, 16);
+  FextorServer server;
+  if (server.init(&param, &pool) != 0 || server.listen(socket_name.c_str()) != 0) {
+    return 1;
+  }
+  std::thread server_thread([&server]() { server.run(); });
+
+  FextorClient client;
+  FextorRequest request;
+  FextorResponse response;
+  error_code |= client.connect(socket_name.c_str());
+  const struct {
+    const char* name;
+    const std::string* input;
+    bool is_inline;
+  } inputs[] = {
+    {"path", &wav_name, false},
+    {"wav", &wav_name, true},
+    {"pcm", &pcm_name, true},
+  };
+  for (const auto& input : inputs) {
+    if (makeRequest(input.input->c_str(), input.is_inline, FEXTOR_TARGET_MFCC,
+                    NULL, &request) != 0 ||
+        client.extract(request, &response) != 0 || !isSameResponse(response, expected)) {
+      fprintf(stderr, "server : response of %s input is different\n", input.name);
+      error_code = 1;
+    }
+  }
+  if (request.input_type != FEXTOR_INPUT_PCM) {
+    error_code = 1;
+  }
+
+  // Server writes feature, and response has no data
+  std::vector<unsigned char> bytes, expected_bytes;
+  if (makeRequest(wav_name.c_str(), false, FEXTOR_TARGET_MFCC, output_name.c_str(),
+                  &request) != 0 ||
+      client.extract(request, &response) != 0 || response.status != 0 ||
+      !response.data.empty() || readFileBytes(output_name, &bytes) != 0 ||
+      readFileBytes(expected_name, &expected_bytes) != 0 || bytes != expected_bytes) {
+    error_code = 1;
+  }
+
+  // Headerless bytes not sent as PCM, and invalid target
+  request.input_type = FEXTOR_INPUT_BYTES;
+  request.input.assign(pcm.begin(), pcm.end());
+  request.output.clear();
+  if (client.extract(request, &response) != 0 || response.status == 0) {
+    error_code = 1;
+  }
+  request.input_type = FEXTOR_INPUT_PATH;
+  request.input = wav_name;
+  request.target = 99;
+  if (client.extract(request, &response) != 0 || response.status == 0) {
+    error_code = 1;
+  }
+  client.close();
+
+  // Concurrent clients
+  const unsigned int num_clients = 4, num_requests = 10;
+  std::atomic<unsigned int> num_matched(0);
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < num_clients; i++) {
+    threads.push_back(std::thread([&, i]() {
+      FextorClient client;
+      FextorRequest request;
+      FextorResponse response;
+      if (client.connect(socket_name.c_str()) != 0 ||
+          makeRequest(wav_name.c_str(), i % 2 == 0, FEXTOR_TARGET_MFCC, NULL,
+                      &request) != 0) {
+        return;
+      }
+      for (unsigned int n = 0; n < num_requests; n++) {
+        if (client.extract(request, &response) == 0 && isSameResponse(response, expected)) {
+          num_matched++;
+        }
+      }
+    }));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (num_matched != num_clients * num_requests) {
+    error_code = 1;
+  }
+
+  server.stop();
+  server_thread.join();
+  if (server.getNumRequests() != 6 + num_clients * num_requests ||
+      server.getNumFailed() != 2) {
+    error_code = 1;
+  }
+  report("server", error_code);
+  return error_code;
+}
+
+bool isSameOutput(const std::vector<float>& output, const Feature& feat) {
+  const dsp::float_t* data = (const dsp::float_t*)feat.getData();
+  const size_t num_values = (size_t)feat.getNumFrame() * feat.getFeatDim();
+  if (output.size() < num_values) {
+    return false;
+  }
+  for (size_t i = 0; i < num_values; i++) {
+    if (output[i] != (float)data[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Features of C API from float and int16 samples are same as computed by
+// fextor for every target, also with a handle per thread, and shape is
+// returned when buffer is too small
+int testCApi() {
+  std::vector<dsp::float_t> wav;
+  if (makeTestWave(getTestPath("c_api.wav"), &wav) != 0) {
+    return 1;
+  }
+  std::vector<float> samples(wav.begin(), wav.end());
+  std::vector<int16_t> samples_int16;
+  for (const auto sample : wav) {
+    samples_int16.push_back((int16_t)lrint(sample * 32768));
+  }
+
+  dsp::FEInitParam param;
+  dsp::setDefaultParam(FEXTOR_SAMPLING_RATE, &param);
+  dsp::FeatureExtractor extractor;
+  fextor_param_t c_param;
+  int error_code = (extractor.init(&param) != DSP_SUCCESS ||
+                    fextor_get_api_version() != FEXTOR_API_VERSION ||
+                    fextor_get_default_param(FEXTOR_SAMPLING_RATE, &c_param) != FEXTOR_OK);
+  if (error_code != 0) {
+    return 1;
+  }
+  const int targets[] = {FEXTOR_TARGET_SPECTRUM, FEXTOR_TARGET_MEL, FEXTOR_TARGET_MFCC};
+  for (const int target : targets) {
+    Feature expected;
+    fextor_extractor_t* handle = NULL;
+    if (computeFeature(wav.data(), (unsigned int)wav.size(), &param, &extractor,
+                       target, &expected) != 0 ||
+        fextor_create(&c_param, target, &handle) != FEXTOR_OK) {
+      fextor_destroy(handle);
+      return 1;
+    }
+    uint32_t num_frame = 0, feat_dim = 0;
+    if (fextor_get_output_shape(handle, samples.size(), &num_frame, &feat_dim) != FEXTOR_OK ||
+        num_frame != expected.getNumFrame() || feat_dim != expected.getFeatDim()) {
+      error_code = 1;
+    }
+    const size_t num_values = (size_t)num_frame * feat_dim;
+
+    // Shape is given also when buffer is too small
+    std::vector<float> output(num_values);
+    num_frame = feat_dim = 0;
+    if (fextor_extract(handle, samples.data(), samples.size(), output.data(),
+                       num_values - 1, &num_frame, &feat_dim) != FEXTOR_ERROR_BUFFER_TOO_SMALL ||
+        num_frame != expected.getNumFrame() || feat_dim != expected.getFeatDim()) {
+      error_code = 1;
+    }
+    if (fextor_extract(handle, samples.data(), samples.size(), output.data(),
+                       num_values, NULL, NULL) != FEXTOR_OK ||
+        !isSameOutput(output, expected)) {
+      fprintf(stderr, "c_api : float output of target %d is different\n", target);
+      error_code = 1;
+    }
+    std::fill(output.begin(), output.end(), 0.0f);
+    if (fextor_extract_int16(handle, samples_int16.data(), samples_int16.size(),
+                             output.data(), num_values, NULL, NULL) != FEXTOR_OK ||
+        !isSameOutput(output, expected)) {
+      fprintf(stderr, "c_api : int16 output of target %d is different\n", target);
+      error_code = 1;
+    }
+    // Samples shorter than a window have no frame
+    if (fextor_extract(handle, samples.data(), c_param.window_size - 1, NULL, 0,
+                       &num_frame, NULL) != FEXTOR_OK || num_frame != 0) {
+      error_code = 1;
+    }
+    fextor_destroy(handle);
+
+    // Handle per thread
+    const unsigned int num_threads = 4;
+    std::atomic<unsigned int> num_matched(0);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < num_threads; i++) {
+      threads.push_back(std::thread([&]() {
+        fextor_extractor_t* handle = NULL;
+        std::vector<float> output(num_values);
+        if (fextor_create(&c_param, target, &handle) == FEXTOR_OK &&
+            fextor_extract(handle, samples.data(), samples.size(), output.data(),
+                           num_values, NULL, NULL) == FEXTOR_OK &&
+            isSameOutput(output, expected)) {
+          num_matched++;
+        }
+        fextor_destroy(handle);
+      }));
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (num_matched != num_threads) {
+      error_code = 1;
+    }
+  }
+
+  // Invalid arguments
+  fextor_extractor_t* handle = NULL;
+  fextor_param_t invalid_param = c_param;
+  invalid_param.struct_size = sizeof(fextor_param_t) - 1;
+  if (fextor_create(&c_param, 99, &handle) != FEXTOR_ERROR_INVALID_ARGUMENT ||
+      fextor_create(&invalid_param, FEXTOR_TARGET_MFCC, &handle) != FEXTOR_ERROR_INVALID_ARGUMENT ||
+      handle != NULL ||
+      fextor_get_default_param(8000, &invalid_param) != FEXTOR_ERROR_INVALID_ARGUMENT ||
+      fextor_extract(NULL, samples.data(), samples.size(), NULL, 0, NULL, NULL) !=
+      FEXTOR_ERROR_INVALID_ARGUMENT ||
+      strcmp(fextor_get_error_string(FEXTOR_ERROR_BUFFER_TOO_SMALL),
+             "output buffer is too small") != 0) {
+    error_code = 1;
+  }
+  report("c_api", error_code);
+  return error_code;
+}
+
+int main(int argc, char** argv) {
+
+  gflags::SetUsageMessage("feature_test");
+  gflags::SetVersionString("1.0.0");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  char temp_dir[] = "/tmp/feature_test_XXXXXX";
+  if (!FLAGS_test_dir.empty()) {
+    g_test_dir = FLAGS_test_dir;
+  } else if (mkdtemp(temp_dir) != NULL) {
+    g_test_dir = temp_dir;
+  } else {
+    fprintf(stderr, "failed to create test directory.\n");
+    return 1;
+  }
+
+  int error_code = 0;
+  error_code |= testArchive();
+  error_code |= testLoad();
+  error_code |= testCodec();
+  error_code |= testFloat16();
+  error_code |= testVectorConversion();
+  error_code |= testDtype();
+  error_code |= testWriter();
+  error_code |= testManifest();
+  error_code |= testStream();
+  error_code |= testServer();
+  error_code |= testCApi();
+
+  fprintf(stdout, "%s\n", (error_code == 0) ? "PASSED" : "FAILED");
+
+  if (FLAGS_test_dir.empty()) {
+    for (const auto& path : g_test_files) {
+      unlink(path.c_str());
+    }
+    rmdir(temp_dir);
+  }
+  gflags::ShutDownCommandLineFlags();
+  return error_code;
+}
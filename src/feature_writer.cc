@@ -0,0 +1,175 @@
+#include "feature_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "parallel/numa.h"
+
+// Buffer of calling thread, NULL if allocation failed. It is placed on NUMA
+// node of the thread, and aligned to pages.
+static unsigned char* get_thread_buffer() {
+  struct Buffer {
+    void* data;
+    Buffer() : data(parallel::allocOnNode(FEATURE_WRITER_BUFFER_SIZE)) {}
+    ~Buffer() { parallel::freeOnNode(data, FEATURE_WRITER_BUFFER_SIZE); }
+  };
+  static thread_local Buffer buffer;
+  return (unsigned char*)buffer.data;
+}
+
+// Write all bytes, resuming after partial write or signal
+static bool write_all(const int fd, const unsigned char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t n = ::write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+FeatureWriter::FeatureWriter(const FeatureFormat& format,
+                             const unsigned int num_threads,
+                             const size_t queue_capacity,
+                             const bool use_direct_io)
+  : format_(format)
+  , use_direct_io_(use_direct_io)
+  , queue_(std::max(queue_capacity, (size_t)1))
+  , is_finished_(false)
+  , num_written_(0)
+  , num_failed_(0) {
+  for (unsigned int i = 0; i < num_threads; i++) {
+    threads_.push_back(std::thread(run, this));
+  }
+}
+
+FeatureWriter::~FeatureWriter() {
+  finish();
+}
+
+void FeatureWriter::run(FeatureWriter* writer) {
+  void* item;
+  while (writer->queue_.pop(&item)) {
+    WriteJob* job = (WriteJob*)item;
+    writer->write(job->file_name, *job->feat);
+    delete job->feat;
+    delete job;
+  }
+}
+
+int FeatureWriter::writeFile(const char* file_name,
+                             const std::vector<unsigned char>& bytes) {
+  unsigned char* buffer = get_thread_buffer();
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  bool is_direct = false;
+  int fd = -1;
+#ifdef O_DIRECT
+  if (use_direct_io_ && buffer != NULL) {
+    fd = open(file_name, flags | O_DIRECT, 0644);
+    is_direct = (fd >= 0);
+  }
+#endif
+  if (fd < 0) {
+    fd = open(file_name, flags, 0644);
+  }
+  if (fd < 0) {
+    fprintf(stderr, "FeatureWriter::write() - failed to open file : %s (%s)\n",
+            file_name, strerror(errno));
+    return 1;
+  }
+
+  bool is_written = true;
+  if (is_direct) {
+    // Buffer, offset and size of each write must be aligned. Last block is
+    // padded, and file is truncated to its size afterwards.
+    for (size_t offset = 0; is_written && offset < bytes.size();
+         offset += FEATURE_WRITER_BUFFER_SIZE) {
+      const size_t size = std::min(bytes.size() - offset,
+                                   (size_t)FEATURE_WRITER_BUFFER_SIZE);
+      const size_t aligned_size = (size + FEATURE_WRITER_ALIGN - 1) /
+                                  FEATURE_WRITER_ALIGN * FEATURE_WRITER_ALIGN;
+      memcpy(buffer, bytes.data() + offset, size);
+      memset(buffer + size, 0, aligned_size - size);
+      is_written = write_all(fd, buffer, aligned_size);
+    }
+    is_written = is_written && ftruncate(fd, (off_t)bytes.size()) == 0;
+  } else {
+    for (size_t offset = 0; is_written && offset < bytes.size();
+         offset += FEATURE_WRITER_BUFFER_SIZE) {
+      const size_t size = std::min(bytes.size() - offset,
+                                   (size_t)FEATURE_WRITER_BUFFER_SIZE);
+      is_written = write_all(fd, bytes.data() + offset, size);
+    }
+  }
+  int write_errno = is_written ? 0 : errno;
+  if (close(fd) != 0 && is_written) {
+    is_written = false;
+    write_errno = errno;
+  }
+
+  if (!is_written) {
+    fprintf(stderr, "FeatureWriter::write() - failed to write file : %s (%s)\n",
+            file_name, strerror(write_errno));
+    unlink(file_name);
+    return 1;
+  }
+  return 0;
+}
+
+int FeatureWriter::write(const std::string& file_name, const Feature& feat) {
+  int error_code;
+  std::vector<unsigned char> bytes;
+  if (file_name == "-") {
+    // Standard output is not a file to be opened
+    error_code = feat.save("-", &format_);
+  } else {
+    error_code = feat.encode(hasSuffix(file_name.c_str(), ".npy"), &format_,
+                             &bytes);
+    if (error_code == 0) {
+      error_code = writeFile(file_name.c_str(), bytes);
+    }
+  }
+
+  if (error_code != 0) {
+    num_failed_++;
+  } else {
+    num_written_++;
+  }
+  return error_code;
+}
+
+int FeatureWriter::submit(const std::string& file_name, Feature* feat) {
+  WriteJob* job = new WriteJob();
+  job->file_name = file_name;
+  job->feat = feat;
+  if (threads_.empty() || !queue_.push((void*)job)) {
+    fprintf(stderr, "FeatureWriter::submit() - writer has no thread, or is already finished.\n");
+    delete job->feat;
+    delete job;
+    num_failed_++;
+    return 1;
+  }
+  return 0;
+}
+
+unsigned int FeatureWriter::finish() {
+  if (!is_finished_) {
+    is_finished_ = true;
+    queue_.close();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+  return num_failed_.load();
+}
@@ -0,0 +1,72 @@
+#ifndef FEATURE_WRITER_H
+#define FEATURE_WRITER_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parallel/pipeline.h"
+#include "fextor_app.h"
+
+// Size of buffer through which each file is written
+#ifndef FEATURE_WRITER_BUFFER_SIZE
+#define FEATURE_WRITER_BUFFER_SIZE (4 << 20)
+#endif
+
+// Alignment of buffer, and of size of each write with O_DIRECT
+#define FEATURE_WRITER_ALIGN 4096
+
+// Writes features with one `write()` per buffer of FEATURE_WRITER_BUFFER_SIZE
+// bytes. Features are written either on calling thread by `write()`, or by
+// threads of writer after `submit()`, so that caller goes back to computing
+// at once. Failure of any write is reported with name of file and counted,
+// and partially written file is removed.
+class FeatureWriter {
+public:
+  // If `num_threads` is 0, features are written only by `write()`. If
+  // `use_direct_io` is set, files are written with O_DIRECT, bypassing page
+  // cache. Files on file systems without O_DIRECT are written normally.
+  FeatureWriter(const FeatureFormat& format, const unsigned int num_threads = 1,
+                const size_t queue_capacity = 64,
+                const bool use_direct_io = false);
+  virtual ~FeatureWriter();
+
+private:
+  typedef struct write_job_t {
+    std::string file_name;
+    Feature* feat;
+  } WriteJob;
+
+  const FeatureFormat format_;
+  const bool use_direct_io_;
+  parallel::BoundedQueue queue_;
+  std::vector<std::thread> threads_;
+  bool is_finished_;
+
+  std::atomic<unsigned int> num_written_;
+  std::atomic<unsigned int> num_failed_;
+
+  static void run(FeatureWriter* writer);
+  int writeFile(const char* file_name, const std::vector<unsigned char>& bytes);
+
+public:
+  // Write feature on calling thread. Returns non-zero on failure.
+  int write(const std::string& file_name, const Feature& feat);
+
+  // Queue feature to be written by threads of writer, which takes ownership
+  // of `feat`. Blocks while `queue_capacity` features are queued. Result is
+  // known only by counters.
+  int submit(const std::string& file_name, Feature* feat);
+
+  // Wait until every submitted feature is written. No more feature can be
+  // submitted. Returns number of failed features.
+  unsigned int finish();
+
+  unsigned int getNumWritten() const { return num_written_.load(); }
+  unsigned int getNumFailed() const { return num_failed_.load(); }
+}; // class FeatureWriter
+
+#endif // FEATURE_WRITER_H
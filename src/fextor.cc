@@ -1,52 +1,696 @@
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "gflags/gflags.h"
 
+#include "parallel/parallel_for.h"
+#include "parallel/pipeline.h"
+#include "parallel/prefetcher.h"
 #include "parallel/threadpool.h"
+#include "parallel/worker_local.h"
+#include "wave/wave.h"
+#include "wave/wave_gain.h"
+#include "wave/wave_shard.h"
+#include "wave/wave_stream.h"
+#include "feature_archive.h"
+#include "feature_manifest.h"
+#include "feature_ring.h"
+#include "feature_writer.h"
 #include "fextor_app.h"
+#include "fextor_server.h"
 
 DEFINE_double(step_duration, 0.01, "size of step in seconds");
 
 DEFINE_string(input, "", "path of input file");
-DEFINE_string(output, "", "path of output file");
+DEFINE_string(output, "", "path of output file. Feature is written in .npy "
+              "format if name ends with \".npy\"");
 
 DEFINE_int32(target, FEXTOR_TARGET_MFCC, "target to extract, "
               "(0: spectrum, 1: mel, 2: mfcc");
 
 DEFINE_bool(list, false, "set fextor to process multi number of files");
 DEFINE_uint32(num_threads, 4, "number of threads for parallel");
+DEFINE_string(affinity, "none", "placement of worker threads, \"none\", "
+              "\"core\" (pin each worker to one CPU) or \"node\" (pin each "
+              "worker to one NUMA node)");
+DEFINE_uint32(idle_spins, 0, "number of times idle worker polls for jobs "
+              "before yielding, larger value lowers latency of tiny jobs "
+              "while burning CPU");
+DEFINE_uint32(idle_yields, 1, "number of times idle worker yields before "
+              "parking");
+DEFINE_uint32(queue_capacity, 32, "number of files queued between stages of "
+              "`list` mode (read, extract and write), and number of jobs "
+              "queued in thread pool of `shard` and `serve` mode, whose "
+              "producers wait while it is full");
+DEFINE_uint32(prefetch_depth, 32, "number of files read ahead of workers in "
+              "`list` mode, 0 to disable read-ahead");
+DEFINE_uint32(prefetch_memory_mb, 512, "memory budget of files read ahead in "
+              "megabytes");
+DEFINE_uint32(decode_memory_mb, 512, "in `list` mode, decoding waits while "
+              "decoded waves waiting for extraction exceed given megabytes, "
+              "as estimated from size of files. A file larger than it is "
+              "still decoded when nothing else is held");
+DEFINE_uint32(num_io_threads, 4, "number of threads reading files ahead, and "
+              "of threads decoding them in `list` mode");
+DEFINE_uint32(num_write_threads, 1, "number of threads writing features in "
+              "`list` and `shard` mode");
+DEFINE_bool(direct_io, false, "write features with O_DIRECT in `list` and "
+            "`shard` mode, bypassing page cache");
+DEFINE_bool(longest_first, false, "read duration of every file in `list` mode "
+            "from its header before processing, and process longest files "
+            "first. Lists are held in memory");
+DEFINE_double(split_duration, 300, "in `list` mode, frames of files longer "
+              "than given seconds are extracted by all threads, 0 to disable. "
+              "If enabled, threads of extract stage hand every file to a pool "
+              "of `num_threads` workers and wait for it, so that extraction "
+              "still runs on `num_threads` threads");
+DEFINE_bool(report_stats, false, "report statistics of thread pool, or of "
+            "each stage in `list` mode, to standard error at exit");
+DEFINE_uint32(stats_interval, 0, "if positive, statistics are also reported "
+              "every given seconds while running");
+DEFINE_bool(shard, false, "`input` is a shard (uncompressed tar of wave files), "
+            "or list of shards if `list` is set. `output` is a directory where "
+            "features are written as <utterance id>.feat");
+DEFINE_bool(raw, false, "`input` is headerless PCM (little endian). "
+            "`input` can be \"-\" to read from standard input");
+DEFINE_uint32(raw_sampling_rate, FEXTOR_SAMPLING_RATE, "sampling rate of raw PCM input");
+DEFINE_uint32(raw_bit_rate, FEXTOR_BIT_RATE, "bit rate of raw PCM input (8, 16, 24 or 32)");
+DEFINE_uint32(raw_num_channels, FEXTOR_NUM_CHANNELS, "number of channels of raw PCM "
+              "input, down-mixed into mono");
+DEFINE_double(agc_target_db, 0, "if negative, gain of `raw` input is "
+              "normalized towards given RMS level in dB while streaming");
+DEFINE_string(codec, "none", "codec of .feat output, \"none\", \"q16\" or "
+              "\"q8\" (each dimension is quantized linearly into 16 or 8 "
+              "bits). Not applied to .npy output nor archive");
+DEFINE_string(dtype, "", "type of stored values, \"float32\", \"float64\", "
+              "\"float16\", \"bfloat16\" or \"int8\". Type of build "
+              "(float32 unless USE_DOUBLE_PRECISION) if empty. .npy output "
+              "supports float types only");
+DEFINE_double(int8_scale, 0, "scale of `int8` values (value = scale x int8) "
+              "shared by all files, 0 to use maximum absolute value of each "
+              "file divided by 127");
+DEFINE_bool(npy, false, "in `shard` mode, features are written as "
+            "<utterance id>.npy in .npy format");
+DEFINE_uint32(max_shard_jobs, 64, "maximum number of shard members held in "
+              "memory at once");
+DEFINE_bool(archive, false, "in `list` or `shard` mode, `output` is a single "
+            "archive where features are written keyed by utterance id, "
+            "instead of list of output files or directory");
+DEFINE_bool(archive_append, false, "append features to existing archive "
+            "instead of overwriting it");
+DEFINE_string(manifest, "", "in `list` mode, manifest of written outputs. "
+              "Outputs written from same input and parameters by previous "
+              "run are skipped, and inputs identical to another one are "
+              "copied instead of extracted");
+DEFINE_bool(serve, false, "keep extractor and threads running, and extract "
+            "features requested by clients on UNIX domain socket `socket` "
+            "until interrupted. `input` and `output` are not used");
+DEFINE_string(socket, "/tmp/fextor.sock", "path of UNIX domain socket of "
+              "`serve` mode");
+DEFINE_string(ring, "", "in `list` or `shard` mode, name of shared memory "
+              "(such as \"/fextor\") where features are published keyed by "
+              "utterance id for other processes, instead of written into "
+              "`output`");
+DEFINE_uint32(ring_size_mb, 256, "size of shared memory of `ring` in MB");
+DEFINE_uint32(ring_readers, 0, "number of readers of `ring` waited for before "
+              "the first feature is published");
+
+// Server of `serve` mode, stopped by SIGINT or SIGTERM
+static FextorServer* g_server = NULL;
+
+static void stop_server(int) {
+  if (g_server != NULL) {
+    g_server->stop();
+  }
+}
+
+// Limits number of jobs whose input data are held in memory
+class JobThrottle {
+public:
+  JobThrottle(const unsigned int max_jobs) : num_jobs_(0), max_jobs_(max_jobs) {}
+
+private:
+  unsigned int num_jobs_;
+  const unsigned int max_jobs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+public:
+  void acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return num_jobs_ < max_jobs_; });
+    num_jobs_++;
+  }
+
+  void release() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_jobs_--;
+    cv_.notify_one();
+  }
+};
+
+// Limits number of bytes held in memory. A request larger than the limit is
+// admitted when nothing is held, so that every request makes progress.
+class MemoryBudget {
+public:
+  MemoryBudget(const size_t max_bytes) : num_bytes_(0), max_bytes_(max_bytes) {}
+
+private:
+  size_t num_bytes_;
+  const size_t max_bytes_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+public:
+  void acquire(const size_t num_bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, num_bytes]() {
+      return num_bytes_ == 0 || num_bytes_ + num_bytes <= max_bytes_;
+    });
+    num_bytes_ += num_bytes;
+  }
+
+  // Replace bytes of earlier `acquire()` by actual ones, without waiting
+  void update(const size_t acquired_bytes, const size_t num_bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_bytes_ = num_bytes_ - acquired_bytes + num_bytes;
+    cv_.notify_all();
+  }
+
+  void release(const size_t num_bytes) { update(num_bytes, 0); }
+};
+
+typedef parallel::WorkerLocal<dsp::FeatureExtractor> WorkerExtractors;
 
 typedef struct fextor_arg_t {
   std::string input_file_name_;
   std::string output_file_name_;
+  std::string utterance_id_;
   dsp::FEInitParam* param_;
-  dsp::FeatureExtractor* extractor_;
+  WorkerExtractors* extractors_;  // extractor of running worker is used
   int target_;
+  FeatureArchiveWriter* archive_;  // if given, feature is appended to it
+  FeatureRingWriter* ring_;        // or published into it
+  FeatureWriter* writer_;          // otherwise feature is submitted to it
+
+  // Input data placed in memory, owned by this job
+  unsigned char* input_bytes_;
+  size_t num_input_bytes_;
+  bool is_pcm_;  // input is headerless PCM, not WAV or FLAC
+  JobThrottle* throttle_;
 
   fextor_arg_t() 
     : param_(NULL)
-    , extractor_(NULL) {
+    , extractors_(NULL)
+    , archive_(NULL)
+    , ring_(NULL)
+    , writer_(NULL)
+    , input_bytes_(NULL)
+    , num_input_bytes_(0)
+    , is_pcm_(false)
+    , throttle_(NULL) {
 
   }
   ~fextor_arg_t() {}
 } FextorArgs;
 
-void worker(void* args) {
+// File passed through stages of `list` mode
+typedef struct fextor_item_t {
+  std::string input_file_name_;
+  std::string output_file_name_;
+  size_t ticket_;  // of prefetcher
+  uint64_t input_hash_;  // set if manifest is given
+  dsp::float_t* wav_;
+  unsigned int wav_length_;
+  size_t wav_bytes_;  // held in budget of decoded waves
+  Feature feat_;
+
+  fextor_item_t()
+      : ticket_(0), input_hash_(0), wav_(NULL), wav_length_(0), wav_bytes_(0) {}
+  ~fextor_item_t() {
+    if (wav_ != NULL) {
+      delete[] wav_;
+      wav_ = NULL;
+    }
+  }
+} FextorItem;
+
+// Output whose input is identical to input of `source`
+typedef struct duplicate_output_t {
+  std::string output_file_name_;
+  std::string source_file_name_;
+  uint64_t input_hash_;
+} DuplicateOutput;
+
+// Shared by stages of `list` mode
+typedef struct fextor_context_t {
+  dsp::FEInitParam* param_;
+  // One per thread of extract stage, created by the thread itself, and used
+  // unless extraction runs on split pool
+  dsp::FeatureExtractor** extractors_;
+  parallel::FilePrefetcher* prefetcher_;  // NULL if files are read directly
+  int target_;
+  std::atomic<unsigned int> num_failed_;
+  FeatureArchiveWriter* archive_;  // if given, features are written into it
+  FeatureRingWriter* ring_;        // or published into it
+  FeatureWriter* writer_;          // otherwise features are written by it
+  MemoryBudget* decode_budget_;    // decoded waves between read and extract
+
+  // Outputs skipped or copied by manifest, NULL if not given
+  FeatureManifest* manifest_;
+  std::atomic<unsigned int> num_skipped_;
+  std::vector<DuplicateOutput> duplicates_;
+  std::mutex duplicates_mutex_;
+
+  // Long files are split among workers of pool, NULL if disabled
+  parallel::ThreadPool* split_pool_;
+  WorkerExtractors* split_extractors_;  // one per worker of split pool
+  unsigned int split_length_;  // in samples
+} FextorContext;
+
+// Pair of files in lists, with duration read from header
+typedef struct list_entry_t {
+  std::string input_file_name_;
+  std::string output_file_name_;
+  unsigned int num_samples_;
+} ListEntry;
+
+// Read whole file into `bytes`
+int readFileBytes(const char* file_name, std::vector<unsigned char>* bytes) {
+  FILE* fp = fopen(file_name, "rb");
+  if (fp == NULL) {
+    return 1;
+  }
+  bytes->clear();
+  unsigned char buffer[65536];
+  size_t num_read;
+  while ((num_read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    bytes->insert(bytes->end(), buffer, buffer + num_read);
+  }
+  const int error_code = ferror(fp) ? 1 : 0;
+  fclose(fp);
+  return error_code;
+}
+
+int copyFile(const char* source, const char* dest) {
+  std::vector<unsigned char> bytes;
+  if (readFileBytes(source, &bytes) != 0) {
+    return 1;
+  }
+  FILE* fp = fopen(dest, "wb");
+  if (fp == NULL) {
+    return 1;
+  }
+  const size_t num_written = fwrite(bytes.data(), 1, bytes.size(), fp);
+  if (fclose(fp) != 0 || num_written != bytes.size()) {
+    remove(dest);
+    return 1;
+  }
+  return 0;
+}
+
+// Hash input file in memory, and decide by manifest whether the item is
+// extracted. Returns false if item is skipped or copied later.
+bool claimItem(FextorItem* fextor_item, FextorContext* fextor_context,
+               const unsigned char* bytes, const size_t num_bytes, int* error_code) {
+  // Only wave and FLAC files are accepted, as by reading from file name
+  if (!wave::isAudioBytes(bytes, num_bytes)) {
+    (*error_code) = 1;
+    return true;
+  }
+  fextor_item->input_hash_ = hashBytes(bytes, num_bytes);
+
+  std::string source;
+  switch (fextor_context->manifest_->claim(fextor_item->output_file_name_,
+                                           fextor_item->input_hash_, &source)) {
+  case FeatureManifest::kClaimUpToDate:
+    fextor_context->num_skipped_++;
+    return false;
+  case FeatureManifest::kClaimDuplicate: {
+    // Copied after all outputs are written, since source may be in progress
+    std::unique_lock<std::mutex> lock(fextor_context->duplicates_mutex_);
+    DuplicateOutput duplicate;
+    duplicate.output_file_name_ = fextor_item->output_file_name_;
+    duplicate.source_file_name_ = source;
+    duplicate.input_hash_ = fextor_item->input_hash_;
+    fextor_context->duplicates_.push_back(duplicate);
+    return false;
+  }
+  default:
+    break;
+  }
+  return true;
+}
+
+// Bytes of wave decoded from file of `num_bytes`, which are exact for WAV
+// and fewer for compressed FLAC
+size_t estimateWaveBytes(const size_t num_bytes) {
+  return num_bytes / (FEXTOR_BIT_RATE / 8) * sizeof(dsp::float_t);
+}
+
+size_t getFileSize(const char* file_name) {
+  struct stat st;
+  return (stat(file_name, &st) == 0) ? (size_t)st.st_size : 0;
+}
+
+// Decode input file, which is read ahead by prefetcher
+void* readStage(void* item, const unsigned int, void* context) {
+  FextorItem* fextor_item = (FextorItem*)item;
+  FextorContext* fextor_context = (FextorContext*)context;
+
+  wave::WaveReader wav_reader;
+  wav_reader.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, FEXTOR_NUM_CHANNELS);
+  int error_code = 0;
+  unsigned char* bytes = NULL;
+  size_t num_bytes = 0;
+  std::vector<unsigned char> file_bytes;
+  if (fextor_context->prefetcher_ != NULL) {
+    error_code = fextor_context->prefetcher_->acquire(fextor_item->ticket_, &bytes,
+                                                      &num_bytes);
+  } else if (fextor_context->manifest_ != NULL) {
+    error_code = readFileBytes(fextor_item->input_file_name_.c_str(), &file_bytes);
+    bytes = file_bytes.data();
+    num_bytes = file_bytes.size();
+  }
+
+  bool is_claimed = true;
+  if (error_code == 0 && fextor_context->manifest_ != NULL) {
+    is_claimed = claimItem(fextor_item, fextor_context, bytes, num_bytes, &error_code);
+  }
+  if (error_code == 0 && is_claimed) {
+    // Wait before decoding while too many decoded waves are queued, so that
+    // reading of next files is held back too
+    const size_t estimated_bytes = estimateWaveBytes(
+        (bytes != NULL) ? num_bytes
+                        : getFileSize(fextor_item->input_file_name_.c_str()));
+    fextor_context->decode_budget_->acquire(estimated_bytes);
+    if (bytes != NULL) {
+      error_code = wav_reader.read(bytes, num_bytes, &fextor_item->wav_,
+                                   &fextor_item->wav_length_);
+    } else {
+      error_code = wav_reader.read(fextor_item->input_file_name_.c_str(),
+                                   &fextor_item->wav_,
+                                   &fextor_item->wav_length_);
+    }
+    if (error_code == WAVE_SUCCESS) {
+      fextor_item->wav_bytes_ = (size_t)fextor_item->wav_length_ * sizeof(dsp::float_t);
+    }
+    fextor_context->decode_budget_->update(estimated_bytes, fextor_item->wav_bytes_);
+  }
+  if (fextor_context->prefetcher_ != NULL) {
+    delete[] bytes;
+  }
+  if (!is_claimed) {
+    delete fextor_item;
+    return NULL;
+  }
+  if (error_code != WAVE_SUCCESS) {
+    fprintf(stderr, "failed to read file : %s\n",
+            fextor_item->input_file_name_.c_str());
+    fextor_context->num_failed_++;
+    delete fextor_item;
+    return NULL;
+  }
+  return item;
+}
+
+// Extractor of thread of extract stage, which is created and initialized by
+// the thread on its first item, so that its memory is placed near the thread.
+// NULL if initialization failed.
+dsp::FeatureExtractor* getStageExtractor(FextorContext* fextor_context,
+                                         const unsigned int thread_index) {
+  dsp::FeatureExtractor** extractor = &fextor_context->extractors_[thread_index];
+  if ((*extractor) == NULL) {
+    dsp::FeatureExtractor* created = new dsp::FeatureExtractor();
+    if (created->init(fextor_context->param_) != DSP_SUCCESS) {
+      fprintf(stderr, "failed to init extractor.\n");
+      delete created;
+      return NULL;
+    }
+    (*extractor) = created;
+  }
+  return (*extractor);
+}
+
+// Extract feature by extractor owned by this thread, or by worker of split
+// pool
+void* extractStage(void* item, const unsigned int thread_index, void* context) {
+  FextorItem* fextor_item = (FextorItem*)item;
+  FextorContext* fextor_context = (FextorContext*)context;
+
+  parallel::ThreadPool* split_pool = fextor_context->split_pool_;
+  int error_code;
+  if (split_pool == NULL) {
+    dsp::FeatureExtractor* extractor = getStageExtractor(fextor_context, thread_index);
+    error_code = (extractor == NULL) ? 1 :
+        computeFeature(fextor_item->wav_, fextor_item->wav_length_,
+                       fextor_context->param_, extractor,
+                       fextor_context->target_, &fextor_item->feat_);
+  } else {
+    // Extraction runs on worker of split pool with extractor of the worker,
+    // and this thread only waits for it, so that split frames and other
+    // files share `num_threads` workers instead of twice as many threads
+    parallel::ThreadPool* pool = NULL;
+    if (fextor_item->wav_length_ > fextor_context->split_length_) {
+      pool = split_pool;
+    }
+    error_code = split_pool->submit([fextor_item, fextor_context, pool]() {
+      return computeFeature(fextor_item->wav_, fextor_item->wav_length_,
+                            fextor_context->param_,
+                            fextor_context->split_extractors_->local(),
+                            fextor_context->target_, &fextor_item->feat_, pool);
+    }).get();
+  }
+  // Release wave as soon as possible, only feature goes to next stage
+  fextor_context->decode_budget_->release(fextor_item->wav_bytes_);
+  delete[] fextor_item->wav_;
+  fextor_item->wav_ = NULL;
+  fextor_item->wav_bytes_ = 0;
+  if (error_code != 0) {
+    fextor_context->num_failed_++;
+    delete fextor_item;
+    return NULL;
+  }
+  return item;
+}
+
+void* writeStage(void* item, const unsigned int, void* context) {
+  FextorItem* fextor_item = (FextorItem*)item;
+  FextorContext* fextor_context = (FextorContext*)context;
+
+  int error_code;
+  if (fextor_context->archive_ != NULL) {
+    error_code = fextor_context->archive_->append(
+        getUtteranceId(fextor_item->input_file_name_), fextor_item->feat_);
+  } else if (fextor_context->ring_ != NULL) {
+    error_code = fextor_context->ring_->append(
+        getUtteranceId(fextor_item->input_file_name_), fextor_item->feat_);
+  } else {
+    error_code = fextor_context->writer_->write(fextor_item->output_file_name_,
+                                                fextor_item->feat_);
+  }
+  if (error_code != 0) {
+    fprintf(stderr, "failed to save feature.\n");
+    fextor_context->num_failed_++;
+  } else if (fextor_context->manifest_ != NULL) {
+    fextor_context->manifest_->add(fextor_item->output_file_name_,
+                                   fextor_item->input_hash_);
+  }
+  delete fextor_item;
+  return NULL;
+}
+
+// Decode member of shard, and append its feature into archive or ring, or
+// hand it to writer
+int extractMember(FextorArgs* fextor_arg, dsp::FeatureExtractor* extractor) {
+  dsp::float_t* wav = NULL;
+  unsigned int wav_length;
+  wave::WaveReader wav_reader;
+  wav_reader.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, FEXTOR_NUM_CHANNELS);
+  int error_code;
+  if (fextor_arg->is_pcm_) {
+    error_code = wav_reader.readPcm(fextor_arg->input_bytes_,
+                                    fextor_arg->num_input_bytes_, &wav,
+                                    &wav_length);
+  } else {
+    error_code = wav_reader.read(fextor_arg->input_bytes_,
+                                 fextor_arg->num_input_bytes_, &wav,
+                                 &wav_length);
+  }
+  if (error_code != WAVE_SUCCESS) {
+    fprintf(stderr, "failed to decode input of %s\n",
+            fextor_arg->utterance_id_.c_str());
+    return error_code;
+  }
 
-  if (args == NULL) {
+  Feature* feat = new Feature();
+  error_code = computeFeature(wav, wav_length, fextor_arg->param_, extractor,
+                              fextor_arg->target_, feat);
+  delete[] wav;
+  if (error_code != 0) {
+    delete feat;
+    return error_code;
+  }
+  if (fextor_arg->archive_ != NULL) {
+    error_code = fextor_arg->archive_->append(fextor_arg->utterance_id_, *feat);
+  } else if (fextor_arg->ring_ != NULL) {
+    error_code = fextor_arg->ring_->append(fextor_arg->utterance_id_, *feat);
+  } else {
+    // Failure of writing is counted by writer
+    return fextor_arg->writer_->submit(fextor_arg->output_file_name_, feat);
+  }
+  if (error_code != 0) {
+    fprintf(stderr, "failed to save feature.\n");
+  }
+  delete feat;
+  return error_code;
+}
+
+// Returns error code of extraction, 0 on success
+int shardWorker(FextorArgs* fextor_arg) {
+
+  if (fextor_arg == NULL) {
     fprintf(stderr, "Invalid argument!\n");
+    return 1;
+  }
+  int error_code = 1;
+  dsp::FeatureExtractor* extractor = fextor_arg->extractors_->local();
+  if (extractor != NULL) {
+    error_code = extractMember(fextor_arg, extractor);
+  } else {
+    fprintf(stderr, "shard job is not run by worker.\n");
+  }
+
+  delete[] fextor_arg->input_bytes_;
+  fextor_arg->throttle_->release();
+  delete fextor_arg;
+  return error_code;
+}
+
+// Reports statistics on its own thread every `interval_sec` seconds while
+// alive, and once more at destruction if `FLAGS_report_stats` is set
+class StatsReporter {
+public:
+  StatsReporter(const std::function<void(FILE*)>& report,
+                const unsigned int interval_sec)
+    : report_(report)
+    , interval_sec_(interval_sec)
+    , is_stopped_(false) {
+    if (interval_sec_ > 0) {
+      thread_ = std::thread([this]() { run(); });
+    }
+  }
+  ~StatsReporter() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      is_stopped_ = true;
+      cv_.notify_all();
+    }
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    if (FLAGS_report_stats) {
+      report_(stderr);
+    }
+  }
+
+private:
+  std::function<void(FILE*)> report_;
+  const unsigned int interval_sec_;
+  bool is_stopped_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, std::chrono::seconds(interval_sec_),
+                         [this]() { return is_stopped_; })) {
+      report_(stderr);
+    }
+  }
+};
+
+void reportPoolStats(FILE* fp, const parallel::ThreadPool* thread_pool) {
+  parallel::PoolStats stats;
+  if (thread_pool->getStats(&stats) != 0) {
+    fprintf(fp, "jobs         : %u processed, %lu queued (build with "
+            "PARALLEL_ENABLE_STATS for details)\n",
+            thread_pool->getNumProcessed(), thread_pool->getQueueDepth());
     return;
   }
-  FextorArgs *fextor_arg = (FextorArgs *)args;
-  extractOne(fextor_arg->input_file_name_.c_str(),
-             fextor_arg->output_file_name_.c_str(), 
-             fextor_arg->param_,
-             fextor_arg->extractor_, 
-             fextor_arg->target_);
+  parallel::printPoolStats(fp, stats);
+}
+
+parallel::IdlePolicy getIdlePolicy() {
+  return parallel::IdlePolicy(FLAGS_idle_spins, FLAGS_idle_yields);
+}
+
+parallel::affinity_t getAffinity() {
+  if (FLAGS_affinity == "core") {
+    return parallel::kAffinityCore;
+  } else if (FLAGS_affinity == "node") {
+    return parallel::kAffinityNode;
+  }
+  if (FLAGS_affinity != "none") {
+    fprintf(stderr, "unknown affinity : %s, workers are not pinned.\n",
+            FLAGS_affinity.c_str());
+  }
+  return parallel::kAffinityNone;
+}
+
+// Read next pair of input and output file names. Returns false at the end of
+// lists, and sets `is_unmatched` if one of lists ends earlier. If
+// `output_list` is NULL, only input list is read.
+bool readListPair(std::ifstream& input_list, std::ifstream* output_list,
+                  std::string* input_name, std::string* output_name,
+                  bool* is_unmatched) {
+  const bool has_input = (bool)getline(input_list, *input_name);
+  if (output_list == NULL) {
+    return has_input;
+  }
+  const bool has_output = (bool)getline(*output_list, *output_name);
+  if (has_input != has_output) {
+    (*is_unmatched) = true;
+  }
+  return has_input && has_output;
+}
+
+// Sort entries by number of samples, longest first. Headers are read in
+// parallel, since it is dominated by file system latency. Files whose
+// header can not be read are placed last, and reported when processed.
+void sortLongestFirst(std::vector<ListEntry>* entries,
+                      parallel::ThreadPool* thread_pool) {
+  parallel::parallelFor(thread_pool, 0, entries->size(), 0,
+                        [entries](size_t begin, size_t end) {
+    wave::WaveReader wav_reader;
+    wav_reader.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, FEXTOR_NUM_CHANNELS);
+    for (size_t i = begin; i < end; i++) {
+      ListEntry& entry = (*entries)[i];
+      if (wav_reader.readNumSamples(entry.input_file_name_.c_str(),
+                                    &entry.num_samples_) != WAVE_SUCCESS) {
+        entry.num_samples_ = 0;
+      }
+    }
+  });
+
+  std::stable_sort(entries->begin(), entries->end(),
+                   [](const ListEntry& a, const ListEntry& b) {
+    return a.num_samples_ > b.num_samples_;
+  });
 }
 
 std::vector<std::string> readListFile(const char* list_file_name) {
@@ -60,6 +704,125 @@ std::vector<std::string> readListFile(const char* list_file_name) {
   return file_list;
 }
 
+// Members of shard are headerless PCM only if named so, and others must
+// have header of WAV or FLAC
+bool isPcmMember(const std::string& name) {
+  const size_t dot = name.find_last_of('.');
+  const size_t slash = name.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return false;
+  }
+  const std::string extension = name.substr(dot);
+  return (extension == ".pcm" || extension == ".raw");
+}
+
+// Create shared memory of `ring`, and wait for its readers if required
+int openRing(FeatureRingWriter* ring) {
+  if (ring->open(FLAGS_ring.c_str(), (size_t)FLAGS_ring_size_mb << 20) != 0) {
+    return 1;
+  }
+  if (FLAGS_ring_readers > 0) {
+    fprintf(stdout, "waiting for %u readers of %s\n", FLAGS_ring_readers,
+            FLAGS_ring.c_str());
+    fflush(stdout);
+    return ring->waitReaders(FLAGS_ring_readers, 0);
+  }
+  return 0;
+}
+
+// Extract features of all members in shards. Each shard is opened once and
+// read sequentially by main thread, while members are processed by workers.
+int processShards(const std::vector<std::string>& shard_file_list,
+                  const char* output_dir, dsp::FEInitParam* extractor_param,
+                  FeatureArchiveWriter* archive, FeatureRingWriter* ring,
+                  const FeatureFormat* format) {
+  int error_code;
+
+  // Each worker initializes its own extractor, so that its tables are placed
+  // on NUMA node of the worker, and reuses it for every member it processes.
+  // Jobs are queued in bounded queue, so reading of shard waits for workers.
+  parallel::ThreadPool thread_pool(FLAGS_num_threads, FLAGS_queue_capacity,
+                                   getAffinity(), getIdlePolicy());
+  WorkerExtractors extractors(&thread_pool, [extractor_param](unsigned int) {
+    dsp::FeatureExtractor* extractor = new dsp::FeatureExtractor();
+    if (extractor->init(extractor_param) != DSP_SUCCESS) {
+      delete extractor;
+      return (dsp::FeatureExtractor*)NULL;
+    }
+    return extractor;
+  });
+  if (!extractors.isValid()) {
+    fprintf(stderr, "failed to init extractor.\n");
+    return 1;
+  }
+
+  StatsReporter reporter([&thread_pool](FILE* fp) {
+    reportPoolStats(fp, &thread_pool);
+  }, FLAGS_stats_interval);
+
+  // Workers hand features to writer, and go back to next member at once
+  FeatureWriter writer(*format, FLAGS_num_write_threads, FLAGS_queue_capacity,
+                       FLAGS_direct_io);
+
+  JobThrottle throttle(FLAGS_max_shard_jobs);
+  parallel::TaskGroup jobs(&thread_pool);
+  unsigned int num_jobs = 0;
+  error_code = 0;
+
+  for (size_t i = 0; i < shard_file_list.size(); i++) {
+    wave::ShardReader shard;
+    if (shard.open(shard_file_list[i].c_str()) != WAVE_SUCCESS) {
+      error_code = 1;
+      continue;
+    }
+
+    while (true) {
+      wave::ShardEntry entry;
+      unsigned char *bytes = NULL;
+      if (shard.next(&entry, &bytes) != WAVE_SUCCESS) {
+        fprintf(stderr, "failed to read shard : %s\n", shard_file_list[i].c_str());
+        error_code = 1;
+        break;
+      }
+      if (entry.name.empty()) {
+        break;
+      }
+      if (entry.size == 0) {
+        continue;
+      }
+
+      throttle.acquire();
+      FextorArgs *args = new FextorArgs();
+      args->utterance_id_ = getUtteranceId(entry.name);
+      args->output_file_name_ = std::string(output_dir) + "/" +
+                                args->utterance_id_ +
+                                (FLAGS_npy ? ".npy" : ".feat");
+      args->param_ = extractor_param;
+      args->extractors_ = &extractors;
+      args->target_ = FLAGS_target;
+      args->archive_ = archive;
+      args->ring_ = ring;
+      args->writer_ = &writer;
+      args->input_bytes_ = bytes;
+      args->num_input_bytes_ = (size_t)entry.size;
+      args->is_pcm_ = isPcmMember(entry.name);
+      args->throttle_ = &throttle;
+      jobs.run([args]() { return shardWorker(args); });
+      num_jobs++;
+    }
+  }
+
+  jobs.wait();
+  const unsigned int num_failed = jobs.getNumFailed() + writer.finish();
+  fprintf(stdout, "%u number of jobs are processed.\n", num_jobs);
+  if (num_failed > 0) {
+    fprintf(stderr, "%u number of jobs are failed.\n", num_failed);
+    error_code = 1;
+  }
+
+  return error_code;
+}
+
 int main(int argc, char **argv) {
 
   gflags::SetUsageMessage("fextor");
@@ -68,71 +831,341 @@ int main(int argc, char **argv) {
 
   // Check arguments
   const char *input_file_name = FLAGS_input.c_str();
-  if (input_file_name[0] == '\0') {
+  if (input_file_name[0] == '\0' && !FLAGS_serve) {
     fprintf(stderr, "Invalid argument - `input` argument is must be given.\n");
     return 1;
   }
   const char *output_file_name = FLAGS_output.c_str();
-  if (output_file_name[0] == '\0') {
+  const bool is_ring = !FLAGS_ring.empty();
+  if (output_file_name[0] == '\0' && !FLAGS_serve && !is_ring) {
     fprintf(stderr, "Invalid argument - `output` argument is must be given.\n");
     return 1;
   }
+  if (is_ring && (FLAGS_serve || FLAGS_raw || !(FLAGS_list || FLAGS_shard))) {
+    fprintf(stderr, "Invalid argument - `ring` is used in `list` or `shard` mode only.\n");
+    return 1;
+  }
+  if (is_ring && FLAGS_archive) {
+    fprintf(stderr, "Invalid argument - `ring` can not be used with `archive`.\n");
+    return 1;
+  }
+  if (FLAGS_queue_capacity == 0) {
+    fprintf(stderr, "Invalid argument - `queue_capacity` must be positive.\n");
+    return 1;
+  }
 
   // Parse parameters for extractor
+  const unsigned int sampling_rate =
+      FLAGS_raw ? FLAGS_raw_sampling_rate : FEXTOR_SAMPLING_RATE;
   dsp::FEInitParam extractor_param;
-  int error_code = dsp::setDefaultParam(FEXTOR_SAMPLING_RATE, &extractor_param);
+  int error_code = dsp::setDefaultParam(sampling_rate, &extractor_param);
   if (error_code != DSP_SUCCESS) {
     fprintf(stderr, "failed to init parameters for extractor.\n");
     return error_code;
   }
 
-  if (FLAGS_list) {
-    // Read list files
-    std::vector<std::string> input_file_list = readListFile(input_file_name);
-    std::vector<std::string> output_file_list = readListFile(output_file_name);
-    if (input_file_list.size() != output_file_list.size()) {
-      fprintf(stderr, "number of files in %s and %s are unmatched.\n", input_file_name, output_file_name);
+  // Format of written features
+  FeatureFormat format;
+  format.codec = getCodec(FLAGS_codec);
+  if (format.codec < 0) {
+    fprintf(stderr, "Invalid argument - unknown codec : %s\n", FLAGS_codec.c_str());
+    return 1;
+  }
+  if (!FLAGS_dtype.empty()) {
+    format.dtype = getDtype(FLAGS_dtype);
+    if (format.dtype < 0) {
+      fprintf(stderr, "Invalid argument - unknown dtype : %s\n", FLAGS_dtype.c_str());
       return 1;
     }
-    const unsigned int num_jobs = (unsigned int)input_file_list.size();
-    fprintf(stdout, "%u number of jobs are found.\n", num_jobs);
+  }
+  format.scale = FLAGS_int8_scale;
+  if (format.codec != FEXTOR_CODEC_NONE && format.dtype != FEXTOR_DTYPE_NATIVE) {
+    fprintf(stderr, "Invalid argument - `codec` can not be used with `dtype`.\n");
+    return 1;
+  }
 
-    // Initialize extractors
-    dsp::FeatureExtractor *extractors = new dsp::FeatureExtractor[FLAGS_num_threads];
-    for (unsigned int n = 0; n < FLAGS_num_threads; n++) {
-      error_code = extractors[n].init(&extractor_param);
-      if (error_code != DSP_SUCCESS) {
-        fprintf(stderr, "failed to init extractor.\n");
+  if (FLAGS_serve) {
+    // Extractor and pool are kept warm between requests
+    parallel::ThreadPool thread_pool(FLAGS_num_threads, FLAGS_queue_capacity,
+                                     getAffinity(), getIdlePolicy());
+    FextorServer server;
+    if (server.init(&extractor_param, &thread_pool, &format) != 0 ||
+        server.listen(FLAGS_socket.c_str()) != 0) {
+      return 1;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_server;
+    g_server = &server;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    fprintf(stdout, "listening on %s\n", FLAGS_socket.c_str());
+    fflush(stdout);
+    {
+      StatsReporter reporter([&thread_pool](FILE* fp) {
+        reportPoolStats(fp, &thread_pool);
+      }, FLAGS_stats_interval);
+      error_code = server.run();
+    }
+    g_server = NULL;
+    fprintf(stdout, "%u number of requests are processed.\n",
+            server.getNumRequests());
+    if (server.getNumFailed() > 0) {
+      fprintf(stderr, "%u number of requests are failed.\n", server.getNumFailed());
+    }
+  } else if (FLAGS_raw) {
+    // Stream raw PCM directly into extractor
+    wave::PcmStreamReader reader;
+    error_code = reader.init(FLAGS_raw_sampling_rate, FLAGS_raw_bit_rate,
+                             FLAGS_raw_num_channels);
+    if (error_code != WAVE_SUCCESS) {
+      fprintf(stderr, "invalid format of raw PCM input.\n");
+      return error_code;
+    }
+    error_code = reader.open(input_file_name);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+
+    dsp::FeatureExtractor extractor;
+    error_code = extractor.init(&extractor_param);
+    if (error_code != DSP_SUCCESS) {
+      fprintf(stderr, "failed to init extractor.\n");
+      return error_code;
+    }
+
+    wave::AutoGainControl agc;
+    if (FLAGS_agc_target_db < 0) {
+      error_code = agc.init(FLAGS_raw_sampling_rate, FLAGS_agc_target_db);
+      if (error_code != 0) {
         return error_code;
       }
     }
 
-    FextorArgs *args = new FextorArgs[num_jobs];
-    for (unsigned int n = 0; n < num_jobs; n++) {
-      std::string input_name = input_file_list[n];
-      std::string output_name = output_file_list[n];
-      
-      args[n].input_file_name_ = input_name;
-      args[n].output_file_name_ = output_name;
-      args[n].param_ = &extractor_param;
-      args[n].extractor_ = &extractors[n % FLAGS_num_threads];
-      args[n].target_ = FLAGS_target;
+    error_code = extractStream(&reader, output_file_name, &extractor_param,
+                               &extractor, FLAGS_target,
+                               (FLAGS_agc_target_db < 0) ? &agc : NULL,
+                               &format);
+    if (error_code != 0) {
+      fprintf(stderr, "Task failed.\n");
     }
-    
-    //parallel::threadpool thread_pool = parallel::thpool_init(FLAGS_num_threads);
-    //for (unsigned int n = 0; n < num_jobs; n++) {
-    //  parallel::thpool_add_work(thread_pool, worker, (void*)&args[n]);
-    //}
-    //parallel::thpool_wait(thread_pool);
-    //parallel::thpool_destroy(thread_pool);
-
-    parallel::ThreadPool thread_pool(FLAGS_num_threads);
-    for (unsigned int n = 0; n < num_jobs; n++) {
-      thread_pool.addJob(worker, (void*)&args[n]);
-    }
-    thread_pool.wait();
-    delete[] args;
-    delete[] extractors;
+  } else if (FLAGS_shard) {
+    std::vector<std::string> shard_file_list;
+    if (FLAGS_list) {
+      shard_file_list = readListFile(input_file_name);
+    } else {
+      shard_file_list.push_back(FLAGS_input);
+    }
+    FeatureArchiveWriter archive;
+    if (FLAGS_archive &&
+        archive.open(output_file_name, FLAGS_archive_append) != 0) {
+      return 1;
+    }
+    FeatureRingWriter ring;
+    if (is_ring && openRing(&ring) != 0) {
+      return 1;
+    }
+    error_code = processShards(shard_file_list, output_file_name,
+                               &extractor_param,
+                               FLAGS_archive ? &archive : NULL,
+                               is_ring ? &ring : NULL, &format);
+    if (FLAGS_archive && archive.close() != 0) {
+      error_code = 1;
+    }
+    if (is_ring && ring.close() != 0) {
+      error_code = 1;
+    }
+  } else if (FLAGS_list) {
+    // List files are read while jobs are running, so that very long lists
+    // are processed with constant memory, unless files are sorted by duration
+    std::ifstream input_list(input_file_name);
+    // Archive and ring are keyed by utterance id, without output list
+    const bool is_keyed = FLAGS_archive || is_ring;
+    std::ifstream output_list;
+    if (!is_keyed) {
+      output_list.open(output_file_name);
+    }
+    if (!input_list.is_open() || (!is_keyed && !output_list.is_open())) {
+      fprintf(stderr, "failed to open list files : %s, %s\n", input_file_name, output_file_name);
+      return 1;
+    }
+    std::ifstream* output_list_ptr = is_keyed ? NULL : &output_list;
+
+    // Outputs are recorded with hash of input and parameters
+    FeatureManifest manifest;
+    if (!FLAGS_manifest.empty()) {
+      if (is_keyed) {
+        fprintf(stderr, "Invalid argument - `manifest` can not be used with `archive` nor `ring`.\n");
+        return 1;
+      }
+      if (manifest.open(FLAGS_manifest.c_str(),
+                        hashConfig(extractor_param, FLAGS_target, format)) != 0) {
+        return 1;
+      }
+    }
+
+    // Features are written into single archive instead of output list
+    FeatureArchiveWriter archive;
+    if (FLAGS_archive &&
+        archive.open(output_file_name, FLAGS_archive_append) != 0) {
+      return 1;
+    }
+    FeatureRingWriter ring;
+    if (is_ring && openRing(&ring) != 0) {
+      return 1;
+    }
+
+    // Extractors are initialized by threads of extract stage
+    FextorContext context;
+    context.param_ = &extractor_param;
+    context.extractors_ = new dsp::FeatureExtractor*[FLAGS_num_threads]();
+    context.prefetcher_ = NULL;
+    context.target_ = FLAGS_target;
+    context.num_failed_ = 0;
+    context.archive_ = FLAGS_archive ? &archive : NULL;
+    context.ring_ = is_ring ? &ring : NULL;
+    // Features are written by threads of write stage
+    FeatureWriter writer(format, 0, 1, FLAGS_direct_io);
+    context.writer_ = &writer;
+    MemoryBudget decode_budget((size_t)FLAGS_decode_memory_mb << 20);
+    context.decode_budget_ = &decode_budget;
+    context.manifest_ = FLAGS_manifest.empty() ? NULL : &manifest;
+    context.num_skipped_ = 0;
+    context.split_pool_ = NULL;
+    context.split_extractors_ = NULL;
+    context.split_length_ = 0;
+
+    // Frames of long files are extracted by pool, so that a few long files do
+    // not keep one thread busy after the others are finished. Other files are
+    // extracted by the pool too, so that threads of extract stage only wait.
+    // The pool also reads headers when files are sorted.
+    std::unique_ptr<parallel::ThreadPool> split_pool;
+    if (FLAGS_split_duration > 0 || FLAGS_longest_first) {
+      split_pool.reset(new parallel::ThreadPool(FLAGS_num_threads, 0,
+                                                getAffinity(), getIdlePolicy()));
+    }
+    std::unique_ptr<WorkerExtractors> split_extractors;
+    if (FLAGS_split_duration > 0) {
+      // Each worker initializes its own extractor, as in `shard` mode
+      split_extractors.reset(new WorkerExtractors(split_pool.get(),
+          [&extractor_param](unsigned int) {
+        dsp::FeatureExtractor* extractor = new dsp::FeatureExtractor();
+        if (extractor->init(&extractor_param) != DSP_SUCCESS) {
+          delete extractor;
+          return (dsp::FeatureExtractor*)NULL;
+        }
+        return extractor;
+      }));
+      if (!split_extractors->isValid()) {
+        fprintf(stderr, "failed to init extractor.\n");
+        delete[] context.extractors_;
+        return 1;
+      }
+      context.split_pool_ = split_pool.get();
+      context.split_extractors_ = split_extractors.get();
+      context.split_length_ =
+          (unsigned int)(FLAGS_split_duration * FEXTOR_SAMPLING_RATE);
+    }
+
+    // Files are read ahead by I/O threads of prefetcher, and decoded,
+    // extracted and written by separate stages, so that they all overlap.
+    // Main thread is blocked while `prefetch_depth` files are read ahead or
+    // queue of read stage is full, so at most `queue_capacity` files are
+    // queued in front of each stage, and decoded waves are limited by
+    // `decode_memory_mb` besides.
+    if (FLAGS_prefetch_depth > 0) {
+      context.prefetcher_ = new parallel::FilePrefetcher(
+          FLAGS_num_io_threads, FLAGS_prefetch_depth,
+          (size_t)FLAGS_prefetch_memory_mb << 20);
+    }
+    parallel::Pipeline pipeline(FLAGS_queue_capacity);
+    if (pipeline.addStage("read", FLAGS_num_io_threads, readStage, (void*)&context) != 0 ||
+        pipeline.addStage("extract", FLAGS_num_threads, extractStage, (void*)&context) != 0 ||
+        pipeline.addStage("write", FLAGS_num_write_threads, writeStage, (void*)&context) != 0 ||
+        pipeline.start() != 0) {
+      delete context.prefetcher_;
+      delete[] context.extractors_;
+      return 1;
+    }
+    std::unique_ptr<StatsReporter> reporter(new StatsReporter(
+        [&pipeline](FILE* fp) { pipeline.report(fp); }, FLAGS_stats_interval));
+
+    unsigned int num_jobs = 0;
+    auto pushItem = [&](const std::string& input_name, const std::string& output_name) {
+      FextorItem *item = new FextorItem();
+      item->input_file_name_ = input_name;
+      item->output_file_name_ = output_name;
+      if (context.prefetcher_ != NULL) {
+        item->ticket_ = context.prefetcher_->push(input_name);
+      }
+      pipeline.push((void*)item);
+      num_jobs++;
+    };
+    std::string input_name, output_name;
+    bool is_unmatched = false;
+    if (FLAGS_longest_first) {
+      std::vector<ListEntry> entries;
+      while (readListPair(input_list, output_list_ptr, &input_name, &output_name,
+                          &is_unmatched)) {
+        ListEntry entry;
+        entry.input_file_name_ = input_name;
+        entry.output_file_name_ = output_name;
+        entry.num_samples_ = 0;
+        entries.push_back(entry);
+      }
+      sortLongestFirst(&entries, split_pool.get());
+
+      for (auto& entry : entries) {
+        pushItem(entry.input_file_name_, entry.output_file_name_);
+      }
+    } else {
+      while (readListPair(input_list, output_list_ptr, &input_name, &output_name,
+                          &is_unmatched)) {
+        pushItem(input_name, output_name);
+      }
+    }
+    if (is_unmatched) {
+      fprintf(stderr, "number of files in %s and %s are unmatched.\n", input_file_name, output_file_name);
+      error_code = 1;
+    }
+    pipeline.finish();
+    reporter.reset();
+    if (FLAGS_archive && archive.close() != 0) {
+      error_code = 1;
+    }
+    if (is_ring && ring.close() != 0) {
+      error_code = 1;
+    }
+
+    // Sources of duplicates are all written, unless failed
+    for (auto& duplicate : context.duplicates_) {
+      if (copyFile(duplicate.source_file_name_.c_str(),
+                   duplicate.output_file_name_.c_str()) != 0) {
+        fprintf(stderr, "failed to copy %s into %s\n",
+                duplicate.source_file_name_.c_str(),
+                duplicate.output_file_name_.c_str());
+        context.num_failed_++;
+        continue;
+      }
+      manifest.add(duplicate.output_file_name_, duplicate.input_hash_);
+    }
+    fprintf(stdout, "%u number of jobs are processed.\n", num_jobs);
+    if (context.manifest_ != NULL) {
+      fprintf(stdout, "%u number of outputs are up to date, %lu number of "
+              "outputs are copied.\n", context.num_skipped_.load(),
+              context.duplicates_.size());
+    }
+    if (context.num_failed_ > 0) {
+      fprintf(stderr, "%u number of jobs are failed.\n", context.num_failed_.load());
+      error_code = 1;
+    }
+
+    delete context.prefetcher_;
+    for (unsigned int i = 0; i < FLAGS_num_threads; i++) {
+      delete context.extractors_[i];
+    }
+    delete[] context.extractors_;
   } else {
     // Initialize extractor
     dsp::FeatureExtractor extractor;
@@ -142,9 +1175,17 @@ int main(int argc, char **argv) {
       return error_code;
     }
     
-    // Do processing
-    error_code = extractOne(input_file_name, output_file_name, 
-                            &extractor_param, &extractor, FLAGS_target);
+    // Do processing, frames are extracted by multiple threads
+    parallel::ThreadPool thread_pool(FLAGS_num_threads, 0, getAffinity(),
+                                   getIdlePolicy());
+    {
+      StatsReporter reporter([&thread_pool](FILE* fp) {
+        reportPoolStats(fp, &thread_pool);
+      }, FLAGS_stats_interval);
+      error_code = extractOne(input_file_name, output_file_name, 
+                              &extractor_param, &extractor, FLAGS_target,
+                              &thread_pool, &format);
+    }
     if (error_code != 0) {
       fprintf(stderr, "Task failed.\n");
     }
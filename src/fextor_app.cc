@@ -1,33 +1,128 @@
 #include "fextor_app.h"
 
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <vector>
 
+#include "parallel/parallel_for.h"
 #include "wave/wave.h"
 #include "dsp/feature_extractor.h"
 
 Feature::Feature() 
   : num_frame_(0)
   , feat_dim_(0)
-  , data_(NULL) {
+  , data_(NULL)
+  , map_(NULL)
+  , map_size_(0)
+  , view_(NULL) {
 
 }
 
 Feature::Feature(unsigned int num_frame, unsigned int feat_dim) 
   : num_frame_(num_frame)
   , feat_dim_(feat_dim)
-  , data_(new dsp::float_t[num_frame * feat_dim]) {
+  , data_(new dsp::float_t[num_frame * feat_dim])
+  , map_(NULL)
+  , map_size_(0)
+  , view_(NULL) {
 
 }
 
 Feature::~Feature() {
+  release();
+}
+
+void Feature::release() {
   if (data_ != NULL) {
     delete[] data_;
     data_ = NULL;
   }
+  if (map_ != NULL) {
+    munmap(map_, map_size_);
+    map_ = NULL;
+    map_size_ = 0;
+    view_ = NULL;
+  }
+}
+
+static const char kNpyMagic[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+
+static inline bool is_little_endian() {
+  const uint16_t value = 1;
+  return *(const uint8_t *)&value == 1;
+}
+
+// Type of floating point values of `dtype` in .npy header (e.g. "<f4"),
+// empty if dtype has no counterpart in numpy
+static std::string get_npy_descr(const int dtype) {
+  if (dtype != FEXTOR_DTYPE_FLOAT16 && dtype != FEXTOR_DTYPE_FLOAT32 &&
+      dtype != FEXTOR_DTYPE_FLOAT64) {
+    return std::string();
+  }
+  char descr[8];
+  snprintf(descr, sizeof(descr), "%cf%u", is_little_endian() ? '<' : '>',
+           getDtypeSize(dtype));
+  return std::string(descr);
+}
+
+// Parse header of .npy file (version 1 to 3). Only C-ordered 2-D arrays of
+// floating point values in native byte order are accepted. Returns offset of
+// data, 0 on failure.
+static size_t parse_npy_header(const unsigned char *bytes, const size_t size,
+                               unsigned int *num_frame, unsigned int *feat_dim,
+                               int *dtype) {
+  if (size < 10 || memcmp(bytes, kNpyMagic, sizeof(kNpyMagic)) != 0) {
+    return 0;
+  }
+  size_t header_offset, header_length;
+  if (bytes[6] == 1) {
+    header_offset = 10;
+    header_length = (size_t)bytes[8] | ((size_t)bytes[9] << 8);
+  } else if (bytes[6] == 2 || bytes[6] == 3) {
+    if (size < 12) {
+      return 0;
+    }
+    header_offset = 12;
+    header_length = (size_t)bytes[8] | ((size_t)bytes[9] << 8) |
+                    ((size_t)bytes[10] << 16) | ((size_t)bytes[11] << 24);
+  } else {
+    return 0;
+  }
+  if (header_offset + header_length > size) {
+    return 0;
+  }
+
+  const std::string header((const char *)bytes + header_offset, header_length);
+  (*dtype) = -1;
+  const int dtypes[3] = {FEXTOR_DTYPE_FLOAT16, FEXTOR_DTYPE_FLOAT32,
+                         FEXTOR_DTYPE_FLOAT64};
+  for (int i = 0; i < 3; i++) {
+    if (header.find("'descr': '" + get_npy_descr(dtypes[i]) + "'") !=
+        std::string::npos) {
+      (*dtype) = dtypes[i];
+    }
+  }
+  const size_t shape = header.find("'shape': (");
+  unsigned int nf, fd;
+  if ((*dtype) < 0 ||
+      header.find("'fortran_order': False") == std::string::npos ||
+      shape == std::string::npos ||
+      sscanf(header.c_str() + shape + 10, "%u, %u)", &nf, &fd) != 2) {
+    return 0;
+  }
+  (*num_frame) = nf;
+  (*feat_dim) = fd;
+  return header_offset + header_length;
 }
 
 int Feature::load(const char* input_file_name) {
@@ -36,81 +131,295 @@ int Feature::load(const char* input_file_name) {
     return 1;
   }
 
-  FILE *fp_in = fopen(input_file_name, "rb");
-  if (fp_in == NULL) {
+  int fd = open(input_file_name, O_RDONLY);
+  if (fd < 0) {
     fprintf(stderr, "Feature::load() - failed to open file : %s\n", input_file_name);
     return 1;
   }
-
-  // read header
-  unsigned long size;
-  int ret = fscanf(fp_in, "%u%u%lu", &num_frame_, &feat_dim_, &size);
-  if (ret != 0) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < FEXTOR_FEAT_HEADER_SIZE) {
     fprintf(stderr, "Feature::load() - failed to read header.\n");
-    fclose(fp_in);
-    return ret;
+    close(fd);
+    return 1;
   }
-  if (size != sizeof(dsp::float_t)) {
-    fprintf(stderr, "Feature::load() - size of data are unmatched.\n");
-    fclose(fp_in);
+  const size_t map_size = (size_t)st.st_size;
+  void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "Feature::load() - failed to map file : %s\n", input_file_name);
     return 1;
   }
+  const unsigned char *bytes = (const unsigned char *)map;
 
-  // read data
-  if (data_ != NULL) {
-    delete[] data_;
-    data_ = NULL;
+  // Encoded features are decoded into memory of this feature
+  if (isEncodedFeature(bytes, map_size)) {
+    FeatFileHeader header;
+    int error_code = readFeatureHeader(bytes, map_size, &header);
+    if (error_code == 0) {
+      resize(header.num_frame, header.feat_dim);
+      error_code = decodeFeature(bytes, header, data_);
+    }
+    munmap(map, map_size);
+    if (error_code != 0) {
+      fprintf(stderr, "Feature::load() - failed to decode : %s\n", input_file_name);
+    }
+    return error_code;
+  }
+
+  // validate header
+  unsigned int num_frame = 0, feat_dim = 0;
+  int dtype = FEXTOR_DTYPE_NATIVE;
+  size_t data_offset;
+  if (memcmp(bytes, kNpyMagic, sizeof(kNpyMagic)) == 0) {
+    data_offset = parse_npy_header(bytes, map_size, &num_frame, &feat_dim,
+                                   &dtype);
+  } else {
+    uint32_t header[2];
+    uint64_t size;
+    memcpy(header, bytes, sizeof(header));
+    memcpy(&size, bytes + sizeof(header), sizeof(size));
+    num_frame = header[0];
+    feat_dim = header[1];
+    data_offset = (size == sizeof(dsp::float_t)) ? FEXTOR_FEAT_HEADER_SIZE : 0;
   }
-  data_ = new dsp::float_t[num_frame_ * feat_dim_];
-  //data_.reset(new dsp::float_t[num_frame_ * feat_dim_]);
-  size_t n = fread(data_, sizeof(dsp::float_t), num_frame_ * feat_dim_, fp_in);
-  if (n != num_frame_ * feat_dim_) {
-    fprintf(stderr, "Feature::load() - failed to load feature data.\n");
-    fclose(fp_in);
+  const uint64_t data_size =
+      (uint64_t)num_frame * feat_dim * getDtypeSize(dtype);
+  if (data_offset == 0 || data_offset % sizeof(dsp::float_t) != 0 ||
+      data_offset + data_size != map_size) {
+    fprintf(stderr, "Feature::load() - invalid header or size of data : %s\n",
+            input_file_name);
+    munmap(map, map_size);
+    return 1;
+  }
+
+  // Values of other dtype are converted into memory
+  if (dtype != FEXTOR_DTYPE_NATIVE) {
+    resize(num_frame, feat_dim);
+    decodeValues(bytes + data_offset, (size_t)num_frame * feat_dim, dtype, 0,
+                 data_);
+    munmap(map, map_size);
+    return 0;
+  }
+
+  release();
+  num_frame_ = num_frame;
+  feat_dim_ = feat_dim;
+  map_ = map;
+  map_size_ = map_size;
+  view_ = (const dsp::float_t *)(bytes + data_offset);
+  return 0;
+}
+
+// Header of .npy version 1.0, padded so that data start at 64-byte boundary
+static std::string make_npy_header(const unsigned int num_frame,
+                                   const unsigned int feat_dim,
+                                   const int dtype) {
+  char dict[128];
+  snprintf(dict, sizeof(dict),
+           "{'descr': '%s', 'fortran_order': False, 'shape': (%u, %u), }",
+           get_npy_descr(dtype).c_str(), num_frame, feat_dim);
+
+  std::string header(kNpyMagic, sizeof(kNpyMagic));
+  header += '\x01';
+  header += '\x00';
+  const size_t length = (10 + strlen(dict) + 1 + 63) / 64 * 64 - 10;
+  header += (char)(length & 0xff);
+  header += (char)((length >> 8) & 0xff);
+  header += dict;
+  header.append(length - strlen(dict) - 1, ' ');
+  header += '\n';
+  return header;
+}
+
+bool hasSuffix(const char* name, const char* suffix) {
+  const size_t name_length = strlen(name);
+  const size_t suffix_length = strlen(suffix);
+  return name_length >= suffix_length &&
+         strcmp(name + name_length - suffix_length, suffix) == 0;
+}
+
+int Feature::encode(const bool is_npy, const FeatureFormat* format,
+                    std::vector<unsigned char>* bytes) const {
+  const int dtype = (format != NULL) ? format->dtype : FEXTOR_DTYPE_NATIVE;
+  if (is_npy && get_npy_descr(dtype).empty()) {
+    fprintf(stderr, "Feature::encode() - dtype is not supported by .npy (given : %d)\n", dtype);
     return 1;
   }
+  if (!is_npy && format != NULL &&
+      (format->codec != FEXTOR_CODEC_NONE || dtype != FEXTOR_DTYPE_NATIVE)) {
+    return encodeFeature(getData(), num_frame_, feat_dim_, *format, bytes);
+  }
 
-  fclose(fp_in);
+  // header
+  std::string header;
+  if (is_npy) {
+    header = make_npy_header(num_frame_, feat_dim_, dtype);
+  } else {
+    uint32_t shape[2] = {num_frame_, feat_dim_};
+    uint64_t size = sizeof(dsp::float_t);
+    header.append((const char*)shape, sizeof(shape));
+    header.append((const char*)&size, sizeof(size));
+  }
+
+  // data
+  const size_t num_values = (size_t)num_frame_ * feat_dim_;
+  bytes->resize(header.size() + num_values * getDtypeSize(dtype));
+  memcpy(bytes->data(), header.data(), header.size());
+  encodeValues(getData(), num_values, dtype, 0, bytes->data() + header.size());
   return 0;
 }
 
-int Feature::save(const char* output_file_name) {
+int Feature::save(const char* output_file_name,
+                  const FeatureFormat* format) const {
   if (output_file_name == NULL) {
     fprintf(stderr, "Feature::save() - invalid argument. `output_file_name` must be not NULL.\n");
     return 1;
   }
 
-  FILE *fp_out = fopen(output_file_name, "wb");
+  // Whole file is encoded, and written at once
+  std::vector<unsigned char> bytes;
+  if (encode(hasSuffix(output_file_name, ".npy"), format, &bytes) != 0) {
+    return 1;
+  }
+
+  // "-" denotes standard output
+  const bool is_stdout = (strcmp(output_file_name, "-") == 0);
+  FILE *fp_out = is_stdout ? stdout : fopen(output_file_name, "wb");
   if (fp_out == NULL) {
     fprintf(stderr, "Feature::save() - failed to open file : %s\n", output_file_name);
     return 1;
   }
-
-  // write header
-  fwrite(&num_frame_, sizeof(unsigned int), 1, fp_out);
-  fwrite(&feat_dim_, sizeof(unsigned int), 1, fp_out);
-  unsigned long size = sizeof(dsp::float_t);
-  fwrite(&size, sizeof(unsigned long), 1, fp_out);
-  //fprintf(fp_out, "%u%u%lu", num_frame_, feat_dim_,
-  //        sizeof(dsp::float_t));
-
-  // write data
-  fwrite(data_, sizeof(dsp::float_t), num_frame_ * feat_dim_, fp_out);
-
-  fclose(fp_out);
+  bool is_written = fwrite(bytes.data(), 1, bytes.size(), fp_out) == bytes.size();
+  if (is_stdout) {
+    is_written = (fflush(fp_out) == 0) && is_written;
+  } else if (fclose(fp_out) != 0) {
+    is_written = false;
+  }
+  if (!is_written) {
+    fprintf(stderr, "Feature::save() - failed to write file : %s\n", output_file_name);
+    return 1;
+  }
   return 0;
 }
 
+void Feature::resize(unsigned int num_frame, unsigned int feat_dim) {
+  release();
+  num_frame_ = num_frame;
+  feat_dim_ = feat_dim;
+  if (num_frame * feat_dim > 0) {
+    data_ = new dsp::float_t[num_frame * feat_dim];
+  }
+}
+
 dsp::float_t* Feature::getPtr(const unsigned int index) {
-  if (index >= num_frame_ * feat_dim_) {
+  if (map_ != NULL || index >= num_frame_ * feat_dim_) {
     return NULL;
   }
   return data_ + index;
 }
 
+unsigned int getFeatureDim(const dsp::FEInitParam* param, int target) {
+  switch (target)
+  {
+  case FEXTOR_TARGET_SPECTRUM:
+    return param->num_fft_point / 2 + 1;
+  case FEXTOR_TARGET_MEL:
+    return param->num_mels;
+  case FEXTOR_TARGET_MFCC:
+    return param->num_mfcc;
+  default:
+    return 0;
+  }
+}
+
+// Extract feature of one frame
+inline int extractFrame(dsp::FeatureExtractor* extractor, int target,
+                        const dsp::float_t* src, dsp::float_t* dest,
+                        dsp::float_t* temp_mem) {
+  switch (target)
+  {
+  case FEXTOR_TARGET_SPECTRUM:
+    return extractor->spectrum(src, dest, false, temp_mem);
+  case FEXTOR_TARGET_MEL:
+    return extractor->melspectrum(src, dest, false, temp_mem);
+  case FEXTOR_TARGET_MFCC:
+    return extractor->mfcc(src, dest, temp_mem);
+  default:
+    return DSP_INVALID_ARG_VALUE;
+  }
+}
+
+// Scratch memory of extractor, kept by each thread and reused for every range
+// of frames it extracts. It is small and first touched by the thread itself,
+// so it is placed on node of the thread without `allocOnNode()`.
+static thread_local std::vector<dsp::float_t> tls_temp_mem;
+
+int computeFeature(const dsp::float_t* wav, const unsigned int wav_length,
+                   const dsp::FEInitParam* param,
+                   dsp::FeatureExtractor* extractor, int target,
+                   Feature* feat, parallel::ThreadPool* pool) {
+  // get number of frames & dimension of each feature
+  unsigned int num_frame = 0;
+  if (wav_length >= param->window_size) {
+    num_frame = (wav_length - param->window_size) / param->step_size;
+  }
+  unsigned int feat_dim = getFeatureDim(param, target);
+  if (feat_dim == 0) {
+    fprintf(stderr, "invalid target (given : %d)\n", (int)target);
+    return 1;
+  }
+
+  // extract feature, frames are divided among workers if pool is given
+  feat->resize(num_frame, feat_dim);
+  std::atomic<int> frame_error(DSP_SUCCESS);
+  parallel::parallelFor(pool, 0, num_frame, 0, [&](size_t begin, size_t end) {
+    if (tls_temp_mem.size() < param->num_fft_point * 2) {
+      tls_temp_mem.resize(param->num_fft_point * 2);
+    }
+    dsp::float_t *temp_mem = tls_temp_mem.data();
+    for (size_t n = begin; n < end; n++) {
+      const dsp::float_t* src = wav + n * param->step_size;
+      dsp::float_t* dest = feat->getPtr((unsigned int)n * feat_dim);
+
+      int ret = extractFrame(extractor, target, src, dest, temp_mem);
+      if (ret != DSP_SUCCESS) {
+        frame_error = ret;
+        break;
+      }
+    }
+  });
+
+  if (frame_error != DSP_SUCCESS) {
+    fprintf(stderr, "failed to extract feature\n");
+  }
+  return frame_error;
+}
+
+// Extract feature from decoded wave and write it. `wav` is released here.
+int extractFeature(dsp::float_t *wav, const unsigned int wav_length,
+                   const char* output_feat_name, const dsp::FEInitParam* param,
+                   dsp::FeatureExtractor* extractor, int target,
+                   parallel::ThreadPool* pool, const FeatureFormat* format) {
+  Feature feat;
+  int error_code = computeFeature(wav, wav_length, param, extractor, target,
+                                  &feat, pool);
+  delete[] wav;
+  if (error_code != DSP_SUCCESS) {
+    return error_code;
+  }
+  
+  // write feature
+  error_code = feat.save(output_feat_name, format);
+  if (error_code != 0) {
+    fprintf(stderr, "failed to save feature.\n");
+  }
+  return error_code;
+}
+
 int extractOne(const char* input_wav_name, const char* output_feat_name, 
                const dsp::FEInitParam* param, dsp::FeatureExtractor* extractor,
-               int target) {
+               int target, parallel::ThreadPool* pool,
+               const FeatureFormat* format) {
   
   // read wav
   dsp::float_t *wav = NULL;
@@ -123,62 +432,155 @@ int extractOne(const char* input_wav_name, const char* output_feat_name,
     return error_code;
   }
 
-  // get number of frames & dimension of each feature
-  unsigned int num_frame = (wav_length - param->window_size) / param->step_size;
-  unsigned int feat_dim;
-  switch (target)
-  {
-  case FEXTOR_TARGET_SPECTRUM:
-    feat_dim = param->num_fft_point / 2 + 1;
-    break;
-  case FEXTOR_TARGET_MEL:
-    feat_dim = param->num_mels;
-    break;
-  case FEXTOR_TARGET_MFCC:
-    feat_dim = param->num_mfcc;
-    break;
-  default:
+  return extractFeature(wav, wav_length, output_feat_name, param, extractor,
+                        target, pool, format);
+}
+
+int extractOne(const unsigned char* input_bytes, const size_t num_input_bytes,
+               const char* output_feat_name, const dsp::FEInitParam* param,
+               dsp::FeatureExtractor* extractor, int target,
+               parallel::ThreadPool* pool, const FeatureFormat* format) {
+
+  // decode wav in memory
+  dsp::float_t *wav = NULL;
+  unsigned int wav_length;
+  wave::WaveReader wav_reader;
+  wav_reader.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, FEXTOR_NUM_CHANNELS);
+  int error_code = wav_reader.read(input_bytes, num_input_bytes, &wav,
+                                   &wav_length);
+  if (error_code != WAVE_SUCCESS) {
+    fprintf(stderr, "failed to decode input of %s\n", output_feat_name);
+    return error_code;
+  }
+
+  return extractFeature(wav, wav_length, output_feat_name, param, extractor,
+                        target, pool, format);
+}
+
+int extractStream(wave::StreamReader* reader, const char* output_feat_name,
+                  const dsp::FEInitParam* param,
+                  dsp::FeatureExtractor* extractor, int target,
+                  wave::AutoGainControl* agc, const FeatureFormat* format) {
+  int error_code = 0;
+
+  const unsigned int feat_dim = getFeatureDim(param, target);
+  if (feat_dim == 0) {
     fprintf(stderr, "invalid target (given : %d)\n", (int)target);
-    delete[] wav;
     return 1;
-    break;
   }
 
-  dsp::float_t *temp_mem = new dsp::float_t[param->num_fft_point * 2];
+  const unsigned int num_channels = reader->getNumChannels();
+  const unsigned int chunk_length = param->step_size * FEXTOR_STREAM_CHUNK_STEPS;
+  std::vector<dsp::float_t> chunk(chunk_length * num_channels);
+  std::vector<dsp::float_t> mono(chunk_length);
+  std::vector<dsp::float_t> gained;
+  if (agc != NULL) {
+    gained.resize(chunk_length + agc->getLatency());
+  }
+  std::vector<dsp::float_t> temp_mem(param->num_fft_point * 2);
 
-  // extract feature
-  Feature feat(num_frame, feat_dim);
-  for (unsigned int n = 0; n < num_frame; n++) {
-    dsp::float_t* src = wav + n * param->step_size;
-    dsp::float_t* dest = feat.getPtr(n * feat_dim);
-    
-    switch (target)
-    {
-    case FEXTOR_TARGET_SPECTRUM:
-      error_code = extractor->spectrum(src, dest, false, temp_mem);
-      break;
-    case FEXTOR_TARGET_MEL:
-      error_code = extractor->melspectrum(src, dest, false, temp_mem);
-      break;
-    case FEXTOR_TARGET_MFCC:
-      error_code = extractor->mfcc(src, dest, temp_mem);
+  // Samples (down-mixed into mono) not yet consumed by frames, and features
+  // of frames extracted so far
+  std::vector<dsp::float_t> samples;
+  samples.reserve(param->window_size + gained.size() + chunk_length);
+  std::vector<dsp::float_t> feats;
+  unsigned long wav_length = 0;
+  unsigned long num_extracted = 0;
+
+  // extract every frame which is completely received
+  auto extract_ready_frames = [&]() -> int {
+    size_t offset = 0;
+    while (samples.size() - offset >= param->window_size) {
+      feats.resize((num_extracted + 1) * feat_dim);
+      int ret = extractFrame(extractor, target, samples.data() + offset,
+                             feats.data() + num_extracted * feat_dim,
+                             temp_mem.data());
+      if (ret != DSP_SUCCESS) {
+        fprintf(stderr, "failed to extract feature\n");
+        return ret;
+      }
+      num_extracted++;
+      offset += param->step_size;
+    }
+    samples.erase(samples.begin(), samples.begin() + offset);
+    return DSP_SUCCESS;
+  };
+
+  while (true) {
+    unsigned int num_read = 0;
+    error_code = reader->read(chunk.data(), (unsigned int)chunk.size(), &num_read);
+    if (error_code != WAVE_SUCCESS) {
+      fprintf(stderr, "failed to read stream.\n");
+      return error_code;
+    }
+    if (num_read == 0) {
       break;
     }
 
+    const unsigned int num_new = num_read / num_channels;
+    if (num_channels == 1) {
+      std::copy(chunk.begin(), chunk.begin() + num_new, mono.begin());
+    } else {
+      for (unsigned int i = 0; i < num_new; i++) {
+        dsp::float_t sum = 0;
+        for (unsigned int c = 0; c < num_channels; c++) {
+          sum += chunk[i * num_channels + c];
+        }
+        mono[i] = sum / (dsp::float_t)num_channels;
+      }
+    }
+    wav_length += num_new;
+
+    if (agc != NULL) {
+      unsigned int num_gained = 0;
+      agc->process(mono.data(), num_new, gained.data(), &num_gained);
+      samples.insert(samples.end(), gained.begin(), gained.begin() + num_gained);
+    } else {
+      samples.insert(samples.end(), mono.begin(), mono.begin() + num_new);
+    }
+
+    error_code = extract_ready_frames();
     if (error_code != DSP_SUCCESS) {
-      fprintf(stderr, "failed to extract feature\n");
-      goto EXIT;
+      return error_code;
     }
   }
-  
-  // write feature
-  error_code = feat.save(output_feat_name);
+
+  // drain look-ahead of gain control
+  if (agc != NULL) {
+    unsigned int num_gained = 0;
+    agc->flush(gained.data(), &num_gained);
+    samples.insert(samples.end(), gained.begin(), gained.begin() + num_gained);
+    error_code = extract_ready_frames();
+    if (error_code != DSP_SUCCESS) {
+      return error_code;
+    }
+  }
+
+  // Same number of frames as extraction of whole wave
+  unsigned int num_frame = 0;
+  if (wav_length >= param->window_size) {
+    num_frame = (unsigned int)((wav_length - param->window_size) / param->step_size);
+  }
+
+  Feature feat(num_frame, feat_dim);
+  if (num_frame > 0) {
+    memcpy(feat.getPtr(0), feats.data(),
+           sizeof(dsp::float_t) * num_frame * feat_dim);
+  }
+
+  error_code = feat.save(output_feat_name, format);
   if (error_code != 0) {
     fprintf(stderr, "failed to save feature.\n");
   }
-
-EXIT:
-  delete[] wav;
-  delete[] temp_mem;
   return error_code;
-}
\ No newline at end of file
+}
+
+std::string getUtteranceId(const std::string& path) {
+  size_t start = path.find_last_of('/');
+  start = (start == std::string::npos) ? 0 : start + 1;
+  size_t end = path.find_last_of('.');
+  if (end == std::string::npos || end < start) {
+    end = path.size();
+  }
+  return path.substr(start, end - start);
+}
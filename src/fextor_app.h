@@ -9,9 +9,24 @@
 #define FEXTOR_TARGET_MEL       1
 #define FEXTOR_TARGET_MFCC      2
 
+// Number of steps of samples read at once in streaming extraction
+#define FEXTOR_STREAM_CHUNK_STEPS 10
+
+// Size of header of .feat file : number of frames (uint32), dimension
+// (uint32) and size of each value in bytes (uint64)
+#define FEXTOR_FEAT_HEADER_SIZE 16
+
+#include <stddef.h>
+
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "dsp/feature_extractor.h"
+#include "feature_codec.h"
+#include "parallel/threadpool.h"
+#include "wave/wave_gain.h"
+#include "wave/wave_stream.h"
 
 class Feature {
 public:
@@ -25,15 +40,80 @@ private:
   //std::unique_ptr<dsp::float_t> data_;
   dsp::float_t *data_;
 
+  // File mapped by `load()`, and its data
+  void *map_;
+  size_t map_size_;
+  const dsp::float_t *view_;
+
+  void release();
+
 public:
+  // Map .feat or .npy file into memory without copying. Data are read-only
+  // until feature is resized. Compressed files are decoded into memory.
   int load(const char* input_file_name);
-  int save(const char* output_file_name);
 
+  // Write feature. If name ends with ".npy", it is written in .npy format
+  // which numpy can load or map directly. `format` selects dtype, and codec
+  // of .feat file.
+  int save(const char* output_file_name,
+           const FeatureFormat* format = NULL) const;
+
+  // Whole contents of file written by `save()`, in .npy format if `is_npy`
+  int encode(const bool is_npy, const FeatureFormat* format,
+             std::vector<unsigned char>* bytes) const;
+
+  // Reallocate data for given shape, contents are not preserved
+  void resize(unsigned int num_frame, unsigned int feat_dim);
+
+  // NULL if feature is mapped by `load()`, use `getData()` instead
   dsp::float_t* getPtr(const unsigned int index);
+
+  unsigned int getNumFrame() const { return num_frame_; }
+  unsigned int getFeatDim() const { return feat_dim_; }
+  const dsp::float_t* getData() const { return (map_ != NULL) ? view_ : data_; }
+  bool isMapped() const { return map_ != NULL; }
 };  // Feature
 
+// Extract feature of decoded wave into `feat`, without writing it. If `pool`
+// is given, frames are extracted by its workers in parallel.
+int computeFeature(const dsp::float_t* wav, const unsigned int wav_length,
+                   const dsp::FEInitParam* param,
+                   dsp::FeatureExtractor* extractor, int target,
+                   Feature* feat, parallel::ThreadPool* pool = NULL);
+
+// Extract feature of wave file and write it in `format` (default if NULL).
+// If `pool` is given, frames are extracted by its workers in parallel.
 int extractOne(const char* input_wav_name, const char* output_feat_name, 
                const dsp::FEInitParam* param, dsp::FeatureExtractor* extractor,
-               int target);
+               int target, parallel::ThreadPool* pool = NULL,
+               const FeatureFormat* format = NULL);
+
+// Same as above, but input is wave placed in memory (WAV or FLAC),
+// such as a member of shard.
+int extractOne(const unsigned char* input_bytes, const size_t num_input_bytes,
+               const char* output_feat_name, const dsp::FEInitParam* param,
+               dsp::FeatureExtractor* extractor, int target,
+               parallel::ThreadPool* pool = NULL,
+               const FeatureFormat* format = NULL);
+
+// Extract feature while reading samples from stream, such as PCM from
+// standard input. Frames are extracted as soon as their samples arrive, and
+// multi channel input is down-mixed into mono. If `agc` is given, gain of
+// samples is controlled chunk by chunk before extraction.
+int extractStream(wave::StreamReader* reader, const char* output_feat_name,
+                  const dsp::FEInitParam* param,
+                  dsp::FeatureExtractor* extractor, int target,
+                  wave::AutoGainControl* agc = NULL,
+                  const FeatureFormat* format = NULL);
+
+// Dimension of feature of given target, 0 if target is invalid
+unsigned int getFeatureDim(const dsp::FEInitParam* param, int target);
+
+// True if `name` ends with `suffix`
+bool hasSuffix(const char* name, const char* suffix);
+
+// Get utterance id from path of file, which is file name without directory
+// and extension. (e.g. "a/b/utt_001.wav" -> "utt_001")
+std::string getUtteranceId(const std::string& path);
 
 #endif // FEXTOR_APP_H
\ No newline at end of file
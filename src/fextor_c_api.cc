@@ -0,0 +1,256 @@
+#include "fextor_c_api.h"
+
+#include <new>
+#include <vector>
+
+#include "dsp/feature_extractor.h"
+
+struct fextor_extractor_t {
+  dsp::FEInitParam param;
+  dsp::FeatureExtractor extractor;
+  int target;
+  unsigned int feat_dim;
+
+  // Scratch memory of extractor, and frame and feature converted from or
+  // into type of build if it is not float
+  std::vector<dsp::float_t> temp_mem;
+  std::vector<dsp::float_t> frame;
+  std::vector<dsp::float_t> output;
+};
+
+int fextor_get_api_version(void) {
+  return FEXTOR_API_VERSION;
+}
+
+const char* fextor_get_error_string(int error_code) {
+  switch (error_code) {
+  case FEXTOR_OK:
+    return "success";
+  case FEXTOR_ERROR_INVALID_ARGUMENT:
+    return "invalid argument";
+  case FEXTOR_ERROR_INIT:
+    return "failed to init extractor, parameters are invalid";
+  case FEXTOR_ERROR_BUFFER_TOO_SMALL:
+    return "output buffer is too small";
+  case FEXTOR_ERROR_EXTRACT:
+    return "failed to extract feature";
+  case FEXTOR_ERROR_MEMORY:
+    return "failed to allocate memory";
+  default:
+    return "unknown error";
+  }
+}
+
+int fextor_get_default_param(uint32_t sampling_rate, fextor_param_t* param) {
+  dsp::FEInitParam init_param;
+  if (param == NULL || sampling_rate != dsp::kSamplingRate16K ||
+      dsp::setDefaultParam(sampling_rate, &init_param) != DSP_SUCCESS) {
+    return FEXTOR_ERROR_INVALID_ARGUMENT;
+  }
+  param->struct_size = sizeof(fextor_param_t);
+  param->sampling_rate = init_param.sampling_rate;
+  param->window_type = (init_param.window_type == dsp::kWindowTypeHanning) ?
+                       FEXTOR_WINDOW_HANNING : FEXTOR_WINDOW_RECTANGLE;
+  param->window_size = init_param.window_size;
+  param->step_size = init_param.step_size;
+  param->num_fft_point = init_param.num_fft_point;
+  param->num_mels = init_param.num_mels;
+  param->num_mfcc = init_param.num_mfcc;
+  param->is_center = init_param.is_center ? 1 : 0;
+  param->reserved = 0;
+  param->min_hertz = init_param.min_hertz;
+  param->max_hertz = init_param.max_hertz;
+  param->epsilon = init_param.epsilon;
+  param->ref_level_db = init_param.ref_level_db;
+  return FEXTOR_OK;
+}
+
+static unsigned int get_feat_dim(const dsp::FEInitParam& param, const int target) {
+  switch (target) {
+  case FEXTOR_TARGET_SPECTRUM:
+    return param.num_fft_point / 2 + 1;
+  case FEXTOR_TARGET_MEL:
+    return param.num_mels;
+  case FEXTOR_TARGET_MFCC:
+    return param.num_mfcc;
+  default:
+    return 0;
+  }
+}
+
+int fextor_create(const fextor_param_t* param, int target,
+                  fextor_extractor_t** extractor) {
+  if (param == NULL || extractor == NULL ||
+      param->struct_size < sizeof(fextor_param_t) ||
+      param->window_type > FEXTOR_WINDOW_HANNING ||
+      param->step_size == 0) {
+    return FEXTOR_ERROR_INVALID_ARGUMENT;
+  }
+  (*extractor) = NULL;
+
+  fextor_extractor_t* handle = new (std::nothrow) fextor_extractor_t();
+  if (handle == NULL) {
+    return FEXTOR_ERROR_MEMORY;
+  }
+  dsp::FEInitParam& init_param = handle->param;
+  init_param.sampling_rate = param->sampling_rate;
+  init_param.window_type = (param->window_type == FEXTOR_WINDOW_HANNING) ?
+                           dsp::kWindowTypeHanning : dsp::kWindowTypeRectangle;
+  init_param.window_size = param->window_size;
+  init_param.step_size = param->step_size;
+  init_param.num_fft_point = param->num_fft_point;
+  init_param.num_mels = param->num_mels;
+  init_param.num_mfcc = param->num_mfcc;
+  init_param.is_center = (param->is_center != 0);
+  init_param.min_hertz = (dsp::float_t)param->min_hertz;
+  init_param.max_hertz = (dsp::float_t)param->max_hertz;
+  init_param.epsilon = (dsp::float_t)param->epsilon;
+  init_param.ref_level_db = (dsp::float_t)param->ref_level_db;
+  handle->target = target;
+  handle->feat_dim = get_feat_dim(init_param, target);
+  if (handle->feat_dim == 0) {
+    delete handle;
+    return FEXTOR_ERROR_INVALID_ARGUMENT;
+  }
+  if (handle->extractor.init(&init_param) != DSP_SUCCESS) {
+    delete handle;
+    return FEXTOR_ERROR_INIT;
+  }
+
+  // Memory used by extraction is allocated here, not in `fextor_extract()`
+  try {
+    handle->temp_mem.resize(init_param.num_fft_point * 2);
+    handle->frame.resize(init_param.window_size);
+    handle->output.resize(handle->feat_dim);
+  } catch (const std::bad_alloc&) {
+    delete handle;
+    return FEXTOR_ERROR_MEMORY;
+  }
+  (*extractor) = handle;
+  return FEXTOR_OK;
+}
+
+void fextor_destroy(fextor_extractor_t* extractor) {
+  delete extractor;
+}
+
+int fextor_get_output_shape(const fextor_extractor_t* extractor,
+                            size_t num_samples, uint32_t* num_frame,
+                            uint32_t* feat_dim) {
+  if (extractor == NULL) {
+    return FEXTOR_ERROR_INVALID_ARGUMENT;
+  }
+  // Same number of frames as `computeFeature()` of fextor
+  const dsp::FEInitParam& param = extractor->param;
+  size_t frames = 0;
+  if (num_samples >= param.window_size) {
+    frames = (num_samples - param.window_size) / param.step_size;
+  }
+  if (frames > UINT32_MAX) {
+    return FEXTOR_ERROR_INVALID_ARGUMENT;
+  }
+  if (num_frame != NULL) {
+    (*num_frame) = (uint32_t)frames;
+  }
+  if (feat_dim != NULL) {
+    (*feat_dim) = extractor->feat_dim;
+  }
+  return FEXTOR_OK;
+}
+
+// Frame of samples in type of build. Samples already in that type are used
+// without copying.
+static inline const dsp::float_t* get_frame(fextor_extractor_t*,
+                                            const dsp::float_t* src,
+                                            const dsp::float_t) {
+  return src;
+}
+
+template <typename T>
+static inline const dsp::float_t* get_frame(fextor_extractor_t* extractor,
+                                            const T* src,
+                                            const dsp::float_t scale) {
+  dsp::float_t* frame = extractor->frame.data();
+  for (size_t i = 0; i < extractor->frame.size(); i++) {
+    frame[i] = (dsp::float_t)src[i] * scale;
+  }
+  return frame;
+}
+
+// Destination of feature of one frame, which is `dest` itself if build is
+// of float
+static inline dsp::float_t* get_output(fextor_extractor_t*,
+                                       dsp::float_t* dest) {
+  return dest;
+}
+
+template <typename T>
+static inline dsp::float_t* get_output(fextor_extractor_t* extractor, T*) {
+  return extractor->output.data();
+}
+
+template <typename T>
+static int extract_frames(fextor_extractor_t* extractor, const T* samples,
+                          const size_t num_samples, const dsp::float_t scale,
+                          float* dest, const size_t dest_size,
+                          uint32_t* num_frame, uint32_t* feat_dim) {
+  uint32_t frames, dim;
+  if (extractor == NULL || (samples == NULL && num_samples > 0) ||
+      fextor_get_output_shape(extractor, num_samples, &frames, &dim) != FEXTOR_OK) {
+    return FEXTOR_ERROR_INVALID_ARGUMENT;
+  }
+  if (num_frame != NULL) {
+    (*num_frame) = frames;
+  }
+  if (feat_dim != NULL) {
+    (*feat_dim) = dim;
+  }
+  if ((size_t)frames * dim > dest_size || (dest == NULL && frames > 0)) {
+    return FEXTOR_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  const size_t step_size = extractor->param.step_size;
+  dsp::float_t* temp_mem = extractor->temp_mem.data();
+  for (uint32_t n = 0; n < frames; n++) {
+    const dsp::float_t* frame = get_frame(extractor, samples + n * step_size, scale);
+    float* frame_dest = dest + (size_t)n * dim;
+    dsp::float_t* output = get_output(extractor, frame_dest);
+
+    int ret;
+    switch (extractor->target) {
+    case FEXTOR_TARGET_SPECTRUM:
+      ret = extractor->extractor.spectrum(frame, output, false, temp_mem);
+      break;
+    case FEXTOR_TARGET_MEL:
+      ret = extractor->extractor.melspectrum(frame, output, false, temp_mem);
+      break;
+    default:
+      ret = extractor->extractor.mfcc(frame, output, temp_mem);
+      break;
+    }
+    if (ret != DSP_SUCCESS) {
+      return FEXTOR_ERROR_EXTRACT;
+    }
+    if ((void*)output != (void*)frame_dest) {
+      for (uint32_t d = 0; d < dim; d++) {
+        frame_dest[d] = (float)output[d];
+      }
+    }
+  }
+  return FEXTOR_OK;
+}
+
+int fextor_extract(fextor_extractor_t* extractor, const float* samples,
+                   size_t num_samples, float* dest, size_t dest_size,
+                   uint32_t* num_frame, uint32_t* feat_dim) {
+  return extract_frames(extractor, samples, num_samples, (dsp::float_t)1.0,
+                        dest, dest_size, num_frame, feat_dim);
+}
+
+int fextor_extract_int16(fextor_extractor_t* extractor, const int16_t* samples,
+                         size_t num_samples, float* dest, size_t dest_size,
+                         uint32_t* num_frame, uint32_t* feat_dim) {
+  return extract_frames(extractor, samples, num_samples,
+                        (dsp::float_t)1.0 / (dsp::float_t)32768.0,
+                        dest, dest_size, num_frame, feat_dim);
+}
@@ -0,0 +1,106 @@
+#ifndef FEXTOR_C_API_H
+#define FEXTOR_C_API_H
+
+/*
+ * C API of libfextor, for extraction inside other programs.
+ *
+ * Extractor handle owns its tables and scratch memory, so that library has
+ * no global state. A handle is used by one thread at a time, and threads
+ * extract at once with handles of their own. Extraction does not allocate
+ * memory nor print messages; features are written into buffer of caller.
+ * Samples are mono at sampling rate of parameters, and features are float
+ * values of `num_frame` x `feat_dim` in row major order, same as `fextor`.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FEXTOR_API_VERSION 1
+
+/* Error codes */
+#define FEXTOR_OK 0
+#define FEXTOR_ERROR_INVALID_ARGUMENT 1
+#define FEXTOR_ERROR_INIT 2              /* invalid parameters */
+#define FEXTOR_ERROR_BUFFER_TOO_SMALL 3
+#define FEXTOR_ERROR_EXTRACT 4
+#define FEXTOR_ERROR_MEMORY 5
+
+#define FEXTOR_WINDOW_RECTANGLE 0
+#define FEXTOR_WINDOW_HANNING 1
+
+#ifndef FEXTOR_TARGET_SPECTRUM
+#define FEXTOR_TARGET_SPECTRUM  0
+#define FEXTOR_TARGET_MEL       1
+#define FEXTOR_TARGET_MFCC      2
+#endif
+
+/* Parameters of extractor, same as `dsp::FEInitParam`. Fields are only
+ * appended in later versions, and `struct_size` tells which of them are
+ * given. */
+typedef struct fextor_param_t {
+  uint32_t struct_size;     /* sizeof(fextor_param_t) */
+  uint32_t sampling_rate;
+  uint32_t window_type;     /* FEXTOR_WINDOW_* */
+  uint32_t window_size;     /* in samples */
+  uint32_t step_size;       /* in samples */
+  uint32_t num_fft_point;
+  uint32_t num_mels;
+  uint32_t num_mfcc;
+  uint32_t is_center;
+  uint32_t reserved;
+  double min_hertz;
+  double max_hertz;
+  double epsilon;
+  double ref_level_db;
+} fextor_param_t;
+
+typedef struct fextor_extractor_t fextor_extractor_t;
+
+#if defined(_WIN32)
+#define FEXTOR_API __declspec(dllexport)
+#else
+#define FEXTOR_API __attribute__((visibility("default")))
+#endif
+
+FEXTOR_API int fextor_get_api_version(void);
+
+/* Description of error code, never NULL */
+FEXTOR_API const char* fextor_get_error_string(int error_code);
+
+/* Default parameters of `fextor` for sampling rate, 16000 only for now */
+FEXTOR_API int fextor_get_default_param(uint32_t sampling_rate,
+                                        fextor_param_t* param);
+
+/* Create extractor of `target` (FEXTOR_TARGET_*). This is where tables are
+ * built, so that handle is created once and reused. */
+FEXTOR_API int fextor_create(const fextor_param_t* param, int target,
+                             fextor_extractor_t** extractor);
+FEXTOR_API void fextor_destroy(fextor_extractor_t* extractor);
+
+/* Shape of feature of `num_samples` samples */
+FEXTOR_API int fextor_get_output_shape(const fextor_extractor_t* extractor,
+                                       size_t num_samples, uint32_t* num_frame,
+                                       uint32_t* feat_dim);
+
+/* Extract feature into `dest` of `dest_size` floats. Shape is written into
+ * `num_frame` and `feat_dim` (either can be NULL), also when `dest` is too
+ * small. Samples are in range of [-1, 1) for float input, and int16 input
+ * is scaled by 1 / 32768. */
+FEXTOR_API int fextor_extract(fextor_extractor_t* extractor,
+                              const float* samples, size_t num_samples,
+                              float* dest, size_t dest_size,
+                              uint32_t* num_frame, uint32_t* feat_dim);
+FEXTOR_API int fextor_extract_int16(fextor_extractor_t* extractor,
+                                    const int16_t* samples, size_t num_samples,
+                                    float* dest, size_t dest_size,
+                                    uint32_t* num_frame, uint32_t* feat_dim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FEXTOR_C_API_H */
@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gflags/gflags.h"
+
+#include "fextor_app.h"
+#include "fextor_protocol.h"
+
+DEFINE_string(socket, "/tmp/fextor.sock", "path of socket of `fextor --serve`");
+DEFINE_string(input, "", "path of input file");
+DEFINE_string(output, "", "path of output file, written in .feat format");
+DEFINE_int32(target, FEXTOR_TARGET_MFCC, "target to extract, "
+             "(0: spectrum, 1: mel, 2: mfcc)");
+DEFINE_bool(inline, false, "send contents of input file instead of its path, "
+            "for server which can not read the file");
+DEFINE_bool(remote_output, false, "server writes `output` in its own format, "
+            "instead of sending feature back");
+
+// Write feature of response as .feat file without codec
+int writeFeature(const char* output_file_name, const FextorResponse& response) {
+  FILE* fp = fopen(output_file_name, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "failed to open file : %s\n", output_file_name);
+    return 1;
+  }
+  const uint32_t num_frame = response.num_frame;
+  const uint32_t feat_dim = response.feat_dim;
+  const uint64_t value_size = (response.dtype == FEXTOR_DTYPE_FLOAT64) ? 8 : 4;
+  size_t num_written = fwrite(&num_frame, sizeof(num_frame), 1, fp);
+  num_written += fwrite(&feat_dim, sizeof(feat_dim), 1, fp);
+  num_written += fwrite(&value_size, sizeof(value_size), 1, fp);
+  if (!response.data.empty()) {
+    num_written += fwrite(response.data.data(), response.data.size(), 1, fp);
+  } else {
+    num_written++;
+  }
+  if (fclose(fp) != 0 || num_written != 4) {
+    fprintf(stderr, "failed to write file : %s\n", output_file_name);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+
+  gflags::SetUsageMessage("fextor_client");
+  gflags::SetVersionString("1.0.0");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_input.empty() || FLAGS_output.empty()) {
+    fprintf(stderr, "Invalid argument - `input` and `output` arguments are must be given.\n");
+    return 1;
+  }
+
+  FextorRequest request;
+  if (makeRequest(FLAGS_input.c_str(), FLAGS_inline, FLAGS_target,
+                  FLAGS_remote_output ? FLAGS_output.c_str() : NULL,
+                  &request) != 0) {
+    return 1;
+  }
+
+  FextorClient client;
+  FextorResponse response;
+  if (client.connect(FLAGS_socket.c_str()) != 0 ||
+      client.extract(request, &response) != 0) {
+    return 1;
+  }
+  if (response.status != 0) {
+    fprintf(stderr, "request failed : %.*s\n", (int)response.data.size(),
+            (const char*)response.data.data());
+    return 1;
+  }
+  fprintf(stdout, "%u frames x %u dimensions, extracted in %u usec\n",
+          response.num_frame, response.feat_dim, response.compute_usec);
+
+  int error_code = 0;
+  if (!FLAGS_remote_output) {
+    error_code = writeFeature(FLAGS_output.c_str(), response);
+  }
+
+  gflags::ShutDownCommandLineFlags();
+  return error_code;
+}
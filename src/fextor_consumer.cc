@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+
+#include "gflags/gflags.h"
+
+#include "feature_ring.h"
+
+DEFINE_string(ring, "/fextor", "name of shared memory of `fextor --ring`");
+DEFINE_string(output_dir, "", "if given, features are written into it as "
+              "<utterance id>.feat, straight from shared memory");
+DEFINE_uint32(timeout, 0, "stop after waiting this number of milliseconds "
+              "for next feature, 0 to wait until `fextor` finishes");
+
+// Write feature in shared memory as .feat file without codec
+int writeFeature(const std::string& output_file_name, const FeatureView& view) {
+  FILE* fp = fopen(output_file_name.c_str(), "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "failed to open file : %s\n", output_file_name.c_str());
+    return 1;
+  }
+  const uint32_t num_frame = view.num_frame;
+  const uint32_t feat_dim = view.feat_dim;
+  const uint64_t value_size = getDtypeSize(view.dtype);
+  const size_t data_size = (size_t)num_frame * feat_dim * value_size;
+  size_t num_written = fwrite(&num_frame, sizeof(num_frame), 1, fp);
+  num_written += fwrite(&feat_dim, sizeof(feat_dim), 1, fp);
+  num_written += fwrite(&value_size, sizeof(value_size), 1, fp);
+  if (data_size > 0) {
+    num_written += fwrite(view.data, data_size, 1, fp);
+  } else {
+    num_written++;
+  }
+  if (fclose(fp) != 0 || num_written != 4) {
+    fprintf(stderr, "failed to write file : %s\n", output_file_name.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+// Sum of bytes of feature, so that every value is read from shared memory
+uint64_t touchFeature(const FeatureView& view) {
+  const size_t data_size =
+      (size_t)view.num_frame * view.feat_dim * getDtypeSize(view.dtype);
+  const uint64_t* words = (const uint64_t*)view.data;
+  uint64_t sum = 0;
+  for (size_t i = 0; i < data_size / sizeof(uint64_t); i++) {
+    sum += words[i];
+  }
+  const unsigned char* bytes = (const unsigned char*)view.data;
+  for (size_t i = data_size / sizeof(uint64_t) * sizeof(uint64_t); i < data_size; i++) {
+    sum += bytes[i];
+  }
+  return sum;
+}
+
+int main(int argc, char** argv) {
+
+  gflags::SetUsageMessage("fextor_consumer");
+  gflags::SetVersionString("1.0.0");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  FeatureRingReader reader;
+  if (reader.open(FLAGS_ring.c_str()) != 0) {
+    return 1;
+  }
+  fprintf(stdout, "attached to %s\n", FLAGS_ring.c_str());
+  fflush(stdout);
+
+  int error_code = 0;
+  unsigned int num_records = 0;
+  unsigned int num_failed = 0;
+  uint64_t num_bytes = 0;
+  uint64_t checksum = 0;
+  std::chrono::steady_clock::time_point start;
+  std::string id;
+  FeatureView view;
+  while (true) {
+    const int ret = reader.next(&id, &view, FLAGS_timeout);
+    if (ret == FEATURE_RING_CLOSED || ret == FEATURE_RING_TIMEOUT) {
+      break;
+    } else if (ret != FEATURE_RING_SUCCESS) {
+      error_code = 1;
+      break;
+    }
+    // Measured from first record, not from waiting for `fextor`
+    if (num_records == 0) {
+      start = std::chrono::steady_clock::now();
+    }
+    num_records++;
+    num_bytes += (uint64_t)view.num_frame * view.feat_dim * getDtypeSize(view.dtype);
+    checksum += touchFeature(view);
+    if (!FLAGS_output_dir.empty() &&
+        writeFeature(FLAGS_output_dir + "/" + id + ".feat", view) != 0) {
+      num_failed++;
+    }
+    reader.release();
+  }
+  reader.close();
+
+  double elapsed = 0;
+  if (num_records > 0) {
+    elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+  fprintf(stdout, "%u number of features are read, %.1f MB in %.3f sec "
+          "(%.1f records/s, %.1f MB/s), checksum %016llx\n", num_records,
+          num_bytes / 1e6, elapsed,
+          (elapsed > 0) ? num_records / elapsed : 0.0,
+          (elapsed > 0) ? num_bytes / 1e6 / elapsed : 0.0,
+          (unsigned long long)checksum);
+  if (num_failed > 0) {
+    fprintf(stderr, "%u number of features are failed to write.\n", num_failed);
+    error_code = 1;
+  }
+
+  gflags::ShutDownCommandLineFlags();
+  return error_code;
+}
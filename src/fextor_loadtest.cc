@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "fextor_app.h"
+#include "fextor_protocol.h"
+
+DEFINE_string(socket, "/tmp/fextor.sock", "path of socket of `fextor --serve`");
+DEFINE_string(input, "", "path of input file, requested repeatedly");
+DEFINE_int32(target, FEXTOR_TARGET_MFCC, "target to extract, "
+             "(0: spectrum, 1: mel, 2: mfcc)");
+DEFINE_bool(inline, false, "send contents of input file instead of its path");
+DEFINE_uint32(num_clients, 4, "number of clients sending requests at once, "
+              "each on its own connection");
+DEFINE_uint32(num_requests, 100, "number of requests of each client");
+DEFINE_uint32(num_warmup, 5, "number of requests of each client sent before "
+              "measuring");
+
+// Latencies in microseconds
+typedef struct client_result_t {
+  std::vector<double> latency;
+  std::vector<double> compute;
+  unsigned int num_failed;
+
+  client_result_t() : num_failed(0) {}
+} ClientResult;
+
+void runClient(const FextorRequest* request, ClientResult* result) {
+  FextorClient client;
+  if (client.connect(FLAGS_socket.c_str()) != 0) {
+    result->num_failed = FLAGS_num_requests;
+    return;
+  }
+
+  FextorResponse response;
+  for (unsigned int i = 0; i < FLAGS_num_warmup + FLAGS_num_requests; i++) {
+    const auto start = std::chrono::steady_clock::now();
+    if (client.extract(*request, &response) != 0) {
+      result->num_failed += FLAGS_num_warmup + FLAGS_num_requests - i;
+      return;
+    }
+    const double latency = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count();
+    if (i < FLAGS_num_warmup) {
+      continue;
+    }
+    if (response.status != 0) {
+      result->num_failed++;
+      continue;
+    }
+    result->latency.push_back(latency);
+    result->compute.push_back((double)response.compute_usec);
+  }
+}
+
+// Value of sorted `values` at `ratio` (0 ~ 1)
+double getPercentile(const std::vector<double>& values, const double ratio) {
+  if (values.empty()) {
+    return 0;
+  }
+  size_t index = (size_t)(ratio * (values.size() - 1) + 0.5);
+  return values[std::min(index, values.size() - 1)];
+}
+
+void printPercentiles(const char* name, std::vector<double>* values) {
+  std::sort(values->begin(), values->end());
+  fprintf(stdout, "%-16s : p50 %10.1f, p90 %10.1f, p99 %10.1f, max %10.1f\n",
+          name, getPercentile(*values, 0.5), getPercentile(*values, 0.9),
+          getPercentile(*values, 0.99), getPercentile(*values, 1.0));
+}
+
+int main(int argc, char** argv) {
+
+  gflags::SetUsageMessage("fextor_loadtest");
+  gflags::SetVersionString("1.0.0");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_input.empty() || FLAGS_num_clients == 0) {
+    fprintf(stderr, "Invalid argument - `input` argument is must be given.\n");
+    return 1;
+  }
+  FextorRequest request;
+  if (makeRequest(FLAGS_input.c_str(), FLAGS_inline, FLAGS_target, NULL,
+                  &request) != 0) {
+    return 1;
+  }
+
+  std::vector<ClientResult> results(FLAGS_num_clients);
+  std::vector<std::thread> threads;
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < FLAGS_num_clients; i++) {
+    threads.push_back(std::thread(runClient, &request, &results[i]));
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::vector<double> latency, compute;
+  unsigned int num_failed = 0;
+  for (auto& result : results) {
+    latency.insert(latency.end(), result.latency.begin(), result.latency.end());
+    compute.insert(compute.end(), result.compute.begin(), result.compute.end());
+    num_failed += result.num_failed;
+  }
+
+  // Elapsed time includes warm up requests
+  const unsigned int num_sent =
+      FLAGS_num_clients * (FLAGS_num_warmup + FLAGS_num_requests);
+  fprintf(stdout, "%lu number of requests are measured, %u are failed, "
+          "%.1f requests/sec\n", latency.size(), num_failed,
+          (elapsed > 0) ? num_sent / elapsed : 0.0);
+  printPercentiles("latency (usec)", &latency);
+  printPercentiles("compute (usec)", &compute);
+
+  gflags::ShutDownCommandLineFlags();
+  return (num_failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+#include "fextor_protocol.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int sendAll(const int fd, const void* data, const size_t size) {
+  const char* p = (const char*)data;
+  size_t num_sent = 0;
+  while (num_sent < size) {
+    // MSG_NOSIGNAL : peer closing connection is an error, not SIGPIPE
+    const ssize_t ret = send(fd, p + num_sent, size - num_sent, MSG_NOSIGNAL);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return FEXTOR_SOCKET_ERROR;
+    }
+    num_sent += (size_t)ret;
+  }
+  return FEXTOR_SOCKET_SUCCESS;
+}
+
+int receiveAll(const int fd, void* data, const size_t size) {
+  char* p = (char*)data;
+  size_t num_received = 0;
+  while (num_received < size) {
+    const ssize_t ret = recv(fd, p + num_received, size - num_received, 0);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return FEXTOR_SOCKET_ERROR;
+    }
+    if (ret == 0) {
+      return (num_received == 0) ? FEXTOR_SOCKET_CLOSED : FEXTOR_SOCKET_ERROR;
+    }
+    num_received += (size_t)ret;
+  }
+  return FEXTOR_SOCKET_SUCCESS;
+}
+
+// Receive `size` bytes into `str`, closing in the middle is an error
+static int receive_string(const int fd, const uint64_t size, std::string* str) {
+  str->resize((size_t)size);
+  if (size == 0) {
+    return FEXTOR_SOCKET_SUCCESS;
+  }
+  const int ret = receiveAll(fd, &(*str)[0], (size_t)size);
+  return (ret == FEXTOR_SOCKET_SUCCESS) ? ret : FEXTOR_SOCKET_ERROR;
+}
+
+static std::string get_absolute_path(const char* path) {
+  char cwd[FEXTOR_MAX_PATH_SIZE];
+  if (path[0] == '/' || getcwd(cwd, sizeof(cwd)) == NULL) {
+    return path;
+  }
+  return std::string(cwd) + "/" + path;
+}
+
+int makeRequest(const char* input_file_name, const bool is_inline,
+                const int target, const char* output_file_name,
+                FextorRequest* request) {
+  if (input_file_name == NULL || request == NULL) {
+    return 1;
+  }
+  request->target = target;
+  request->output.clear();
+  if (output_file_name != NULL && output_file_name[0] != '\0') {
+    request->output = get_absolute_path(output_file_name);
+  }
+  if (!is_inline) {
+    request->input_type = FEXTOR_INPUT_PATH;
+    request->input = get_absolute_path(input_file_name);
+    return 0;
+  }
+
+  // Only files named so are sent as headerless PCM
+  const char* extension = strrchr(input_file_name, '.');
+  const bool is_pcm = (extension != NULL && strchr(extension, '/') == NULL &&
+                       (strcmp(extension, ".pcm") == 0 || strcmp(extension, ".raw") == 0));
+  request->input_type = is_pcm ? FEXTOR_INPUT_PCM : FEXTOR_INPUT_BYTES;
+  request->input.clear();
+  FILE* fp = fopen(input_file_name, "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "makeRequest() - failed to open file : %s\n", input_file_name);
+    return 1;
+  }
+  char buffer[65536];
+  size_t num_read;
+  while ((num_read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    request->input.append(buffer, num_read);
+  }
+  const int error_code = ferror(fp) ? 1 : 0;
+  fclose(fp);
+  if (error_code != 0) {
+    fprintf(stderr, "makeRequest() - failed to read file : %s\n", input_file_name);
+  }
+  return error_code;
+}
+
+int sendRequest(const int fd, const FextorRequest& request) {
+  FextorRequestHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "FXRQ", 4);
+  header.version = FEXTOR_PROTOCOL_VERSION;
+  header.input_type = request.input_type;
+  header.target = request.target;
+  header.input_size = request.input.size();
+  header.output_size = request.output.size();
+
+  if (sendAll(fd, &header, sizeof(header)) != FEXTOR_SOCKET_SUCCESS ||
+      sendAll(fd, request.input.data(), request.input.size()) != FEXTOR_SOCKET_SUCCESS ||
+      sendAll(fd, request.output.data(), request.output.size()) != FEXTOR_SOCKET_SUCCESS) {
+    return FEXTOR_SOCKET_ERROR;
+  }
+  return FEXTOR_SOCKET_SUCCESS;
+}
+
+int receiveRequest(const int fd, FextorRequest* request) {
+  FextorRequestHeader header;
+  int ret = receiveAll(fd, &header, sizeof(header));
+  if (ret != FEXTOR_SOCKET_SUCCESS) {
+    return ret;
+  }
+  if (memcmp(header.magic, "FXRQ", 4) != 0 ||
+      header.version != FEXTOR_PROTOCOL_VERSION) {
+    fprintf(stderr, "receiveRequest() - invalid header of request.\n");
+    return FEXTOR_SOCKET_ERROR;
+  }
+  const uint64_t max_input_size = (header.input_type == FEXTOR_INPUT_PATH) ?
+      FEXTOR_MAX_PATH_SIZE : FEXTOR_MAX_INPUT_SIZE;
+  if (header.input_size > max_input_size ||
+      header.output_size > FEXTOR_MAX_PATH_SIZE) {
+    fprintf(stderr, "receiveRequest() - request is too large.\n");
+    return FEXTOR_SOCKET_ERROR;
+  }
+
+  request->input_type = header.input_type;
+  request->target = header.target;
+  if (receive_string(fd, header.input_size, &request->input) != FEXTOR_SOCKET_SUCCESS ||
+      receive_string(fd, header.output_size, &request->output) != FEXTOR_SOCKET_SUCCESS) {
+    return FEXTOR_SOCKET_ERROR;
+  }
+  return FEXTOR_SOCKET_SUCCESS;
+}
+
+int sendResponse(const int fd, const FextorResponseHeader& header,
+                 const void* data) {
+  FextorResponseHeader sent = header;
+  memcpy(sent.magic, "FXRS", 4);
+  if (sendAll(fd, &sent, sizeof(sent)) != FEXTOR_SOCKET_SUCCESS ||
+      sendAll(fd, data, (size_t)header.data_size) != FEXTOR_SOCKET_SUCCESS) {
+    return FEXTOR_SOCKET_ERROR;
+  }
+  return FEXTOR_SOCKET_SUCCESS;
+}
+
+int receiveResponse(const int fd, FextorResponse* response) {
+  FextorResponseHeader header;
+  if (receiveAll(fd, &header, sizeof(header)) != FEXTOR_SOCKET_SUCCESS) {
+    return FEXTOR_SOCKET_ERROR;
+  }
+  if (memcmp(header.magic, "FXRS", 4) != 0) {
+    fprintf(stderr, "receiveResponse() - invalid header of response.\n");
+    return FEXTOR_SOCKET_ERROR;
+  }
+  response->status = header.status;
+  response->num_frame = header.num_frame;
+  response->feat_dim = header.feat_dim;
+  response->dtype = header.dtype;
+  response->compute_usec = header.compute_usec;
+  response->data.resize((size_t)header.data_size);
+  if (header.data_size > 0 &&
+      receiveAll(fd, response->data.data(), (size_t)header.data_size) != FEXTOR_SOCKET_SUCCESS) {
+    return FEXTOR_SOCKET_ERROR;
+  }
+  return FEXTOR_SOCKET_SUCCESS;
+}
+
+FextorClient::FextorClient() : fd_(-1) {
+
+}
+
+FextorClient::~FextorClient() {
+  close();
+}
+
+int FextorClient::connect(const char* socket_path) {
+  struct sockaddr_un address;
+  if (socket_path == NULL || strlen(socket_path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "FextorClient::connect() - invalid path of socket.\n");
+    return 1;
+  }
+  close();
+
+  fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    fprintf(stderr, "FextorClient::connect() - failed to create socket : %s\n",
+            strerror(errno));
+    return 1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+  if (::connect(fd_, (struct sockaddr*)&address, sizeof(address)) != 0) {
+    fprintf(stderr, "FextorClient::connect() - failed to connect %s : %s\n",
+            socket_path, strerror(errno));
+    close();
+    return 1;
+  }
+  return 0;
+}
+
+void FextorClient::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+int FextorClient::extract(const FextorRequest& request,
+                          FextorResponse* response) {
+  if (fd_ < 0 || response == NULL) {
+    return 1;
+  }
+  if (sendRequest(fd_, request) != FEXTOR_SOCKET_SUCCESS ||
+      receiveResponse(fd_, response) != FEXTOR_SOCKET_SUCCESS) {
+    fprintf(stderr, "FextorClient::extract() - connection is broken.\n");
+    close();
+    return 1;
+  }
+  return 0;
+}
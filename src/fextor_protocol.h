@@ -0,0 +1,116 @@
+#ifndef FEXTOR_PROTOCOL_H
+#define FEXTOR_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Protocol of `fextor --serve` over UNIX domain stream socket.
+//
+// Client sends requests one after another on a connection, and server
+// answers each of them in order :
+//   request  : header (32 bytes), input (`input_size` bytes),
+//              output path (`output_size` bytes)
+//   response : header (32 bytes), data (`data_size` bytes)
+//
+// Input is path of audio file readable by server, or audio itself : WAV or
+// FLAC for FEXTOR_INPUT_BYTES, and headerless 16 kHz 16 bit mono PCM for
+// FEXTOR_INPUT_PCM. If output path is given,
+// server writes feature there and response has no data. Otherwise data is
+// feature of `num_frame` x `feat_dim` values of `dtype`. If `status` is not
+// 0, data is error message. Values are in byte order of host.
+
+#define FEXTOR_PROTOCOL_VERSION 1
+
+#define FEXTOR_INPUT_PATH 1
+#define FEXTOR_INPUT_BYTES 2
+#define FEXTOR_INPUT_PCM 3
+
+// Requests larger than these are rejected, and connection is closed
+#define FEXTOR_MAX_PATH_SIZE 4096
+#define FEXTOR_MAX_INPUT_SIZE ((uint64_t)1 << 31)
+
+// Return values of socket functions below
+#define FEXTOR_SOCKET_SUCCESS 0
+#define FEXTOR_SOCKET_ERROR 1
+#define FEXTOR_SOCKET_CLOSED 2  // peer closed connection between messages
+
+typedef struct fextor_request_header_t {
+  char magic[4];          // "FXRQ"
+  uint32_t version;
+  uint32_t input_type;    // FEXTOR_INPUT_*
+  int32_t target;         // FEXTOR_TARGET_*
+  uint64_t input_size;    // in bytes
+  uint64_t output_size;   // in bytes, 0 to get feature in response
+} FextorRequestHeader;
+
+typedef struct fextor_response_header_t {
+  char magic[4];          // "FXRS"
+  int32_t status;         // 0 on success
+  uint32_t num_frame;
+  uint32_t feat_dim;
+  uint32_t dtype;         // FEXTOR_DTYPE_* of data
+  uint32_t compute_usec;  // time taken by server, excluding transfer
+  uint64_t data_size;     // in bytes
+} FextorResponseHeader;
+
+typedef struct fextor_request_t {
+  unsigned int input_type;
+  int target;
+  std::string input;      // path or bytes of audio
+  std::string output;     // empty to get feature in response
+} FextorRequest;
+
+typedef struct fextor_response_t {
+  int status;
+  unsigned int num_frame;
+  unsigned int feat_dim;
+  unsigned int dtype;
+  unsigned int compute_usec;
+  std::vector<unsigned char> data;  // feature, or error message
+
+  fextor_response_t()
+    : status(0), num_frame(0), feat_dim(0), dtype(0), compute_usec(0) {}
+} FextorResponse;
+
+// Request of `input_file_name`. If `is_inline`, contents of file are sent
+// instead of its path, as headerless PCM if file is named `.pcm` or `.raw`.
+// Relative paths are made absolute, since server may
+// run in other directory. `output_file_name` can be NULL.
+int makeRequest(const char* input_file_name, const bool is_inline,
+                const int target, const char* output_file_name,
+                FextorRequest* request);
+
+// Send or receive exactly `size` bytes, retrying on short transfer
+int sendAll(const int fd, const void* data, const size_t size);
+int receiveAll(const int fd, void* data, const size_t size);
+
+int sendRequest(const int fd, const FextorRequest& request);
+int receiveRequest(const int fd, FextorRequest* request);
+
+// `data` is sent as it is, so that feature is not copied
+int sendResponse(const int fd, const FextorResponseHeader& header,
+                 const void* data);
+int receiveResponse(const int fd, FextorResponse* response);
+
+// Connection to `fextor --serve`, used by one thread at a time
+class FextorClient {
+public:
+  FextorClient();
+  virtual ~FextorClient();
+
+private:
+  int fd_;
+
+public:
+  int connect(const char* socket_path);
+  void close();
+
+  // Returns non-zero if connection is broken. Failure of extraction is
+  // reported by `status` of response instead.
+  int extract(const FextorRequest& request, FextorResponse* response);
+}; // class FextorClient
+
+#endif // FEXTOR_PROTOCOL_H
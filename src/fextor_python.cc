@@ -0,0 +1,444 @@
+// Python module `fextor`, extracting features of samples in memory.
+//
+//   import fextor
+//   extractor = fextor.Extractor(target=fextor.TARGET_MFCC, num_threads=4)
+//   feat = extractor.extract(samples)            # (num_frame, feat_dim)
+//   feats = extractor.extract_batch([a, b, c])   # list of features
+//
+// Samples are 1-D int16 or float32 objects supporting buffer protocol, such
+// as numpy arrays, and are read without copying. Features are float32
+// buffers of shape (num_frame, feat_dim), returned as numpy arrays viewing
+// them without copying if numpy is installed. GIL is released while frames
+// are extracted by workers of pool.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string.h>
+
+#include <new>
+#include <vector>
+
+#include "fextor_c_api.h"
+#include "parallel/task.h"
+#include "parallel/threadpool.h"
+#include "parallel/worker_local.h"
+
+// Frames extracted by one task, so that long input is spread over workers
+#define FEXTOR_PYTHON_TASK_FRAMES 1000
+
+// `numpy.asarray`, NULL if numpy is not installed
+static PyObject* g_asarray = NULL;
+
+// Handle of C API owned by each worker of pool
+typedef struct worker_extractor_t {
+  fextor_extractor_t* handle;
+
+  worker_extractor_t() : handle(NULL) {}
+  ~worker_extractor_t() { fextor_destroy(handle); }
+} WorkerExtractor;
+
+typedef struct {
+  PyObject_HEAD
+  float* data;
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+} FeatureObject;
+
+typedef struct {
+  PyObject_HEAD
+  fextor_param_t param;
+  int target;
+  uint32_t feat_dim;
+  parallel::ThreadPool* pool;
+  parallel::WorkerLocal<WorkerExtractor>* extractors;
+} ExtractorObject;
+
+// Input samples held while GIL is released, and feature written from them
+typedef struct extract_job_t {
+  Py_buffer view;
+  bool is_int16;
+  size_t num_samples;
+  uint32_t num_frame;
+  FeatureObject* feat;
+} ExtractJob;
+
+// Feature
+
+static void feature_dealloc(FeatureObject* self) {
+  delete[] self->data;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int feature_getbuffer(FeatureObject* self, Py_buffer* view, int flags) {
+  view->buf = self->data;
+  view->obj = (PyObject*)self;
+  Py_INCREF(self);
+  view->len = self->shape[0] * self->shape[1] * (Py_ssize_t)sizeof(float);
+  view->readonly = 0;
+  view->itemsize = sizeof(float);
+  view->format = (flags & PyBUF_FORMAT) ? (char*)"f" : NULL;
+  view->ndim = 2;
+  view->shape = self->shape;
+  view->strides = self->strides;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+static PyBufferProcs feature_as_buffer = {
+  (getbufferproc)feature_getbuffer,
+  NULL,
+};
+
+static PyObject* feature_get_shape(FeatureObject* self, void*) {
+  return Py_BuildValue("(nn)", self->shape[0], self->shape[1]);
+}
+
+static PyGetSetDef feature_getset[] = {
+  {(char*)"shape", (getter)feature_get_shape, NULL,
+   (char*)"(num_frame, feat_dim)", NULL},
+  {NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyTypeObject FeatureType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "fextor.Feature",
+};
+
+static FeatureObject* new_feature(const uint32_t num_frame,
+                                  const uint32_t feat_dim) {
+  FeatureObject* self = PyObject_New(FeatureObject, &FeatureType);
+  if (self == NULL) {
+    return NULL;
+  }
+  const size_t size = (size_t)num_frame * feat_dim;
+  self->data = new (std::nothrow) float[(size > 0) ? size : 1];
+  self->shape[0] = num_frame;
+  self->shape[1] = feat_dim;
+  self->strides[0] = (Py_ssize_t)(feat_dim * sizeof(float));
+  self->strides[1] = sizeof(float);
+  if (self->data == NULL) {
+    Py_DECREF(self);
+    PyErr_NoMemory();
+    return NULL;
+  }
+  return self;
+}
+
+// numpy array viewing feature, or feature itself without numpy
+static PyObject* wrap_feature(FeatureObject* feat) {
+  if (g_asarray == NULL) {
+    return (PyObject*)feat;
+  }
+  PyObject* array = PyObject_CallFunctionObjArgs(g_asarray, (PyObject*)feat, NULL);
+  Py_DECREF(feat);
+  return array;
+}
+
+// Extractor
+
+static void extractor_dealloc(ExtractorObject* self) {
+  // Handles are destroyed before workers which own them
+  delete self->extractors;
+  delete self->pool;
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int extractor_init(ExtractorObject* self, PyObject* args,
+                          PyObject* kwargs) {
+  static const char* keywords[] = {
+    "target", "num_threads", "window_size", "step_size", "num_fft_point",
+    "num_mels", "num_mfcc", "min_hertz", "max_hertz", NULL,
+  };
+  // Parsed into locals, and kept only when extractor is made
+  fextor_param_t param;
+  fextor_get_default_param(16000, &param);
+  int target = FEXTOR_TARGET_MFCC;
+  unsigned int num_threads = 4;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iIIIIIIdd", (char**)keywords,
+                                   &target, &num_threads, &param.window_size,
+                                   &param.step_size, &param.num_fft_point,
+                                   &param.num_mels, &param.num_mfcc,
+                                   &param.min_hertz, &param.max_hertz)) {
+    return -1;
+  }
+  if (self->pool != NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "Extractor is already initialized");
+    return -1;
+  }
+  if (num_threads == 0) {
+    PyErr_SetString(PyExc_ValueError, "num_threads must be positive");
+    return -1;
+  }
+
+  // Parameters and target are checked by one handle before workers are made
+  fextor_extractor_t* handle = NULL;
+  uint32_t feat_dim = 0;
+  int error_code = fextor_create(&param, target, &handle);
+  if (error_code == FEXTOR_OK) {
+    fextor_get_output_shape(handle, 0, NULL, &feat_dim);
+    fextor_destroy(handle);
+  }
+  if (error_code != FEXTOR_OK) {
+    PyErr_SetString(PyExc_ValueError, fextor_get_error_string(error_code));
+    return -1;
+  }
+
+  parallel::ThreadPool* pool = NULL;
+  parallel::WorkerLocal<WorkerExtractor>* extractors = NULL;
+  Py_BEGIN_ALLOW_THREADS
+  pool = new parallel::ThreadPool(num_threads);
+  extractors = new parallel::WorkerLocal<WorkerExtractor>(
+      pool, [param, target](unsigned int) {
+    WorkerExtractor* extractor = new WorkerExtractor();
+    if (fextor_create(&param, target, &extractor->handle) != FEXTOR_OK) {
+      delete extractor;
+      return (WorkerExtractor*)NULL;
+    }
+    return extractor;
+  });
+  if (!extractors->isValid()) {
+    // Handles are destroyed before workers which own them
+    delete extractors;
+    delete pool;
+    extractors = NULL;
+    pool = NULL;
+  }
+  Py_END_ALLOW_THREADS
+  if (pool == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "failed to create extractors");
+    return -1;
+  }
+  self->param = param;
+  self->target = target;
+  self->feat_dim = feat_dim;
+  self->pool = pool;
+  self->extractors = extractors;
+  return 0;
+}
+
+// Get samples of `object`, and allocate its feature
+static int prepare_job(ExtractorObject* self, PyObject* object, ExtractJob* job) {
+  if (PyObject_GetBuffer(object, &job->view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+    return -1;
+  }
+  const char* format = (job->view.format != NULL) ? job->view.format : "B";
+  if (format[0] == '<' || format[0] == '=' || format[0] == '@') {
+    format++;
+  }
+  job->is_int16 = (strcmp(format, "h") == 0 && job->view.itemsize == 2);
+  const bool is_float = (strcmp(format, "f") == 0 && job->view.itemsize == 4);
+  if ((!job->is_int16 && !is_float) || job->view.ndim > 1) {
+    PyBuffer_Release(&job->view);
+    PyErr_SetString(PyExc_TypeError, "samples must be 1-D array of int16 or float32");
+    return -1;
+  }
+  job->num_samples = (size_t)(job->view.len / job->view.itemsize);
+
+  fextor_get_output_shape(self->extractors->get(0)->handle, job->num_samples,
+                          &job->num_frame, NULL);
+  job->feat = new_feature(job->num_frame, self->feat_dim);
+  if (job->feat == NULL) {
+    PyBuffer_Release(&job->view);
+    return -1;
+  }
+  return 0;
+}
+
+// Extract frames [begin, end) of job by extractor of running worker
+static int extract_frames(ExtractorObject* self, const ExtractJob* job,
+                          const uint32_t begin, const uint32_t end) {
+  fextor_extractor_t* handle = self->extractors->local()->handle;
+  const size_t offset = (size_t)begin * self->param.step_size;
+  // Samples of frames [begin, end) only, so that exactly those are extracted
+  const size_t num_samples = (size_t)(end - begin) * self->param.step_size +
+                             self->param.window_size;
+  float* dest = job->feat->data + (size_t)begin * self->feat_dim;
+  const size_t dest_size = (size_t)(end - begin) * self->feat_dim;
+  if (job->is_int16) {
+    return fextor_extract_int16(handle, (const int16_t*)job->view.buf + offset,
+                                num_samples, dest, dest_size, NULL, NULL);
+  }
+  return fextor_extract(handle, (const float*)job->view.buf + offset,
+                        num_samples, dest, dest_size, NULL, NULL);
+}
+
+// Extract all jobs by pool, and return list of features or NULL on failure.
+// Jobs are released here.
+static PyObject* run_jobs(ExtractorObject* self, std::vector<ExtractJob>* jobs) {
+  unsigned int num_failed;
+  Py_BEGIN_ALLOW_THREADS
+  parallel::TaskGroup group(self->pool);
+  for (auto& job : *jobs) {
+    for (uint32_t begin = 0; begin < job.num_frame; begin += FEXTOR_PYTHON_TASK_FRAMES) {
+      const uint32_t end = (job.num_frame - begin > FEXTOR_PYTHON_TASK_FRAMES) ?
+                           begin + FEXTOR_PYTHON_TASK_FRAMES : job.num_frame;
+      const ExtractJob* job_ptr = &job;
+      group.run([self, job_ptr, begin, end]() {
+        return extract_frames(self, job_ptr, begin, end);
+      });
+    }
+  }
+  group.wait();
+  num_failed = group.getNumFailed();
+  Py_END_ALLOW_THREADS
+
+  PyObject* list = (num_failed == 0) ? PyList_New(jobs->size()) : NULL;
+  for (size_t i = 0; i < jobs->size(); i++) {
+    ExtractJob& job = (*jobs)[i];
+    PyBuffer_Release(&job.view);
+    if (list == NULL) {
+      Py_DECREF(job.feat);
+      continue;
+    }
+    PyObject* feat = wrap_feature(job.feat);
+    if (feat == NULL) {
+      Py_CLEAR(list);
+      continue;
+    }
+    PyList_SET_ITEM(list, i, feat);
+  }
+  if (num_failed > 0) {
+    PyErr_SetString(PyExc_RuntimeError,
+                    fextor_get_error_string(FEXTOR_ERROR_EXTRACT));
+  }
+  return list;
+}
+
+static PyObject* extractor_extract(ExtractorObject* self, PyObject* args) {
+  PyObject* samples;
+  if (!PyArg_ParseTuple(args, "O", &samples)) {
+    return NULL;
+  }
+  if (self->pool == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "Extractor is not initialized");
+    return NULL;
+  }
+  std::vector<ExtractJob> jobs(1);
+  if (prepare_job(self, samples, &jobs[0]) != 0) {
+    return NULL;
+  }
+  PyObject* list = run_jobs(self, &jobs);
+  if (list == NULL) {
+    return NULL;
+  }
+  PyObject* feat = PyList_GET_ITEM(list, 0);
+  Py_INCREF(feat);
+  Py_DECREF(list);
+  return feat;
+}
+
+static PyObject* extractor_extract_batch(ExtractorObject* self, PyObject* args) {
+  PyObject* batch;
+  if (!PyArg_ParseTuple(args, "O", &batch)) {
+    return NULL;
+  }
+  if (self->pool == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "Extractor is not initialized");
+    return NULL;
+  }
+  PyObject* sequence = PySequence_Fast(batch, "batch must be sequence of samples");
+  if (sequence == NULL) {
+    return NULL;
+  }
+
+  const Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence);
+  std::vector<ExtractJob> jobs(size);
+  for (Py_ssize_t i = 0; i < size; i++) {
+    if (prepare_job(self, PySequence_Fast_GET_ITEM(sequence, i), &jobs[i]) != 0) {
+      for (Py_ssize_t j = 0; j < i; j++) {
+        PyBuffer_Release(&jobs[j].view);
+        Py_DECREF(jobs[j].feat);
+      }
+      Py_DECREF(sequence);
+      return NULL;
+    }
+  }
+  // Views of samples keep them alive, sequence is not needed any more
+  Py_DECREF(sequence);
+  return run_jobs(self, &jobs);
+}
+
+static PyObject* extractor_get_feat_dim(ExtractorObject* self, void*) {
+  return PyLong_FromUnsignedLong(self->feat_dim);
+}
+
+static PyObject* extractor_get_num_threads(ExtractorObject* self, void*) {
+  return PyLong_FromUnsignedLong((self->pool != NULL) ? self->pool->getNumThreads() : 0);
+}
+
+static PyMethodDef extractor_methods[] = {
+  {"extract", (PyCFunction)extractor_extract, METH_VARARGS,
+   "extract(samples) -> feature of shape (num_frame, feat_dim)"},
+  {"extract_batch", (PyCFunction)extractor_extract_batch, METH_VARARGS,
+   "extract_batch(list of samples) -> list of features, extracted at once"},
+  {NULL, NULL, 0, NULL},
+};
+
+static PyGetSetDef extractor_getset[] = {
+  {(char*)"feat_dim", (getter)extractor_get_feat_dim, NULL,
+   (char*)"dimension of feature", NULL},
+  {(char*)"num_threads", (getter)extractor_get_num_threads, NULL,
+   (char*)"number of workers of pool", NULL},
+  {NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyTypeObject ExtractorType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "fextor.Extractor",
+};
+
+// Module
+
+static struct PyModuleDef fextor_module = {
+  PyModuleDef_HEAD_INIT,
+  "fextor",
+  "Feature extraction of fextor",
+  -1,
+  NULL,
+};
+
+PyMODINIT_FUNC PyInit_fextor(void) {
+  FeatureType.tp_basicsize = sizeof(FeatureObject);
+  FeatureType.tp_dealloc = (destructor)feature_dealloc;
+  FeatureType.tp_as_buffer = &feature_as_buffer;
+  FeatureType.tp_flags = Py_TPFLAGS_DEFAULT;
+  FeatureType.tp_doc = "Feature of float32 values, supporting buffer protocol";
+  FeatureType.tp_getset = feature_getset;
+
+  ExtractorType.tp_basicsize = sizeof(ExtractorObject);
+  ExtractorType.tp_dealloc = (destructor)extractor_dealloc;
+  ExtractorType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ExtractorType.tp_doc = "Extractor(target=TARGET_MFCC, num_threads=4, "
+                         "window_size=320, step_size=160, num_fft_point=512, "
+                         "num_mels=80, num_mfcc=40, min_hertz=0, max_hertz=8000)";
+  ExtractorType.tp_methods = extractor_methods;
+  ExtractorType.tp_getset = extractor_getset;
+  ExtractorType.tp_init = (initproc)extractor_init;
+  ExtractorType.tp_new = PyType_GenericNew;
+
+  if (PyType_Ready(&FeatureType) < 0 || PyType_Ready(&ExtractorType) < 0) {
+    return NULL;
+  }
+  PyObject* module = PyModule_Create(&fextor_module);
+  if (module == NULL) {
+    return NULL;
+  }
+  Py_INCREF(&FeatureType);
+  Py_INCREF(&ExtractorType);
+  PyModule_AddObject(module, "Feature", (PyObject*)&FeatureType);
+  PyModule_AddObject(module, "Extractor", (PyObject*)&ExtractorType);
+  PyModule_AddIntConstant(module, "TARGET_SPECTRUM", FEXTOR_TARGET_SPECTRUM);
+  PyModule_AddIntConstant(module, "TARGET_MEL", FEXTOR_TARGET_MEL);
+  PyModule_AddIntConstant(module, "TARGET_MFCC", FEXTOR_TARGET_MFCC);
+
+  // numpy is optional, features are still usable by buffer protocol
+  PyObject* numpy = PyImport_ImportModule("numpy");
+  if (numpy != NULL) {
+    g_asarray = PyObject_GetAttrString(numpy, "asarray");
+    Py_DECREF(numpy);
+  }
+  PyErr_Clear();
+  return module;
+}
@@ -0,0 +1,129 @@
+"""Test of python module `fextor`, compared with features written by `fextor`.
+
+$ python src/fextor_python_test.py --bin_dir build/bin --lib_dir build/lib
+"""
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import wave
+
+import numpy as np
+
+TARGETS = {0: "spectrum", 1: "mel", 2: "mfcc"}
+
+def make_samples(num_samples, seed):
+  """Tone with deterministic noise, as int16 samples."""
+  t = np.arange(num_samples) / 16000.0
+  rng = np.random.RandomState(seed)
+  x = 0.3 * np.sin(2 * np.pi * (220 + 110 * seed) * t) + 0.01 * rng.randn(num_samples)
+  return np.round(x * 32767).astype(np.int16)
+
+def write_wave(filename, samples):
+  with wave.open(filename, 'wb') as f:
+    f.setnchannels(1)
+    f.setsampwidth(2)
+    f.setframerate(16000)
+    f.writeframes(samples.tobytes())
+
+def run_fextor(bin_dir, input_name, output_name, target):
+  """Feature of `fextor` in float32, which is type of module."""
+  subprocess.check_call([os.path.join(bin_dir, "fextor"), "--input", input_name,
+                         "--output", output_name, "--target", str(target)],
+                        stdout=subprocess.DEVNULL)
+  return np.load(output_name).astype(np.float32)
+
+def check(name, is_ok):
+  print("{:<24s}: {}".format(name, "ok" if is_ok else "FAILED"))
+  return 0 if is_ok else 1
+
+def is_zero_copy(feat, module):
+  """Feature is numpy array viewing buffer of `fextor.Feature`."""
+  base = feat.base.obj if isinstance(feat.base, memoryview) else feat.base
+  return (isinstance(feat, np.ndarray) and not feat.flags.owndata and
+          isinstance(base, module.Feature) and feat.dtype == np.float32 and
+          feat.flags.c_contiguous)
+
+def test_target(module, bin_dir, work_dir, target, samples_list):
+  name = TARGETS[target]
+  extractor = module.Extractor(target=target, num_threads=2)
+  error_code = 0
+  expected = []
+  for i, samples in enumerate(samples_list):
+    wav_name = os.path.join(work_dir, "{}.wav".format(i))
+    write_wave(wav_name, samples)
+    expected.append(run_fextor(bin_dir, wav_name, os.path.join(
+        work_dir, "{}_{}.npy".format(i, name)), target))
+
+  # Long input is extracted by several tasks
+  feats = [extractor.extract(samples) for samples in samples_list]
+  error_code |= check(name + " int16", all(
+      np.array_equal(f, e) for f, e in zip(feats, expected)))
+  error_code |= check(name + " zero copy", all(is_zero_copy(f, module) for f in feats) and
+                      extractor.feat_dim == expected[0].shape[1])
+  feats = [extractor.extract(samples.astype(np.float32) / 32768) for samples in samples_list]
+  error_code |= check(name + " float32", all(
+      np.array_equal(f, e) for f, e in zip(feats, expected)))
+  feats = extractor.extract_batch(samples_list)
+  error_code |= check(name + " batch", len(feats) == len(expected) and all(
+      np.array_equal(f, e) for f, e in zip(feats, expected)))
+  return error_code
+
+def test_invalid(module):
+  extractor = module.Extractor(num_threads=1)
+  samples = make_samples(16000, 0)
+  is_ok = True
+  # Strided, 2-D, and int32 samples are rejected
+  for invalid in (samples[::2], samples.reshape(2, -1), samples.astype(np.int32)):
+    try:
+      extractor.extract(invalid)
+      is_ok = False
+    except (TypeError, ValueError):
+      pass
+  try:
+    extractor.extract_batch([samples, samples.astype(np.float64)])
+    is_ok = False
+  except TypeError:
+    pass
+  # Samples shorter than a window have no frame
+  feat = extractor.extract(samples[:100])
+  is_ok = is_ok and feat.shape == (0, extractor.feat_dim)
+  # Initialized extractor is kept by second initialization
+  feat_dim = extractor.feat_dim
+  try:
+    extractor.__init__(target=1, num_mels=7)
+    is_ok = False
+  except RuntimeError:
+    pass
+  is_ok = is_ok and extractor.feat_dim == feat_dim and \
+      extractor.extract(samples).shape[1] == feat_dim
+  return check("invalid input", is_ok)
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('--bin_dir', default='build/bin', help='directory of fextor')
+  parser.add_argument('--lib_dir', default='build/lib', help='directory of module')
+  args = parser.parse_args()
+
+  sys.path.insert(0, args.lib_dir)
+  import fextor
+
+  work_dir = tempfile.mkdtemp(prefix="fextor_python_test_")
+  try:
+    # Lengths around a task of 1000 frames
+    samples_list = [make_samples(n, i) for i, n in enumerate(
+        [16000, 160 * 1000 + 320, 160 * 1001 + 320, 160 * 2500 + 123])]
+    error_code = 0
+    for target in sorted(TARGETS):
+      error_code |= test_target(fextor, args.bin_dir, work_dir, target, samples_list)
+    error_code |= test_invalid(fextor)
+  finally:
+    shutil.rmtree(work_dir)
+
+  print("PASSED" if error_code == 0 else "FAILED")
+  return error_code
+
+if __name__ == '__main__':
+  sys.exit(main())
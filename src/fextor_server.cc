@@ -0,0 +1,237 @@
+#include "fextor_server.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "wave/wave.h"
+
+FextorServer::FextorServer()
+  : pool_(NULL)
+  , listen_fd_(-1)
+  , is_stopped_(false)
+  , num_requests_(0)
+  , num_failed_(0) {
+
+}
+
+FextorServer::~FextorServer() {
+  stop();
+  joinConnections(false);
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(socket_path_.c_str());
+  }
+}
+
+int FextorServer::init(const dsp::FEInitParam* param,
+                       parallel::ThreadPool* pool,
+                       const FeatureFormat* format) {
+  if (param == NULL) {
+    fprintf(stderr, "FextorServer::init() - invalid argument.\n");
+    return 1;
+  }
+  param_ = *param;
+  pool_ = pool;
+  if (format != NULL) {
+    format_ = *format;
+  }
+  if (extractor_.init(&param_) != DSP_SUCCESS) {
+    fprintf(stderr, "FextorServer::init() - failed to init extractor.\n");
+    return 1;
+  }
+  return 0;
+}
+
+int FextorServer::listen(const char* socket_path) {
+  struct sockaddr_un address;
+  if (socket_path == NULL || strlen(socket_path) >= sizeof(address.sun_path) ||
+      listen_fd_ >= 0) {
+    fprintf(stderr, "FextorServer::listen() - invalid path of socket or already listening.\n");
+    return 1;
+  }
+
+  // Socket file left by server which was killed is replaced, but other
+  // files are not
+  struct stat status;
+  if (stat(socket_path, &status) == 0) {
+    if (!S_ISSOCK(status.st_mode)) {
+      fprintf(stderr, "FextorServer::listen() - file exists : %s\n", socket_path);
+      return 1;
+    }
+    unlink(socket_path);
+  }
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    fprintf(stderr, "FextorServer::listen() - failed to create socket : %s\n",
+            strerror(errno));
+    return 1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+  if (bind(listen_fd_, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+      ::listen(listen_fd_, SOMAXCONN) != 0) {
+    fprintf(stderr, "FextorServer::listen() - failed to listen %s : %s\n",
+            socket_path, strerror(errno));
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return 1;
+  }
+  socket_path_ = socket_path;
+  return 0;
+}
+
+int FextorServer::run() {
+  if (listen_fd_ < 0) {
+    fprintf(stderr, "FextorServer::run() - server is not listening.\n");
+    return 1;
+  }
+
+  struct pollfd poll_fd;
+  poll_fd.fd = listen_fd_;
+  poll_fd.events = POLLIN;
+  while (!is_stopped_) {
+    // Wait with timeout, so that stop is noticed without connection
+    const int ret = poll(&poll_fd, 1, FEXTOR_SERVER_POLL_MSEC);
+    if (ret <= 0) {
+      if (ret < 0 && errno != EINTR) {
+        fprintf(stderr, "FextorServer::run() - failed to wait connection : %s\n",
+                strerror(errno));
+        break;
+      }
+      joinConnections(true);
+      continue;
+    }
+
+    const int fd = accept(listen_fd_, NULL, NULL);
+    if (fd < 0) {
+      if (errno != EINTR && errno != ECONNABORTED) {
+        fprintf(stderr, "FextorServer::run() - failed to accept : %s\n",
+                strerror(errno));
+      }
+      continue;
+    }
+    Connection* connection = new Connection();
+    connection->fd = fd;
+    connection->is_finished = false;
+    connection->thread = std::thread([this, connection]() {
+      serveConnection(connection);
+    });
+    connections_.push_back(connection);
+    joinConnections(true);
+  }
+
+  joinConnections(false);
+  return 0;
+}
+
+void FextorServer::joinConnections(const bool finished_only) {
+  for (auto it = connections_.begin(); it != connections_.end();) {
+    Connection* connection = *it;
+    if (finished_only && !connection->is_finished) {
+      it++;
+      continue;
+    }
+    // Wake up thread waiting for next request of idle client
+    shutdown(connection->fd, SHUT_RDWR);
+    connection->thread.join();
+    close(connection->fd);
+    delete connection;
+    it = connections_.erase(it);
+  }
+}
+
+void FextorServer::serveConnection(Connection* connection) {
+  FextorRequest request;
+  while (!is_stopped_) {
+    int ret = receiveRequest(connection->fd, &request);
+    if (ret != FEXTOR_SOCKET_SUCCESS) {
+      break;
+    }
+    num_requests_++;
+    if (handleRequest(connection->fd, request) != 0) {
+      break;
+    }
+  }
+  connection->is_finished = true;
+}
+
+// Returns non-zero only if response can not be sent. Failure of extraction
+// is sent to client.
+int FextorServer::handleRequest(const int fd, const FextorRequest& request) {
+  const auto start = std::chrono::steady_clock::now();
+  FextorResponseHeader header;
+  memset(&header, 0, sizeof(header));
+  std::string message;
+  Feature feat;
+
+  dsp::float_t* wav = NULL;
+  unsigned int wav_length = 0;
+  wave::WaveReader wav_reader;
+  wav_reader.init(FEXTOR_SAMPLING_RATE, FEXTOR_BIT_RATE, FEXTOR_NUM_CHANNELS);
+  int error_code = 0;
+  if (getFeatureDim(&param_, request.target) == 0) {
+    message = "invalid target";
+  } else if (request.input_type == FEXTOR_INPUT_PATH) {
+    error_code = wav_reader.read(request.input.c_str(), &wav, &wav_length);
+    if (error_code != WAVE_SUCCESS) {
+      message = "failed to read file : " + request.input;
+    }
+  } else if (request.input_type == FEXTOR_INPUT_BYTES) {
+    error_code = wav_reader.read((const unsigned char*)request.input.data(),
+                                 request.input.size(), &wav, &wav_length);
+    if (error_code != WAVE_SUCCESS) {
+      message = "failed to decode input";
+    }
+  } else if (request.input_type == FEXTOR_INPUT_PCM) {
+    error_code = wav_reader.readPcm((const unsigned char*)request.input.data(),
+                                    request.input.size(), &wav, &wav_length);
+    if (error_code != WAVE_SUCCESS) {
+      message = "failed to decode input";
+    }
+  } else {
+    message = "invalid type of input";
+  }
+
+  if (message.empty()) {
+    error_code = computeFeature(wav, wav_length, &param_, &extractor_,
+                                request.target, &feat, pool_);
+    if (error_code != 0) {
+      message = "failed to extract feature";
+    } else if (!request.output.empty() &&
+               feat.save(request.output.c_str(), &format_) != 0) {
+      message = "failed to save feature : " + request.output;
+    }
+  }
+  delete[] wav;
+
+  const void* data = NULL;
+  if (!message.empty()) {
+    num_failed_++;
+    header.status = (error_code != 0) ? error_code : 1;
+    header.data_size = message.size();
+    data = message.data();
+  } else {
+    header.num_frame = feat.getNumFrame();
+    header.feat_dim = feat.getFeatDim();
+    header.dtype = FEXTOR_DTYPE_NATIVE;
+    if (request.output.empty()) {
+      header.data_size = (uint64_t)feat.getNumFrame() * feat.getFeatDim() *
+                         sizeof(dsp::float_t);
+      data = feat.getData();
+    }
+  }
+  header.compute_usec = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+  return (sendResponse(fd, header, data) == FEXTOR_SOCKET_SUCCESS) ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#ifndef FEXTOR_SERVER_H
+#define FEXTOR_SERVER_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "dsp/feature_extractor.h"
+#include "parallel/threadpool.h"
+#include "fextor_app.h"
+#include "fextor_protocol.h"
+
+// Interval to check whether server is stopped while waiting for connections
+#define FEXTOR_SERVER_POLL_MSEC 200
+
+// Serve requests of `FextorClient` on UNIX domain socket. Extractor is
+// initialized once, and frames of every request are extracted by workers of
+// pool, so that a request costs about its extraction only. Each connection
+// is read by its own thread, and requests of different connections are
+// extracted at once.
+class FextorServer {
+public:
+  FextorServer();
+  virtual ~FextorServer();
+
+private:
+  typedef struct connection_t {
+    int fd;
+    std::thread thread;
+    std::atomic<bool> is_finished;
+  } Connection;
+
+  dsp::FEInitParam param_;
+  dsp::FeatureExtractor extractor_;  // shared by all threads, read only
+  parallel::ThreadPool* pool_;
+  FeatureFormat format_;             // format of features written by server
+
+  int listen_fd_;
+  std::string socket_path_;
+  std::atomic<bool> is_stopped_;
+  std::list<Connection*> connections_;
+
+  std::atomic<unsigned int> num_requests_;
+  std::atomic<unsigned int> num_failed_;
+
+  void serveConnection(Connection* connection);
+  int handleRequest(const int fd, const FextorRequest& request);
+  void joinConnections(const bool finished_only);
+
+public:
+  int init(const dsp::FEInitParam* param, parallel::ThreadPool* pool,
+           const FeatureFormat* format = NULL);
+
+  // Bind socket at `socket_path`, replacing stale socket file
+  int listen(const char* socket_path);
+
+  // Accept connections until `stop()` is called, then close all of them
+  int run();
+
+  // Only sets flag, so that it can be called by signal handler
+  void stop() { is_stopped_ = true; }
+
+  unsigned int getNumRequests() const { return num_requests_; }
+  unsigned int getNumFailed() const { return num_failed_; }
+}; // class FextorServer
+
+#endif // FEXTOR_SERVER_H
@@ -0,0 +1,111 @@
+#include "parallel/job_deque.h"
+
+namespace parallel {
+
+JobDeque::JobDeque(const size_t capacity)
+    : top_(0)
+    , bottom_(0) {
+
+  size_t size = 16;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  buffer_.store(allocBuffer(size), std::memory_order_relaxed);
+}
+
+JobDeque::~JobDeque() {
+  freeBuffer(buffer_.load(std::memory_order_relaxed));
+  for (auto buffer : retired_) {
+    freeBuffer(buffer);
+  }
+  retired_.clear();
+}
+
+JobDeque::Buffer *JobDeque::allocBuffer(const size_t capacity) {
+  Buffer *buffer = new Buffer;
+  buffer->mask = capacity - 1;
+  buffer->jobs = new std::atomic<job_t*>[capacity];
+  return buffer;
+}
+
+void JobDeque::freeBuffer(Buffer *buffer) {
+  if (buffer != NULL) {
+    delete[] buffer->jobs;
+    delete buffer;
+  }
+}
+
+JobDeque::Buffer *JobDeque::grow(Buffer *buffer, const int64_t top,
+                                 const int64_t bottom) {
+  Buffer *new_buffer = allocBuffer((buffer->mask + 1) << 1);
+  for (int64_t i = top; i < bottom; i++) {
+    new_buffer->jobs[i & new_buffer->mask].store(
+        buffer->jobs[i & buffer->mask].load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+  }
+  retired_.push_back(buffer);
+  buffer_.store(new_buffer, std::memory_order_release);
+  return new_buffer;
+}
+
+void JobDeque::push(job_t *job) {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  const int64_t top = top_.load(std::memory_order_acquire);
+  Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+  if (bottom - top > (int64_t)buffer->mask) {
+    buffer = grow(buffer, top, bottom);
+  }
+  buffer->jobs[bottom & buffer->mask].store(job, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+}
+
+job_t *JobDeque::pop() {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = top_.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    // empty
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return NULL;
+  }
+
+  job_t *job = buffer->jobs[bottom & buffer->mask].load(std::memory_order_relaxed);
+  if (top == bottom) {
+    // last job, race with thieves
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      job = NULL;
+    }
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+job_t *JobDeque::steal() {
+  int64_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return NULL;
+  }
+
+  Buffer *buffer = buffer_.load(std::memory_order_acquire);
+  job_t *job = buffer->jobs[top & buffer->mask].load(std::memory_order_relaxed);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return NULL;
+  }
+  return job;
+}
+
+size_t JobDeque::size() const {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  const int64_t top = top_.load(std::memory_order_relaxed);
+  return (bottom > top) ? (size_t)(bottom - top) : 0;
+}
+
+} // namespace parallel
@@ -0,0 +1,59 @@
+#ifndef PARALLEL_JOB_DEQUE_H
+#define PARALLEL_JOB_DEQUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+namespace parallel {
+
+struct job_t;
+
+// Lock-free work-stealing deque of jobs (Chase-Lev).
+// Only owner thread calls `push()` and `pop()` at bottom, which is LIFO and
+// keeps recently spawned jobs in cache. Any other thread calls `steal()` at
+// top, which takes the oldest job.
+class JobDeque {
+public:
+  JobDeque(const size_t capacity = 256);
+  virtual ~JobDeque();
+
+private:
+  typedef struct buffer_t {
+    size_t mask;  // capacity - 1, capacity is power of 2
+    std::atomic<job_t*> *jobs;
+  } Buffer;
+
+  // Indices are padded into different cache lines, since `top_` is written
+  // by thieves while `bottom_` is written by owner.
+  std::atomic<int64_t> top_;
+  char pad_top_[64 - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t> bottom_;
+  char pad_bottom_[64 - sizeof(std::atomic<int64_t>)];
+  std::atomic<Buffer*> buffer_;
+
+  // Buffers replaced by `grow()`. Thieves may still read them, so they are
+  // released in destructor only.
+  std::vector<Buffer*> retired_;
+
+  static Buffer *allocBuffer(const size_t capacity);
+  static void freeBuffer(Buffer *buffer);
+  Buffer *grow(Buffer *buffer, const int64_t top, const int64_t bottom);
+
+public:
+  // Owner only
+  void push(job_t *job);
+  job_t *pop();
+
+  // Any thread. Returns NULL if empty or lost race with other thread.
+  job_t *steal();
+
+  // Approximate number of jobs
+  size_t size() const;
+}; // class JobDeque
+
+} // namespace parallel
+
+#endif // PARALLEL_JOB_DEQUE_H
@@ -0,0 +1,99 @@
+#include "parallel/job_queue.h"
+
+#include <stdint.h>
+
+#include "parallel/threadpool.h"
+
+namespace parallel {
+
+JobQueue::JobQueue(const size_t capacity)
+    : enqueue_pos_(0)
+    , dequeue_pos_(0) {
+
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  mask_ = size - 1;
+
+  cells_ = new Cell[size];
+  for (size_t i = 0; i < size; i++) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+    cells_[i].function = NULL;
+    cells_[i].arg = NULL;
+  }
+}
+
+JobQueue::~JobQueue() {
+  // Release pre-allocated memory
+  if (cells_ != NULL) {
+    delete[] cells_;
+    cells_ = NULL;
+  }
+}
+
+bool JobQueue::push(void (*function)(void *), void *arg) {
+  Cell *cell;
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // full
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->function = function;
+  cell->arg = arg;
+#ifdef PARALLEL_ENABLE_STATS
+  cell->enqueue_nsec = getTimeNsec();
+#endif
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool JobQueue::pop(job_t *job) {
+  Cell *cell;
+  size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    cell = &cells_[pos & mask_];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // empty
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  job->function_ = cell->function;
+  job->arg_ = cell->arg;
+#ifdef PARALLEL_ENABLE_STATS
+  job->enqueue_nsec_ = cell->enqueue_nsec;
+#endif
+  cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+  return true;
+}
+
+size_t JobQueue::size() const {
+  const size_t enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+  const size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+  return (enqueue_pos > dequeue_pos) ? (enqueue_pos - dequeue_pos) : 0;
+}
+
+} // namespace parallel
@@ -0,0 +1,56 @@
+#ifndef PARALLEL_JOB_QUEUE_H
+#define PARALLEL_JOB_QUEUE_H
+
+#include <stddef.h>
+
+#include <atomic>
+
+namespace parallel {
+
+struct job_t;
+
+// Bounded lock-free multi-producer multi-consumer queue of jobs (Vyukov).
+// Slots are allocated once at construction and jobs are stored by value, so
+// that no memory is allocated per job.
+class JobQueue {
+public:
+  JobQueue(const size_t capacity);
+  virtual ~JobQueue();
+
+private:
+  typedef struct cell_t {
+    std::atomic<size_t> sequence;
+    void (*function)(void *);
+    void *arg;
+#ifdef PARALLEL_ENABLE_STATS
+    unsigned long enqueue_nsec;
+#endif
+  } Cell;
+
+  Cell *cells_;
+  size_t mask_;  // capacity - 1, capacity is power of 2
+
+  // Positions are padded into different cache lines, since they are written
+  // by producers and consumers respectively.
+  char pad_cells_[64];
+  std::atomic<size_t> enqueue_pos_;
+  char pad_enqueue_[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeue_pos_;
+  char pad_dequeue_[64 - sizeof(std::atomic<size_t>)];
+
+public:
+  // Returns false if queue is full
+  bool push(void (*function)(void *), void *arg);
+
+  // Returns false if queue is empty
+  bool pop(job_t *job);
+
+  size_t getCapacity() const { return mask_ + 1; }
+
+  // Approximate number of jobs
+  size_t size() const;
+}; // class JobQueue
+
+} // namespace parallel
+
+#endif // PARALLEL_JOB_QUEUE_H
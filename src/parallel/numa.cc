@@ -0,0 +1,195 @@
+#include "parallel/numa.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
+
+// Memory policy of mbind(2), defined here to avoid dependency on libnuma
+#ifndef PARALLEL_MPOL_PREFERRED
+#define PARALLEL_MPOL_PREFERRED 1
+#endif
+
+namespace parallel {
+
+// Parse CPU list of sysfs (e.g. "0-3,8-11")
+static std::vector<int> parse_cpu_list(const char *text) {
+  std::vector<int> cpus;
+  const char *p = text;
+  while (*p != '\0' && *p != '\n') {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; cpu++) {
+      cpus.push_back((int)cpu);
+    }
+    if (*p == ',') {
+      p++;
+    }
+  }
+  return cpus;
+}
+
+static bool read_node_cpus(const int node, std::vector<int> *cpus) {
+  char path[128];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return false;
+  }
+  char text[4096];
+  bool is_read = (fgets(text, sizeof(text), fp) != NULL);
+  fclose(fp);
+  if (!is_read) {
+    return false;
+  }
+  (*cpus) = parse_cpu_list(text);
+  return true;
+}
+
+// CPUs usable by this process
+static std::vector<int> get_allowed_cpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < num_cpus; cpu++) {
+      cpus.push_back((int)cpu);
+    }
+  }
+  return cpus;
+}
+
+static NumaTopology read_topology() {
+  NumaTopology topology;
+  std::vector<int> allowed = get_allowed_cpus();
+  int max_cpu = 0;
+  for (auto cpu : allowed) {
+    max_cpu = (cpu > max_cpu) ? cpu : max_cpu;
+  }
+  topology.cpu_nodes.assign(max_cpu + 1, -1);
+  std::vector<bool> is_allowed(max_cpu + 1, false);
+  for (auto cpu : allowed) {
+    is_allowed[cpu] = true;
+  }
+
+  // Nodes are numbered contiguously in practice, stop at first missing one
+  std::vector<int> cpus;
+  for (int node = 0; read_node_cpus(node, &cpus); node++) {
+    std::vector<int> node_cpus;
+    for (auto cpu : cpus) {
+      if (cpu <= max_cpu && is_allowed[cpu]) {
+        node_cpus.push_back(cpu);
+        topology.cpu_nodes[cpu] = node;
+      }
+    }
+    topology.node_cpus.push_back(node_cpus);
+  }
+
+  if (topology.node_cpus.empty()) {
+    topology.node_cpus.push_back(allowed);
+    for (auto cpu : allowed) {
+      topology.cpu_nodes[cpu] = 0;
+    }
+  }
+  return topology;
+}
+
+const NumaTopology &getNumaTopology() {
+  static const NumaTopology topology = read_topology();
+  return topology;
+}
+
+unsigned int getNumNumaNodes() {
+  return (unsigned int)getNumaTopology().node_cpus.size();
+}
+
+int getCurrentNumaNode() {
+#ifdef __linux__
+  const int cpu = sched_getcpu();
+  const NumaTopology &topology = getNumaTopology();
+  if (cpu >= 0 && cpu < (int)topology.cpu_nodes.size() &&
+      topology.cpu_nodes[cpu] >= 0) {
+    return topology.cpu_nodes[cpu];
+  }
+#endif
+  return 0;
+}
+
+int setCurrentThreadAffinity(const std::vector<int> &cpus) {
+#ifdef __linux__
+  if (cpus.empty()) {
+    return 1;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  return 1;
+#endif
+}
+
+void *allocOnNode(const size_t size, const int node) {
+  if (size == 0) {
+    return NULL;
+  }
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    return NULL;
+  }
+
+#if defined(__linux__) && defined(SYS_mbind)
+  if (node >= 0 && node < 64) {
+    // Failure is ignored, since first touch places pages as well
+    unsigned long node_mask = 1UL << node;
+    syscall(SYS_mbind, ptr, size, PARALLEL_MPOL_PREFERRED, &node_mask,
+            sizeof(node_mask) * 8, 0);
+  }
+#endif
+
+  // First touch by calling thread
+  const long page_size = sysconf(_SC_PAGESIZE);
+  for (size_t offset = 0; offset < size; offset += (size_t)page_size) {
+    ((volatile char *)ptr)[offset] = 0;
+  }
+  return ptr;
+}
+
+void freeOnNode(void *ptr, const size_t size) {
+  if (ptr != NULL && size > 0) {
+    munmap(ptr, size);
+  }
+}
+
+} // namespace parallel
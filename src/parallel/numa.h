@@ -0,0 +1,38 @@
+#ifndef PARALLEL_NUMA_H
+#define PARALLEL_NUMA_H
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace parallel {
+
+// Topology of CPUs, read from /sys/devices/system/node. If NUMA information
+// is not available, all CPUs usable by this process belong to node 0.
+typedef struct numa_topology_t {
+  std::vector<std::vector<int>> node_cpus;  // CPUs of each node
+  std::vector<int> cpu_nodes;               // node of each CPU, -1 if unknown
+} NumaTopology;
+
+// Topology is read once and cached
+const NumaTopology &getNumaTopology();
+
+unsigned int getNumNumaNodes();
+
+// Node of CPU where calling thread is running, 0 if unknown
+int getCurrentNumaNode();
+
+// Pin calling thread to given CPUs. Returns 0 on success.
+int setCurrentThreadAffinity(const std::vector<int> &cpus);
+
+// Allocate memory placed on given node, or on node of calling thread if
+// `node` is negative. Pages are bound to the node if kernel supports it, and
+// touched by calling thread in any case, so that first-touch policy places
+// them locally. Returns NULL on failure. Used for large buffers of threads,
+// while small per-worker data rely on first touch by their worker.
+void *allocOnNode(const size_t size, const int node = -1);
+void freeOnNode(void *ptr, const size_t size);
+
+} // namespace parallel
+
+#endif // PARALLEL_NUMA_H
@@ -0,0 +1,105 @@
+#ifndef PARALLEL_PARALLEL_FOR_H
+#define PARALLEL_PARALLEL_FOR_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "parallel/task.h"
+#include "parallel/threadpool.h"
+
+// Number of chunks per thread when grain size is chosen automatically
+#ifndef PARALLEL_CHUNKS_PER_THREAD
+#define PARALLEL_CHUNKS_PER_THREAD 8
+#endif
+
+namespace parallel {
+
+// Grain size used if 0 is given, so that each thread gets several chunks
+inline size_t autoGrainSize(const ThreadPool *pool, const size_t length) {
+  const size_t num_threads = (pool != NULL) ? pool->getNumThreads() : 1;
+  const size_t grain = length / (num_threads * PARALLEL_CHUNKS_PER_THREAD);
+  return (grain > 0) ? grain : 1;
+}
+
+// Split [begin, end) in halves until it is smaller than grain. Upper halves
+// are spawned as tasks into deque of current worker, and stolen by idle
+// workers, so that busy workers keep splitting while the others balance load.
+template <typename F>
+void splitRange(ThreadPool *pool, TaskGroup *group, const size_t begin,
+                size_t end, const size_t grain, const F &function) {
+  while (end - begin > grain) {
+    const size_t middle = begin + (end - begin) / 2;
+    const size_t upper_end = end;
+    group->run([pool, group, middle, upper_end, grain, &function]() {
+      splitRange(pool, group, middle, upper_end, grain, function);
+    });
+    end = middle;
+  }
+  function(begin, end);
+}
+
+// Call `function(sub_begin, sub_end)` for sub-ranges covering [begin, end)
+// in parallel, and wait until all of them are finished. If `grain` is 0,
+// it is chosen from length of range and number of threads. Calling thread
+// also processes sub-ranges, and exception thrown by `function` is rethrown.
+template <typename F>
+void parallelFor(ThreadPool *pool, const size_t begin, const size_t end,
+                 size_t grain, const F &function) {
+  if (end <= begin) {
+    return;
+  }
+  if (grain == 0) {
+    grain = autoGrainSize(pool, end - begin);
+  }
+  if (pool == NULL || pool->getNumThreads() <= 1 || end - begin <= grain) {
+    function(begin, end);
+    return;
+  }
+
+  TaskGroup group(pool);
+  try {
+    splitRange(pool, &group, begin, end, grain, function);
+  } catch (...) {
+    group.wait();
+    throw;
+  }
+  group.wait();
+}
+
+// Reduce [begin, end) into single value. `function(sub_begin, sub_end)`
+// returns partial result of sub-range, and partial results are combined by
+// `reduce(a, b)` starting from `identity`. Range is divided into chunks of
+// `grain` regardless of scheduling, and partial results are combined in
+// order, so that result is deterministic even for floating point.
+template <typename T, typename F, typename R>
+T parallelReduce(ThreadPool *pool, const size_t begin, const size_t end,
+                 size_t grain, const T &identity, const F &function,
+                 const R &reduce) {
+  if (end <= begin) {
+    return identity;
+  }
+  if (grain == 0) {
+    grain = autoGrainSize(pool, end - begin);
+  }
+
+  const size_t num_chunks = (end - begin + grain - 1) / grain;
+  std::vector<T> partials(num_chunks, identity);
+  parallelFor(pool, 0, num_chunks, 1, [&](size_t chunk_begin, size_t chunk_end) {
+    for (size_t i = chunk_begin; i < chunk_end; i++) {
+      const size_t sub_begin = begin + i * grain;
+      const size_t sub_end = (sub_begin + grain < end) ? sub_begin + grain : end;
+      partials[i] = function(sub_begin, sub_end);
+    }
+  });
+
+  T result = identity;
+  for (size_t i = 0; i < num_chunks; i++) {
+    result = reduce(result, partials[i]);
+  }
+  return result;
+}
+
+} // namespace parallel
+
+#endif // PARALLEL_PARALLEL_FOR_H
@@ -0,0 +1,157 @@
+#include "parallel/pipeline.h"
+
+#include <chrono>
+
+namespace parallel {
+
+BoundedQueue::BoundedQueue(const size_t capacity)
+    : capacity_(capacity > 0 ? capacity : 1)
+    , is_closed_(false) {
+
+}
+
+bool BoundedQueue::push(void *item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_not_full_.wait(lock, [this]() {
+    return is_closed_ || items_.size() < capacity_;
+  });
+  if (is_closed_) {
+    return false;
+  }
+  items_.push_back(item);
+  cv_not_empty_.notify_one();
+  return true;
+}
+
+bool BoundedQueue::pop(void **item) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_not_empty_.wait(lock, [this]() { return is_closed_ || !items_.empty(); });
+  if (items_.empty()) {
+    return false;
+  }
+  (*item) = items_.front();
+  items_.pop_front();
+  cv_not_full_.notify_one();
+  return true;
+}
+
+void BoundedQueue::close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  is_closed_ = true;
+  cv_not_empty_.notify_all();
+  cv_not_full_.notify_all();
+}
+
+Pipeline::Pipeline(const size_t queue_capacity)
+    : queue_capacity_(queue_capacity)
+    , is_started_(false)
+    , is_finished_(false) {
+
+}
+
+Pipeline::~Pipeline() {
+  if (is_started_) {
+    finish();
+  }
+}
+
+int Pipeline::addStage(const std::string &name, const unsigned int num_threads,
+                       stage_function_t function, void *context) {
+  if (is_started_) {
+    fprintf(stderr, "Pipeline::addStage() - pipeline is already started.\n");
+    return 1;
+  }
+  if (function == NULL || num_threads == 0) {
+    fprintf(stderr, "Pipeline::addStage() - invalid argument.\n");
+    return 1;
+  }
+
+  Stage *stage = new Stage;
+  stage->name = name;
+  stage->num_threads = num_threads;
+  stage->function = function;
+  stage->context = context;
+  stage->input.reset(new BoundedQueue(queue_capacity_));
+  stage->num_running = 0;
+  stage->num_items = 0;
+  stage->busy_nsec = 0;
+  stages_.push_back(std::unique_ptr<Stage>(stage));
+  return 0;
+}
+
+int Pipeline::start() {
+  if (is_started_ || stages_.empty()) {
+    fprintf(stderr, "Pipeline::start() - no stage or already started.\n");
+    return 1;
+  }
+  is_started_ = true;
+
+  for (unsigned int s = 0; s < stages_.size(); s++) {
+    Stage *stage = stages_[s].get();
+    stage->num_running = stage->num_threads;
+    for (unsigned int t = 0; t < stage->num_threads; t++) {
+      stage->threads.push_back(std::thread(runStage, this, s, t));
+    }
+  }
+  return 0;
+}
+
+void Pipeline::runStage(Pipeline *pipeline, const unsigned int stage_index,
+                        const unsigned int thread_index) {
+  Stage *stage = pipeline->stages_[stage_index].get();
+  BoundedQueue *output = NULL;
+  if (stage_index + 1 < pipeline->stages_.size()) {
+    output = pipeline->stages_[stage_index + 1]->input.get();
+  }
+
+  void *item;
+  while (stage->input->pop(&item)) {
+    auto start = std::chrono::steady_clock::now();
+    void *result = stage->function(item, thread_index, stage->context);
+    stage->busy_nsec += (unsigned long)std::chrono::duration_cast<
+        std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    stage->num_items++;
+
+    if (output != NULL && result != NULL) {
+      output->push(result);
+    }
+  }
+
+  // Last thread of stage closes input of next stage
+  if (stage->num_running.fetch_sub(1) == 1 && output != NULL) {
+    output->close();
+  }
+}
+
+int Pipeline::push(void *item) {
+  if (!is_started_ || is_finished_) {
+    fprintf(stderr, "Pipeline::push() - pipeline is not running.\n");
+    return 1;
+  }
+  return stages_[0]->input->push(item) ? 0 : 1;
+}
+
+void Pipeline::finish() {
+  if (!is_started_ || is_finished_) {
+    return;
+  }
+  is_finished_ = true;
+
+  stages_[0]->input->close();
+  for (auto &stage : stages_) {
+    for (auto &thread : stage->threads) {
+      thread.join();
+    }
+  }
+}
+
+void Pipeline::report(FILE *fp) const {
+  for (auto &stage : stages_) {
+    const double busy_sec = stage->busy_nsec.load() * 1e-9;
+    fprintf(fp, "stage %-10s : %u threads, %lu items, busy %.3f sec "
+            "(%.3f sec per thread)\n", stage->name.c_str(), stage->num_threads,
+            stage->num_items.load(), busy_sec, busy_sec / stage->num_threads);
+  }
+}
+
+} // namespace parallel
@@ -0,0 +1,103 @@
+#ifndef PARALLEL_PIPELINE_H
+#define PARALLEL_PIPELINE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// Function of pipeline stage. Processes `item` and returns item passed to
+// next stage, or NULL to drop it. Stage dropping an item, as well as last
+// stage, is responsible for releasing it. `thread_index` is index of thread
+// in the stage, which can be used to select per-thread resources.
+typedef void *(*stage_function_t)(void *item, const unsigned int thread_index,
+                                  void *context);
+
+// Blocking queue of limited number of items
+class BoundedQueue {
+public:
+  BoundedQueue(const size_t capacity);
+  virtual ~BoundedQueue() {}
+
+private:
+  const size_t capacity_;
+  bool is_closed_;
+  std::deque<void *> items_;
+  std::mutex mutex_;
+  std::condition_variable cv_not_empty_;
+  std::condition_variable cv_not_full_;
+
+public:
+  // Blocks while queue is full. Returns false if queue is closed.
+  bool push(void *item);
+
+  // Blocks while queue is empty. Returns false if queue is closed and empty.
+  bool pop(void **item);
+
+  // No more items are pushed
+  void close();
+};
+
+// Items flow through stages in order. Each stage has its own threads, and
+// stages are connected by bounded queues, so that stages overlap each other
+// and a slow stage blocks the previous ones instead of piling up items.
+class Pipeline {
+public:
+  Pipeline(const size_t queue_capacity = 64);
+  virtual ~Pipeline();
+
+private:
+  typedef struct stage_t {
+    std::string name;
+    unsigned int num_threads;
+    stage_function_t function;
+    void *context;
+    std::unique_ptr<BoundedQueue> input;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> num_running;
+
+    // Statistics
+    std::atomic<unsigned long> num_items;
+    std::atomic<unsigned long> busy_nsec;
+  } Stage;
+
+  const size_t queue_capacity_;
+  std::vector<std::unique_ptr<Stage>> stages_;
+  bool is_started_;
+  bool is_finished_;
+
+  static void runStage(Pipeline *pipeline, const unsigned int stage_index,
+                       const unsigned int thread_index);
+
+public:
+  // Add stage processed by `num_threads` threads. Must be called before
+  // `start()`. Returns 0 on success.
+  int addStage(const std::string &name, const unsigned int num_threads,
+               stage_function_t function, void *context);
+
+  int start();
+
+  // Feed item into first stage. Blocks while queue of first stage is full.
+  // Returns 0 on success.
+  int push(void *item);
+
+  // Notify that no more items are pushed, and wait until all items pass
+  // through all stages
+  void finish();
+
+  // Write number of items and busy time of each stage
+  void report(FILE *fp) const;
+}; // class Pipeline
+
+} // namespace parallel
+
+#endif // PARALLEL_PIPELINE_H
@@ -0,0 +1,93 @@
+#include "parallel/pool_stats.h"
+
+namespace parallel {
+
+Histogram::Histogram() : count_(0), sum_(0), max_(0) {
+  for (int i = 0; i < PARALLEL_STATS_NUM_BUCKETS; i++) {
+    buckets_[i] = 0;
+  }
+}
+
+void Histogram::add(const unsigned long value) {
+  int bucket = 0;
+  for (unsigned long v = value; v > 0 && bucket < PARALLEL_STATS_NUM_BUCKETS - 1; v >>= 1) {
+    bucket++;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+
+  unsigned long max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+void Histogram::merge(const Histogram &other) {
+  for (int i = 0; i < PARALLEL_STATS_NUM_BUCKETS; i++) {
+    buckets_[i].fetch_add(other.buckets_[i].load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+  }
+  count_.fetch_add(other.getCount(), std::memory_order_relaxed);
+  sum_.fetch_add(other.sum_.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+  if (other.getMax() > getMax()) {
+    max_.store(other.getMax(), std::memory_order_relaxed);
+  }
+}
+
+double Histogram::getMean() const {
+  const unsigned long count = getCount();
+  if (count == 0) {
+    return 0;
+  }
+  return (double)sum_.load(std::memory_order_relaxed) / count;
+}
+
+unsigned long Histogram::getQuantile(const double quantile) const {
+  const unsigned long count = getCount();
+  if (count == 0) {
+    return 0;
+  }
+
+  const unsigned long rank = (unsigned long)(quantile * (count - 1)) + 1;
+  unsigned long num_values = 0;
+  for (int i = 0; i < PARALLEL_STATS_NUM_BUCKETS; i++) {
+    num_values += buckets_[i].load(std::memory_order_relaxed);
+    if (num_values >= rank) {
+      if (i == PARALLEL_STATS_NUM_BUCKETS - 1) {
+        return getMax();
+      }
+      const unsigned long upper = (i == 0) ? 0 : (1UL << i) - 1;
+      return (upper < getMax()) ? upper : getMax();
+    }
+  }
+  return getMax();
+}
+
+static void print_histogram(FILE *fp, const char *name, const Histogram &hist,
+                            const double scale, const char *unit) {
+  fprintf(fp, "%-12s : mean %10.3f, p50 %10.3f, p90 %10.3f, p99 %10.3f, "
+          "max %10.3f %s\n", name, hist.getMean() * scale,
+          hist.getQuantile(0.5) * scale, hist.getQuantile(0.9) * scale,
+          hist.getQuantile(0.99) * scale, hist.getMax() * scale, unit);
+}
+
+void printPoolStats(FILE *fp, const PoolStats &stats) {
+  fprintf(fp, "jobs         : %lu in %.3f sec\n", stats.run_nsec.getCount(),
+          stats.elapsed_nsec * 1e-9);
+  print_histogram(fp, "wait", stats.wait_nsec, 1e-3, "usec");
+  print_histogram(fp, "run", stats.run_nsec, 1e-3, "usec");
+  print_histogram(fp, "queue depth", stats.queue_depth, 1, "jobs");
+
+  for (size_t i = 0; i < stats.worker_busy_nsec.size(); i++) {
+    const unsigned long busy = stats.worker_busy_nsec[i];
+    const unsigned long idle =
+        (stats.elapsed_nsec > busy) ? stats.elapsed_nsec - busy : 0;
+    fprintf(fp, "worker %-5lu : busy %.3f sec, idle %.3f sec (%.1f%% busy)\n",
+            i, busy * 1e-9, idle * 1e-9,
+            (stats.elapsed_nsec > 0) ? 100.0 * busy / stats.elapsed_nsec : 0.0);
+  }
+}
+
+} // namespace parallel
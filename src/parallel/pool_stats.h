@@ -0,0 +1,84 @@
+#ifndef PARALLEL_POOL_STATS_H
+#define PARALLEL_POOL_STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Statistics of ThreadPool are collected only if PARALLEL_ENABLE_STATS is
+// defined. Otherwise no counter is kept and no clock is read per job.
+
+// Number of buckets of histogram. Bucket `i` counts values in
+// [2^(i-1), 2^i), and last bucket counts all larger values.
+#ifndef PARALLEL_STATS_NUM_BUCKETS
+#define PARALLEL_STATS_NUM_BUCKETS 48
+#endif
+
+namespace parallel {
+
+inline unsigned long getTimeNsec() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Histogram of values in power-of-2 buckets. Counters are atomic, so that it
+// can be read while another thread updates it.
+class Histogram {
+public:
+  Histogram();
+  virtual ~Histogram() {}
+
+private:
+  std::atomic<unsigned long> buckets_[PARALLEL_STATS_NUM_BUCKETS];
+  std::atomic<unsigned long> count_;
+  std::atomic<unsigned long> sum_;
+  std::atomic<unsigned long> max_;
+
+public:
+  void add(const unsigned long value);
+
+  // Add all values of `other` to this histogram
+  void merge(const Histogram &other);
+
+  unsigned long getCount() const { return count_.load(std::memory_order_relaxed); }
+  unsigned long getMax() const { return max_.load(std::memory_order_relaxed); }
+  double getMean() const;
+
+  // Upper bound of bucket where given quantile (0 to 1) lies
+  unsigned long getQuantile(const double quantile) const;
+}; // class Histogram
+
+// Counters of one worker, written only by the worker itself
+typedef struct worker_stats_t {
+  Histogram wait_nsec;    // from enqueue to start of job
+  Histogram run_nsec;     // run time of job
+  Histogram queue_depth;  // number of queued jobs when a job is started
+  std::atomic<unsigned long> busy_nsec;
+
+  // Counters of different workers are kept in different cache lines
+  char pad_[64];
+
+  worker_stats_t() : busy_nsec(0) {}
+} WorkerStats;
+
+// Snapshot of statistics of ThreadPool
+typedef struct pool_stats_t {
+  Histogram wait_nsec;
+  Histogram run_nsec;
+  Histogram queue_depth;
+  unsigned long elapsed_nsec;                 // since pool is created
+  std::vector<unsigned long> worker_busy_nsec;
+
+  pool_stats_t() : elapsed_nsec(0) {}
+} PoolStats;
+
+// Write summary of `stats`: latency and run time quantiles, queue depth and
+// utilization of each worker
+void printPoolStats(FILE *fp, const PoolStats &stats);
+
+} // namespace parallel
+
+#endif // PARALLEL_POOL_STATS_H
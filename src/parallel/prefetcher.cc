@@ -0,0 +1,210 @@
+#include "parallel/prefetcher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+namespace parallel {
+
+// Read whole file into memory, returns 0 on success
+int read_whole_file(const char *file_name, unsigned char **data, size_t *size) {
+  int fd = open(file_name, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return 1;
+  }
+#if defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  const size_t file_size = (size_t)st.st_size;
+  unsigned char *bytes = new unsigned char[file_size > 0 ? file_size : 1];
+  size_t num_read = 0;
+  while (num_read < file_size) {
+    ssize_t n = read(fd, bytes + num_read, file_size - num_read);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    num_read += (size_t)n;
+  }
+  close(fd);
+
+  if (num_read != file_size) {
+    delete[] bytes;
+    return 1;
+  }
+
+  (*data) = bytes;
+  (*size) = file_size;
+  return 0;
+}
+
+FilePrefetcher::FilePrefetcher(const unsigned int num_io_threads,
+                               const unsigned int depth,
+                               const size_t memory_budget)
+    : depth_(depth > 0 ? depth : 1)
+    , memory_budget_(memory_budget)
+    , is_stopped_(false)
+    , base_ticket_(0)
+    , next_ticket_(0)
+    , next_load_ticket_(0)
+    , num_ready_bytes_(0) {
+
+  const unsigned int num_threads = (num_io_threads > 0) ? num_io_threads : 1;
+  io_threads_.resize(num_threads);
+  for (unsigned int i = 0; i < num_threads; i++) {
+    io_threads_[i] = std::thread(runIoThread, this);
+  }
+}
+
+FilePrefetcher::~FilePrefetcher() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_stopped_ = true;
+    cv_load_.notify_all();
+  }
+
+  for (auto &thread : io_threads_) {
+    thread.join();
+  }
+
+  // release data which are never acquired
+  for (auto &slot : slots_) {
+    if (slot.data != NULL) {
+      delete[] slot.data;
+      slot.data = NULL;
+    }
+  }
+}
+
+// Must be called in critical section
+bool FilePrefetcher::canLoad() const {
+  if (next_load_ticket_ == next_ticket_) {
+    return false;
+  }
+  // Consumer is already waiting for this file, so load it regardless of
+  // memory budget. Otherwise consumers could wait forever.
+  if (!waiting_tickets_.empty() &&
+      *waiting_tickets_.begin() <= next_load_ticket_) {
+    return true;
+  }
+  return num_ready_bytes_ < memory_budget_;
+}
+
+void FilePrefetcher::runIoThread(FilePrefetcher *prefetcher) {
+  FilePrefetcher *pf = prefetcher;
+
+  while (true) {
+    size_t ticket;
+    std::string file_name;
+    { // Critical section
+      std::unique_lock<std::mutex> lock(pf->mutex_);
+      pf->cv_load_.wait(lock, [pf]() { return pf->is_stopped_ || pf->canLoad(); });
+      if (pf->is_stopped_) {
+        break;
+      }
+
+      ticket = pf->next_load_ticket_++;
+      Slot &slot = pf->slots_[ticket - pf->base_ticket_];
+      slot.state = kSlotLoading;
+      file_name = slot.file_name;
+    } // End of critical section
+
+    unsigned char *data = NULL;
+    size_t size = 0;
+    int ret = read_whole_file(file_name.c_str(), &data, &size);
+
+    { // Critical section
+      std::unique_lock<std::mutex> lock(pf->mutex_);
+      Slot &slot = pf->slots_[ticket - pf->base_ticket_];
+      if (ret == 0) {
+        slot.state = kSlotReady;
+        slot.data = data;
+        slot.size = size;
+        pf->num_ready_bytes_ += size;
+      } else {
+        slot.state = kSlotFailed;
+      }
+      pf->cv_ready_.notify_all();
+    } // End of critical section
+  }
+}
+
+size_t FilePrefetcher::push(const std::string &file_name) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (is_stopped_) {
+    throw std::runtime_error("FilePrefetcher is already stopped.\n");
+  }
+
+  cv_space_.wait(lock, [this]() { return slots_.size() < depth_; });
+
+  Slot slot;
+  slot.file_name = file_name;
+  slot.state = kSlotPending;
+  slot.data = NULL;
+  slot.size = 0;
+  slots_.push_back(slot);
+
+  size_t ticket = next_ticket_++;
+  cv_load_.notify_one();
+  return ticket;
+}
+
+int FilePrefetcher::acquire(const size_t ticket, unsigned char **data,
+                            size_t *size) {
+  if ((data == NULL) || (size == NULL)) {
+    return 1;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (ticket < base_ticket_ || ticket >= next_ticket_) {
+    return 1;
+  }
+
+  auto it = waiting_tickets_.insert(ticket);
+  cv_load_.notify_all();
+  cv_ready_.wait(lock, [this, ticket]() {
+    slot_state_t state = slots_[ticket - base_ticket_].state;
+    return state == kSlotReady || state == kSlotFailed;
+  });
+  waiting_tickets_.erase(it);
+
+  Slot &slot = slots_[ticket - base_ticket_];
+  int ret = 0;
+  if (slot.state == kSlotReady) {
+    (*data) = slot.data;
+    (*size) = slot.size;
+    num_ready_bytes_ -= slot.size;
+  } else {
+    fprintf(stderr, "FilePrefetcher::acquire() - failed to read file : %s\n",
+            slot.file_name.c_str());
+    ret = 1;
+  }
+  slot.state = kSlotTaken;
+  slot.data = NULL;
+  slot.size = 0;
+
+  // drop finished slots
+  while (!slots_.empty() && slots_.front().state == kSlotTaken) {
+    slots_.pop_front();
+    base_ticket_++;
+  }
+
+  cv_space_.notify_all();
+  cv_load_.notify_all();
+  return ret;
+}
+
+} // namespace parallel
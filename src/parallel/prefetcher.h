@@ -0,0 +1,78 @@
+#ifndef PARALLEL_PREFETCHER_H
+#define PARALLEL_PREFETCHER_H
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// Reads whole files ahead of their consumers on dedicated I/O threads, so
+// that compute threads do not stall on disk or network file system latency.
+// Files are registered in consuming order by `push()` and loaded in the same
+// order. At most `depth` files are registered but not yet acquired, and
+// loaded files waiting for consumers occupy at most `memory_budget` bytes.
+class FilePrefetcher {
+public:
+  FilePrefetcher(const unsigned int num_io_threads = 4,
+                 const unsigned int depth = 32,
+                 const size_t memory_budget = 512 << 20);
+  virtual ~FilePrefetcher();
+
+private:
+  enum slot_state_t {
+    kSlotPending,
+    kSlotLoading,
+    kSlotReady,
+    kSlotFailed,
+    kSlotTaken
+  };
+
+  typedef struct slot_t {
+    std::string file_name;
+    slot_state_t state;
+    unsigned char *data;
+    size_t size;
+  } Slot;
+
+  const unsigned int depth_;
+  const size_t memory_budget_;
+  bool is_stopped_;
+
+  std::deque<Slot> slots_;  // slot of ticket `base_ticket_ + i` is `slots_[i]`
+  size_t base_ticket_;
+  size_t next_ticket_;      // ticket of next pushed file
+  size_t next_load_ticket_; // ticket of next file to be loaded
+  size_t num_ready_bytes_;  // bytes loaded but not yet acquired
+  std::multiset<size_t> waiting_tickets_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_load_;
+  std::condition_variable cv_ready_;
+  std::condition_variable cv_space_;
+
+  std::vector<std::thread> io_threads_;
+
+  static void runIoThread(FilePrefetcher *prefetcher);
+  bool canLoad() const;
+
+public:
+  // Register file to be read ahead, and returns its ticket.
+  // Blocks while `depth` files are registered but not acquired.
+  size_t push(const std::string &file_name);
+
+  // Wait until file of `ticket` is loaded, and take its data. Memory of
+  // `data` is owned by caller, and must be released by `delete[]`.
+  // Returns 0 on success, and non-zero if the file could not be read.
+  int acquire(const size_t ticket, unsigned char **data, size_t *size);
+}; // class FilePrefetcher
+
+} // namespace parallel
+
+#endif // PARALLEL_PREFETCHER_H
@@ -0,0 +1,174 @@
+#include "parallel/task.h"
+
+#include <chrono>
+#include <vector>
+
+// Maximum number of free blocks kept by each thread, and number of blocks
+// exchanged with global list at once
+#ifndef PARALLEL_TASK_CACHE_SIZE
+#define PARALLEL_TASK_CACHE_SIZE 64
+#endif
+#ifndef PARALLEL_TASK_TRANSFER_SIZE
+#define PARALLEL_TASK_TRANSFER_SIZE 32
+#endif
+
+namespace parallel {
+
+typedef struct block_list_t {
+  std::vector<void *> blocks;
+
+  ~block_list_t() {
+    for (auto block : blocks) {
+      ::operator delete(block);
+    }
+    blocks.clear();
+  }
+} BlockList;
+
+// Blocks are usually allocated by producer and released by workers, so that
+// thread local caches exchange blocks through global list
+static BlockList global_blocks;
+static std::mutex global_blocks_mutex;
+static thread_local BlockList tls_blocks;
+
+void *allocTaskBlock(const size_t size) {
+  if (size > PARALLEL_TASK_BLOCK_SIZE) {
+    return ::operator new(size);
+  }
+
+  std::vector<void *> &cache = tls_blocks.blocks;
+  if (cache.empty()) {
+    std::unique_lock<std::mutex> lock(global_blocks_mutex);
+    std::vector<void *> &global = global_blocks.blocks;
+    for (unsigned int i = 0; i < PARALLEL_TASK_TRANSFER_SIZE && !global.empty(); i++) {
+      cache.push_back(global.back());
+      global.pop_back();
+    }
+  }
+  if (cache.empty()) {
+    return ::operator new(PARALLEL_TASK_BLOCK_SIZE);
+  }
+
+  void *block = cache.back();
+  cache.pop_back();
+  return block;
+}
+
+void freeTaskBlock(void *block, const size_t size) {
+  if (size > PARALLEL_TASK_BLOCK_SIZE) {
+    ::operator delete(block);
+    return;
+  }
+
+  std::vector<void *> &cache = tls_blocks.blocks;
+  cache.push_back(block);
+  if (cache.size() > PARALLEL_TASK_CACHE_SIZE) {
+    std::unique_lock<std::mutex> lock(global_blocks_mutex);
+    std::vector<void *> &global = global_blocks.blocks;
+    for (unsigned int i = 0; i < PARALLEL_TASK_TRANSFER_SIZE; i++) {
+      global.push_back(cache.back());
+      cache.pop_back();
+    }
+  }
+}
+
+void TaskStateBase::run(void *state) {
+  TaskStateBase *task = (TaskStateBase *)state;
+  task->invoke();
+  task->finish();
+}
+
+// Waiter increases `num_waiting_` before checking `is_ready_`, and finisher
+// sets `is_ready_` before checking `num_waiting_`, so that either of them sees
+// the other. Lock is taken only if someone is parked.
+void TaskStateBase::finish() {
+  is_ready_.store(true);
+  if (num_waiting_ > 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_ready_.notify_all();
+  }
+
+  if (group_ != NULL) {
+    group_->finishTask(is_failed_, error_);
+  }
+  release();
+}
+
+void TaskStateBase::wait() {
+  while (!isReady()) {
+    // Keep worker busy with other jobs, which may include this task
+    if (pool_->runPendingJob()) {
+      continue;
+    }
+    if (pool_->spinUntil([this]() { return isReady(); })) {
+      break;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_waiting_++;
+    if (pool_->isWorkerThread()) {
+      cv_ready_.wait_for(lock, std::chrono::milliseconds(1),
+                         [this]() { return is_ready_.load(); });
+    } else {
+      cv_ready_.wait(lock, [this]() { return is_ready_.load(); });
+    }
+    num_waiting_--;
+  }
+}
+
+TaskGroup::TaskGroup(ThreadPool *pool)
+    : pool_(pool)
+    , num_pending_(0)
+    , num_failed_(0) {
+
+}
+
+TaskGroup::~TaskGroup() {
+  // Tasks refer to this group until they finish
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_finished_.wait(lock, [this]() { return num_pending_ == 0; });
+}
+
+void TaskGroup::finishTask(const bool is_failed,
+                           const std::exception_ptr &error) {
+  // Counter is decreased in critical section, so that waiter does not
+  // destroy the group while last task is still touching it
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (is_failed) {
+    num_failed_++;
+    if (error && !error_) {
+      error_ = error;
+    }
+  }
+  if (--num_pending_ == 0) {
+    cv_finished_.notify_all();
+  }
+}
+
+void TaskGroup::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (num_pending_ > 0) {
+    if (pool_->isWorkerThread()) {
+      // Worker of the pool runs other jobs, since blocking all workers on
+      // tasks which are still queued would never finish
+      lock.unlock();
+      const bool has_run = pool_->runPendingJob();
+      lock.lock();
+      if (!has_run) {
+        cv_finished_.wait_for(lock, std::chrono::milliseconds(1),
+                              [this]() { return num_pending_ == 0; });
+      }
+    } else {
+      cv_finished_.wait(lock, [this]() { return num_pending_ == 0; });
+    }
+  }
+
+  std::exception_ptr error = error_;
+  error_ = nullptr;
+  lock.unlock();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace parallel
@@ -0,0 +1,262 @@
+#ifndef PARALLEL_TASK_H
+#define PARALLEL_TASK_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "parallel/threadpool.h"
+
+// Size of blocks recycled for task states. States of callables with small
+// captures fit in a block, and larger ones are allocated from heap.
+#ifndef PARALLEL_TASK_BLOCK_SIZE
+#define PARALLEL_TASK_BLOCK_SIZE 256
+#endif
+
+namespace parallel {
+
+// Allocate and release memory of task state. Blocks of
+// `PARALLEL_TASK_BLOCK_SIZE` are recycled through thread local caches, so
+// that submitting small tasks does not touch heap in steady state.
+void *allocTaskBlock(const size_t size);
+void freeTaskBlock(void *block, const size_t size);
+
+class TaskGroup;
+
+// Shared state of task, referenced by job and by future
+class TaskStateBase {
+public:
+  TaskStateBase(ThreadPool *pool, TaskGroup *group, const int ref_count)
+      : pool_(pool), group_(group), ref_count_(ref_count), is_ready_(false),
+        num_waiting_(0), is_failed_(false) {}
+  virtual ~TaskStateBase() {}
+
+protected:
+  ThreadPool *pool_;
+  TaskGroup *group_;
+  std::atomic<int> ref_count_;
+  std::atomic<bool> is_ready_;
+  std::atomic<unsigned int> num_waiting_;  // threads parked in `wait()`
+  bool is_failed_;  // returned non-zero error code or threw exception
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable cv_ready_;
+
+  virtual void invoke() = 0;
+  virtual void destroy() = 0;
+  void finish();
+
+public:
+  // Job function of thread pool
+  static void run(void *state);
+
+  bool isReady() const { return is_ready_.load(std::memory_order_acquire); }
+  void wait();
+  void release() {
+    if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      destroy();
+    }
+  }
+  void rethrow() const {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+};
+
+// Result of task. Error code of `int` result is reported to group.
+template <typename T>
+class TaskResult {
+public:
+  TaskResult() : has_value_(false) {}
+  ~TaskResult() {
+    if (has_value_) {
+      reinterpret_cast<T *>(&storage_)->~T();
+    }
+  }
+
+private:
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+  bool has_value_;
+
+public:
+  template <typename F>
+  bool invoke(F &function) {
+    new (&storage_) T(function());
+    has_value_ = true;
+    return isError(*reinterpret_cast<T *>(&storage_));
+  }
+  T take() { return std::move(*reinterpret_cast<T *>(&storage_)); }
+
+  template <typename U>
+  static bool isError(const U &) { return false; }
+  static bool isError(const int &value) { return value != 0; }
+};
+
+template <>
+class TaskResult<void> {
+public:
+  template <typename F>
+  bool invoke(F &function) {
+    function();
+    return false;
+  }
+  void take() {}
+};
+
+template <typename T>
+class TaskState : public TaskStateBase {
+public:
+  TaskState(ThreadPool *pool, TaskGroup *group, const int ref_count)
+      : TaskStateBase(pool, group, ref_count) {}
+
+protected:
+  TaskResult<T> result_;
+
+public:
+  T take() {
+    wait();
+    rethrow();
+    return result_.take();
+  }
+};
+
+// Task state holding callable of type `F`
+template <typename T, typename F>
+class TaskImpl : public TaskState<T> {
+public:
+  TaskImpl(ThreadPool *pool, TaskGroup *group, const int ref_count, F &&function)
+      : TaskState<T>(pool, group, ref_count), function_(std::move(function)) {}
+
+  static TaskImpl *create(ThreadPool *pool, TaskGroup *group,
+                          const int ref_count, F &&function) {
+    void *block = allocTaskBlock(sizeof(TaskImpl));
+    return new (block) TaskImpl(pool, group, ref_count, std::move(function));
+  }
+
+private:
+  F function_;
+
+  void invoke() {
+    try {
+      this->is_failed_ = this->result_.invoke(function_);
+    } catch (...) {
+      this->error_ = std::current_exception();
+      this->is_failed_ = true;
+    }
+  }
+
+  void destroy() {
+    this->~TaskImpl();
+    freeTaskBlock(this, sizeof(TaskImpl));
+  }
+};
+
+// Handle of result of task submitted by `ThreadPool::submit()`
+template <typename T>
+class Future {
+public:
+  Future() : state_(NULL) {}
+  explicit Future(TaskState<T> *state) : state_(state) {}
+  Future(Future &&other) : state_(other.state_) { other.state_ = NULL; }
+  Future &operator=(Future &&other) {
+    if (this != &other) {
+      reset();
+      state_ = other.state_;
+      other.state_ = NULL;
+    }
+    return *this;
+  }
+  Future(const Future &) = delete;
+  Future &operator=(const Future &) = delete;
+  ~Future() { reset(); }
+
+private:
+  TaskState<T> *state_;
+
+  void reset() {
+    if (state_ != NULL) {
+      state_->release();
+      state_ = NULL;
+    }
+  }
+
+public:
+  bool valid() const { return state_ != NULL; }
+  bool isReady() const { return (state_ != NULL) && state_->isReady(); }
+
+  // Wait until task is finished. Worker of the pool runs other jobs while
+  // waiting.
+  void wait() const {
+    if (state_ != NULL) {
+      state_->wait();
+    }
+  }
+
+  // Wait and take result, or rethrow exception thrown by task. Can be called
+  // only once.
+  T get() {
+    TaskState<T> *state = state_;
+    state_ = NULL;
+    struct Releaser {
+      TaskState<T> *state;
+      ~Releaser() { state->release(); }
+    } releaser = {state};
+    return state->take();
+  }
+}; // class Future
+
+// Group of tasks which can be waited for separately from other jobs of pool.
+// Task returning `int` is counted as failed if it returns non-zero, as well
+// as task throwing exception.
+class TaskGroup {
+public:
+  TaskGroup(ThreadPool *pool);
+  virtual ~TaskGroup();
+
+private:
+  ThreadPool *pool_;
+  std::atomic<unsigned int> num_pending_;
+  std::atomic<unsigned int> num_failed_;
+  std::exception_ptr error_;  // first exception thrown by tasks
+  std::mutex mutex_;
+  std::condition_variable cv_finished_;
+
+  friend class TaskStateBase;
+  void finishTask(const bool is_failed, const std::exception_ptr &error);
+
+public:
+  template <typename F>
+  void run(F function) {
+    typedef typename std::result_of<F()>::type result_t;
+    num_pending_++;
+    TaskImpl<result_t, F> *state = TaskImpl<result_t, F>::create(
+        pool_, this, 1, std::move(function));
+    pool_->addJob(TaskStateBase::run, (void *)state);
+  }
+
+  // Wait until all tasks of this group are finished, and rethrow first
+  // exception thrown by tasks if any.
+  void wait();
+
+  unsigned int getNumFailed() const { return num_failed_.load(); }
+}; // class TaskGroup
+
+template <typename F>
+Future<typename std::result_of<F()>::type> ThreadPool::submit(F function) {
+  typedef typename std::result_of<F()>::type result_t;
+  TaskImpl<result_t, F> *state = TaskImpl<result_t, F>::create(
+      this, NULL, 2, std::move(function));
+  addJob(TaskStateBase::run, (void *)state);
+  return Future<result_t>(state);
+}
+
+} // namespace parallel
+
+#endif // PARALLEL_TASK_H
@@ -1,70 +1,314 @@
 #include "parallel/threadpool.h"
+#include "parallel/numa.h"
 
 #include <stdio.h>
 
 #include <condition_variable>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
 #include <thread>
 
+// Maximum number of jobs moved from injection queue to own deque at once
+#ifndef PARALLEL_INJECT_BATCH_SIZE
+#define PARALLEL_INJECT_BATCH_SIZE 32
+#endif
+
 namespace parallel {
 
+// Pool and index of the worker running on current thread
+static thread_local ThreadPool *tls_pool = NULL;
+static thread_local unsigned int tls_worker_index = 0;
+
+#ifdef PARALLEL_ENABLE_STATS
+// Number of jobs running on current thread, more than 1 if a job runs other
+// jobs while waiting, so that busy time is not counted twice
+static thread_local unsigned int tls_job_depth = 0;
+#endif
 
-ThreadPool::ThreadPool(const unsigned int num_threads) 
-    : num_running_threads_(0)
-    , num_processed_(0)
-    , is_stopped_(false) {
-  
-  workers_.resize(num_threads);
-  for (unsigned int i = 0; i < num_threads; i++) {
-    workers_[i] = std::thread(runThread, this);
-    //workers_.emplace_back(std::bind(&ThreadPool::runThread, this));
+// Spinning on single CPU only delays the thread being waited for
+static IdlePolicy adjust_idle_policy(const IdlePolicy &idle_policy) {
+  IdlePolicy policy = idle_policy;
+  if (std::thread::hardware_concurrency() <= 1) {
+    policy.num_spins = 0;
+  }
+  return policy;
+}
+
+ThreadPool::ThreadPool(const unsigned int num_threads,
+                       const size_t queue_capacity,
+                       const affinity_t affinity,
+                       const IdlePolicy& idle_policy)
+    : num_processed_(0)
+    , is_stopped_(false)
+    , num_pending_(0)
+    , num_queued_(0)
+    , num_sleeping_(0)
+    , num_blocked_(0)
+    , num_waiting_(0)
+    , idle_policy_(adjust_idle_policy(idle_policy)) {
+
+  if (queue_capacity > 0) {
+    bounded_queue_.reset(new JobQueue(queue_capacity));
+  }
+
+  const unsigned int num_workers = (num_threads > 0) ? num_threads : 1;
+#ifdef PARALLEL_ENABLE_STATS
+  worker_stats_.reset(new WorkerStats[num_workers]);
+  start_nsec_ = getTimeNsec();
+#endif
+  deques_.resize(num_workers);
+  for (unsigned int i = 0; i < num_workers; i++) {
+    deques_[i].reset(new JobDeque());
+  }
+
+  workers_.resize(num_workers);
+  assignCpus(affinity);
+  for (unsigned int i = 0; i < num_workers; i++) {
+    workers_[i] = std::thread(runThread, this, i);
   }
 }
 
 ThreadPool::~ThreadPool() {
   {
-    std::unique_lock<std::mutex> lock(queue_mutex_);
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
     is_stopped_ = true;
     cv_job_added_.notify_all();
   }
 
   for (auto& thread : workers_) {
     thread.join();
-  } 
+  }
+
+  // Release jobs which are never started
+  for (auto& deque : deques_) {
+    Job *job;
+    while ((job = deque->pop()) != NULL) {
+      delete job;
+    }
+  }
+  for (auto job : inject_queue_) {
+    delete job;
+  }
+  inject_queue_.clear();
+}
+
+// Worker `i` is placed on node `i % number of nodes`, so that workers are
+// spread evenly over sockets
+void ThreadPool::assignCpus(const affinity_t affinity) {
+  const unsigned int num_workers = (unsigned int)workers_.size();
+  worker_cpus_.assign(num_workers, std::vector<int>());
+  worker_nodes_.assign(num_workers, -1);
+  if (affinity == kAffinityNone) {
+    return;
+  }
+
+  const NumaTopology &topology = getNumaTopology();
+  std::vector<int> nodes;
+  for (unsigned int node = 0; node < topology.node_cpus.size(); node++) {
+    if (!topology.node_cpus[node].empty()) {
+      nodes.push_back((int)node);
+    }
+  }
+  if (nodes.empty()) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < num_workers; i++) {
+    const int node = nodes[i % nodes.size()];
+    const std::vector<int> &cpus = topology.node_cpus[node];
+    worker_nodes_[i] = node;
+    if (affinity == kAffinityCore) {
+      worker_cpus_[i].push_back(cpus[(i / nodes.size()) % cpus.size()]);
+    } else {
+      worker_cpus_[i] = cpus;
+    }
+  }
+}
+
+// Take a job from injection queue, and move some more into own deque so that
+// they can be stolen by others without touching the global lock
+Job* ThreadPool::takeInjected(const unsigned int index) {
+  std::unique_lock<std::mutex> lock(inject_mutex_);
+  if (inject_queue_.empty()) {
+    return NULL;
+  }
+
+  Job *job = inject_queue_.front();
+  inject_queue_.pop_front();
+
+  size_t num_moves = inject_queue_.size() / workers_.size();
+  if (num_moves > PARALLEL_INJECT_BATCH_SIZE) {
+    num_moves = PARALLEL_INJECT_BATCH_SIZE;
+  }
+  for (size_t i = 0; i < num_moves; i++) {
+    deques_[index]->push(inject_queue_.front());
+    inject_queue_.pop_front();
+  }
+  return job;
 }
 
-void ThreadPool::runThread(ThreadPool* pool_) {
+// Put job taken by waiting worker back to injection queue, to be run by an
+// idle worker
+void ThreadPool::returnInjected(Job *job) {
+  {
+    std::unique_lock<std::mutex> lock(inject_mutex_);
+    inject_queue_.push_front(job);
+  }
+  if (num_sleeping_ > 0) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    cv_job_added_.notify_one();
+  }
+}
+
+bool ThreadPool::findJob(const unsigned int index, unsigned int *seed,
+                         Job *job, const bool is_waiting) {
+  if (bounded_queue_ != NULL) {
+    if (!bounded_queue_->pop(job)) {
+      return false;
+    }
+    num_queued_.fetch_sub(1);
+
+    // Wake up producer blocked by full queue
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_blocked_ > 0) {
+      std::unique_lock<std::mutex> lock(space_mutex_);
+      cv_space_.notify_one();
+    }
+    return true;
+  }
+
+  // Waiting worker skips jobs injected from outside, which are moved into
+  // deques in batches by `takeInjected()`
+  Job *heap_job = deques_[index]->pop();
+  while (is_waiting && heap_job != NULL && heap_job->is_injected_) {
+    returnInjected(heap_job);
+    heap_job = deques_[index]->pop();
+  }
+  if (heap_job == NULL && !is_waiting) {
+    heap_job = takeInjected(index);
+  }
+  if (heap_job == NULL) {
+    // Steal from other workers, starting at random victim
+    const unsigned int num_workers = (unsigned int)deques_.size();
+    unsigned int x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    for (unsigned int i = 0; i < num_workers && heap_job == NULL; i++) {
+      const unsigned int victim = (x + i) % num_workers;
+      if (victim != index) {
+        heap_job = deques_[victim]->steal();
+        if (is_waiting && heap_job != NULL && heap_job->is_injected_) {
+          returnInjected(heap_job);
+          heap_job = NULL;
+        }
+      }
+    }
+  }
+
+  if (heap_job == NULL) {
+    return false;
+  }
+  num_queued_.fetch_sub(1);
+  (*job) = (*heap_job);
+  delete heap_job;
+  return true;
+}
+
+// Jobs are run only by workers of this pool
+void ThreadPool::runJob(const Job& job) {
+#ifdef PARALLEL_ENABLE_STATS
+  WorkerStats &stats = worker_stats_[tls_worker_index];
+  const unsigned long start_nsec = getTimeNsec();
+  stats.wait_nsec.add((start_nsec > job.enqueue_nsec_) ?
+                      start_nsec - job.enqueue_nsec_ : 0);
+  stats.queue_depth.add(getQueueDepth());
+  tls_job_depth++;
+#endif
+
+  job.function_(job.arg_);
+
+#ifdef PARALLEL_ENABLE_STATS
+  const unsigned long run_nsec = getTimeNsec() - start_nsec;
+  stats.run_nsec.add(run_nsec);
+  if (--tls_job_depth == 0) {
+    stats.busy_nsec.fetch_add(run_nsec, std::memory_order_relaxed);
+  }
+#endif
+  num_processed_++;
+  finishJob();
+}
+
+// Waiter increases `num_waiting_` before checking `num_pending_`, so that
+// lock is taken only if someone is parked in `wait()`
+void ThreadPool::finishJob() {
+  if (num_pending_.fetch_sub(1) == 1 && num_waiting_ > 0) {
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    cv_job_finished_.notify_all();
+  }
+}
+
+// Poll queues as configured by idle policy. Spinning polls only counter of
+// queued jobs, so that idle workers do not hammer locks of queues.
+bool ThreadPool::pollJob(const unsigned int index, unsigned int *seed,
+                         Job *job) {
+  bool found = false;
+  spinUntil([this, index, seed, job, &found]() {
+    if (is_stopped_) {
+      return true;
+    }
+    if (num_queued_.load(std::memory_order_relaxed) > 0) {
+      found = findJob(index, seed, job);
+    }
+    return found;
+  });
+  return found;
+}
+
+void ThreadPool::runThread(ThreadPool* pool_, const unsigned int index) {
   ThreadPool *pool = (pool_);
-  void (*fn)(void*);
-  void* arg;
-  while (true) {
+  tls_pool = pool;
+  tls_worker_index = index;
+  if (!pool->worker_cpus_[index].empty() &&
+      setCurrentThreadAffinity(pool->worker_cpus_[index]) != 0) {
+    fprintf(stderr, "ThreadPool::runThread() - failed to set affinity of "
+            "worker %u.\n", index);
+  }
+  unsigned int seed = 2654435761u * (index + 1);
+
+  Job job;
+  while (!pool->is_stopped_) {
+    // Give producers a chance before parking, since going to sleep and
+    // being woken up costs much more than a small job
+    const bool found = pool->findJob(index, &seed, &job) ||
+                       pool->pollJob(index, &seed, &job);
+    if (found) {
+      pool->runJob(job);
+      continue;
+    }
+
     { // Critical section
-      std::unique_lock<std::mutex> lock(pool->queue_mutex_);
+      // `num_sleeping_` is increased before checking `num_queued_`, and
+      // `addJob()` increases `num_queued_` before checking `num_sleeping_`,
+      // so that either of them sees the other and no wake-up is lost.
+      std::unique_lock<std::mutex> lock(pool->sleep_mutex_);
+      pool->num_sleeping_++;
       pool->cv_job_added_.wait(
-        lock, [pool](){ return pool->is_stopped_ || !pool->job_queue_.empty(); });
-      
-      if (pool->is_stopped_) {
-        break;
-      }
-      if (!pool->job_queue_.empty()) {
-        pool->num_running_threads_++;
-        
-        auto job = pool->job_queue_.front().get();
-        fn = job->function_;
-        arg = job->arg_;
-        pool->job_queue_.pop();
-      }
+        lock, [pool](){ return pool->is_stopped_ || pool->num_queued_ > 0; });
+      pool->num_sleeping_--;
     } // end of critictal section
+  }
 
-    fn(arg);
-    pool->num_processed_++;
-      
-    { // Critical section
-      std::unique_lock<std::mutex> lock(pool->queue_mutex_);
-      pool->num_running_threads_--;
-      pool->cv_job_finished_.notify_one();
-    } // end of critictal section
+  tls_pool = NULL;
+}
+
+void ThreadPool::notifyJobAdded() {
+  num_queued_++;
+
+  if (num_sleeping_ > 0) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    cv_job_added_.notify_one();
   }
 }
 
@@ -77,23 +321,175 @@ void ThreadPool::addJob(void (*function)(void *), void *arg) {
     throw std::runtime_error("ThreadPool is already stopped.\n");
   }
 
-  { // Critical section
-    std::unique_lock<std::mutex> lock(queue_mutex_);
+  num_pending_++;
+  if (bounded_queue_ != NULL) {
+    if (!bounded_queue_->push(function, arg)) {
+      if (tls_pool == this) {
+        // Worker must not wait for queue which only workers can drain
+        runJob(Job(function, arg));
+        return;
+      }
 
-    std::unique_ptr<Job> job(new Job(function, arg));
-    job_queue_.push(std::move(job));
-    cv_job_added_.notify_one();
-  } // End of critical section
+      { // Critical section
+        // `num_blocked_` is increased before retrying, and consumers check
+        // it after freeing a slot, so that no wake-up is lost.
+        std::unique_lock<std::mutex> lock(space_mutex_);
+        num_blocked_++;
+        cv_space_.wait(lock, [this, function, arg]() {
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          return bounded_queue_->push(function, arg);
+        });
+        num_blocked_--;
+      } // End of critical section
+    }
+  } else {
+    Job *job = new Job(function, arg);
+    if (tls_pool == this) {
+      deques_[tls_worker_index]->push(job);
+    } else {
+      job->is_injected_ = true;
+      std::unique_lock<std::mutex> lock(inject_mutex_);
+      inject_queue_.push_back(job);
+    }
+  }
+  notifyJobAdded();
+}
+
+bool ThreadPool::tryAddJob(void (*function)(void *), void *arg) {
+  if (bounded_queue_ == NULL) {
+    addJob(function, arg);
+    return true;
+  }
+
+  if (arg == NULL) {
+    throw std::runtime_error("ThreadPool::tryAddJob() - `job` is NULL.\n");
+  }
+
+  if (is_stopped_) {
+    throw std::runtime_error("ThreadPool is already stopped.\n");
+  }
+
+  num_pending_++;
+  if (!bounded_queue_->push(function, arg)) {
+    finishJob();
+    return false;
+  }
+  notifyJobAdded();
+  return true;
+}
+
+bool ThreadPool::isWorkerThread() const {
+  return tls_pool == this;
+}
+
+int ThreadPool::currentWorkerIndex() const {
+  return (tls_pool == this) ? (int)tls_worker_index : -1;
+}
+
+int ThreadPool::getCurrentNode() const {
+  if (tls_pool == this && worker_nodes_[tls_worker_index] >= 0) {
+    return worker_nodes_[tls_worker_index];
+  }
+  return getCurrentNumaNode();
+}
+
+typedef struct broadcast_t {
+  void (*function)(unsigned int, void *);
+  void *arg;
+  unsigned int num_workers;
+  unsigned int num_started;
+  unsigned int num_finished;
+  std::mutex mutex;
+  std::condition_variable cv;
+} Broadcast;
+
+// Job of `runOnEachWorker()`. Each job blocks its worker until all jobs are
+// started, so that no worker takes two of them.
+static void run_broadcast(void *arg) {
+  Broadcast *broadcast = (Broadcast *)arg;
+  {
+    std::unique_lock<std::mutex> lock(broadcast->mutex);
+    broadcast->num_started++;
+    broadcast->cv.notify_all();
+    broadcast->cv.wait(lock, [broadcast]() {
+      return broadcast->num_started == broadcast->num_workers;
+    });
+  }
+
+  broadcast->function(tls_worker_index, broadcast->arg);
+
+  std::unique_lock<std::mutex> lock(broadcast->mutex);
+  broadcast->num_finished++;
+  broadcast->cv.notify_all();
+}
+
+void ThreadPool::runOnEachWorker(void (*function)(unsigned int, void *),
+                                 void *arg) {
+  if (tls_pool == this) {
+    throw std::runtime_error("ThreadPool::runOnEachWorker() - called by worker.\n");
+  }
+
+  Broadcast broadcast;
+  broadcast.function = function;
+  broadcast.arg = arg;
+  broadcast.num_workers = (unsigned int)workers_.size();
+  broadcast.num_started = 0;
+  broadcast.num_finished = 0;
+  for (unsigned int i = 0; i < broadcast.num_workers; i++) {
+    addJob(run_broadcast, (void *)&broadcast);
+  }
+
+  std::unique_lock<std::mutex> lock(broadcast.mutex);
+  broadcast.cv.wait(lock, [&broadcast]() {
+    return broadcast.num_finished == broadcast.num_workers;
+  });
+}
+
+int ThreadPool::getStats(PoolStats *stats) const {
+#ifdef PARALLEL_ENABLE_STATS
+  stats->elapsed_nsec = getTimeNsec() - start_nsec_;
+  stats->worker_busy_nsec.resize(workers_.size());
+  for (size_t i = 0; i < workers_.size(); i++) {
+    const WorkerStats &worker = worker_stats_[i];
+    stats->wait_nsec.merge(worker.wait_nsec);
+    stats->run_nsec.merge(worker.run_nsec);
+    stats->queue_depth.merge(worker.queue_depth);
+    stats->worker_busy_nsec[i] = worker.busy_nsec.load(std::memory_order_relaxed);
+  }
+  return 0;
+#else
+  (void)stats;  // statistics are not collected
+  return 1;
+#endif
+}
+
+bool ThreadPool::runPendingJob() {
+  if (tls_pool != this) {
+    return false;
+  }
+
+  Job job;
+  unsigned int seed = 2654435761u * (tls_worker_index + 1) + num_processed_;
+  if (!findJob(tls_worker_index, &seed, &job, true)) {
+    return false;
+  }
+  runJob(job);
+  return true;
 }
 
 void ThreadPool::wait() {
-  
+  if (spinUntil([this]() { return num_pending_ == 0; })) {
+    return;
+  }
+
   {  // Critical section
-    std::unique_lock<std::mutex> lock(queue_mutex_);
-    cv_job_finished_.wait(lock, 
-      [this]() { return job_queue_.empty() && (num_running_threads_ == 0); }
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    num_waiting_++;
+    cv_job_finished_.wait(lock,
+      [this]() { return num_pending_ == 0; }
     );
+    num_waiting_--;
   }  // End of critical section
 }
 
-} // namespace parallel
\ No newline at end of file
+} // namespace parallel
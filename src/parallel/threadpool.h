@@ -2,51 +2,234 @@
 #define PARALLEL_THREADPOOL_H
 
 #include <iostream>
-#include <queue>
+#include <deque>
 #include <thread>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include <type_traits>
+#include <vector>
+
+#include "parallel/job_deque.h"
+#include "parallel/job_queue.h"
+#include "parallel/pool_stats.h"
 
 namespace parallel {
 
+template <typename T> class Future;
+
+// Placement of workers
+enum affinity_t {
+  kAffinityNone,  // workers float over all CPUs
+  kAffinityCore,  // each worker is pinned to one CPU, spread over nodes
+  kAffinityNode   // each worker is pinned to CPUs of one NUMA node
+};
+
+// Behavior of thread waiting for job or for completion. It polls with CPU
+// pause `num_spins` times, then polls with yield `num_yields` times, and then
+// parks until it is notified. Spinning keeps dispatch latency of tiny jobs
+// low, since neither side pays for futex wake-up, at the cost of CPU time of
+// idle workers.
+typedef struct idle_policy_t {
+  unsigned int num_spins;
+  unsigned int num_yields;
+
+  idle_policy_t(const unsigned int spins = 0, const unsigned int yields = 1)
+    : num_spins(spins), num_yields(yields) {}
+} IdlePolicy;
+
+// Hint to CPU that calling thread is spinning
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
 typedef struct job_t {
   void (*function_)(void *);
   void *arg_;
+  bool is_injected_;  // added from outside of pool
+#ifdef PARALLEL_ENABLE_STATS
+  unsigned long enqueue_nsec_;
+#endif
 
-  job_t() : function_(NULL), arg_(NULL){};
+  job_t() : function_(NULL), arg_(NULL), is_injected_(false){
+#ifdef PARALLEL_ENABLE_STATS
+    enqueue_nsec_ = 0;
+#endif
+  };
 
-  job_t(void (*function)(void *), void *arg) : function_(function), arg_(arg){};
+  job_t(void (*function)(void *), void *arg)
+      : function_(function), arg_(arg), is_injected_(false){
+#ifdef PARALLEL_ENABLE_STATS
+    enqueue_nsec_ = getTimeNsec();
+#endif
+  };
 
   ~job_t(){};
 
 } Job;
 
+// Work-stealing thread pool.
+// Each worker owns a deque of jobs. Jobs added by a worker go to its own
+// deque, and jobs added from outside of the pool go to a global injection
+// queue. Idle workers take jobs from their own deque first, then from the
+// injection queue, and finally steal from other workers, so that workers do
+// not contend on a single lock. Workers waiting for their tasks help only
+// with jobs added by workers.
+// If `queue_capacity` is given, all jobs are placed in a bounded lock-free
+// queue of preallocated slots instead, so that no memory is allocated per job
+// and producers are blocked while the queue is full.
+// Workers can be pinned by `affinity`, so that memory touched by a worker
+// stays on its NUMA node. Idle workers and waiters follow `idle_policy`.
+// If PARALLEL_ENABLE_STATS is defined, each worker records wait and run time
+// of its jobs, which are read by `getStats()`.
 class ThreadPool {
 public:
-  ThreadPool(const unsigned int num_threads=std::thread::hardware_concurrency());
+  ThreadPool(const unsigned int num_threads=std::thread::hardware_concurrency(),
+             const size_t queue_capacity=0,
+             const affinity_t affinity=kAffinityNone,
+             const IdlePolicy& idle_policy=IdlePolicy());
   virtual ~ThreadPool();
 
 private:
   std::atomic<unsigned int> num_processed_;
-  unsigned int num_running_threads_;
-  bool is_stopped_;
+  std::atomic<bool> is_stopped_;
+  std::atomic<size_t> num_pending_;     // added but not finished
+  std::atomic<long> num_queued_;        // added but not started
+  std::atomic<unsigned int> num_sleeping_;
+  std::atomic<unsigned int> num_blocked_;  // producers waiting for space
+  std::atomic<unsigned int> num_waiting_;  // threads parked in `wait()`
+  const IdlePolicy idle_policy_;
 
   std::vector<std::thread> workers_;
+  std::vector<std::vector<int>> worker_cpus_;  // empty if not pinned
+  std::vector<int> worker_nodes_;              // -1 if not pinned
+  std::vector<std::unique_ptr<JobDeque>> deques_;  // deque of each worker
 
-  std::queue<std::unique_ptr<Job>> job_queue_;
-  std::mutex queue_mutex_;
+  // Global injection queue
+  std::deque<Job*> inject_queue_;
+  std::mutex inject_mutex_;
+
+  // Bounded queue, NULL if unbounded
+  std::unique_ptr<JobQueue> bounded_queue_;
+  std::mutex space_mutex_;
+  std::condition_variable cv_space_;
+
+  std::mutex sleep_mutex_;
   std::condition_variable cv_job_added_;
+  std::mutex wait_mutex_;
   std::condition_variable cv_job_finished_;
 
-  static void runThread(ThreadPool* pool_);
+#ifdef PARALLEL_ENABLE_STATS
+  std::unique_ptr<WorkerStats[]> worker_stats_;
+  unsigned long start_nsec_;
+#endif
+
+  void assignCpus(const affinity_t affinity);
+  static void runThread(ThreadPool* pool_, const unsigned int index);
+  Job* takeInjected(const unsigned int index);
+  void returnInjected(Job *job);
+  bool findJob(const unsigned int index, unsigned int *seed, Job *job,
+               const bool is_waiting = false);
+  bool pollJob(const unsigned int index, unsigned int *seed, Job *job);
+  void runJob(const Job& job);
+  void finishJob();
+  void notifyJobAdded();
 
 public:
+  // Add job to the pool. Can be called from any thread, including workers of
+  // this pool. If queue is bounded and full, blocks until a slot is freed,
+  // or runs the job in place if called from worker of this pool.
   void addJob(void (*function)(void *), void *arg);
+
+  // Same as above, but returns false instead of blocking if queue is full
+  bool tryAddJob(void (*function)(void *), void *arg);
+
+  // Add callable with no argument, and get future of its result. Exception
+  // thrown by callable is rethrown by `Future::get()`. Defined in
+  // "parallel/task.h".
+  template <typename F>
+  Future<typename std::result_of<F()>::type> submit(F function);
+
+  // Run one queued job on calling thread, if it is worker of this pool.
+  // Returns false if no job is run. Used to keep worker busy while it waits
+  // for other jobs. Only jobs added by workers, such as tasks spawned by the
+  // job it waits for, are run, since jobs added from outside may take much
+  // longer than it. Bounded queue does not tell them apart.
+  bool runPendingJob();
+  bool isWorkerThread() const;
+
+  // Index of calling worker in [0, getNumThreads()), or -1 if calling thread
+  // is not worker of this pool. See "parallel/worker_local.h" for objects
+  // bound to each worker.
+  int currentWorkerIndex() const;
+
+  // Call `function(index, arg)` once on every worker, where `index` is index
+  // of the worker, and wait until all of them return. Used to build
+  // per-worker data on the worker itself, so that its memory is placed on
+  // node of the worker. Must not be called by workers of this pool.
+  void runOnEachWorker(void (*function)(unsigned int, void *), void *arg);
+
+  // NUMA node of worker, -1 if worker is not pinned to a node
+  int getWorkerNode(const unsigned int index) const {
+    return (index < worker_nodes_.size()) ? worker_nodes_[index] : -1;
+  }
+
+  // NUMA node of calling thread
+  int getCurrentNode() const;
+
+  // Wait until all added jobs are finished. Must not be called by workers of
+  // this pool.
   void wait();
+
+  // Spin and yield as configured by idle policy until `ready()` returns
+  // true. Returns false if it is still not ready, where caller should park.
+  template <typename P>
+  bool spinUntil(const P &ready) const {
+    for (unsigned int i = 0; i < idle_policy_.num_spins; i++) {
+      if (ready()) {
+        return true;
+      }
+      cpuRelax();
+    }
+    for (unsigned int i = 0; i < idle_policy_.num_yields; i++) {
+      if (ready()) {
+        return true;
+      }
+      std::this_thread::yield();
+    }
+    return ready();
+  }
+
+  const IdlePolicy &getIdlePolicy() const { return idle_policy_; }
+
+  unsigned int getNumThreads() const { return (unsigned int)workers_.size(); }
+  unsigned int getNumProcessed() const { return num_processed_.load(); }
+
+  // Number of jobs added but not yet started
+  size_t getQueueDepth() const {
+    const long num_queued = num_queued_.load();
+    return (num_queued > 0) ? (size_t)num_queued : 0;
+  }
+
+  // Take snapshot of statistics. Can be called while jobs are running.
+  // Returns non-zero if statistics are not collected, i.e. PARALLEL_ENABLE_STATS
+  // is not defined.
+  int getStats(PoolStats *stats) const;
+
+  // Capacity of bounded queue, 0 if unbounded
+  size_t getQueueCapacity() const {
+    return (bounded_queue_ != NULL) ? bounded_queue_->getCapacity() : 0;
+  }
 };
 
 }  // namespace parallel
 
-#endif // PARALLEL_THREADPOOL_H
\ No newline at end of file
+#include "parallel/task.h"
+
+#endif // PARALLEL_THREADPOOL_H
@@ -0,0 +1,77 @@
+#ifndef PARALLEL_WORKER_LOCAL_H
+#define PARALLEL_WORKER_LOCAL_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "parallel/threadpool.h"
+
+namespace parallel {
+
+// One object per worker of pool. Objects are created by `factory(index)` on
+// the worker itself, so that their memory is placed on node of the worker,
+// and each worker reuses its own object for every job it runs. Factory
+// returns object allocated by `new`, or NULL on failure.
+template <typename T>
+class WorkerLocal {
+public:
+  template <typename F>
+  WorkerLocal(ThreadPool *pool, const F &factory)
+      : pool_(pool), objects_(pool->getNumThreads(), (T *)NULL) {
+    Creator<F> creator = {this, &factory};
+    pool->runOnEachWorker(Creator<F>::run, (void *)&creator);
+  }
+  virtual ~WorkerLocal() {
+    for (auto object : objects_) {
+      delete object;
+    }
+    objects_.clear();
+  }
+
+private:
+  template <typename F>
+  struct Creator {
+    WorkerLocal *local;
+    const F *factory;
+
+    static void run(unsigned int index, void *arg) {
+      Creator *creator = (Creator *)arg;
+      creator->local->objects_[index] = (*creator->factory)(index);
+    }
+  };
+
+  ThreadPool *pool_;
+  std::vector<T *> objects_;
+
+  // Not copyable, objects are owned by this class
+  WorkerLocal(const WorkerLocal &);
+  WorkerLocal &operator=(const WorkerLocal &);
+
+public:
+  // False if factory failed for any worker
+  bool isValid() const {
+    for (auto object : objects_) {
+      if (object == NULL) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Object of calling worker, NULL if calling thread is not worker of pool
+  T *local() const {
+    const int index = pool_->currentWorkerIndex();
+    return (index >= 0) ? objects_[index] : NULL;
+  }
+
+  T *get(const unsigned int index) const {
+    return (index < objects_.size()) ? objects_[index] : NULL;
+  }
+
+  size_t size() const { return objects_.size(); }
+}; // class WorkerLocal
+
+} // namespace parallel
+
+#endif // PARALLEL_WORKER_LOCAL_H
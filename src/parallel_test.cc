@@ -0,0 +1,491 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "parallel/numa.h"
+#include "parallel/parallel_for.h"
+#include "parallel/pipeline.h"
+#include "parallel/threadpool.h"
+#include "parallel/worker_local.h"
+#include "wave/wave_gain.h"
+
+DEFINE_uint32(num_threads, 4, "number of threads");
+DEFINE_uint32(num_jobs, 1000000, "number of jobs");
+DEFINE_uint32(num_children, 4, "number of jobs spawned by each job in nested test");
+DEFINE_uint32(queue_capacity, 1024, "capacity of bounded queue");
+DEFINE_uint32(num_spins, 1 << 14, "spins of idle policy in latency test");
+
+static std::atomic<unsigned long> counter(0);
+
+// Set while calling thread waits for its parallel loop
+static thread_local bool tls_is_waiting = false;
+
+void count(void* arg) {
+  counter += *(unsigned int*)arg;
+}
+
+typedef struct spawn_arg_t {
+  parallel::ThreadPool* pool_;
+  unsigned int depth_;
+} SpawnArg;
+
+// Spawn children from worker, which go to its own deque and are stolen by others
+void spawn(void* arg) {
+  SpawnArg* spawn_arg = (SpawnArg*)arg;
+  counter++;
+  if (spawn_arg->depth_ > 0) {
+    for (unsigned int i = 0; i < FLAGS_num_children; i++) {
+      SpawnArg* child = new SpawnArg;
+      child->pool_ = spawn_arg->pool_;
+      child->depth_ = spawn_arg->depth_ - 1;
+      spawn_arg->pool_->addJob(spawn, (void*)child);
+    }
+  }
+  delete spawn_arg;
+}
+
+double elapsedSec(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int testPool(parallel::ThreadPool& pool) {
+  int error_code = 0;
+
+  // Many tiny jobs from outside of pool
+  unsigned int one = 1;
+  counter = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int n = 0; n < FLAGS_num_jobs; n++) {
+    pool.addJob(count, (void*)&one);
+  }
+  pool.wait();
+  double sec = elapsedSec(start);
+  fprintf(stdout, "flat   : %lu / %u jobs, %.3f sec (%.0f jobs/sec)\n",
+          counter.load(), FLAGS_num_jobs, sec, FLAGS_num_jobs / sec);
+  if (counter != FLAGS_num_jobs) {
+    error_code = 1;
+  }
+
+  // Nested jobs spawned by workers
+  unsigned int depth = 0;
+  unsigned long expected = 1;
+  for (unsigned long n = 1; expected + n * FLAGS_num_children <= FLAGS_num_jobs; depth++) {
+    n *= FLAGS_num_children;
+    expected += n;
+  }
+  counter = 0;
+  start = std::chrono::steady_clock::now();
+  SpawnArg* root = new SpawnArg;
+  root->pool_ = &pool;
+  root->depth_ = depth;
+  pool.addJob(spawn, (void*)root);
+  pool.wait();
+  sec = elapsedSec(start);
+  fprintf(stdout, "nested : %lu / %lu jobs, %.3f sec (%.0f jobs/sec)\n",
+          counter.load(), expected, sec, expected / sec);
+  if (counter != expected) {
+    error_code = 1;
+  }
+
+  return error_code;
+}
+
+// Sum of range computed by tasks which split range and wait for their halves
+long sumRange(parallel::ThreadPool* pool, long begin, long end) {
+  if (end - begin <= 1000) {
+    long sum = 0;
+    for (long i = begin; i < end; i++) {
+      sum += i;
+    }
+    return sum;
+  }
+  const long middle = begin + (end - begin) / 2;
+  parallel::Future<long> left = pool->submit([pool, begin, middle]() {
+    return sumRange(pool, begin, middle);
+  });
+  const long right = sumRange(pool, middle, end);
+  return left.get() + right;
+}
+
+int testTask(parallel::ThreadPool& pool) {
+  int error_code = 0;
+
+  // Results of futures
+  const unsigned int num_tasks = FLAGS_num_jobs / 10;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<parallel::Future<unsigned long>> futures;
+  for (unsigned int n = 0; n < num_tasks; n++) {
+    futures.push_back(pool.submit([n]() { return (unsigned long)n * n; }));
+  }
+  unsigned long sum = 0;
+  unsigned long expected = 0;
+  for (unsigned int n = 0; n < num_tasks; n++) {
+    sum += futures[n].get();
+    expected += (unsigned long)n * n;
+  }
+  double sec = elapsedSec(start);
+  fprintf(stdout, "future : %u tasks, %.3f sec (%.0f tasks/sec)\n",
+          num_tasks, sec, num_tasks / sec);
+  if (sum != expected) {
+    error_code = 1;
+  }
+
+  // Exception is rethrown by future
+  parallel::Future<int> failed = pool.submit([]() -> int {
+    throw std::runtime_error("expected error");
+  });
+  try {
+    failed.get();
+    error_code = 1;
+  } catch (const std::runtime_error& e) {
+    fprintf(stdout, "future : caught \"%s\"\n", e.what());
+  }
+
+  // Tasks waiting for other tasks on workers
+  const long num_elements = 1000000;
+  parallel::Future<long> total = pool.submit([&pool, num_elements]() {
+    return sumRange(&pool, 0, num_elements);
+  });
+  if (total.get() != num_elements * (num_elements - 1) / 2) {
+    error_code = 1;
+  }
+
+  // Failures are counted by group
+  parallel::TaskGroup group(&pool);
+  counter = 0;
+  for (unsigned int n = 0; n < 100; n++) {
+    group.run([n]() { counter++; return (n % 10 == 0) ? 1 : 0; });
+  }
+  group.wait();
+  fprintf(stdout, "group  : %lu tasks, %u failed\n", counter.load(), group.getNumFailed());
+  if (counter != 100 || group.getNumFailed() != 10) {
+    error_code = 1;
+  }
+
+  return error_code;
+}
+
+int testParallelFor(parallel::ThreadPool& pool) {
+  int error_code = 0;
+
+  // Every element is visited once
+  const size_t length = FLAGS_num_jobs;
+  std::vector<unsigned int> visited(length, 0);
+  auto start = std::chrono::steady_clock::now();
+  parallel::parallelFor(&pool, 0, length, 0, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      visited[i]++;
+    }
+  });
+  double sec = elapsedSec(start);
+  size_t num_visited = 0;
+  for (size_t i = 0; i < length; i++) {
+    num_visited += (visited[i] == 1) ? 1 : 0;
+  }
+  fprintf(stdout, "for    : %lu / %lu elements, %.3f sec\n", num_visited, length, sec);
+  if (num_visited != length) {
+    error_code = 1;
+  }
+
+  // Worker waiting for its loop does not start jobs added from outside of
+  // pool, which can be much longer than its own tasks. Upper half of loop
+  // is stolen and takes longer, so that the worker waits while other jobs
+  // are queued.
+  std::atomic<unsigned int> num_nested(0);
+  parallel::Future<int> outer = pool.submit([&pool]() {
+    tls_is_waiting = true;
+    parallel::parallelFor(&pool, 0, 2, 1, [](size_t begin, size_t) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(begin == 0 ? 10 : 30));
+    });
+    tls_is_waiting = false;
+    return 0;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  std::vector<parallel::Future<int>> others;
+  for (unsigned int n = 0; n < 64; n++) {
+    others.push_back(pool.submit([&num_nested]() {
+      if (tls_is_waiting) {
+        num_nested++;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      return 0;
+    }));
+  }
+  outer.get();
+  for (auto& other : others) {
+    other.get();
+  }
+  fprintf(stdout, "for    : %u outside jobs run while waiting\n", num_nested.load());
+  if (num_nested != 0) {
+    error_code = 1;
+  }
+
+  // Statistics reduced in parallel equal to sequential ones
+  std::vector<float> wav(length);
+  for (size_t i = 0; i < length; i++) {
+    wav[i] = (float)((i * 7919) % 2001) / 1000.0f - 1.0f;
+  }
+  start = std::chrono::steady_clock::now();
+  wave::WaveStatsAccumulator acc = parallel::parallelReduce(
+      &pool, 0, length, 0, wave::WaveStatsAccumulator(),
+      [&](size_t begin, size_t end) {
+        wave::WaveStatsAccumulator partial;
+        partial.update(wav.data() + begin, (unsigned int)(end - begin));
+        return partial;
+      },
+      [](wave::WaveStatsAccumulator a, const wave::WaveStatsAccumulator& b) {
+        a.merge(b);
+        return a;
+      });
+  sec = elapsedSec(start);
+  wave::WaveStats stats, expected;
+  acc.getStats(&stats);
+  wave::computeStats(wav.data(), (unsigned int)length, &expected);
+  fprintf(stdout, "reduce : rms %.9f (expected %.9f), %.3f sec\n",
+          stats.rms, expected.rms, sec);
+  if (stats.num_samples != expected.num_samples ||
+      stats.peak != expected.peak ||
+      fabs(stats.rms - expected.rms) > 1e-12 ||
+      fabs(stats.dc_offset - expected.dc_offset) > 1e-12) {
+    error_code = 1;
+  }
+
+  return error_code;
+}
+
+void markWorker(unsigned int index, void* arg) {
+  std::vector<std::atomic<unsigned int>>* marks = (std::vector<std::atomic<unsigned int>>*)arg;
+  (*marks)[index]++;
+}
+
+int testAffinity() {
+  int error_code = 0;
+
+  const parallel::NumaTopology& topology = parallel::getNumaTopology();
+  for (size_t node = 0; node < topology.node_cpus.size(); node++) {
+    fprintf(stdout, "numa   : node %lu has %lu cpus\n", node, topology.node_cpus[node].size());
+  }
+
+  parallel::ThreadPool pool(FLAGS_num_threads, 0, parallel::kAffinityNode);
+
+  // Every worker runs broadcast once
+  std::vector<std::atomic<unsigned int>> marks(pool.getNumThreads());
+  for (auto& mark : marks) {
+    mark = 0;
+  }
+  pool.runOnEachWorker(markWorker, (void*)&marks);
+  for (auto& mark : marks) {
+    if (mark != 1) {
+      error_code = 1;
+    }
+  }
+
+  // Worker reports its node, and allocates memory there
+  parallel::Future<int> node = pool.submit([&pool]() {
+    const int current = pool.getCurrentNode();
+    char* buffer = (char*)parallel::allocOnNode(1 << 20, current);
+    if (buffer == NULL) {
+      return -1;
+    }
+    buffer[(1 << 20) - 1] = 1;
+    parallel::freeOnNode(buffer, 1 << 20);
+    return current;
+  });
+  const int worker_node = node.get();
+  fprintf(stdout, "numa   : worker on node %d\n", worker_node);
+  if (worker_node < 0 || worker_node >= (int)topology.node_cpus.size()) {
+    error_code = 1;
+  }
+
+  return error_code;
+}
+
+// First stage drops multiples of 3, second one squares, last one sums
+void* dropStage(void* item, const unsigned int, void*) {
+  long* value = (long*)item;
+  if ((*value) % 3 == 0) {
+    delete value;
+    return NULL;
+  }
+  return item;
+}
+
+void* squareStage(void* item, const unsigned int, void*) {
+  long* value = (long*)item;
+  (*value) = (*value) * (*value);
+  return item;
+}
+
+void* sumStage(void* item, const unsigned int, void* context) {
+  long* value = (long*)item;
+  (*(std::atomic<long>*)context) += (*value);
+  delete value;
+  return NULL;
+}
+
+int testPipeline() {
+  const long num_items = 100000;
+  std::atomic<long> sum(0);
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    parallel::Pipeline pipeline(16);
+    pipeline.addStage("drop", 2, dropStage, NULL);
+    pipeline.addStage("square", FLAGS_num_threads, squareStage, NULL);
+    pipeline.addStage("sum", 1, sumStage, (void*)&sum);
+    pipeline.start();
+    for (long n = 0; n < num_items; n++) {
+      pipeline.push(new long(n));
+    }
+    pipeline.finish();
+    pipeline.report(stdout);
+  }
+
+  long expected = 0;
+  for (long n = 0; n < num_items; n++) {
+    if (n % 3 != 0) {
+      expected += n * n;
+    }
+  }
+  fprintf(stdout, "pipe   : %ld items in %.3f sec, sum %ld (expected %ld)\n",
+          num_items, elapsedSec(start), sum.load(), expected);
+  return (sum == expected) ? 0 : 1;
+}
+
+// Round trip of tiny task, from submission to result
+int testLatency(const char* name, const parallel::IdlePolicy& policy) {
+  const unsigned int num_tasks = 20000;
+  parallel::ThreadPool pool(FLAGS_num_threads, 0, parallel::kAffinityNone, policy);
+
+  long sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int n = 0; n < num_tasks; n++) {
+    sum += pool.submit([n]() { return (long)n; }).get();
+  }
+  const double sec = elapsedSec(start);
+  pool.wait();
+  fprintf(stdout, "%-6s : %.3f usec per round trip\n", name, sec * 1e6 / num_tasks);
+  return (sum == (long)num_tasks * (num_tasks - 1) / 2) ? 0 : 1;
+}
+
+typedef struct worker_counter_t {
+  int created_by;                 // index of worker which created this counter
+  std::thread::id creator_thread;
+  unsigned long count;            // updated only by owner, without atomic
+} WorkerCounter;
+
+int testWorkerLocal(parallel::ThreadPool& pool) {
+  int error_code = 0;
+
+  parallel::WorkerLocal<WorkerCounter> counters(&pool, [&pool](unsigned int) {
+    WorkerCounter* counter = new WorkerCounter();
+    counter->created_by = pool.currentWorkerIndex();
+    counter->creator_thread = std::this_thread::get_id();
+    counter->count = 0;
+    return counter;
+  });
+  if (!counters.isValid() || counters.local() != NULL ||
+      pool.currentWorkerIndex() != -1) {
+    error_code = 1;
+  }
+  for (unsigned int i = 0; i < counters.size(); i++) {
+    if (counters.get(i)->created_by != (int)i) {
+      error_code = 1;
+    }
+  }
+
+  // Every job runs on worker, and sees object created by that worker
+  const unsigned long num_jobs = FLAGS_num_jobs / 10;
+  std::atomic<unsigned long> num_matched(0);
+  parallel::TaskGroup group(&pool);
+  for (unsigned long n = 0; n < num_jobs; n++) {
+    group.run([&pool, &counters, &num_matched]() {
+      const int index = pool.currentWorkerIndex();
+      WorkerCounter* counter = counters.local();
+      if (index < 0 || counter == NULL || counter != counters.get(index) ||
+          counter->creator_thread != std::this_thread::get_id()) {
+        return 1;
+      }
+      counter->count++;
+      num_matched++;
+      return 0;
+    });
+  }
+  group.wait();
+
+  unsigned long sum = 0;
+  for (unsigned int i = 0; i < counters.size(); i++) {
+    sum += counters.get(i)->count;
+  }
+  fprintf(stdout, "local  : %lu / %lu jobs matched, %lu counted by workers\n",
+          num_matched.load(), num_jobs, sum);
+  if (group.getNumFailed() != 0 || num_matched != num_jobs || sum != num_jobs) {
+    error_code = 1;
+  }
+  return error_code;
+}
+
+int main(int argc, char** argv) {
+
+  gflags::SetUsageMessage("parallel_test");
+  gflags::SetVersionString("1.0.0");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  int error_code = 0;
+  {
+    fprintf(stdout, "[unbounded queue]\n");
+    parallel::ThreadPool pool(FLAGS_num_threads);
+    error_code |= testPool(pool);
+    error_code |= testTask(pool);
+    error_code |= testParallelFor(pool);
+    error_code |= testWorkerLocal(pool);
+
+    // Every job is recorded once, if statistics are collected
+    parallel::PoolStats stats;
+    if (pool.getStats(&stats) == 0) {
+      parallel::printPoolStats(stdout, stats);
+      if (stats.run_nsec.getCount() != pool.getNumProcessed() ||
+          stats.wait_nsec.getCount() != pool.getNumProcessed()) {
+        error_code = 1;
+      }
+    }
+  }
+  {
+    fprintf(stdout, "[bounded queue of %u]\n", FLAGS_queue_capacity);
+    parallel::ThreadPool pool(FLAGS_num_threads, FLAGS_queue_capacity);
+    error_code |= testPool(pool);
+    error_code |= testTask(pool);
+
+    // Producer is rejected while queue is full
+    unsigned int one = 1;
+    unsigned int num_added = 0;
+    counter = 0;
+    for (unsigned int n = 0; n < FLAGS_num_jobs; n++) {
+      if (pool.tryAddJob(count, (void*)&one)) {
+        num_added++;
+      }
+    }
+    pool.wait();
+    fprintf(stdout, "try    : %lu / %u jobs accepted\n", counter.load(), num_added);
+    if (counter != num_added) {
+      error_code = 1;
+    }
+  }
+
+  error_code |= testAffinity();
+  error_code |= testPipeline();
+  error_code |= testLatency("park", parallel::IdlePolicy());
+  error_code |= testLatency("spin", parallel::IdlePolicy(FLAGS_num_spins, 16));
+
+  fprintf(stdout, "%s\n", (error_code == 0) ? "PASSED" : "FAILED");
+
+  gflags::ShutDownCommandLineFlags();
+  return error_code;
+}
@@ -1,11 +1,13 @@
 #include "wave/wave.h"
 
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "wave/wave_core.h"
+#include "wave/wave_flac.h"
 
 #ifndef BITS_PER_BYTE
 #define BITS_PER_BYTE 8
@@ -90,6 +92,171 @@ void convert_char_to_float(const unsigned int bit_rate,
   samples = NULL;
 }
 
+template <typename T>
+int read_flac(FlacDecoder *decoder, const unsigned int sampling_rate,
+              const unsigned int bit_rate, const unsigned int num_channels,
+              T **dest, unsigned int *dest_size) {
+  int error_code;
+
+  if (decoder->getNumChannels() != num_channels) {
+    fprintf(stderr,
+            "wave::WaveReader::read() - Invalid input file. Expected number of "
+            "channels : %d, but given %d\n",
+            (int)num_channels, (int)decoder->getNumChannels());
+    return WAVE_INVALID_FORMAT;
+  }
+  if (decoder->getSamplingRate() != sampling_rate) {
+    fprintf(stderr,
+            "wave::WaveReader::read() - Invalid input file. Expected sampling "
+            "rate : %d, but given %d\n",
+            (int)sampling_rate, (int)decoder->getSamplingRate());
+    return WAVE_INVALID_FORMAT;
+  }
+  if (decoder->getBitRate() != bit_rate) {
+    fprintf(stderr,
+            "wave::WaveReader::read() - Invalid input file. Expected bit "
+            "rate : %d, but given %d\n",
+            (int)bit_rate, (int)decoder->getBitRate());
+    return WAVE_INVALID_FORMAT;
+  }
+
+  // Release pre-allocated memory
+  if ((*dest) != NULL) {
+    delete[](*dest);
+    (*dest) = NULL;
+  }
+
+  // Number of samples is unknown if STREAMINFO does not have it, in that case
+  // buffer is grown while decoding.
+  const uint64_t total_samples = decoder->getTotalSamples();
+  if (total_samples > UINT_MAX / num_channels) {
+    fprintf(stderr,
+            "wave::WaveReader::read() - Too many samples in input file : "
+            "%llu\n",
+            (unsigned long long)total_samples);
+    return WAVE_INVALID_FORMAT;
+  }
+  // Largest number of samples held in a buffer, multiple of channels
+  const unsigned int max_capacity = UINT_MAX - UINT_MAX % num_channels;
+  const bool is_known = (total_samples > 0);
+  unsigned int capacity = (unsigned int)total_samples * num_channels;
+  if (!is_known) {
+    capacity = sampling_rate * num_channels;
+  }
+  T *samples = new T[capacity];
+  unsigned int num_samples = 0;
+
+  while (true) {
+    if (num_samples == capacity) {
+      // Whole stream is decoded if its length is known
+      if (is_known) {
+        break;
+      }
+      if (capacity == max_capacity) {
+        fprintf(stderr,
+                "wave::WaveReader::read() - Too many samples in input file.\n");
+        delete[] samples;
+        return WAVE_INVALID_FORMAT;
+      }
+      capacity = (capacity > max_capacity / 2) ? max_capacity : capacity * 2;
+      T *grown = new T[capacity];
+      memcpy((void *)grown, (const void *)samples, sizeof(T) * num_samples);
+      delete[] samples;
+      samples = grown;
+    }
+
+    unsigned int n = 0;
+    error_code = decoder->read(samples + num_samples, capacity - num_samples, &n);
+    if (error_code != WAVE_SUCCESS) {
+      delete[] samples;
+      return error_code;
+    }
+    if (n == 0) {
+      break;
+    }
+    num_samples += n;
+  }
+
+  (*dest) = samples;
+  (*dest_size) = num_samples;
+  return WAVE_SUCCESS;
+}
+
+static bool is_wave_bytes(const unsigned char *bytes, const size_t num_bytes) {
+  return (num_bytes >= 4) && (memcmp(bytes, "RIFF", 4) == 0);
+}
+
+// FLAC may be preceded by ID3 tag
+static bool is_flac_bytes(const unsigned char *bytes, const size_t num_bytes) {
+  return (num_bytes >= 4) && ((memcmp(bytes, "fLaC", 4) == 0) ||
+                              (memcmp(bytes, "ID3", 3) == 0));
+}
+
+template <typename T>
+int read_memory(WaveCore *core, const unsigned int sampling_rate,
+                const unsigned int bit_rate, const unsigned int num_channels,
+                const unsigned char *bytes, const size_t num_bytes,
+                const bool is_pcm, T **dest, unsigned int *dest_size) {
+  int error_code;
+
+  if (is_pcm) {
+    // Headerless PCM holds whole samples of all channels
+    const size_t block_align = (size_t)(bit_rate / 8) * num_channels;
+    if ((block_align == 0) || (num_bytes % block_align != 0) ||
+        (num_bytes > UINT_MAX)) {
+      fprintf(stderr, "read_memory() - invalid size of PCM : %zu bytes.\n",
+              num_bytes);
+      return WAVE_INVALID_FORMAT;
+    }
+    return convertChar2Float(bit_rate, bytes, (unsigned int)num_bytes, dest,
+                             dest_size);
+  }
+
+  if (is_wave_bytes(bytes, num_bytes)) {
+    error_code = core->init(sampling_rate, bit_rate, num_channels, bytes,
+                            num_bytes);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+
+    error_code = core->readHeader();
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+
+    error_code = core->readData();
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+
+    return convertChar2Float(bit_rate, core->getBytePtr(), core->getNumBytes(),
+                             dest, dest_size);
+  }
+
+  if (is_flac_bytes(bytes, num_bytes)) {
+    FILE *fp = fmemopen((void *)bytes, num_bytes, "rb");
+    if (fp == NULL) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    FlacDecoder decoder;
+    error_code = decoder.open(fp);
+    if (error_code == WAVE_SUCCESS) {
+      error_code = read_flac<T>(&decoder, sampling_rate, bit_rate, num_channels,
+                                dest, dest_size);
+    }
+    decoder.close();
+    fclose(fp);
+    return error_code;
+  }
+
+  fprintf(stderr, "read_memory() - unknown format of audio.\n");
+  return WAVE_INVALID_FORMAT;
+}
+
+bool isAudioBytes(const unsigned char *bytes, const size_t num_bytes) {
+  return is_wave_bytes(bytes, num_bytes) || is_flac_bytes(bytes, num_bytes);
+}
+
 int convertFloat2Char(const unsigned int bit_rate, const float *src,
                       const unsigned int num_samples, unsigned char **dest,
                       unsigned int *num_bytes) {
@@ -240,6 +407,16 @@ int WaveReader::read(const char *file_name, float **dest,
     return WAVE_INVALID_ARG_VALUE;
   }
 
+  if (isFlacFileName(file_name)) {
+    FlacDecoder decoder;
+    error_code = decoder.open(file_name);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+    return read_flac<float>(&decoder, sampling_rate_, bit_rate_, num_channels_,
+                         dest, dest_size);
+  }
+
   if (core_ == NULL) {
     error_code = init(sampling_rate_, bit_rate_, num_channels_);
     if (error_code != WAVE_SUCCESS) {
@@ -272,6 +449,45 @@ int WaveReader::read(const char *file_name, float **dest,
   return WAVE_SUCCESS;
 }
 
+int WaveReader::readNumSamples(const char *file_name,
+                               unsigned int *num_samples) {
+  int error_code;
+
+  if ((file_name == NULL) || (num_samples == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  if (isFlacFileName(file_name)) {
+    FlacDecoder decoder;
+    error_code = decoder.open(file_name);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+    (*num_samples) = (unsigned int)decoder.getTotalSamples();
+    return WAVE_SUCCESS;
+  }
+
+  if (core_ == NULL) {
+    error_code = init(sampling_rate_, bit_rate_, num_channels_);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+  }
+
+  error_code = core_->init(sampling_rate_, bit_rate_, num_channels_, file_name,
+                           WaveCore::kWaveCoreModeReadOnly);
+  if (error_code != WAVE_SUCCESS) {
+    return error_code;
+  }
+
+  error_code = core_->readHeader();
+  if (error_code == WAVE_SUCCESS) {
+    (*num_samples) = core_->getNumBytes() / (bit_rate_ / 8 * num_channels_);
+  }
+  core_->clear();
+  return error_code;
+}
+
 int WaveReader::read(const char *file_name, double **dest,
                      unsigned int *dest_size) {
   int error_code;
@@ -280,6 +496,16 @@ int WaveReader::read(const char *file_name, double **dest,
     return WAVE_INVALID_ARG_VALUE;
   }
 
+  if (isFlacFileName(file_name)) {
+    FlacDecoder decoder;
+    error_code = decoder.open(file_name);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+    return read_flac<double>(&decoder, sampling_rate_, bit_rate_, num_channels_,
+                         dest, dest_size);
+  }
+
   if (core_ == NULL) {
     error_code = init(sampling_rate_, bit_rate_, num_channels_);
     if (error_code != WAVE_SUCCESS) {
@@ -312,6 +538,86 @@ int WaveReader::read(const char *file_name, double **dest,
   return WAVE_SUCCESS;
 }
 
+int WaveReader::read(const unsigned char *bytes, const size_t num_bytes,
+                     float **dest, unsigned int *dest_size) {
+  int error_code;
+
+  if ((bytes == NULL) || (num_bytes == 0) || (dest == NULL) ||
+      (dest_size == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  if (core_ == NULL) {
+    error_code = init(sampling_rate_, bit_rate_, num_channels_);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+  }
+
+  return read_memory<float>(core_, sampling_rate_, bit_rate_, num_channels_,
+                            bytes, num_bytes, false, dest, dest_size);
+}
+
+int WaveReader::readPcm(const unsigned char *bytes, const size_t num_bytes,
+                        float **dest, unsigned int *dest_size) {
+  int error_code;
+
+  if ((bytes == NULL) || (num_bytes == 0) || (dest == NULL) ||
+      (dest_size == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  if (core_ == NULL) {
+    error_code = init(sampling_rate_, bit_rate_, num_channels_);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+  }
+
+  return read_memory<float>(core_, sampling_rate_, bit_rate_, num_channels_,
+                            bytes, num_bytes, true, dest, dest_size);
+}
+
+int WaveReader::read(const unsigned char *bytes, const size_t num_bytes,
+                     double **dest, unsigned int *dest_size) {
+  int error_code;
+
+  if ((bytes == NULL) || (num_bytes == 0) || (dest == NULL) ||
+      (dest_size == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  if (core_ == NULL) {
+    error_code = init(sampling_rate_, bit_rate_, num_channels_);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+  }
+
+  return read_memory<double>(core_, sampling_rate_, bit_rate_, num_channels_,
+                             bytes, num_bytes, false, dest, dest_size);
+}
+
+int WaveReader::readPcm(const unsigned char *bytes, const size_t num_bytes,
+                        double **dest, unsigned int *dest_size) {
+  int error_code;
+
+  if ((bytes == NULL) || (num_bytes == 0) || (dest == NULL) ||
+      (dest_size == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  if (core_ == NULL) {
+    error_code = init(sampling_rate_, bit_rate_, num_channels_);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+  }
+
+  return read_memory<double>(core_, sampling_rate_, bit_rate_, num_channels_,
+                             bytes, num_bytes, true, dest, dest_size);
+}
+
 WaveWriter::WaveWriter(const unsigned int sampling_rate,
                        const unsigned int bit_rate,
                        const unsigned int num_channels)
@@ -10,6 +10,8 @@
 #define WAVE_UNSUPPORTED_TYPE -5
 #define WAVE_INVALID_FORMAT -6
 
+#include <stddef.h>
+
 namespace wave {
 
 // Supported sampling rates
@@ -75,6 +77,9 @@ int convertChar2Float(const unsigned int bit_rate, const unsigned char *src,
                       const unsigned int num_bytes, double **dest,
                       unsigned int *num_samples);
 
+// Whether bytes are in format of wave or FLAC, which WaveReader::read() accepts
+bool isAudioBytes(const unsigned char *bytes, const size_t num_bytes);
+
 class WaveReader {
 public:
   WaveReader(const unsigned int sampling_rate = 0,
@@ -100,6 +105,26 @@ public:
 
   int read(const char *file_name, float **dest, unsigned int *dest_size);
   int read(const char *file_name, double **dest, unsigned int *dest_size);
+
+  // Read audio placed in memory, such as a member of shard.
+  // Format is detected by magic number : RIFF wave or FLAC, and otherwise
+  // WAVE_INVALID_FORMAT is returned.
+  int read(const unsigned char *bytes, const size_t num_bytes, float **dest,
+           unsigned int *dest_size);
+  int read(const unsigned char *bytes, const size_t num_bytes, double **dest,
+           unsigned int *dest_size);
+
+  // Read `bytes` as headerless PCM of given format. `num_bytes` must be
+  // multiple of size of a sample times number of channels.
+  int readPcm(const unsigned char *bytes, const size_t num_bytes,
+              float **dest, unsigned int *dest_size);
+  int readPcm(const unsigned char *bytes, const size_t num_bytes,
+              double **dest, unsigned int *dest_size);
+
+  // Number of samples per channel, read from header of WAV or FLAC file
+  // without decoding its data. `num_samples` is 0 if FLAC header does not
+  // have it.
+  int readNumSamples(const char *file_name, unsigned int *num_samples);
 }; // class WaveReader
 
 class WaveWriter {
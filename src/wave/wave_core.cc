@@ -127,6 +127,33 @@ int WaveCore::init(const unsigned int sampling_rate,
   return WAVE_SUCCESS;
 }
 
+int WaveCore::init(const unsigned int sampling_rate,
+                   const unsigned int bit_rate, const unsigned int num_channels,
+                   const unsigned char *bytes, const size_t num_bytes) {
+
+  if ((bytes == NULL) || (num_bytes == 0)) {
+    fprintf(stderr, "wave::WaveCore::init() - invalid argument `bytes`.\n");
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  clear();
+
+  sampling_rate_ = sampling_rate;
+  bit_rate_ = bit_rate;
+  num_channels_ = num_channels;
+  mode_ = kWaveCoreModeReadOnly;
+
+  fp_ = fmemopen((void *)bytes, num_bytes, "rb");
+  if (fp_ == NULL) {
+    fprintf(stderr, "wave::WaveCore::init() - failed to open memory stream.\n");
+    return WAVE_FILE_IO_FAILED;
+  }
+
+  is_initialized_ = true;
+
+  return WAVE_SUCCESS;
+}
+
 void WaveCore::clear() {
 
   sampling_rate_ = 0;
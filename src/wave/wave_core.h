@@ -44,6 +44,12 @@ public:
            const unsigned int num_channels, const char *file_name,
            const wave_core_mode_t mode);
 
+  // Initialize variables for reading wave file placed in memory.
+  // `bytes` must be alive until reading is finished.
+  int init(const unsigned int sampling_rate, const unsigned int bit_rate,
+           const unsigned int num_channels, const unsigned char *bytes,
+           const size_t num_bytes);
+
   // Clear all variables in this class, including `mode_`
   // After clear, you must re-initialize this class using init() method
   void clear();
@@ -0,0 +1,974 @@
+#include "wave/wave_flac.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "wave/wave.h"
+
+#ifndef FLAC_INPUT_BUFFER_SIZE
+#define FLAC_INPUT_BUFFER_SIZE (1 << 16)
+#endif
+
+#ifndef FLAC_MAX_CHANNELS
+#define FLAC_MAX_CHANNELS 8
+#endif
+
+#ifndef FLAC_MAX_BITS_PER_SAMPLE
+#define FLAC_MAX_BITS_PER_SAMPLE 24
+#endif
+
+#ifndef FLAC_MAX_LPC_ORDER
+#define FLAC_MAX_LPC_ORDER 32
+#endif
+
+namespace wave {
+
+enum flac_channel_assignment_t {
+  kFlacChannelIndependent = 0,
+  kFlacChannelLeftSide = 8,
+  kFlacChannelSideRight = 9,
+  kFlacChannelMidSide = 10
+};
+
+static const unsigned char kCrc8Table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31,
+    0x24, 0x23, 0x2A, 0x2D, 0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65,
+    0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D, 0xE0, 0xE7, 0xEE, 0xE9,
+    0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1,
+    0xB4, 0xB3, 0xBA, 0xBD, 0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2,
+    0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA, 0xB7, 0xB0, 0xB9, 0xBE,
+    0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16,
+    0x03, 0x04, 0x0D, 0x0A, 0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42,
+    0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A, 0x89, 0x8E, 0x87, 0x80,
+    0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8,
+    0xDD, 0xDA, 0xD3, 0xD4, 0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C,
+    0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44, 0x19, 0x1E, 0x17, 0x10,
+    0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F,
+    0x6A, 0x6D, 0x64, 0x63, 0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B,
+    0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13, 0xAE, 0xA9, 0xA0, 0xA7,
+    0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF,
+    0xFA, 0xFD, 0xF4, 0xF3};
+
+// CRC-16 of frame, polynomial x^16 + x^15 + x^2 + 1
+static const uint16_t kCrc16Table[256] = {
+    0x0000, 0x8005, 0x800F, 0x000A, 0x801B, 0x001E, 0x0014, 0x8011,
+    0x8033, 0x0036, 0x003C, 0x8039, 0x0028, 0x802D, 0x8027, 0x0022,
+    0x8063, 0x0066, 0x006C, 0x8069, 0x0078, 0x807D, 0x8077, 0x0072,
+    0x0050, 0x8055, 0x805F, 0x005A, 0x804B, 0x004E, 0x0044, 0x8041,
+    0x80C3, 0x00C6, 0x00CC, 0x80C9, 0x00D8, 0x80DD, 0x80D7, 0x00D2,
+    0x00F0, 0x80F5, 0x80FF, 0x00FA, 0x80EB, 0x00EE, 0x00E4, 0x80E1,
+    0x00A0, 0x80A5, 0x80AF, 0x00AA, 0x80BB, 0x00BE, 0x00B4, 0x80B1,
+    0x8093, 0x0096, 0x009C, 0x8099, 0x0088, 0x808D, 0x8087, 0x0082,
+    0x8183, 0x0186, 0x018C, 0x8189, 0x0198, 0x819D, 0x8197, 0x0192,
+    0x01B0, 0x81B5, 0x81BF, 0x01BA, 0x81AB, 0x01AE, 0x01A4, 0x81A1,
+    0x01E0, 0x81E5, 0x81EF, 0x01EA, 0x81FB, 0x01FE, 0x01F4, 0x81F1,
+    0x81D3, 0x01D6, 0x01DC, 0x81D9, 0x01C8, 0x81CD, 0x81C7, 0x01C2,
+    0x0140, 0x8145, 0x814F, 0x014A, 0x815B, 0x015E, 0x0154, 0x8151,
+    0x8173, 0x0176, 0x017C, 0x8179, 0x0168, 0x816D, 0x8167, 0x0162,
+    0x8123, 0x0126, 0x012C, 0x8129, 0x0138, 0x813D, 0x8137, 0x0132,
+    0x0110, 0x8115, 0x811F, 0x011A, 0x810B, 0x010E, 0x0104, 0x8101,
+    0x8303, 0x0306, 0x030C, 0x8309, 0x0318, 0x831D, 0x8317, 0x0312,
+    0x0330, 0x8335, 0x833F, 0x033A, 0x832B, 0x032E, 0x0324, 0x8321,
+    0x0360, 0x8365, 0x836F, 0x036A, 0x837B, 0x037E, 0x0374, 0x8371,
+    0x8353, 0x0356, 0x035C, 0x8359, 0x0348, 0x834D, 0x8347, 0x0342,
+    0x03C0, 0x83C5, 0x83CF, 0x03CA, 0x83DB, 0x03DE, 0x03D4, 0x83D1,
+    0x83F3, 0x03F6, 0x03FC, 0x83F9, 0x03E8, 0x83ED, 0x83E7, 0x03E2,
+    0x83A3, 0x03A6, 0x03AC, 0x83A9, 0x03B8, 0x83BD, 0x83B7, 0x03B2,
+    0x0390, 0x8395, 0x839F, 0x039A, 0x838B, 0x038E, 0x0384, 0x8381,
+    0x0280, 0x8285, 0x828F, 0x028A, 0x829B, 0x029E, 0x0294, 0x8291,
+    0x82B3, 0x02B6, 0x02BC, 0x82B9, 0x02A8, 0x82AD, 0x82A7, 0x02A2,
+    0x82E3, 0x02E6, 0x02EC, 0x82E9, 0x02F8, 0x82FD, 0x82F7, 0x02F2,
+    0x02D0, 0x82D5, 0x82DF, 0x02DA, 0x82CB, 0x02CE, 0x02C4, 0x82C1,
+    0x8243, 0x0246, 0x024C, 0x8249, 0x0258, 0x825D, 0x8257, 0x0252,
+    0x0270, 0x8275, 0x827F, 0x027A, 0x826B, 0x026E, 0x0264, 0x8261,
+    0x0220, 0x8225, 0x822F, 0x022A, 0x823B, 0x023E, 0x0234, 0x8231,
+    0x8213, 0x0216, 0x021C, 0x8219, 0x0208, 0x820D, 0x8207, 0x0202};
+
+static inline unsigned int count_leading_zeros(uint64_t x) {
+#if defined(__GNUC__)
+  return (unsigned int)__builtin_clzll(x);
+#else
+  unsigned int n = 0;
+  while ((x & 0x8000000000000000ULL) == 0) {
+    x <<= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+bool isFlacFileName(const char *file_name) {
+  if (file_name == NULL) {
+    return false;
+  }
+  const char *ext = strrchr(file_name, '.');
+  if (ext == NULL) {
+    return false;
+  }
+  return (strcasecmp(ext, ".flac") == 0) || (strcasecmp(ext, ".fla") == 0);
+}
+
+FlacDecoder::FlacDecoder()
+    : fp_(NULL), own_fp_(false), buffer_(NULL), buffer_size_(0),
+      buffer_pos_(0), is_eof_(false), cache_(0), num_bits_(0),
+      crc_(0), crc_head_(0), num_crc_bytes_(0),
+      sampling_rate_(0), bit_rate_(0), num_channels_(0), max_block_size_(0),
+      total_samples_(0), samples_(NULL), block_size_(0), block_pos_(0) {}
+
+FlacDecoder::~FlacDecoder() {
+  close();
+  if (buffer_ != NULL) {
+    delete[] buffer_;
+    buffer_ = NULL;
+  }
+}
+
+int FlacDecoder::open(const char *file_name) {
+  if (file_name == NULL) {
+    fprintf(stderr, "wave::FlacDecoder::open() - invalid argument `file_name`.\n");
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  FILE *fp = fopen(file_name, "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "wave::FlacDecoder::open() - failed to open file %s\n",
+            file_name);
+    return WAVE_FILE_IO_FAILED;
+  }
+
+  int error_code = open(fp);
+  own_fp_ = true;
+  if (error_code != WAVE_SUCCESS) {
+    close();
+  }
+  return error_code;
+}
+
+int FlacDecoder::open(FILE *fp) {
+  if (fp == NULL) {
+    fprintf(stderr, "wave::FlacDecoder::open() - invalid argument `fp`.\n");
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  close();
+  fp_ = fp;
+  own_fp_ = false;
+
+  if (buffer_ == NULL) {
+    buffer_ = new unsigned char[FLAC_INPUT_BUFFER_SIZE];
+  }
+
+  return readMetadata();
+}
+
+void FlacDecoder::close() {
+  if ((fp_ != NULL) && own_fp_) {
+    fclose(fp_);
+  }
+  fp_ = NULL;
+  own_fp_ = false;
+
+  buffer_size_ = 0;
+  buffer_pos_ = 0;
+  is_eof_ = false;
+  cache_ = 0;
+  num_bits_ = 0;
+  crc_ = 0;
+  crc_head_ = 0;
+  num_crc_bytes_ = 0;
+
+  sampling_rate_ = 0;
+  bit_rate_ = 0;
+  num_channels_ = 0;
+  max_block_size_ = 0;
+  total_samples_ = 0;
+
+  if (samples_ != NULL) {
+    delete[] samples_;
+    samples_ = NULL;
+  }
+  block_size_ = 0;
+  block_pos_ = 0;
+}
+
+///// bit reader /////
+
+int FlacDecoder::refill() {
+  while (num_bits_ <= 56) {
+    if (buffer_pos_ == buffer_size_) {
+      if (is_eof_) {
+        break;
+      }
+      buffer_size_ = fread(buffer_, 1, FLAC_INPUT_BUFFER_SIZE, fp_);
+      buffer_pos_ = 0;
+      if (buffer_size_ == 0) {
+        is_eof_ = true;
+        break;
+      }
+    }
+    const unsigned char byte = buffer_[buffer_pos_++];
+    cache_ |= (uint64_t)byte << (56 - num_bits_);
+    num_bits_ += 8;
+
+    // At most 7 bytes are left in cache before this one, so the oldest of
+    // 8 held bytes is consumed
+    if (num_crc_bytes_ == 8) {
+      crc_ = (uint16_t)((crc_ << 8) ^ kCrc16Table[(crc_ >> 8) ^ crc_bytes_[crc_head_]]);
+      crc_head_ = (crc_head_ + 1) & 7;
+      num_crc_bytes_--;
+    }
+    crc_bytes_[(crc_head_ + num_crc_bytes_) & 7] = byte;
+    num_crc_bytes_++;
+  }
+  return num_bits_;
+}
+
+inline int FlacDecoder::readBits(unsigned int n, uint32_t *value) {
+  if (n == 0) {
+    (*value) = 0;
+    return WAVE_SUCCESS;
+  }
+  if (num_bits_ < n) {
+    refill();
+    if (num_bits_ < n) {
+      return WAVE_FILE_IO_FAILED;
+    }
+  }
+  (*value) = (uint32_t)(cache_ >> (64 - n));
+  cache_ <<= n;
+  num_bits_ -= n;
+  return WAVE_SUCCESS;
+}
+
+inline int FlacDecoder::readSignedBits(unsigned int n, int32_t *value) {
+  uint32_t raw;
+  if (readBits(n, &raw) != WAVE_SUCCESS) {
+    return WAVE_FILE_IO_FAILED;
+  }
+  if (n == 0) {
+    (*value) = 0;
+  } else if (n < 32) {
+    // sign extension
+    const uint32_t sign = (uint32_t)1 << (n - 1);
+    (*value) = (int32_t)((raw ^ sign) - sign);
+  } else {
+    (*value) = (int32_t)raw;
+  }
+  return WAVE_SUCCESS;
+}
+
+// Count zero bits until the next one bit, and consume them all
+inline int FlacDecoder::readUnary(uint32_t *value) {
+  uint32_t count = 0;
+  while (true) {
+    if (num_bits_ == 0) {
+      refill();
+      if (num_bits_ == 0) {
+        return WAVE_FILE_IO_FAILED;
+      }
+    }
+    // Bits after `num_bits_` are always zero, thus the first one bit is
+    // placed in valid region.
+    if (cache_ != 0) {
+      unsigned int num_zeros = count_leading_zeros(cache_);
+      cache_ <<= num_zeros;
+      cache_ <<= 1;
+      num_bits_ -= num_zeros + 1;
+      (*value) = count + num_zeros;
+      return WAVE_SUCCESS;
+    }
+    count += num_bits_;
+    cache_ = 0;
+    num_bits_ = 0;
+  }
+}
+
+int FlacDecoder::skipBytes(size_t n) {
+  uint32_t dummy;
+  while (n > 0 && num_bits_ >= 8) {
+    readBits(8, &dummy);
+    n--;
+  }
+  while (n > 0) {
+    size_t available = buffer_size_ - buffer_pos_;
+    if (available == 0) {
+      if (is_eof_) {
+        return WAVE_FILE_IO_FAILED;
+      }
+      buffer_size_ = fread(buffer_, 1, FLAC_INPUT_BUFFER_SIZE, fp_);
+      buffer_pos_ = 0;
+      if (buffer_size_ == 0) {
+        is_eof_ = true;
+        return WAVE_FILE_IO_FAILED;
+      }
+      continue;
+    }
+    size_t m = (available < n) ? available : n;
+    buffer_pos_ += m;
+    n -= m;
+  }
+  return WAVE_SUCCESS;
+}
+
+void FlacDecoder::alignToByte() {
+  unsigned int remainder = num_bits_ % 8;
+  cache_ <<= remainder;
+  num_bits_ -= remainder;
+}
+
+// Start CRC-16 of frame from `header`, which is already consumed. Must be
+// called at byte boundary.
+void FlacDecoder::startCrc(const unsigned char *header, unsigned int length) {
+  crc_ = 0;
+  for (unsigned int i = 0; i < length; i++) {
+    crc_ = (uint16_t)((crc_ << 8) ^ kCrc16Table[(crc_ >> 8) ^ header[i]]);
+  }
+  // Bytes left in cache belong to frame, and older ones are dropped
+  const unsigned int num_cached = num_bits_ / 8;
+  crc_head_ = (crc_head_ + num_crc_bytes_ - num_cached) & 7;
+  num_crc_bytes_ = num_cached;
+}
+
+// Add bytes consumed so far into CRC-16. Must be called at byte boundary.
+void FlacDecoder::updateCrc() {
+  const unsigned int num_cached = num_bits_ / 8;
+  while (num_crc_bytes_ > num_cached) {
+    crc_ = (uint16_t)((crc_ << 8) ^ kCrc16Table[(crc_ >> 8) ^ crc_bytes_[crc_head_]]);
+    crc_head_ = (crc_head_ + 1) & 7;
+    num_crc_bytes_--;
+  }
+}
+
+///// metadata /////
+
+int FlacDecoder::readMetadata() {
+  uint32_t value;
+  unsigned char magic[4];
+
+  for (unsigned int i = 0; i < 4; i++) {
+    if (readBits(8, &value) != WAVE_SUCCESS) {
+      fprintf(stderr, "wave::FlacDecoder::readMetadata() - failed to read magic.\n");
+      return WAVE_FILE_IO_FAILED;
+    }
+    magic[i] = (unsigned char)value;
+  }
+
+  // skip ID3v2 tag, whose header is version (2), flags (1) and size (4)
+  if (magic[0] == 'I' && magic[1] == 'D' && magic[2] == '3') {
+    unsigned char tag[7];
+    tag[0] = magic[3];
+    for (unsigned int i = 1; i < 7; i++) {
+      if (readBits(8, &value) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+      tag[i] = (unsigned char)value;
+    }
+    size_t tag_size = ((size_t)(tag[3] & 0x7F) << 21) |
+                      ((size_t)(tag[4] & 0x7F) << 14) |
+                      ((size_t)(tag[5] & 0x7F) << 7) | (size_t)(tag[6] & 0x7F);
+    if (tag[2] & 0x10) {
+      tag_size += 10;  // footer
+    }
+    if (skipBytes(tag_size) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+      if (readBits(8, &value) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+      magic[i] = (unsigned char)value;
+    }
+  }
+
+  if (memcmp(magic, "fLaC", 4) != 0) {
+    fprintf(stderr, "wave::FlacDecoder::readMetadata() - invalid format. "
+                    "stream must be started with 'fLaC'.\n");
+    return WAVE_UNSUPPORTED_TYPE;
+  }
+
+  bool has_stream_info = false;
+  bool is_last = false;
+  while (!is_last) {
+    uint32_t is_last_bit, block_type, block_length;
+    if ((readBits(1, &is_last_bit) != WAVE_SUCCESS) ||
+        (readBits(7, &block_type) != WAVE_SUCCESS) ||
+        (readBits(24, &block_length) != WAVE_SUCCESS)) {
+      fprintf(stderr, "wave::FlacDecoder::readMetadata() - failed to read "
+                      "metadata block header.\n");
+      return WAVE_FILE_IO_FAILED;
+    }
+    is_last = (is_last_bit != 0);
+
+    if (block_type != 0) {
+      // Only STREAMINFO is needed for decoding
+      if (skipBytes(block_length) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+      continue;
+    }
+
+    if (block_length != 34) {
+      fprintf(stderr, "wave::FlacDecoder::readMetadata() - invalid STREAMINFO.\n");
+      return WAVE_INVALID_FORMAT;
+    }
+
+    uint32_t min_block_size, max_block_size, sampling_rate, num_channels,
+        bit_rate, total_high, total_low;
+    if ((readBits(16, &min_block_size) != WAVE_SUCCESS) ||
+        (readBits(16, &max_block_size) != WAVE_SUCCESS) ||
+        (readBits(24, &value) != WAVE_SUCCESS) || // min frame size
+        (readBits(24, &value) != WAVE_SUCCESS) || // max frame size
+        (readBits(20, &sampling_rate) != WAVE_SUCCESS) ||
+        (readBits(3, &num_channels) != WAVE_SUCCESS) ||
+        (readBits(5, &bit_rate) != WAVE_SUCCESS) ||
+        (readBits(4, &total_high) != WAVE_SUCCESS) ||
+        (readBits(32, &total_low) != WAVE_SUCCESS) ||
+        (skipBytes(16) != WAVE_SUCCESS)) { // MD5 signature
+      fprintf(stderr, "wave::FlacDecoder::readMetadata() - failed to read STREAMINFO.\n");
+      return WAVE_FILE_IO_FAILED;
+    }
+
+    sampling_rate_ = sampling_rate;
+    num_channels_ = num_channels + 1;
+    bit_rate_ = bit_rate + 1;
+    max_block_size_ = max_block_size;
+    total_samples_ = ((uint64_t)total_high << 32) | (uint64_t)total_low;
+    has_stream_info = true;
+  }
+
+  if (!has_stream_info) {
+    fprintf(stderr, "wave::FlacDecoder::readMetadata() - STREAMINFO is not found.\n");
+    return WAVE_INVALID_FORMAT;
+  }
+  if ((bit_rate_ < 4) || (bit_rate_ > FLAC_MAX_BITS_PER_SAMPLE)) {
+    fprintf(stderr, "wave::FlacDecoder::readMetadata() - unsupported bits per "
+                    "sample : %u\n", bit_rate_);
+    return WAVE_UNSUPPORTED_TYPE;
+  }
+  if ((max_block_size_ < 16) || (num_channels_ > FLAC_MAX_CHANNELS)) {
+    fprintf(stderr, "wave::FlacDecoder::readMetadata() - invalid STREAMINFO.\n");
+    return WAVE_INVALID_FORMAT;
+  }
+
+  samples_ = new int32_t[num_channels_ * max_block_size_];
+  block_size_ = 0;
+  block_pos_ = 0;
+
+  return WAVE_SUCCESS;
+}
+
+///// frame /////
+
+int FlacDecoder::decodeFrame() {
+  uint32_t value;
+  unsigned char crc = 0;
+  unsigned char header[16];
+  unsigned int header_length = 0;
+
+  block_size_ = 0;
+  block_pos_ = 0;
+
+  alignToByte();
+
+  // Find frame sync code (0xFFF8 or 0xFFF9). Frames are always placed right
+  // after the previous one, but search to be tolerant of junk data.
+  uint32_t sync = 0;
+  while (true) {
+    refill();
+    if (num_bits_ == 0) {
+      return WAVE_SUCCESS; // end of stream
+    }
+    if (readBits(8, &value) != WAVE_SUCCESS) {
+      return WAVE_SUCCESS;
+    }
+    sync = ((sync << 8) | value) & 0xFFFF;
+    if ((sync & 0xFFFE) == 0xFFF8) {
+      break;
+    }
+  }
+  header[header_length++] = 0xFF;
+  header[header_length++] = (unsigned char)sync;
+  startCrc(header, header_length);
+
+  // block size & sampling rate codes, channel assignment & sample size codes
+  uint32_t byte2, byte3;
+  if ((readBits(8, &byte2) != WAVE_SUCCESS) ||
+      (readBits(8, &byte3) != WAVE_SUCCESS)) {
+    return WAVE_FILE_IO_FAILED;
+  }
+  header[header_length++] = (unsigned char)byte2;
+  header[header_length++] = (unsigned char)byte3;
+
+  const unsigned int block_size_code = byte2 >> 4;
+  const unsigned int sampling_rate_code = byte2 & 0x0F;
+  const unsigned int channel_assignment = byte3 >> 4;
+  const unsigned int sample_size_code = (byte3 >> 1) & 0x07;
+
+  // frame or sample number, coded in UTF-8 like manner
+  uint32_t first;
+  if (readBits(8, &first) != WAVE_SUCCESS) {
+    return WAVE_FILE_IO_FAILED;
+  }
+  header[header_length++] = (unsigned char)first;
+  unsigned int num_extra = 0;
+  if ((first & 0x80) != 0) {
+    for (uint32_t mask = 0x40; (first & mask) != 0 && mask != 0; mask >>= 1) {
+      num_extra++;
+    }
+    if (num_extra == 0 || num_extra > 6) {
+      return WAVE_INVALID_FORMAT;
+    }
+  }
+  for (unsigned int i = 0; i < num_extra; i++) {
+    if (readBits(8, &value) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    header[header_length++] = (unsigned char)value;
+  }
+
+  unsigned int block_size;
+  switch (block_size_code) {
+  case 0:
+    return WAVE_INVALID_FORMAT;
+  case 1:
+    block_size = 192;
+    break;
+  case 6:
+    if (readBits(8, &value) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    header[header_length++] = (unsigned char)value;
+    block_size = value + 1;
+    break;
+  case 7:
+    if (readBits(16, &value) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    header[header_length++] = (unsigned char)(value >> 8);
+    header[header_length++] = (unsigned char)value;
+    block_size = value + 1;
+    break;
+  default:
+    if (block_size_code < 6) {
+      block_size = 576 << (block_size_code - 2);
+    } else {
+      block_size = 256 << (block_size_code - 8);
+    }
+    break;
+  }
+
+  switch (sampling_rate_code) {
+  case 12:
+    if (readBits(8, &value) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    header[header_length++] = (unsigned char)value;
+    break;
+  case 13:
+  case 14:
+    if (readBits(16, &value) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    header[header_length++] = (unsigned char)(value >> 8);
+    header[header_length++] = (unsigned char)value;
+    break;
+  case 15:
+    return WAVE_INVALID_FORMAT;
+  default:
+    break;
+  }
+
+  uint32_t crc_value;
+  if (readBits(8, &crc_value) != WAVE_SUCCESS) {
+    return WAVE_FILE_IO_FAILED;
+  }
+  for (unsigned int i = 0; i < header_length; i++) {
+    crc = kCrc8Table[crc ^ header[i]];
+  }
+  if (crc != (unsigned char)crc_value) {
+    fprintf(stderr, "wave::FlacDecoder::decodeFrame() - CRC of frame header is "
+                    "unmatched.\n");
+    return WAVE_INVALID_FORMAT;
+  }
+
+  if (block_size > max_block_size_) {
+    fprintf(stderr, "wave::FlacDecoder::decodeFrame() - block size is larger "
+                    "than maximum block size.\n");
+    return WAVE_INVALID_FORMAT;
+  }
+
+  unsigned int bits_per_sample;
+  switch (sample_size_code) {
+  case 0:
+    bits_per_sample = bit_rate_;
+    break;
+  case 1:
+    bits_per_sample = 8;
+    break;
+  case 2:
+    bits_per_sample = 12;
+    break;
+  case 4:
+    bits_per_sample = 16;
+    break;
+  case 5:
+    bits_per_sample = 20;
+    break;
+  case 6:
+    bits_per_sample = 24;
+    break;
+  default:
+    return WAVE_UNSUPPORTED_TYPE;
+  }
+  if (bits_per_sample != bit_rate_) {
+    return WAVE_INVALID_FORMAT;
+  }
+
+  unsigned int num_channels;
+  if (channel_assignment < 8) {
+    num_channels = channel_assignment + 1;
+  } else if (channel_assignment <= kFlacChannelMidSide) {
+    num_channels = 2;
+  } else {
+    return WAVE_INVALID_FORMAT;
+  }
+  if (num_channels != num_channels_) {
+    return WAVE_INVALID_FORMAT;
+  }
+
+  // subframes
+  for (unsigned int c = 0; c < num_channels; c++) {
+    unsigned int bps = bits_per_sample;
+    if (((channel_assignment == kFlacChannelLeftSide) && (c == 1)) ||
+        ((channel_assignment == kFlacChannelSideRight) && (c == 0)) ||
+        ((channel_assignment == kFlacChannelMidSide) && (c == 1))) {
+      bps++; // side channel has one more bit
+    }
+    int error_code =
+        decodeSubframe(samples_ + c * max_block_size_, block_size, bps);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+  }
+
+  // Stereo decorrelation
+  int32_t *ch0 = samples_;
+  int32_t *ch1 = samples_ + max_block_size_;
+  switch (channel_assignment) {
+  case kFlacChannelLeftSide:
+    for (unsigned int i = 0; i < block_size; i++) {
+      ch1[i] = ch0[i] - ch1[i];
+    }
+    break;
+  case kFlacChannelSideRight:
+    for (unsigned int i = 0; i < block_size; i++) {
+      ch0[i] += ch1[i];
+    }
+    break;
+  case kFlacChannelMidSide:
+    for (unsigned int i = 0; i < block_size; i++) {
+      int32_t side = ch1[i];
+      int32_t mid = (int32_t)(((uint32_t)ch0[i] << 1) | (side & 1));
+      ch0[i] = (mid + side) >> 1;
+      ch1[i] = (mid - side) >> 1;
+    }
+    break;
+  default:
+    break;
+  }
+
+  // Zero padding & CRC-16 of whole frame
+  alignToByte();
+  updateCrc();
+  const uint16_t crc16 = crc_;
+  if (readBits(16, &value) != WAVE_SUCCESS) {
+    return WAVE_FILE_IO_FAILED;
+  }
+  if (crc16 != (uint16_t)value) {
+    fprintf(stderr, "wave::FlacDecoder::decodeFrame() - CRC of frame is "
+                    "unmatched.\n");
+    return WAVE_INVALID_FORMAT;
+  }
+
+  block_size_ = block_size;
+  block_pos_ = 0;
+  return WAVE_SUCCESS;
+}
+
+int FlacDecoder::decodeSubframe(int32_t *dest, unsigned int block_size,
+                                unsigned int bits_per_sample) {
+  uint32_t value;
+  int error_code;
+
+  // zero bit padding, type (6 bits), wasted bits flag
+  if (readBits(8, &value) != WAVE_SUCCESS) {
+    return WAVE_FILE_IO_FAILED;
+  }
+  if ((value & 0x80) != 0) {
+    return WAVE_INVALID_FORMAT;
+  }
+  const unsigned int type = (value >> 1) & 0x3F;
+  unsigned int wasted_bits = 0;
+  if ((value & 0x01) != 0) {
+    if (readUnary(&value) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    wasted_bits = value + 1;
+    if (wasted_bits >= bits_per_sample) {
+      return WAVE_INVALID_FORMAT;
+    }
+    bits_per_sample -= wasted_bits;
+  }
+
+  if (type == 0) {
+    // CONSTANT
+    int32_t sample;
+    if (readSignedBits(bits_per_sample, &sample) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    for (unsigned int i = 0; i < block_size; i++) {
+      dest[i] = sample;
+    }
+  } else if (type == 1) {
+    // VERBATIM
+    for (unsigned int i = 0; i < block_size; i++) {
+      if (readSignedBits(bits_per_sample, dest + i) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+    }
+  } else if ((type >= 8) && (type <= 12)) {
+    // FIXED
+    const unsigned int order = type - 8;
+    if (order > block_size) {
+      return WAVE_INVALID_FORMAT;
+    }
+    for (unsigned int i = 0; i < order; i++) {
+      if (readSignedBits(bits_per_sample, dest + i) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+    }
+    error_code = decodeResidual(dest, block_size, order);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+
+    switch (order) {
+    case 1:
+      for (unsigned int i = 1; i < block_size; i++) {
+        dest[i] += dest[i - 1];
+      }
+      break;
+    case 2:
+      for (unsigned int i = 2; i < block_size; i++) {
+        dest[i] += 2 * dest[i - 1] - dest[i - 2];
+      }
+      break;
+    case 3:
+      for (unsigned int i = 3; i < block_size; i++) {
+        dest[i] += 3 * dest[i - 1] - 3 * dest[i - 2] + dest[i - 3];
+      }
+      break;
+    case 4:
+      for (unsigned int i = 4; i < block_size; i++) {
+        dest[i] += 4 * dest[i - 1] - 6 * dest[i - 2] + 4 * dest[i - 3] -
+                   dest[i - 4];
+      }
+      break;
+    default:
+      break;
+    }
+  } else if (type >= 32) {
+    // LPC
+    const unsigned int order = type - 31;
+    if (order > block_size) {
+      return WAVE_INVALID_FORMAT;
+    }
+    for (unsigned int i = 0; i < order; i++) {
+      if (readSignedBits(bits_per_sample, dest + i) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+    }
+
+    uint32_t precision;
+    int32_t shift;
+    if (readBits(4, &precision) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    if (precision == 15) {
+      return WAVE_INVALID_FORMAT;
+    }
+    precision++;
+    if (readSignedBits(5, &shift) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+    if (shift < 0) {
+      return WAVE_INVALID_FORMAT;
+    }
+
+    int32_t coefs[FLAC_MAX_LPC_ORDER];
+    for (unsigned int i = 0; i < order; i++) {
+      if (readSignedBits(precision, coefs + i) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+    }
+
+    error_code = decodeResidual(dest, block_size, order);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+
+    for (unsigned int i = order; i < block_size; i++) {
+      int64_t sum = 0;
+      const int32_t *history = dest + i - 1;
+      for (unsigned int j = 0; j < order; j++) {
+        sum += (int64_t)coefs[j] * (int64_t)history[-(int)j];
+      }
+      dest[i] += (int32_t)(sum >> shift);
+    }
+  } else {
+    fprintf(stderr, "wave::FlacDecoder::decodeSubframe() - reserved subframe "
+                    "type : %u\n", type);
+    return WAVE_INVALID_FORMAT;
+  }
+
+  if (wasted_bits > 0) {
+    for (unsigned int i = 0; i < block_size; i++) {
+      dest[i] = (int32_t)((uint32_t)dest[i] << wasted_bits);
+    }
+  }
+
+  return WAVE_SUCCESS;
+}
+
+int FlacDecoder::decodeResidual(int32_t *dest, unsigned int block_size,
+                                unsigned int order) {
+  uint32_t method, partition_order;
+  if ((readBits(2, &method) != WAVE_SUCCESS) ||
+      (readBits(4, &partition_order) != WAVE_SUCCESS)) {
+    return WAVE_FILE_IO_FAILED;
+  }
+  if (method > 1) {
+    return WAVE_INVALID_FORMAT;
+  }
+
+  const unsigned int param_bits = (method == 0) ? 4 : 5;
+  const uint32_t escape_code = (method == 0) ? 15 : 31;
+  const unsigned int num_partitions = 1u << partition_order;
+  const unsigned int partition_size = block_size >> partition_order;
+  if ((partition_size << partition_order) != block_size ||
+      partition_size < order) {
+    return WAVE_INVALID_FORMAT;
+  }
+
+  unsigned int index = order;
+  for (unsigned int p = 0; p < num_partitions; p++) {
+    const unsigned int count = (p == 0) ? partition_size - order : partition_size;
+
+    uint32_t rice_param;
+    if (readBits(param_bits, &rice_param) != WAVE_SUCCESS) {
+      return WAVE_FILE_IO_FAILED;
+    }
+
+    if (rice_param == escape_code) {
+      uint32_t num_raw_bits;
+      if (readBits(5, &num_raw_bits) != WAVE_SUCCESS) {
+        return WAVE_FILE_IO_FAILED;
+      }
+      for (unsigned int i = 0; i < count; i++) {
+        if (readSignedBits(num_raw_bits, dest + index + i) != WAVE_SUCCESS) {
+          return WAVE_FILE_IO_FAILED;
+        }
+      }
+    } else {
+      // Rice coded residuals. This is the hottest loop of the decoder.
+      for (unsigned int i = 0; i < count; i++) {
+        uint32_t quotient, remainder;
+        if ((readUnary(&quotient) != WAVE_SUCCESS) ||
+            (readBits(rice_param, &remainder) != WAVE_SUCCESS)) {
+          return WAVE_FILE_IO_FAILED;
+        }
+        const uint32_t folded = (quotient << rice_param) | remainder;
+        dest[index + i] = (int32_t)(folded >> 1) ^ -(int32_t)(folded & 1);
+      }
+    }
+    index += count;
+  }
+
+  return WAVE_SUCCESS;
+}
+
+///// output /////
+
+template <typename T>
+int FlacDecoder::readSamples(T *dest, unsigned int max_samples,
+                             unsigned int *num_samples) {
+  if ((dest == NULL) || (num_samples == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+  if (fp_ == NULL || samples_ == NULL) {
+    fprintf(stderr, "wave::FlacDecoder::read() - stream is not opened.\n");
+    return WAVE_INVALID_USAGE;
+  }
+
+  const T scale = (T)1.0 / (T)((uint32_t)1 << (bit_rate_ - 1));
+  const unsigned int max_frames = max_samples / num_channels_;
+  unsigned int num_frames = 0;
+
+  while (num_frames < max_frames) {
+    if (block_pos_ == block_size_) {
+      int error_code = decodeFrame();
+      if (error_code != WAVE_SUCCESS) {
+        fprintf(stderr, "wave::FlacDecoder::read() - failed to decode frame.\n");
+        return error_code;
+      }
+      if (block_size_ == 0) {
+        break; // end of stream
+      }
+    }
+
+    unsigned int n = block_size_ - block_pos_;
+    if (n > max_frames - num_frames) {
+      n = max_frames - num_frames;
+    }
+
+    T *out = dest + num_frames * num_channels_;
+    if (num_channels_ == 1) {
+      const int32_t *src = samples_ + block_pos_;
+      for (unsigned int i = 0; i < n; i++) {
+        out[i] = (T)src[i] * scale;
+      }
+    } else {
+      for (unsigned int c = 0; c < num_channels_; c++) {
+        const int32_t *src = samples_ + c * max_block_size_ + block_pos_;
+        for (unsigned int i = 0; i < n; i++) {
+          out[i * num_channels_ + c] = (T)src[i] * scale;
+        }
+      }
+    }
+
+    block_pos_ += n;
+    num_frames += n;
+  }
+
+  (*num_samples) = num_frames * num_channels_;
+  return WAVE_SUCCESS;
+}
+
+int FlacDecoder::read(float *dest, unsigned int max_samples,
+                      unsigned int *num_samples) {
+  return readSamples<float>(dest, max_samples, num_samples);
+}
+
+int FlacDecoder::read(double *dest, unsigned int max_samples,
+                      unsigned int *num_samples) {
+  return readSamples<double>(dest, max_samples, num_samples);
+}
+
+} // namespace wave
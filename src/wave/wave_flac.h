@@ -0,0 +1,101 @@
+#ifndef WAVE_WAVE_FLAC_H
+#define WAVE_WAVE_FLAC_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "wave/wave_stream.h"
+
+namespace wave {
+
+// Returns true if `file_name` has a FLAC extension (".flac" or ".fla")
+bool isFlacFileName(const char *file_name);
+
+// Streaming decoder for native FLAC files.
+// Supports CONSTANT, VERBATIM, FIXED and LPC subframes with Rice coded
+// residuals, all stereo decorrelation modes and 8 ~ 24 bits per sample.
+// Decoded samples are interleaved and scaled into [-1, 1) in the same way as
+// `convertChar2Float()`, so that the outputs are identical to the ones of
+// `WaveReader::read()` for the equivalent WAV file.
+class FlacDecoder : public StreamReader {
+public:
+  FlacDecoder();
+  virtual ~FlacDecoder();
+
+private:
+  FILE *fp_;
+  bool own_fp_;
+
+  // Input buffer & bit cache
+  unsigned char *buffer_;
+  size_t buffer_size_;
+  size_t buffer_pos_;
+  bool is_eof_;
+  uint64_t cache_;        // Left aligned bit cache
+  unsigned int num_bits_; // Number of valid bits in `cache_`
+
+  // CRC-16 of current frame. Bytes loaded into `cache_` are held in
+  // `crc_bytes_` until they are consumed, and then added to `crc_`.
+  uint16_t crc_;
+  unsigned char crc_bytes_[8];
+  unsigned int crc_head_;     // index of oldest byte in `crc_bytes_`
+  unsigned int num_crc_bytes_;
+
+  // STREAMINFO
+  unsigned int sampling_rate_;
+  unsigned int bit_rate_;
+  unsigned int num_channels_;
+  unsigned int max_block_size_;
+  uint64_t total_samples_;
+
+  // Decoded samples of current frame, `num_channels_` x `max_block_size_`
+  int32_t *samples_;
+  unsigned int block_size_;
+  unsigned int block_pos_;
+
+  int refill();
+  int readBits(unsigned int n, uint32_t *value);
+  int readSignedBits(unsigned int n, int32_t *value);
+  int readUnary(uint32_t *value);
+  int skipBytes(size_t n);
+  void alignToByte();
+  void startCrc(const unsigned char *header, unsigned int length);
+  void updateCrc();
+
+  int readMetadata();
+  int decodeFrame();
+  int decodeSubframe(int32_t *dest, unsigned int block_size,
+                     unsigned int bits_per_sample);
+  int decodeResidual(int32_t *dest, unsigned int block_size,
+                     unsigned int order);
+
+  template <typename T>
+  int readSamples(T *dest, unsigned int max_samples, unsigned int *num_samples);
+
+public:
+  unsigned int getSamplingRate() const { return sampling_rate_; }
+  unsigned int getBitRate() const { return bit_rate_; }
+  unsigned int getNumChannels() const { return num_channels_; }
+
+  // Number of samples per channel, 0 if unknown
+  uint64_t getTotalSamples() const { return total_samples_; }
+
+  // Open FLAC file and read metadata blocks
+  int open(const char *file_name);
+
+  // Same as above, but read from already opened stream. The stream is not
+  // closed by this class.
+  int open(FILE *fp);
+
+  void close();
+
+  // Decode at most `max_samples` interleaved samples into `dest`.
+  // `num_samples` is set to number of decoded samples, which is 0 at the end
+  // of stream. Note that `max_samples` must be multiple of number of channels.
+  int read(float *dest, unsigned int max_samples, unsigned int *num_samples);
+  int read(double *dest, unsigned int max_samples, unsigned int *num_samples);
+}; // class FlacDecoder
+
+} // namespace wave
+
+#endif // WAVE_WAVE_FLAC_H
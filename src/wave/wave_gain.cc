@@ -4,17 +4,202 @@
 #include <stdlib.h>
 #include <math.h>
 
+#include <algorithm>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef WAVE_GAIN_POWER_FLOOR
+#define WAVE_GAIN_POWER_FLOOR 1e-10
+#endif
 
 namespace wave {
 
+inline void kahan_add(double* sum, double* comp, const double x) {
+  double y = x - (*comp);
+  double t = (*sum) + y;
+  (*comp) = (t - (*sum)) - y;
+  (*sum) = t;
+}
+
+#if defined(__SSE2__)
+inline void kahan_add_pd(__m128d* sum, __m128d* comp, const __m128d x) {
+  __m128d y = _mm_sub_pd(x, *comp);
+  __m128d t = _mm_add_pd(*sum, y);
+  (*comp) = _mm_sub_pd(_mm_sub_pd(t, *sum), y);
+  (*sum) = t;
+}
+
+// Fold lanes of vector accumulator into scalar accumulator
+inline void kahan_merge_pd(double* sum, double* comp, const __m128d lane_sum,
+                           const __m128d lane_comp) {
+  double s[2], c[2];
+  _mm_storeu_pd(s, lane_sum);
+  _mm_storeu_pd(c, lane_comp);
+  kahan_add(sum, comp, s[0]);
+  kahan_add(sum, comp, s[1]);
+  kahan_add(sum, comp, -c[0]);
+  kahan_add(sum, comp, -c[1]);
+}
+#endif
+
+WaveStatsAccumulator::WaveStatsAccumulator() {
+  reset();
+}
+
+void WaveStatsAccumulator::reset() {
+  num_samples_ = 0;
+  sum_ = 0;
+  sum_comp_ = 0;
+  sum_sq_ = 0;
+  sum_sq_comp_ = 0;
+  peak_ = 0;
+}
+
+void WaveStatsAccumulator::update(const float* const wav,
+                                  const unsigned int wav_length) {
+  unsigned int i = 0;
+
+#if defined(__SSE2__)
+  if (wav_length >= 4) {
+    // Each 4 samples are widened into 2 x 2 doubles. Square of float is exact
+    // in double, so only summation needs compensation.
+    __m128d sum_lo = _mm_setzero_pd(), comp_lo = _mm_setzero_pd();
+    __m128d sum_hi = _mm_setzero_pd(), comp_hi = _mm_setzero_pd();
+    __m128d sq_lo = _mm_setzero_pd(), sq_comp_lo = _mm_setzero_pd();
+    __m128d sq_hi = _mm_setzero_pd(), sq_comp_hi = _mm_setzero_pd();
+    __m128 peak = _mm_setzero_ps();
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    for (; i + 4 <= wav_length; i += 4) {
+      __m128 x = _mm_loadu_ps(wav + i);
+      peak = _mm_max_ps(peak, _mm_and_ps(x, abs_mask));
+
+      __m128d lo = _mm_cvtps_pd(x);
+      __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+      kahan_add_pd(&sum_lo, &comp_lo, lo);
+      kahan_add_pd(&sum_hi, &comp_hi, hi);
+      kahan_add_pd(&sq_lo, &sq_comp_lo, _mm_mul_pd(lo, lo));
+      kahan_add_pd(&sq_hi, &sq_comp_hi, _mm_mul_pd(hi, hi));
+    }
+
+    kahan_merge_pd(&sum_, &sum_comp_, sum_lo, comp_lo);
+    kahan_merge_pd(&sum_, &sum_comp_, sum_hi, comp_hi);
+    kahan_merge_pd(&sum_sq_, &sum_sq_comp_, sq_lo, sq_comp_lo);
+    kahan_merge_pd(&sum_sq_, &sum_sq_comp_, sq_hi, sq_comp_hi);
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, peak);
+    for (unsigned int k = 0; k < 4; k++) {
+      if (lanes[k] > peak_) {
+        peak_ = lanes[k];
+      }
+    }
+  }
+#endif
+
+  for (; i < wav_length; i++) {
+    const double x = wav[i];
+    kahan_add(&sum_, &sum_comp_, x);
+    kahan_add(&sum_sq_, &sum_sq_comp_, x * x);
+    if (fabs(x) > peak_) {
+      peak_ = fabs(x);
+    }
+  }
+
+  num_samples_ += wav_length;
+}
+
+void WaveStatsAccumulator::update(const double* const wav,
+                                  const unsigned int wav_length) {
+  unsigned int i = 0;
+
+#if defined(__SSE2__)
+  if (wav_length >= 2) {
+    __m128d sum = _mm_setzero_pd(), comp = _mm_setzero_pd();
+    __m128d sq = _mm_setzero_pd(), sq_comp = _mm_setzero_pd();
+    __m128d peak = _mm_setzero_pd();
+    const __m128d abs_mask =
+        _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+
+    for (; i + 2 <= wav_length; i += 2) {
+      __m128d x = _mm_loadu_pd(wav + i);
+      peak = _mm_max_pd(peak, _mm_and_pd(x, abs_mask));
+      kahan_add_pd(&sum, &comp, x);
+      kahan_add_pd(&sq, &sq_comp, _mm_mul_pd(x, x));
+    }
+
+    kahan_merge_pd(&sum_, &sum_comp_, sum, comp);
+    kahan_merge_pd(&sum_sq_, &sum_sq_comp_, sq, sq_comp);
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, peak);
+    for (unsigned int k = 0; k < 2; k++) {
+      if (lanes[k] > peak_) {
+        peak_ = lanes[k];
+      }
+    }
+  }
+#endif
+
+  for (; i < wav_length; i++) {
+    const double x = wav[i];
+    kahan_add(&sum_, &sum_comp_, x);
+    kahan_add(&sum_sq_, &sum_sq_comp_, x * x);
+    if (fabs(x) > peak_) {
+      peak_ = fabs(x);
+    }
+  }
+
+  num_samples_ += wav_length;
+}
+
+void WaveStatsAccumulator::merge(const WaveStatsAccumulator& other) {
+  kahan_add(&sum_, &sum_comp_, other.sum_);
+  kahan_add(&sum_, &sum_comp_, -other.sum_comp_);
+  kahan_add(&sum_sq_, &sum_sq_comp_, other.sum_sq_);
+  kahan_add(&sum_sq_, &sum_sq_comp_, -other.sum_sq_comp_);
+  if (other.peak_ > peak_) {
+    peak_ = other.peak_;
+  }
+  num_samples_ += other.num_samples_;
+}
+
+void WaveStatsAccumulator::getStats(WaveStats* stats) const {
+  stats->num_samples = num_samples_;
+  if (num_samples_ == 0) {
+    stats->rms = 0;
+    stats->peak = 0;
+    stats->dc_offset = 0;
+    return;
+  }
+  const double n = (double)num_samples_;
+  stats->rms = std::sqrt(sum_sq_ / n);
+  stats->peak = peak_;
+  stats->dc_offset = sum_ / n;
+}
+
+template <typename T>
+int _computeStats(const T* const wav, const unsigned int wav_length,
+                  WaveStats* stats) {
+  if ((wav == NULL) || (stats == NULL)) {
+    return 1;
+  }
+  WaveStatsAccumulator accumulator;
+  accumulator.update(wav, wav_length);
+  accumulator.getStats(stats);
+  return 0;
+}
+
 template <typename T>
 T _computeRms(const T* const wav, const unsigned int wav_length) {
-  T rms = 0;
-  for (unsigned int i = 0; i < wav_length; i++) {
-    rms += wav[i] * wav[i] / (T)wav_length;
+  WaveStats stats;
+  if (_computeStats<T>(wav, wav_length, &stats) != 0) {
+    return 0;
   }
-  rms = std::sqrt(rms);
-  return rms;
+  return (T)stats.rms;
 }
 
 template <typename T>
@@ -26,20 +211,37 @@ T _computeDecibel(const T* const wav, const unsigned int wav_length) {
 template <typename T>
 int _normalizeDbScale(T* wav, const unsigned int wav_length, const T db) {
 
-  if ((wav == NULL) || (wav_length == 0) || (db > 0)){ 
+  if ((wav == NULL) || (wav_length == 0) || (db > 0)){
     return 1;
   }
 
-  T signal_level = _computeDecibel(wav, wav_length);
-  T scalor = std::pow((T)10.0, (db - signal_level) / (T)20.0);
+  // one pass for statistics, one pass for scaling
+  WaveStats stats;
+  _computeStats<T>(wav, wav_length, &stats);
+  // Silence has no level to be scaled from, and is left as is
+  if (stats.rms == 0) {
+    return 0;
+  }
+  double signal_level = 20.0 * std::log10(stats.rms);
+  T scalor = (T)std::pow(10.0, ((double)db - signal_level) / 20.0);
 
   for (unsigned int i = 0; i < wav_length; i++) {
     wav[i] *= scalor;
   }
-  
+
   return 0;
 }
 
+int computeStats(const float* const wav, const unsigned int wav_length,
+                 WaveStats* stats) {
+  return _computeStats<float>(wav, wav_length, stats);
+}
+
+int computeStats(const double* const wav, const unsigned int wav_length,
+                 WaveStats* stats) {
+  return _computeStats<double>(wav, wav_length, stats);
+}
+
 float computeRms(const float* const wav, const unsigned int wav_length) {
   return _computeRms<float>(wav, wav_length);
 }
@@ -65,7 +267,159 @@ int normalizeDb(double* wav, const unsigned int wav_length, const double db) {
   return _normalizeDbScale<double>(wav, wav_length, db);
 }
 
+///// AutoGainControl /////
 
-}  // namespace wave
+inline double time_constant_to_coef(const double seconds,
+                                    const unsigned int sampling_rate) {
+  if (seconds <= 0) {
+    return 1.0;
+  }
+  return 1.0 - std::exp(-1.0 / (seconds * (double)sampling_rate));
+}
+
+AutoGainControl::AutoGainControl()
+    : target_power_(0), power_(0), power_coef_(0), gain_(1), attack_coef_(0),
+      release_coef_(0), min_gain_(1), max_gain_(1), ceiling_(1), lookahead_(0),
+      num_input_(0), num_output_(0) {}
+
+int AutoGainControl::init(const unsigned int sampling_rate,
+                          const double target_db, const double lookahead_sec,
+                          const double window_sec, const double attack_sec,
+                          const double release_sec, const double max_gain_db,
+                          const double ceiling) {
+  if ((sampling_rate == 0) || (target_db > 0) || (lookahead_sec < 0) ||
+      (max_gain_db < 0) || (ceiling <= 0)) {
+    fprintf(stderr, "wave::AutoGainControl::init() - invalid argument.\n");
+    return 1;
+  }
+
+  target_power_ = std::pow(10.0, target_db / 10.0);
+  power_coef_ = time_constant_to_coef(window_sec, sampling_rate);
+  attack_coef_ = time_constant_to_coef(attack_sec, sampling_rate);
+  release_coef_ = time_constant_to_coef(release_sec, sampling_rate);
+  max_gain_ = std::pow(10.0, max_gain_db / 20.0);
+  min_gain_ = 1.0 / max_gain_;
+  ceiling_ = ceiling;
+  lookahead_ = (unsigned int)(lookahead_sec * (double)sampling_rate);
+
+  reset();
+  return 0;
+}
+
+void AutoGainControl::reset() {
+  // Start from unity gain
+  power_ = target_power_;
+  gain_ = 1.0;
+  delay_.assign(lookahead_, 0.0);
+  num_input_ = 0;
+  num_output_ = 0;
+  peaks_.clear();
+}
+
+// Gain of output sample `num_output_`, whose look-ahead window is
+// [num_output_, num_input_)
+double AutoGainControl::drainSample() {
+  while (!peaks_.empty() && peaks_.front().first < num_output_) {
+    peaks_.pop_front();
+  }
+  const double peak = peaks_.empty() ? 0.0 : peaks_.front().second;
+
+  double desired = std::sqrt(target_power_ /
+                             std::max(power_, (double)WAVE_GAIN_POWER_FLOOR));
+  desired = std::min(std::max(desired, min_gain_), max_gain_);
+  const double coef = (desired < gain_) ? attack_coef_ : release_coef_;
+  gain_ += coef * (desired - gain_);
+
+  double gain = gain_;
+  if (peak * gain > ceiling_) {
+    gain = ceiling_ / peak;
+  }
+  num_output_++;
+  return gain;
+}
+
+double AutoGainControl::processSample(const double x, bool* has_output) {
+  power_ += power_coef_ * (x * x - power_);
+
+  const double magnitude = std::fabs(x);
+  while (!peaks_.empty() && peaks_.back().second <= magnitude) {
+    peaks_.pop_back();
+  }
+  peaks_.push_back(std::make_pair(num_input_, magnitude));
+
+  double y;
+  if (lookahead_ == 0) {
+    num_input_++;
+    y = x * drainSample();
+    (*has_output) = true;
+    return y;
+  }
+
+  // output sample and new input share the same slot of ring buffer
+  const unsigned int slot = (unsigned int)(num_input_ % lookahead_);
+  const double delayed = delay_[slot];
+  delay_[slot] = x;
+  num_input_++;
+
+  if (num_input_ <= lookahead_) {
+    (*has_output) = false;
+    return 0;
+  }
+  y = delayed * drainSample();
+  (*has_output) = true;
+  return y;
+}
+
+template <typename T>
+int AutoGainControl::processChunk(const T* src, const unsigned int length,
+                                  T* dest, unsigned int* num_output) {
+  if ((src == NULL) || (dest == NULL) || (num_output == NULL)) {
+    return 1;
+  }
+
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < length; i++) {
+    bool has_output;
+    double y = processSample((double)src[i], &has_output);
+    if (has_output) {
+      dest[n++] = (T)y;
+    }
+  }
+  (*num_output) = n;
+  return 0;
+}
+
+template <typename T>
+int AutoGainControl::flushChunk(T* dest, unsigned int* num_output) {
+  if ((dest == NULL) || (num_output == NULL)) {
+    return 1;
+  }
 
+  unsigned int n = 0;
+  while (num_output_ < num_input_) {
+    const double delayed = delay_[num_output_ % lookahead_];
+    dest[n++] = (T)(delayed * drainSample());
+  }
+  (*num_output) = n;
+  return 0;
+}
 
+int AutoGainControl::process(const float* src, const unsigned int length,
+                             float* dest, unsigned int* num_output) {
+  return processChunk<float>(src, length, dest, num_output);
+}
+
+int AutoGainControl::process(const double* src, const unsigned int length,
+                             double* dest, unsigned int* num_output) {
+  return processChunk<double>(src, length, dest, num_output);
+}
+
+int AutoGainControl::flush(float* dest, unsigned int* num_output) {
+  return flushChunk<float>(dest, num_output);
+}
+
+int AutoGainControl::flush(double* dest, unsigned int* num_output) {
+  return flushChunk<double>(dest, num_output);
+}
+
+}  // namespace wave
@@ -1,9 +1,54 @@
 #ifndef WAVE_WAVE_GAIN_H
 #define WAVE_WAVE_GAIN_H
 
+#include <deque>
+#include <vector>
+
 namespace wave {
 
-// Compute Root Mean Square of input wav  
+// Statistics of wav computed in single pass
+typedef struct wave_stats_t {
+  unsigned long num_samples;
+  double rms;        // Root Mean Square
+  double peak;       // Maximum absolute value
+  double dc_offset;  // Mean value
+} WaveStats;
+
+// Accumulates statistics of wav given chunk by chunk. Sums are accumulated in
+// double precision with Kahan compensation, so results do not depend on
+// length or precision of input.
+class WaveStatsAccumulator {
+public:
+  WaveStatsAccumulator();
+
+private:
+  unsigned long num_samples_;
+  double sum_;
+  double sum_comp_;
+  double sum_sq_;
+  double sum_sq_comp_;
+  double peak_;
+
+public:
+  void reset();
+
+  void update(const float* const wav, const unsigned int wav_length);
+  void update(const double* const wav, const unsigned int wav_length);
+
+  // Add statistics accumulated by other, such as the one of other part of
+  // wav processed by other thread
+  void merge(const WaveStatsAccumulator& other);
+
+  void getStats(WaveStats* stats) const;
+};
+
+// Compute RMS, peak and DC offset of input wav in single pass
+int computeStats(const float* const wav, const unsigned int wav_length,
+                 WaveStats* stats);
+int computeStats(const double* const wav, const unsigned int wav_length,
+                 WaveStats* stats);
+
+// Compute Root Mean Square of input wav
 float computeRms(const float* const wav, const unsigned int wav_length);
 double computeRms(const double* const wav, const unsigned int wav_length);
 
@@ -11,10 +56,69 @@ double computeRms(const double* const wav, const unsigned int wav_length);
 float computeDecibel(const float* const wav, const unsigned int wav_length);
 double computeDecibel(const double* const wav, const unsigned int wav_length);
 
-// Normalize input wav in given DB
+// Normalize input wav in given DB. Silent wav is left unchanged.
 int normalizeDb(float* wav, const unsigned int wav_length, const float db);
 int normalizeDb(double* wav, const unsigned int wav_length, const double db);
 
+// Streaming automatic gain control.
+// Gain follows running RMS of input towards `target_db`, and a look-ahead
+// limiter reduces gain before peaks, so that output never exceeds `ceiling`.
+// Output is delayed by look-ahead, which is drained by `flush()` at the end
+// of stream. Total number of output samples equals to number of input.
+class AutoGainControl {
+public:
+  AutoGainControl();
+
+private:
+  double target_power_;
+  double power_;         // running mean of squares
+  double power_coef_;
+  double gain_;          // smoothed gain
+  double attack_coef_;
+  double release_coef_;
+  double min_gain_;
+  double max_gain_;
+  double ceiling_;
+  unsigned int lookahead_;
+
+  std::vector<double> delay_;  // ring buffer of look-ahead samples
+  unsigned long num_input_;
+  unsigned long num_output_;
+  std::deque<std::pair<unsigned long, double> > peaks_; // sliding maximum
+
+  double processSample(const double x, bool *has_output);
+  double drainSample();
+
+  template <typename T>
+  int processChunk(const T* src, const unsigned int length, T* dest,
+                   unsigned int* num_output);
+  template <typename T>
+  int flushChunk(T* dest, unsigned int* num_output);
+
+public:
+  // `window_sec` : time constant of RMS estimation,
+  // `attack_sec` / `release_sec` : time constants of decreasing / increasing gain
+  int init(const unsigned int sampling_rate, const double target_db,
+           const double lookahead_sec = 0.005, const double window_sec = 0.4,
+           const double attack_sec = 0.05, const double release_sec = 0.5,
+           const double max_gain_db = 30.0, const double ceiling = 0.99);
+  void reset();
+
+  unsigned int getLatency() const { return lookahead_; }
+
+  // Process chunk of samples. `dest` must be larger than `length`, and
+  // `num_output` is set to number of output samples.
+  int process(const float* src, const unsigned int length, float* dest,
+              unsigned int* num_output);
+  int process(const double* src, const unsigned int length, double* dest,
+              unsigned int* num_output);
+
+  // Output samples remaining in look-ahead. `dest` must be larger than
+  // `getLatency()`.
+  int flush(float* dest, unsigned int* num_output);
+  int flush(double* dest, unsigned int* num_output);
+}; // class AutoGainControl
+
 }  // namespace wave
 
-#endif  // WAVE_WAVE_GAIN_H
\ No newline at end of file
+#endif  // WAVE_WAVE_GAIN_H
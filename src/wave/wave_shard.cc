@@ -0,0 +1,380 @@
+#include "wave/wave_shard.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wave/wave.h"
+
+#ifndef TAR_BLOCK_SIZE
+#define TAR_BLOCK_SIZE 512
+#endif
+
+#ifndef SHARD_IO_BUFFER_SIZE
+#define SHARD_IO_BUFFER_SIZE (4 << 20)
+#endif
+
+// Long names and pax records are small, and larger ones are broken
+#ifndef SHARD_MAX_EXTENDED_HEADER_SIZE
+#define SHARD_MAX_EXTENDED_HEADER_SIZE (1 << 20)
+#endif
+
+namespace wave {
+
+////////////////////////////////
+// Prototype of local functions
+uint64_t parse_tar_number(const unsigned char *field, const unsigned int length);
+bool is_zero_block(const unsigned char *block);
+bool check_tar_checksum(const unsigned char *block);
+void parse_pax_header(const char *data, const size_t size, std::string *path,
+                      uint64_t *file_size);
+
+inline uint64_t pad_to_block(const uint64_t size) {
+  return (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+}
+
+ShardReader::ShardReader()
+    : fp_(NULL), io_buffer_(NULL), file_size_(0), position_(0),
+      is_end_(false) {}
+
+ShardReader::~ShardReader() {
+  close();
+}
+
+int ShardReader::open(const char *file_name) {
+  if (file_name == NULL) {
+    fprintf(stderr, "wave::ShardReader::open() - invalid argument `file_name`.\n");
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  close();
+
+  fp_ = fopen(file_name, "rb");
+  if (fp_ == NULL) {
+    fprintf(stderr, "wave::ShardReader::open() - failed to open file %s\n",
+            file_name);
+    return WAVE_FILE_IO_FAILED;
+  }
+
+  // Sizes in headers are checked against it before allocating memory
+  struct stat st;
+  if (fstat(fileno(fp_), &st) != 0) {
+    fprintf(stderr, "wave::ShardReader::open() - failed to get size of file %s\n",
+            file_name);
+    close();
+    return WAVE_FILE_IO_FAILED;
+  }
+  file_size_ = (uint64_t)st.st_size;
+
+  // Headers are small, so use large stdio buffer to make every read from
+  // the file system large & sequential.
+  io_buffer_ = new char[SHARD_IO_BUFFER_SIZE];
+  setvbuf(fp_, io_buffer_, _IOFBF, SHARD_IO_BUFFER_SIZE);
+
+  position_ = 0;
+  is_end_ = false;
+  return WAVE_SUCCESS;
+}
+
+void ShardReader::close() {
+  if (fp_ != NULL) {
+    fclose(fp_);
+    fp_ = NULL;
+  }
+  if (io_buffer_ != NULL) {
+    delete[] io_buffer_;
+    io_buffer_ = NULL;
+  }
+  file_size_ = 0;
+  position_ = 0;
+  is_end_ = false;
+  entries_.clear();
+}
+
+int ShardReader::readHeader(ShardEntry *entry) {
+  unsigned char block[TAR_BLOCK_SIZE];
+  std::string long_name;
+  uint64_t pax_size = 0;
+  bool has_pax_size = false;
+
+  entry->name.clear();
+  entry->offset = 0;
+  entry->size = 0;
+
+  while (!is_end_) {
+    if (TAR_BLOCK_SIZE != fread(block, 1, TAR_BLOCK_SIZE, fp_)) {
+      // Some writers omit end-of-archive blocks
+      is_end_ = true;
+      break;
+    }
+    position_ += TAR_BLOCK_SIZE;
+
+    if (is_zero_block(block)) {
+      is_end_ = true;
+      break;
+    }
+    if (!check_tar_checksum(block)) {
+      fprintf(stderr, "wave::ShardReader::readHeader() - invalid checksum of "
+                      "tar header at %llu.\n",
+              (unsigned long long)(position_ - TAR_BLOCK_SIZE));
+      return WAVE_INVALID_FORMAT;
+    }
+
+    const char type = (char)block[156];
+    uint64_t size = parse_tar_number(block + 124, 12);
+
+    if (type == 'L' || type == 'x') {
+      // GNU long name or pax extended header, applied to next member
+      if (size > SHARD_MAX_EXTENDED_HEADER_SIZE) {
+        fprintf(stderr, "wave::ShardReader::readHeader() - too large extended "
+                        "header at %llu.\n",
+                (unsigned long long)(position_ - TAR_BLOCK_SIZE));
+        return WAVE_INVALID_FORMAT;
+      }
+      char *data = new char[size + 1];
+      if (size != fread(data, 1, size, fp_)) {
+        delete[] data;
+        fprintf(stderr, "wave::ShardReader::readHeader() - failed to read "
+                        "extended header.\n");
+        return WAVE_FILE_IO_FAILED;
+      }
+      data[size] = '\0';
+      if (type == 'L') {
+        long_name.assign(data, strnlen(data, size));
+      } else {
+        parse_pax_header(data, size, &long_name, &pax_size);
+        has_pax_size = (pax_size != 0);
+      }
+      delete[] data;
+
+      position_ += pad_to_block(size);
+      fseeko(fp_, (off_t)position_, SEEK_SET);
+      continue;
+    }
+
+    if (type != '0' && type != '\0' && type != '7') {
+      // directories, links, global pax headers, ...
+      position_ += pad_to_block(size);
+      fseeko(fp_, (off_t)position_, SEEK_SET);
+      long_name.clear();
+      has_pax_size = false;
+      continue;
+    }
+
+    if (!long_name.empty()) {
+      entry->name = long_name;
+    } else {
+      std::string name((const char *)block, strnlen((const char *)block, 100));
+      const char *prefix = (const char *)block + 345;
+      if ((memcmp(block + 257, "ustar", 5) == 0) && (prefix[0] != '\0')) {
+        name = std::string(prefix, strnlen(prefix, 155)) + "/" + name;
+      }
+      entry->name = name;
+    }
+    entry->offset = position_;
+    entry->size = has_pax_size ? pax_size : size;
+    if (entry->size > file_size_ - position_) {
+      fprintf(stderr, "wave::ShardReader::readHeader() - member %s exceeds "
+                      "end of shard.\n", entry->name.c_str());
+      return WAVE_INVALID_FORMAT;
+    }
+    return WAVE_SUCCESS;
+  }
+
+  return WAVE_SUCCESS;
+}
+
+int ShardReader::next(ShardEntry *entry, unsigned char **data) {
+  if ((entry == NULL) || (data == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+  if (fp_ == NULL) {
+    fprintf(stderr, "wave::ShardReader::next() - shard is not opened.\n");
+    return WAVE_INVALID_USAGE;
+  }
+
+  // Release pre-allocated memory
+  if ((*data) != NULL) {
+    delete[](*data);
+    (*data) = NULL;
+  }
+
+  int error_code = readHeader(entry);
+  if (error_code != WAVE_SUCCESS) {
+    return error_code;
+  }
+  if (entry->name.empty()) {
+    return WAVE_SUCCESS; // end of shard
+  }
+
+  if (entry->size > 0) {
+    (*data) = new unsigned char[entry->size];
+    if (entry->size != fread(*data, 1, entry->size, fp_)) {
+      fprintf(stderr, "wave::ShardReader::next() - failed to read member %s\n",
+              entry->name.c_str());
+      delete[](*data);
+      (*data) = NULL;
+      return WAVE_FILE_IO_FAILED;
+    }
+  }
+
+  position_ += pad_to_block(entry->size);
+  if (pad_to_block(entry->size) != entry->size) {
+    fseeko(fp_, (off_t)position_, SEEK_SET);
+  }
+  return WAVE_SUCCESS;
+}
+
+int ShardReader::buildIndex() {
+  if (fp_ == NULL) {
+    fprintf(stderr, "wave::ShardReader::buildIndex() - shard is not opened.\n");
+    return WAVE_INVALID_USAGE;
+  }
+
+  entries_.clear();
+  position_ = 0;
+  is_end_ = false;
+  fseeko(fp_, 0, SEEK_SET);
+
+  while (true) {
+    ShardEntry entry;
+    int error_code = readHeader(&entry);
+    if (error_code != WAVE_SUCCESS) {
+      return error_code;
+    }
+    if (entry.name.empty()) {
+      break;
+    }
+    entries_.push_back(entry);
+
+    position_ += pad_to_block(entry.size);
+    fseeko(fp_, (off_t)position_, SEEK_SET);
+  }
+
+  // rewind for sequential reading
+  position_ = 0;
+  is_end_ = false;
+  fseeko(fp_, 0, SEEK_SET);
+
+  return WAVE_SUCCESS;
+}
+
+int ShardReader::readEntry(const size_t index, unsigned char **data,
+                           size_t *size) const {
+  if ((data == NULL) || (size == NULL) || (index >= entries_.size())) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+  if (fp_ == NULL) {
+    fprintf(stderr, "wave::ShardReader::readEntry() - shard is not opened.\n");
+    return WAVE_INVALID_USAGE;
+  }
+
+  // Release pre-allocated memory
+  if ((*data) != NULL) {
+    delete[](*data);
+    (*data) = NULL;
+  }
+
+  const ShardEntry &entry = entries_[index];
+  (*size) = (size_t)entry.size;
+  if (entry.size == 0) {
+    return WAVE_SUCCESS;
+  }
+
+  unsigned char *bytes = new unsigned char[entry.size];
+  const int fd = fileno(fp_);
+  size_t num_read = 0;
+  while (num_read < entry.size) {
+    ssize_t n = pread(fd, bytes + num_read, entry.size - num_read,
+                      (off_t)(entry.offset + num_read));
+    if (n <= 0) {
+      fprintf(stderr, "wave::ShardReader::readEntry() - failed to read member %s\n",
+              entry.name.c_str());
+      delete[] bytes;
+      return WAVE_FILE_IO_FAILED;
+    }
+    num_read += (size_t)n;
+  }
+
+  (*data) = bytes;
+  return WAVE_SUCCESS;
+}
+
+///// local functions /////
+
+uint64_t parse_tar_number(const unsigned char *field, const unsigned int length) {
+  uint64_t value = 0;
+
+  if ((field[0] & 0x80) != 0) {
+    // base-256 encoding of GNU tar for large files
+    value = field[0] & 0x7F;
+    for (unsigned int i = 1; i < length; i++) {
+      value = (value << 8) | field[i];
+    }
+    return value;
+  }
+
+  for (unsigned int i = 0; i < length; i++) {
+    if (field[i] == ' ') {
+      continue;
+    }
+    if (field[i] < '0' || field[i] > '7') {
+      break;
+    }
+    value = (value << 3) | (uint64_t)(field[i] - '0');
+  }
+  return value;
+}
+
+bool is_zero_block(const unsigned char *block) {
+  for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i++) {
+    if (block[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool check_tar_checksum(const unsigned char *block) {
+  const uint64_t expected = parse_tar_number(block + 148, 8);
+  uint64_t sum = 0;
+  for (unsigned int i = 0; i < TAR_BLOCK_SIZE; i++) {
+    // checksum field itself is treated as spaces
+    sum += (i >= 148 && i < 156) ? (uint64_t)' ' : (uint64_t)block[i];
+  }
+  return sum == expected;
+}
+
+void parse_pax_header(const char *data, const size_t size, std::string *path,
+                      uint64_t *file_size) {
+  // records are formed as "<length> <key>=<value>\n"
+  size_t offset = 0;
+  while (offset < size) {
+    char *end = NULL;
+    unsigned long length = strtoul(data + offset, &end, 10);
+    if (length == 0 || end == NULL || offset + length > size) {
+      break;
+    }
+    const char *key = end + 1;
+    const char *record_end = data + offset + length - 1; // '\n'
+    // Record must hold the length, a space and a key after it
+    if (*end != ' ' || record_end <= key) {
+      break;
+    }
+    const char *equal = (const char *)memchr(key, '=', record_end - key);
+    if (equal != NULL) {
+      std::string name(key, equal - key);
+      std::string value(equal + 1, record_end - equal - 1);
+      if (name == "path") {
+        (*path) = value;
+      } else if (name == "size") {
+        (*file_size) = strtoull(value.c_str(), NULL, 10);
+      }
+    }
+    offset += length;
+  }
+}
+
+} // namespace wave
@@ -0,0 +1,67 @@
+#ifndef WAVE_WAVE_SHARD_H
+#define WAVE_WAVE_SHARD_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace wave {
+
+typedef struct shard_entry_t {
+  std::string name;  // member name in the shard
+  uint64_t offset;   // offset of member data from start of the shard
+  uint64_t size;     // number of bytes of member data
+} ShardEntry;
+
+// Reader of audio shards, a single uncompressed tar (ustar, GNU or pax)
+// archive holding many WAV, FLAC or headerless PCM files as its members.
+// A shard is opened once and can be iterated sequentially with large reads,
+// or accessed randomly after building offset index. Members are usually
+// decoded with `WaveReader::read()` on memory, or `WaveReader::readPcm()` if
+// they are named `.pcm` or `.raw`.
+class ShardReader {
+public:
+  ShardReader();
+  virtual ~ShardReader();
+
+private:
+  FILE *fp_;
+  char *io_buffer_;
+  uint64_t file_size_;
+  uint64_t position_;  // offset of next tar header
+  bool is_end_;
+
+  std::vector<ShardEntry> entries_;
+
+  // Read tar header at `position_`, and fill `entry` of next regular file.
+  // Extended headers (GNU long name & pax) and non-regular files are skipped.
+  int readHeader(ShardEntry *entry);
+
+public:
+  // Open shard file for reading
+  int open(const char *file_name);
+  void close();
+
+  // Read next member. Memory of `data` is allocated in this function, and
+  // pre-allocated memory is released. At the end of shard, WAVE_SUCCESS is
+  // returned with empty `entry->name`.
+  int next(ShardEntry *entry, unsigned char **data);
+
+  // Scan all headers and build index for random access. Note that this
+  // function seeks over member data, so sequential `next()` is cheaper when
+  // whole shard will be read anyway.
+  int buildIndex();
+
+  size_t getNumEntries() const { return entries_.size(); }
+  const ShardEntry &getEntry(const size_t index) const { return entries_[index]; }
+
+  // Read member data of `index` th entry in index. This function uses
+  // positional read, thus it can be called from multiple threads at once.
+  int readEntry(const size_t index, unsigned char **data, size_t *size) const;
+}; // class ShardReader
+
+} // namespace wave
+
+#endif // WAVE_WAVE_SHARD_H
@@ -0,0 +1,218 @@
+#include "wave/wave_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "wave/wave.h"
+
+#ifndef BITS_PER_BYTE
+#define BITS_PER_BYTE 8
+#endif
+
+namespace wave {
+
+PcmStreamReader::PcmStreamReader(const unsigned int sampling_rate,
+                                 const unsigned int bit_rate,
+                                 const unsigned int num_channels)
+    : sampling_rate_(0), bit_rate_(0), num_channels_(0), fd_(-1),
+      own_fd_(false), is_eof_(false), buffer_(NULL), buffer_size_(0),
+      num_pending_bytes_(0) {
+  if (sampling_rate != 0 && bit_rate != 0 && num_channels != 0) {
+    init(sampling_rate, bit_rate, num_channels);
+  }
+}
+
+PcmStreamReader::~PcmStreamReader() {
+  close();
+  if (buffer_ != NULL) {
+    delete[] buffer_;
+    buffer_ = NULL;
+  }
+}
+
+int PcmStreamReader::init(const unsigned int sampling_rate,
+                          const unsigned int bit_rate,
+                          const unsigned int num_channels) {
+  if (sampling_rate == 0 || num_channels == 0) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+
+  switch (bit_rate) {
+  case 8:
+  case 16:
+  case 24:
+  case 32:
+    break;
+
+  default:
+    return WAVE_UNSUPPORTED_TYPE;
+  }
+
+  sampling_rate_ = sampling_rate;
+  bit_rate_ = bit_rate;
+  num_channels_ = num_channels;
+  return WAVE_SUCCESS;
+}
+
+int PcmStreamReader::open(const char *file_name) {
+  if (file_name == NULL) {
+    fprintf(stderr, "wave::PcmStreamReader::open() - invalid argument `file_name`.\n");
+    return WAVE_INVALID_ARG_VALUE;
+  }
+  if (bit_rate_ == 0) {
+    fprintf(stderr, "wave::PcmStreamReader::open() - format is not setted. "
+                    "call init() first.\n");
+    return WAVE_INVALID_USAGE;
+  }
+
+  close();
+
+  if (strcmp(file_name, "-") == 0) {
+    fd_ = STDIN_FILENO;
+    own_fd_ = false;
+  } else {
+    fd_ = ::open(file_name, O_RDONLY);
+    own_fd_ = true;
+  }
+  if (fd_ < 0) {
+    fprintf(stderr, "wave::PcmStreamReader::open() - failed to open file %s\n",
+            file_name);
+    return WAVE_FILE_IO_FAILED;
+  }
+
+  is_eof_ = false;
+  num_pending_bytes_ = 0;
+  return WAVE_SUCCESS;
+}
+
+void PcmStreamReader::close() {
+  if (fd_ >= 0 && own_fd_) {
+    ::close(fd_);
+  }
+  fd_ = -1;
+  own_fd_ = false;
+  is_eof_ = false;
+  num_pending_bytes_ = 0;
+}
+
+template <typename T>
+int PcmStreamReader::readSamples(T *dest, unsigned int max_samples,
+                                 unsigned int *num_samples) {
+  if ((dest == NULL) || (num_samples == NULL)) {
+    return WAVE_INVALID_ARG_VALUE;
+  }
+  if (fd_ < 0) {
+    fprintf(stderr, "wave::PcmStreamReader::read() - stream is not opened.\n");
+    return WAVE_INVALID_USAGE;
+  }
+
+  (*num_samples) = 0;
+
+  const unsigned int sample_bytes = bit_rate_ / BITS_PER_BYTE;
+  const unsigned int frame_bytes = sample_bytes * num_channels_;
+  max_samples -= max_samples % num_channels_;
+  if (max_samples == 0 || is_eof_) {
+    return WAVE_SUCCESS;
+  }
+
+  const unsigned int required = max_samples * sample_bytes;
+  if (buffer_size_ < required) {
+    unsigned char *buffer = new unsigned char[required];
+    if (buffer_ != NULL) {
+      memcpy(buffer, buffer_, num_pending_bytes_);
+      delete[] buffer_;
+    }
+    buffer_ = buffer;
+    buffer_size_ = required;
+  }
+
+  // Wait until at least one complete frame is available, but do not wait for
+  // whole buffer to be filled.
+  unsigned int num_bytes = num_pending_bytes_;
+  while (num_bytes < frame_bytes) {
+    ssize_t n = ::read(fd_, buffer_ + num_bytes, required - num_bytes);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "wave::PcmStreamReader::read() - failed to read data.\n");
+      return WAVE_FILE_IO_FAILED;
+    }
+    if (n == 0) {
+      is_eof_ = true;
+      break;
+    }
+    num_bytes += (unsigned int)n;
+  }
+
+  const unsigned int num_frames = num_bytes / frame_bytes;
+  const unsigned int n = num_frames * num_channels_;
+  const unsigned char *src = buffer_;
+
+  switch (bit_rate_) {
+  case 8: {
+    const T scale = (T)1.0 / (T)128.0;
+    for (unsigned int i = 0; i < n; i++) {
+      dest[i] = (T)((int)src[i] - 128) * scale;
+    }
+    break;
+  }
+  case 16: {
+    const T scale = (T)1.0 / (T)32768.0;
+    for (unsigned int i = 0; i < n; i++) {
+      int16_t sample = (int16_t)((uint16_t)src[2 * i] |
+                                 ((uint16_t)src[2 * i + 1] << 8));
+      dest[i] = (T)sample * scale;
+    }
+    break;
+  }
+  case 24: {
+    const T scale = (T)1.0 / (T)8388608.0;
+    for (unsigned int i = 0; i < n; i++) {
+      const unsigned char *p = src + 3 * i;
+      int32_t sample = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+                                 ((uint32_t)p[2] << 24)) >> 8;
+      dest[i] = (T)sample * scale;
+    }
+    break;
+  }
+  case 32: {
+    const T scale = (T)1.0 / (T)2147483648.0;
+    for (unsigned int i = 0; i < n; i++) {
+      const unsigned char *p = src + 4 * i;
+      int32_t sample = (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                                 ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+      dest[i] = (T)sample * scale;
+    }
+    break;
+  }
+  default:
+    return WAVE_UNSUPPORTED_TYPE;
+  }
+
+  // keep incomplete frame for next read
+  num_pending_bytes_ = num_bytes - num_frames * frame_bytes;
+  if (num_pending_bytes_ > 0) {
+    memmove(buffer_, buffer_ + num_frames * frame_bytes, num_pending_bytes_);
+  }
+
+  (*num_samples) = n;
+  return WAVE_SUCCESS;
+}
+
+int PcmStreamReader::read(float *dest, unsigned int max_samples,
+                          unsigned int *num_samples) {
+  return readSamples<float>(dest, max_samples, num_samples);
+}
+
+int PcmStreamReader::read(double *dest, unsigned int max_samples,
+                          unsigned int *num_samples) {
+  return readSamples<double>(dest, max_samples, num_samples);
+}
+
+} // namespace wave
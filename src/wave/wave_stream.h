@@ -0,0 +1,72 @@
+#ifndef WAVE_WAVE_STREAM_H
+#define WAVE_WAVE_STREAM_H
+
+#include <stdio.h>
+
+namespace wave {
+
+// Interface of readers which decode audio incrementally, so that consumers
+// can process samples while the rest of input is still being produced.
+class StreamReader {
+public:
+  virtual ~StreamReader() {}
+
+  virtual unsigned int getSamplingRate() const = 0;
+  virtual unsigned int getBitRate() const = 0;
+  virtual unsigned int getNumChannels() const = 0;
+
+  // Decode at most `max_samples` interleaved samples into `dest`.
+  // `num_samples` is set to number of decoded samples, which is 0 at the end
+  // of stream. Note that `max_samples` must be multiple of number of channels.
+  virtual int read(float *dest, unsigned int max_samples,
+                   unsigned int *num_samples) = 0;
+  virtual int read(double *dest, unsigned int max_samples,
+                   unsigned int *num_samples) = 0;
+}; // class StreamReader
+
+// Reader of headerless PCM (little endian, signed except 8 bits) from file,
+// pipe or standard input. Returns as soon as any data are available, thus
+// samples can be consumed while producer is still writing.
+class PcmStreamReader : public StreamReader {
+public:
+  PcmStreamReader(const unsigned int sampling_rate = 0,
+                  const unsigned int bit_rate = 0,
+                  const unsigned int num_channels = 0);
+  virtual ~PcmStreamReader();
+
+private:
+  unsigned int sampling_rate_;
+  unsigned int bit_rate_;
+  unsigned int num_channels_;
+
+  int fd_;
+  bool own_fd_;
+  bool is_eof_;
+
+  unsigned char *buffer_;
+  unsigned int buffer_size_;
+  unsigned int num_pending_bytes_; // incomplete sample frame of last read
+
+  template <typename T>
+  int readSamples(T *dest, unsigned int max_samples, unsigned int *num_samples);
+
+public:
+  unsigned int getSamplingRate() const { return sampling_rate_; }
+  unsigned int getBitRate() const { return bit_rate_; }
+  unsigned int getNumChannels() const { return num_channels_; }
+
+  // Supported bit rates are 8, 16, 24 and 32.
+  int init(const unsigned int sampling_rate, const unsigned int bit_rate,
+           const unsigned int num_channels);
+
+  // Open file for reading. If `file_name` is "-", standard input is used.
+  int open(const char *file_name);
+  void close();
+
+  int read(float *dest, unsigned int max_samples, unsigned int *num_samples);
+  int read(double *dest, unsigned int max_samples, unsigned int *num_samples);
+}; // class PcmStreamReader
+
+} // namespace wave
+
+#endif // WAVE_WAVE_STREAM_H
@@ -1,8 +1,26 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "gflags/gflags.h"
 
 #include "wave/wave.h"
+#include "wave/wave_gain.h"
+#include "wave/wave_shard.h"
+#include "wave/wave_stream.h"
+
+#ifndef WAVE_TEST_DATA_DIR
+#define WAVE_TEST_DATA_DIR "testdata"
+#endif
 
 DEFINE_uint32(sampling_rate, 16000, "sampling rate");
 DEFINE_uint32(bit_rate, 16, "bit rate");
@@ -10,6 +28,440 @@ DEFINE_uint32(num_channels, 1, "number of channels");
 
 DEFINE_string(input_file_name, "", "name of input file");
 DEFINE_string(output_file_name, "", "name of output file");
+DEFINE_string(test_data_dir, WAVE_TEST_DATA_DIR, "directory of test files, "
+              "which are tested if `input_file_name` is not given");
+
+// `stereo16.flac` is a stereo 16 bit FLAC file of 9 frames, which has
+// CONSTANT, VERBATIM, FIXED (order 0 ~ 4) and LPC (order 1 ~ 32) subframes,
+// all stereo decorrelation modes, wasted bits, escaped partitions and both
+// Rice coding methods. `stereo16.wav` has same samples.
+#define FLAC_FIXTURE "stereo16"
+
+int readFileBytes(const std::string& file_name, std::vector<unsigned char>* bytes) {
+    FILE* fp = fopen(file_name.c_str(), "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "failed to open file : %s\n", file_name.c_str());
+        return 1;
+    }
+    unsigned char buffer[4096];
+    size_t num_read;
+    bytes->clear();
+    while ((num_read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        bytes->insert(bytes->end(), buffer, buffer + num_read);
+    }
+    fclose(fp);
+    return 0;
+}
+
+// Decode FLAC fixture from file and from memory, and compare with WAV twin
+int testFlacFixture() {
+    const std::string prefix = FLAGS_test_data_dir + "/" + FLAC_FIXTURE;
+    wave::WaveReader reader;
+    reader.init(16000, 16, 2);
+
+    float* expected = NULL;
+    float* decoded = NULL;
+    unsigned int num_expected = 0, num_decoded = 0;
+    int error_code = 0;
+    if (reader.read((prefix + ".wav").c_str(), &expected, &num_expected) != WAVE_SUCCESS ||
+        reader.read((prefix + ".flac").c_str(), &decoded, &num_decoded) != WAVE_SUCCESS ||
+        num_decoded != num_expected ||
+        memcmp(decoded, expected, sizeof(float) * num_expected) != 0) {
+        error_code = 1;
+    }
+    fprintf(stdout, "flac file   : %u / %u samples%s\n", num_decoded, num_expected,
+            (error_code == 0) ? "" : " FAILED");
+    delete[] decoded;
+    decoded = NULL;
+
+    std::vector<unsigned char> bytes;
+    if (readFileBytes(prefix + ".flac", &bytes) != 0 ||
+        reader.read(bytes.data(), bytes.size(), &decoded, &num_decoded) != WAVE_SUCCESS ||
+        num_decoded != num_expected ||
+        memcmp(decoded, expected, sizeof(float) * num_expected) != 0) {
+        fprintf(stdout, "flac memory : FAILED\n");
+        error_code = 1;
+    }
+    delete[] decoded;
+    decoded = NULL;
+
+    // ID3v2 tag of 10 + 130 bytes before stream, with size above 7 bits
+    std::vector<unsigned char> tagged(140, 0);
+    memcpy(tagged.data(), "ID3\x04\x00\x00\x00\x00\x01\x02", 10);
+    tagged.insert(tagged.end(), bytes.begin(), bytes.end());
+    if (reader.read(tagged.data(), tagged.size(), &decoded, &num_decoded) != WAVE_SUCCESS ||
+        num_decoded != num_expected ||
+        memcmp(decoded, expected, sizeof(float) * num_expected) != 0) {
+        fprintf(stdout, "flac id3    : FAILED\n");
+        error_code = 1;
+    }
+    delete[] decoded;
+    delete[] expected;
+    return error_code;
+}
+
+// Corrupt frames are rejected by CRC-8 of header or CRC-16 of frame
+int testFlacCorrupt() {
+    std::vector<unsigned char> bytes;
+    if (readFileBytes(FLAGS_test_data_dir + "/" + FLAC_FIXTURE + ".flac", &bytes) != 0) {
+        return 1;
+    }
+    // First frame follows "fLaC", STREAMINFO and PADDING of 10 bytes
+    const size_t first_frame = 4 + 4 + 34 + 4 + 10;
+    const struct {
+        const char* name;
+        size_t offset;
+    } cases[] = {
+        {"header", first_frame + 4},       // frame number
+        {"body", bytes.size() / 2},
+        {"padding", bytes.size() - 3},     // last byte before CRC-16
+        {"crc16", bytes.size() - 1},
+    };
+
+    wave::WaveReader reader;
+    reader.init(16000, 16, 2);
+    int error_code = 0;
+    for (const auto& c : cases) {
+        std::vector<unsigned char> corrupt = bytes;
+        corrupt[c.offset] ^= 0x01;
+        float* decoded = NULL;
+        unsigned int num_decoded = 0;
+        const int ret = reader.read(corrupt.data(), corrupt.size(), &decoded,
+                                    &num_decoded);
+        delete[] decoded;
+        fprintf(stdout, "flac corrupt %-8s: %s\n", c.name,
+                (ret == WAVE_INVALID_FORMAT) ? "rejected" : "FAILED");
+        if (ret != WAVE_INVALID_FORMAT) {
+            error_code = 1;
+        }
+    }
+    return error_code;
+}
+
+// Decode fixture repeatedly, and compare speed with real time
+int testFlacSpeed() {
+    std::vector<unsigned char> bytes;
+    if (readFileBytes(FLAGS_test_data_dir + "/" + FLAC_FIXTURE + ".flac", &bytes) != 0) {
+        return 1;
+    }
+    wave::WaveReader reader;
+    reader.init(16000, 16, 2);
+    double audio_sec = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while (elapsed < 0.2) {
+        float* decoded = NULL;
+        unsigned int num_decoded = 0;
+        if (reader.read(bytes.data(), bytes.size(), &decoded, &num_decoded) != WAVE_SUCCESS) {
+            return 1;
+        }
+        delete[] decoded;
+        audio_sec += num_decoded / 2 / 16000.0;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    const double speed = audio_sec / elapsed;
+    fprintf(stdout, "flac speed  : %.0f x real time\n", speed);
+    return (speed >= 10) ? 0 : 1;
+}
+
+// Headerless PCM is read only when asked, and must hold whole samples
+int testPcm() {
+    const unsigned char bytes[] = {'a', 'b', 'c', 'd', 0x10, 0x00, 0xF0, 0xFF};
+    wave::WaveReader reader;
+    reader.init(16000, 16, 2);
+    float* decoded = NULL;
+    unsigned int num_decoded = 0;
+    int error_code = 0;
+    if (reader.read(bytes, sizeof(bytes), &decoded, &num_decoded) != WAVE_INVALID_FORMAT) {
+        error_code = 1;
+    }
+    // Half of stereo sample
+    if (reader.readPcm(bytes, 6, &decoded, &num_decoded) != WAVE_INVALID_FORMAT) {
+        error_code = 1;
+    }
+    if (reader.readPcm(bytes, sizeof(bytes), &decoded, &num_decoded) != WAVE_SUCCESS ||
+        num_decoded != 4 || decoded[2] != 16 / 32768.0f ||
+        decoded[3] != -16 / 32768.0f) {
+        error_code = 1;
+    }
+    delete[] decoded;
+    fprintf(stdout, "pcm         : %s\n", (error_code == 0) ? "ok" : "FAILED");
+    return error_code;
+}
+
+// Samples streamed from file and from pipe a few at a time, also split in
+// the middle of samples, are same as those of whole PCM
+int testPcmStream() {
+    std::vector<unsigned char> bytes(4 * 1000);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = (unsigned char)(i * 37 + 11);
+    }
+    wave::WaveReader reader;
+    reader.init(16000, 16, 2);
+    float* expected = NULL;
+    unsigned int num_expected = 0;
+    if (reader.readPcm(bytes.data(), bytes.size(), &expected, &num_expected) != WAVE_SUCCESS) {
+        return 1;
+    }
+
+    int error_code = 0;
+    float chunk[64];
+    unsigned int num_read = 0;
+    std::vector<float> streamed;
+    wave::PcmStreamReader stream;
+    stream.init(16000, 16, 2);
+
+    char file_name[] = "/tmp/wave_test_XXXXXX";
+    const int fd = mkstemp(file_name);
+    if (fd < 0) {
+        delete[] expected;
+        return 1;
+    }
+    const bool is_written = (write(fd, bytes.data(), bytes.size()) == (ssize_t)bytes.size());
+    close(fd);
+    if (!is_written || stream.open(file_name) != WAVE_SUCCESS) {
+        error_code = 1;
+    }
+    for (unsigned int i = 0; error_code == 0; i++) {
+        if (stream.read(chunk, 2 + 2 * (i % 5), &num_read) != WAVE_SUCCESS) {
+            error_code = 1;
+        }
+        if (num_read == 0) {
+            break;
+        }
+        streamed.insert(streamed.end(), chunk, chunk + num_read);
+    }
+    stream.close();
+    unlink(file_name);
+    if (streamed.size() != num_expected ||
+        memcmp(streamed.data(), expected, sizeof(float) * num_expected) != 0) {
+        error_code = 1;
+    }
+
+    // Each write holds at least one whole sample with the rest of last one
+    int fds[2];
+    if (pipe(fds) != 0) {
+        delete[] expected;
+        return 1;
+    }
+    const std::string pipe_name = "/dev/fd/" + std::to_string(fds[0]);
+    if (stream.open(pipe_name.c_str()) != WAVE_SUCCESS) {
+        error_code = 1;
+    }
+    streamed.clear();
+    size_t offset = 0;
+    for (unsigned int i = 0; error_code == 0 && offset < bytes.size(); i++) {
+        const size_t length = std::min((size_t)(5 + 2 * (i % 4)), bytes.size() - offset);
+        if (write(fds[1], bytes.data() + offset, length) != (ssize_t)length ||
+            stream.read(chunk, 64, &num_read) != WAVE_SUCCESS) {
+            error_code = 1;
+        }
+        streamed.insert(streamed.end(), chunk, chunk + num_read);
+        offset += length;
+    }
+    close(fds[1]);
+    while (error_code == 0) {
+        if (stream.read(chunk, 64, &num_read) != WAVE_SUCCESS) {
+            error_code = 1;
+        }
+        if (num_read == 0) {
+            break;
+        }
+        streamed.insert(streamed.end(), chunk, chunk + num_read);
+    }
+    stream.close();
+    close(fds[0]);
+    if (streamed.size() != num_expected ||
+        memcmp(streamed.data(), expected, sizeof(float) * num_expected) != 0) {
+        error_code = 1;
+    }
+    delete[] expected;
+    fprintf(stdout, "pcm stream  : %s\n", (error_code == 0) ? "ok" : "FAILED");
+    return error_code;
+}
+
+// Tone of `num_samples` with noise and DC offset, and loud bursts in the
+// middle if `has_bursts`
+std::vector<float> makeTone(const unsigned int num_samples, const bool has_bursts) {
+    std::vector<float> wav(num_samples);
+    uint32_t seed = 1;
+    for (unsigned int i = 0; i < num_samples; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        const double noise = (double)(seed >> 8) / (1 << 24) - 0.5;
+        double amplitude = 0.05;
+        if (has_bursts && (i / 4000) % 3 == 1) {
+            amplitude = 0.9;
+        }
+        wav[i] = (float)(amplitude * sin(0.05 * i) + 0.01 * noise + 0.003);
+    }
+    return wav;
+}
+
+// Statistics accumulated chunk by chunk and merged are same as naive ones
+int testStats() {
+    const std::vector<float> wav = makeTone(100003, true);
+    double sum = 0, sum_sq = 0, peak = 0;
+    for (const auto sample : wav) {
+        sum += sample;
+        sum_sq += (double)sample * sample;
+        peak = std::max(peak, (double)fabs(sample));
+    }
+    const double rms = sqrt(sum_sq / wav.size());
+    const double dc_offset = sum / wav.size();
+
+    wave::WaveStatsAccumulator first, second;
+    const unsigned int half = (unsigned int)wav.size() / 2;
+    for (unsigned int i = 0, length = 1; i < half; i += length, length = length * 2 + 1) {
+        first.update(wav.data() + i, std::min(length, half - i));
+    }
+    second.update(wav.data() + half, (unsigned int)wav.size() - half);
+    first.merge(second);
+    wave::WaveStats stats;
+    first.getStats(&stats);
+
+    int error_code = 0;
+    if (stats.num_samples != wav.size() || fabs(stats.rms - rms) > 1e-12 * rms ||
+        stats.peak != peak || fabs(stats.dc_offset - dc_offset) > 1e-12) {
+        error_code = 1;
+    }
+    // Silence is left as is, instead of scaled by infinity
+    std::vector<float> silence(160, 0.0f);
+    if (wave::normalizeDb(silence.data(), (unsigned int)silence.size(), -20.0f) != 0 ||
+        silence != std::vector<float>(160, 0.0f)) {
+        error_code = 1;
+    }
+    fprintf(stdout, "stats       : %s\n", (error_code == 0) ? "ok" : "FAILED");
+    return error_code;
+}
+
+// Output of gain control is delayed by its latency, has as many samples as
+// input, does not exceed ceiling, and is same whether input is given at once
+// or chunk by chunk
+int testAutoGainControl() {
+    const std::vector<float> wav = makeTone(48000, true);
+    const double ceiling = 0.5;
+    wave::AutoGainControl agc;
+    if (agc.init(16000, -20.0, 0.005, 0.4, 0.05, 0.5, 30.0, ceiling) != 0) {
+        return 1;
+    }
+    const unsigned int latency = agc.getLatency();
+    int error_code = (latency == 80) ? 0 : 1;
+
+    std::vector<float> whole(wav.size());
+    unsigned int num_output = 0, num_flushed = 0;
+    agc.process(wav.data(), (unsigned int)wav.size(), whole.data(), &num_output);
+    agc.flush(whole.data() + num_output, &num_flushed);
+    if (num_output != wav.size() - latency || num_flushed != latency) {
+        error_code = 1;
+    }
+    float max_output = 0;
+    for (const auto sample : whole) {
+        max_output = std::max(max_output, (float)fabs(sample));
+    }
+    if (max_output > ceiling + 1e-6 || max_output < ceiling * 0.9) {
+        error_code = 1;
+    }
+
+    agc.reset();
+    std::vector<float> streamed;
+    std::vector<float> chunk(1000 + latency);
+    for (unsigned int i = 0, length = 1; i < wav.size(); i += length, length = length % 997 + 13) {
+        length = std::min(length, (unsigned int)wav.size() - i);
+        agc.process(wav.data() + i, length, chunk.data(), &num_output);
+        streamed.insert(streamed.end(), chunk.begin(), chunk.begin() + num_output);
+    }
+    agc.flush(chunk.data(), &num_flushed);
+    streamed.insert(streamed.end(), chunk.begin(), chunk.begin() + num_flushed);
+    if (streamed != whole) {
+        error_code = 1;
+    }
+    fprintf(stdout, "agc         : %s\n", (error_code == 0) ? "ok" : "FAILED");
+    return error_code;
+}
+
+// Append tar header of `type` and `size` to `tar`
+void appendTarHeader(const char* name, const char type, const uint64_t size,
+                     std::vector<unsigned char>* tar) {
+    unsigned char block[512];
+    memset(block, 0, sizeof(block));
+    snprintf((char*)block, 100, "%s", name);
+    snprintf((char*)block + 124, 12, "%011llo", (unsigned long long)size);
+    block[156] = (unsigned char)type;
+    memcpy(block + 257, "ustar", 6);
+    memset(block + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (unsigned int i = 0; i < sizeof(block); i++) {
+        checksum += block[i];
+    }
+    snprintf((char*)block + 148, 8, "%06o", checksum);
+    tar->insert(tar->end(), block, block + sizeof(block));
+}
+
+// Read all members of `tar`, and return error code of the first failure
+int readShard(const std::vector<unsigned char>& tar, unsigned int* num_members) {
+    char file_name[] = "/tmp/wave_test_XXXXXX";
+    const int fd = mkstemp(file_name);
+    if (fd < 0) {
+        return WAVE_FILE_IO_FAILED;
+    }
+    const bool is_written = (write(fd, tar.data(), tar.size()) == (ssize_t)tar.size());
+    close(fd);
+    wave::ShardReader shard;
+    int error_code = is_written ? shard.open(file_name) : WAVE_FILE_IO_FAILED;
+    (*num_members) = 0;
+    unsigned char* data = NULL;
+    while (error_code == WAVE_SUCCESS) {
+        wave::ShardEntry entry;
+        error_code = shard.next(&entry, &data);
+        if (error_code != WAVE_SUCCESS || entry.name.empty()) {
+            break;
+        }
+        (*num_members)++;
+    }
+    delete[] data;
+    shard.close();
+    unlink(file_name);
+    return error_code;
+}
+
+// Sizes in headers of shard are checked before memory is allocated
+int testShardBounds() {
+    std::vector<unsigned char> tar;
+    appendTarHeader("a.pcm", '0', 1000, &tar);
+    tar.resize(tar.size() + 1024);
+    const size_t valid_size = tar.size();
+
+    int error_code = 0;
+    unsigned int num_members = 0;
+    if (readShard(tar, &num_members) != WAVE_SUCCESS || num_members != 1) {
+        error_code = 1;
+    }
+    // Member larger than rest of file
+    std::vector<unsigned char> broken = tar;
+    appendTarHeader("b.pcm", '0', (uint64_t)1 << 40, &broken);
+    if (readShard(broken, &num_members) != WAVE_INVALID_FORMAT || num_members != 1) {
+        error_code = 1;
+    }
+    // Extended header over limit
+    broken.resize(valid_size);
+    appendTarHeader("././@PaxHeader", 'x', (uint64_t)1 << 33, &broken);
+    if (readShard(broken, &num_members) != WAVE_INVALID_FORMAT || num_members != 1) {
+        error_code = 1;
+    }
+    // Pax record shorter than its length field is ignored
+    broken.resize(valid_size);
+    const char record[] = "1\n";
+    appendTarHeader("././@PaxHeader", 'x', sizeof(record) - 1, &broken);
+    broken.insert(broken.end(), record, record + sizeof(record) - 1);
+    broken.resize(broken.size() + 512 - (sizeof(record) - 1));
+    appendTarHeader("b.pcm", '0', 4, &broken);
+    broken.resize(broken.size() + 512);
+    if (readShard(broken, &num_members) != WAVE_SUCCESS || num_members != 2) {
+        error_code = 1;
+    }
+    fprintf(stdout, "shard bounds: %s\n", (error_code == 0) ? "ok" : "FAILED");
+    return error_code;
+}
 
 int main(int argc, char** argv) {
 
@@ -17,6 +469,21 @@ int main(int argc, char** argv) {
     gflags::SetVersionString("1.0.0");        
     gflags::ParseCommandLineFlags(&argc, &argv, true);
 
+    if (FLAGS_input_file_name.empty()) {
+        int error_code = 0;
+        error_code |= testFlacFixture();
+        error_code |= testFlacCorrupt();
+        error_code |= testFlacSpeed();
+        error_code |= testPcm();
+        error_code |= testPcmStream();
+        error_code |= testStats();
+        error_code |= testAutoGainControl();
+        error_code |= testShardBounds();
+        fprintf(stdout, "%s\n", (error_code == 0) ? "PASSED" : "FAILED");
+        gflags::ShutDownCommandLineFlags();
+        return error_code;
+    }
+
     const unsigned int sampling_rate = FLAGS_sampling_rate;
     const unsigned int bit_rate = FLAGS_bit_rate;
     const unsigned int num_channels = FLAGS_num_channels;